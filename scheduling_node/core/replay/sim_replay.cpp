@@ -0,0 +1,452 @@
+/*
+	@brief
+	Replays one pipeline stage from a channel log recorded with
+	sim_sc --chan-log (src/chan_log.h), without the rest of the core, the
+	memories or the testbench. Every input port of the stage is driven with
+	the messages its channel carried, each offered no earlier than the
+	cycle it was consumed in the recording; every output port is drained
+	at the recorded cycles and checked against the messages the consumer
+	of that channel received. The reset pulses are replayed too.
+
+	The signal inputs (entry_pc, the HPM event lines into execute) are
+	driven with their recorded values, each visible from the cycle it was
+	read in. The signal outputs that feed them (imem_wait, hpm_events,
+	dmem_wait) are checked against the sequence of recorded values.
+
+	The log is streamed: it is decoded a few cycles ahead of the
+	simulation and only the messages of the replayed ports are kept, until
+	they are consumed.
+
+	Usage: sim_replay <chan.log> <fetch|decode|execute|writeback> [--max-mismatches <n>]
+
+*/
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "drim4hls_datatypes.h"
+#include "defines.h"
+#include "globals.h"
+#include "fetch.h"
+#include "decode.h"
+#include "execute.h"
+#include "writeback.h"
+#include "chan_log.h"
+
+#include <mc_connections.h>
+
+// Progress of one replayed port.
+class replay_port {
+    public:
+    replay_port(chan_log_reader & log, const std::string & suffix, unsigned max_mismatches):
+        log(log),
+        handle(log.subscribe(suffix)),
+        suffix(suffix),
+        mismatches(0),
+        extra(0),
+        max_mismatches(max_mismatches) {}
+
+    virtual ~replay_port() {}
+
+    unsigned long long taken() const {
+        return log.channel(handle).taken;
+    }
+
+    // Messages of the channel in the log, once it is read to the end.
+    unsigned long long recorded() const {
+        return taken() + log.channel(handle).pending.size();
+    }
+
+    bool done() const {
+        return log.done(handle);
+    }
+
+    // Messages past the last recorded one are not failures: the
+    // recording stops wherever sim_sc does, before the consumer took them.
+    bool failed() const {
+        return mismatches != 0;
+    }
+
+    virtual void report(std::ostream & os) const = 0;
+
+    protected:
+    chan_log_reader & log;
+    unsigned handle;
+    std::string suffix;
+    unsigned long long mismatches;
+    unsigned long long extra;
+    unsigned max_mismatches;
+
+    uint64_t cycle() const {
+        return sc_time_stamp().value() / log.period();
+    }
+
+    // Waits for the falling edge ahead cycles before the recorded cycle
+    // of the next message.
+    void wait_recorded(uint64_t ahead) {
+        while (!done() && (!log.front(handle) || cycle() + ahead < log.front(handle)->cycle))
+            sc_core::wait();
+    }
+
+    // Compares a message of the stage with the next recorded one.
+    template < class T > void check(const T & msg) {
+        const chan_log_reader::message_t * want = log.front(handle);
+        if (!want) {
+            extra++;
+            return;
+        }
+        std::vector < uint8_t > got;
+        chan_log::pack(msg, got);
+        if (got != want->payload && ++mismatches <= max_mismatches) {
+            std::cerr << suffix << " message " << taken() << " (recorded cycle " << want->cycle << ", replay cycle "
+                      << cycle() << "): got " << msg << ", recorded "
+                      << chan_log_reader::unpack < T > (want->payload.data()) << std::endl;
+        }
+        log.pop(handle);
+    }
+};
+
+// The testbench side of the channels runs on the falling edges, between
+// the rising edges the stage runs on, in a fixed order of delta cycles:
+// the sinks pop what the stage pushed (delta 0), the bench drives the
+// recorded reset (delta 1), the stage resets (delta 2) and the sources
+// push what it consumes on the next rising edge (SOURCE_DELTA). The
+// recorded order on a rising edge, where the consumer ran before the
+// reset, is thus kept whatever order the processes are scheduled in.
+static const int SOURCE_DELTA = 3;
+
+// Input of the stage: pushes every recorded message on the falling edge
+// before the cycle it was consumed in.
+template < class T > class replay_source: public sc_module, public replay_port {
+    public:
+    sc_in < bool > clk;
+    sc_in < bool > rst;
+    Connections::Out < T > out;
+    Connections::Combinational < T > chan;
+
+    SC_HAS_PROCESS(replay_source);
+    replay_source(sc_module_name name, chan_log_reader & log, const std::string & suffix):
+        sc_module(name), replay_port(log, suffix, 0), clk("clk"), rst("rst"), out("out"), chan("chan") {
+        out(chan);
+        SC_THREAD(run);
+        sensitive << clk.neg();
+    }
+
+    void report(std::ostream & os) const {
+        os << "   " << std::left << std::setw(24) << suffix << " in  " << taken() << " of " << recorded()
+           << " messages driven" << std::endl;
+    }
+
+    private:
+    // Not reset: the read position survives the reset pulses, as the
+    // recorded stream does.
+    void run() {
+        out.Reset();
+        wait();
+        while (true) {
+            wait_recorded(1);
+            if (done()) {
+                wait();
+                continue;
+            }
+            for (int d = 0; d < SOURCE_DELTA; d++)
+                wait(SC_ZERO_TIME);
+            out.Push(chan_log_reader::unpack < T > (log.front(handle)->payload.data()));
+            log.pop(handle);
+        }
+    }
+};
+
+// Output of the stage: pops on the falling edge of the recorded cycles,
+// after the stage has run on the rising one, and compares.
+template < class T > class replay_sink: public sc_module, public replay_port {
+    public:
+    sc_in < bool > clk;
+    sc_in < bool > rst;
+    Connections::In < T > in;
+    Connections::Combinational < T > chan;
+
+    SC_HAS_PROCESS(replay_sink);
+    replay_sink(sc_module_name name, chan_log_reader & log, const std::string & suffix, unsigned max_mismatches):
+        sc_module(name), replay_port(log, suffix, max_mismatches), clk("clk"), rst("rst"), in("in"), chan("chan") {
+        in(chan);
+        SC_THREAD(run);
+        sensitive << clk.neg();
+    }
+
+    void report(std::ostream & os) const {
+        os << "   " << std::left << std::setw(24) << suffix << " out " << taken() << " of " << recorded()
+           << " messages checked, " << mismatches << " mismatches";
+        if (extra)
+            os << ", " << extra << " past the end of the log";
+        os << std::endl;
+    }
+
+    private:
+    void run() {
+        in.Reset();
+        wait();
+        while (true) {
+            wait_recorded(0);
+            T msg = in.Pop();
+            check(msg);
+        }
+    }
+};
+
+// Signal input of the stage: the recorded value of every cycle, written
+// one cycle ahead so that the stage reads it on the recorded edge.
+template < class T > class replay_signal: public sc_module, public replay_port {
+    public:
+    sc_in < bool > clk;
+    sc_in < bool > rst;
+    sc_signal < T > sig;
+
+    SC_HAS_PROCESS(replay_signal);
+    replay_signal(sc_module_name name, chan_log_reader & log, const std::string & suffix):
+        sc_module(name), replay_port(log, suffix, 0), clk("clk"), rst("rst"), sig("sig") {
+        SC_THREAD(run);
+        sensitive << clk.pos();
+    }
+
+    void report(std::ostream & os) const {
+        os << "   " << std::left << std::setw(24) << suffix << " in  " << taken() << " of " << recorded()
+           << " values driven" << std::endl;
+    }
+
+    private:
+    void run() {
+        while (true) {
+            const chan_log_reader::message_t * m;
+            while ((m = log.front(handle)) && m->cycle <= cycle() + 1) {
+                sig.write(chan_log_reader::unpack < T > (m->payload.data()));
+                log.pop(handle);
+            }
+            wait();
+        }
+    }
+};
+
+// Signal output of the stage: its value changes, compared in order with
+// the recorded ones.
+template < class T > class replay_signal_check: public sc_module, public replay_port {
+    public:
+    sc_in < bool > clk;
+    sc_in < bool > rst;
+    sc_signal < T > sig;
+
+    SC_HAS_PROCESS(replay_signal_check);
+    replay_signal_check(sc_module_name name, chan_log_reader & log, const std::string & suffix, unsigned max_mismatches):
+        sc_module(name), replay_port(log, suffix, max_mismatches), clk("clk"), rst("rst"), sig("sig"), last(), first(true) {
+        SC_THREAD(run);
+        sensitive << clk.pos();
+    }
+
+    void report(std::ostream & os) const {
+        os << "   " << std::left << std::setw(24) << suffix << " out " << taken() << " of " << recorded()
+           << " values checked, " << mismatches << " mismatches";
+        if (extra)
+            os << ", " << extra << " past the end of the log";
+        os << std::endl;
+    }
+
+    private:
+    T last;
+    bool first;
+
+    void run() {
+        while (true) {
+            wait();
+            T v = sig.read();
+            if (first || v != last)
+                check(v);
+            last = v;
+            first = false;
+        }
+    }
+};
+
+// Clock, replayed reset, the log read-ahead and the end of the run.
+class replay_bench: public sc_module {
+    public:
+    sc_clock clk;
+    sc_signal < bool > rst;
+
+    SC_HAS_PROCESS(replay_bench);
+    replay_bench(sc_module_name name, chan_log_reader & log):
+        sc_module(name),
+        clk("clk", sc_time((double) log.period(), SC_PS), 0.5, SC_ZERO_TIME, true),
+        log(log),
+        resets(log.subscribe("rst")),
+        read_error(false) {
+        SC_THREAD(run);
+        sensitive << clk.negedge_event();
+    }
+
+    template < class P > P * add(P * p) {
+        p->clk(clk);
+        p->rst(rst);
+        ports.push_back(p);
+        return p;
+    }
+
+    bool passed() const {
+        if (read_error)
+            return false;
+        for (size_t i = 0; i < ports.size(); i++)
+            if (ports[i]->failed() || !ports[i]->done())
+                return false;
+        return true;
+    }
+
+    void report(std::ostream & os) const {
+        for (size_t i = 0; i < ports.size(); i++)
+            ports[i]->report(os);
+    }
+
+    private:
+    static const uint64_t DRAIN_CYCLES = 100;
+    // Decoded on a falling edge: the messages the sources push on the
+    // next one, and the signals written on the next rising edge.
+    static const uint64_t READ_AHEAD = 2;
+
+    chan_log_reader & log;
+    unsigned resets;
+    bool read_error;
+    std::vector < replay_port * > ports;
+
+    void run() {
+        rst.write(0);
+        while (true) {
+            uint64_t cycle = sc_time_stamp().value() / log.period();
+            if (!log.advance(cycle + READ_AHEAD)) {
+                std::cerr << log.error() << std::endl;
+                read_error = true;
+                break;
+            }
+            wait(SC_ZERO_TIME);
+            const chan_log_reader::message_t * r;
+            while ((r = log.front(resets)) && r->cycle <= cycle) {
+                rst.write(r->payload[0] != 0);
+                log.pop(resets);
+            }
+
+            bool all_done = true;
+            for (size_t i = 0; i < ports.size(); i++)
+                all_done = all_done && ports[i]->done();
+            if (log.eof() && (all_done || cycle > log.last_cycle() + DRAIN_CYCLES))
+                break;
+            wait();
+        }
+        sc_stop();
+    }
+};
+
+// One bench per stage. Inputs are named after the stage port, outputs
+// after the port of the stage that consumes them in drim4hls.
+static void replay_fetch(replay_bench & b, chan_log_reader & log, unsigned max_mismatches) {
+    fetch * dut = new fetch("Fetch");
+    dut->clk(b.clk);
+    dut->rst(b.rst);
+    dut->fetch_din(b.add(new replay_source < fe_in_t > ("fetch_din", log, "Fetch.fetch_din"))->chan);
+    dut->imem_dout(b.add(new replay_source < imem_out_t > ("imem_dout", log, "Fetch.imem_dout"))->chan);
+    dut->imem_din(b.add(new replay_sink < imem_in_t > ("imem_din", log, ".fe2imem_ch", max_mismatches))->chan);
+    dut->dout(b.add(new replay_sink < fe_out_t > ("dout", log, "Decode.fetch_din", max_mismatches))->chan);
+    dut->imem_de(b.add(new replay_sink < imem_out_t > ("imem_de", log, "Decode.imem_out", max_mismatches))->chan);
+    dut->imem_wait(b.add(new replay_signal_check < bool > ("imem_wait", log, "Execute.imem_wait", max_mismatches))->sig);
+    dut->entry_pc(b.add(new replay_signal < sc_uint < PC_LEN > > ("entry_pc", log, "Fetch.entry_pc"))->sig);
+}
+
+static void replay_decode(replay_bench & b, chan_log_reader & log, unsigned max_mismatches) {
+    decode * dut = new decode("Decode");
+    dut->clk(b.clk);
+    dut->rst(b.rst);
+    dut->fetch_din(b.add(new replay_source < fe_out_t > ("fetch_din", log, "Decode.fetch_din"))->chan);
+    dut->imem_out(b.add(new replay_source < imem_out_t > ("imem_out", log, "Decode.imem_out"))->chan);
+    dut->feed_from_wb(b.add(new replay_source < mem_out_t > ("feed_from_wb", log, "Decode.feed_from_wb"))->chan);
+    dut->fwd_exe(b.add(new replay_source < reg_forward_t > ("fwd_exe", log, "Decode.fwd_exe"))->chan);
+    dut->dout(b.add(new replay_sink < de_out_t > ("dout", log, "Execute.din", max_mismatches))->chan);
+    dut->fetch_dout(b.add(new replay_sink < fe_in_t > ("fetch_dout", log, "Fetch.fetch_din", max_mismatches))->chan);
+    dut->program_end(* new sc_signal < bool > ("program_end"));
+    dut->icount(* new sc_signal < long int > ("icount"));
+    dut->j_icount(* new sc_signal < long int > ("j_icount"));
+    dut->b_icount(* new sc_signal < long int > ("b_icount"));
+    dut->m_icount(* new sc_signal < long int > ("m_icount"));
+    dut->o_icount(* new sc_signal < long int > ("o_icount"));
+    dut->hpm_events(b.add(new replay_signal_check < sc_uint < HPM_EV_NUM > > ("hpm_events", log, "Execute.de_events", max_mismatches))->sig);
+    dut->entry_pc(b.add(new replay_signal < sc_uint < PC_LEN > > ("entry_pc", log, "Decode.entry_pc"))->sig);
+}
+
+static void replay_execute(replay_bench & b, chan_log_reader & log, unsigned max_mismatches) {
+    execute * dut = new execute("Execute");
+    dut->clk(b.clk);
+    dut->rst(b.rst);
+    dut->din(b.add(new replay_source < de_out_t > ("din", log, "Execute.din"))->chan);
+    dut->dout(b.add(new replay_sink < exe_out_t > ("dout", log, "Writeback.din", max_mismatches))->chan);
+    dut->fwd_exe(b.add(new replay_sink < reg_forward_t > ("fwd_exe", log, "Decode.fwd_exe", max_mismatches))->chan);
+    dut->de_events(b.add(new replay_signal < sc_uint < HPM_EV_NUM > > ("de_events", log, "Execute.de_events"))->sig);
+    dut->imem_wait(b.add(new replay_signal < bool > ("imem_wait", log, "Execute.imem_wait"))->sig);
+    dut->dmem_wait(b.add(new replay_signal < bool > ("dmem_wait", log, "Execute.dmem_wait"))->sig);
+}
+
+static void replay_writeback(replay_bench & b, chan_log_reader & log, unsigned max_mismatches) {
+    writeback * dut = new writeback("Writeback");
+    dut->clk(b.clk);
+    dut->rst(b.rst);
+    dut->din(b.add(new replay_source < exe_out_t > ("din", log, "Writeback.din"))->chan);
+    dut->dmem_out(b.add(new replay_source < dmem_out_t > ("dmem_out", log, "Writeback.dmem_out"))->chan);
+    dut->dout(b.add(new replay_sink < mem_out_t > ("dout", log, "Decode.feed_from_wb", max_mismatches))->chan);
+    dut->dmem_in(b.add(new replay_sink < dmem_in_t > ("dmem_in", log, ".wb2dmem_ch", max_mismatches))->chan);
+    dut->dmem_wait(b.add(new replay_signal_check < bool > ("dmem_wait", log, "Execute.dmem_wait", max_mismatches))->sig);
+}
+
+int sc_main(int argc, char * argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <chan.log> <fetch|decode|execute|writeback> [--max-mismatches <n>]" << std::endl;
+        return -1;
+    }
+    unsigned max_mismatches = 10;
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--max-mismatches" && i + 1 < argc) {
+            max_mismatches = atoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return -1;
+        }
+    }
+
+    chan_log_reader log;
+    if (!log.open(argv[1])) {
+        std::cerr << log.error() << std::endl;
+        return -1;
+    }
+
+    std::string stage = argv[2];
+    replay_bench bench("replay", log);
+    if (stage == "fetch")
+        replay_fetch(bench, log, max_mismatches);
+    else if (stage == "decode")
+        replay_decode(bench, log, max_mismatches);
+    else if (stage == "execute")
+        replay_execute(bench, log, max_mismatches);
+    else if (stage == "writeback")
+        replay_writeback(bench, log, max_mismatches);
+    else {
+        std::cerr << "Unknown stage: " << stage << std::endl;
+        return -1;
+    }
+
+    Connections::set_sim_clk(& bench.clk);
+    sc_start();
+
+    std::cout << "REPLAY " << stage << ": " << sc_time_stamp().value() / log.period() << " cycles" << std::endl;
+    bench.report(std::cout);
+    bool ok = bench.passed();
+    std::cout << (ok ? "REPLAY MATCH" : "REPLAY MISMATCH") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -2,12 +2,18 @@
 // Enabling Rank-Based P4 Programmable Schedulers: Requirements, Implementation,
 // and Evaluation on BMv2 Switches
 
-#define META_ADDR ((volatile unsigned int*)0x100)
-#define DMEM_BASE ((volatile unsigned int*)0x150)
-#define WEIGHT_TABLE ((volatile unsigned int*)0x180)      // Quantum per flow
-#define SRV_CNTR_BASE \
-  ((volatile unsigned int*)0x1D0)  // Service counter per flow
-#define DEQ_CYCLE_PTR ((volatile unsigned int*)0x210)  // Global dequeue cycle
+// DMEM layout of the rank ABI, defined by ../lscript
+extern volatile unsigned int rank_meta[];
+extern volatile unsigned int rank_out[];
+extern volatile unsigned int rank_quantum_table[];
+extern volatile unsigned int rank_srv_cntr[];
+extern volatile unsigned int rank_deq_cycle[];
+
+#define META_ADDR rank_meta
+#define DMEM_BASE rank_out
+#define QUANTUM_TABLE rank_quantum_table  // Quantum per flow
+#define SRV_CNTR_BASE rank_srv_cntr     // Service counter per flow
+#define DEQ_CYCLE_PTR rank_deq_cycle    // Global dequeue cycle
 
 #define N 8              // Number of flows
 #define MIN_PKT_SIZE 64  // Smallest allowed packet length (in bytes)
@@ -15,7 +21,7 @@
 void notmain() {
   unsigned int flow_id = META_ADDR[3] & 0xFFFF;
   unsigned int pkt_len = META_ADDR[2] & 0xFFFF;
-  unsigned int Q = WEIGHT_TABLE[flow_id];  // flow's quantum
+  unsigned int Q = QUANTUM_TABLE[flow_id];  // flow's quantum
   unsigned int deq_cycle = DEQ_CYCLE_PTR[0];
   unsigned int pkts_per_rnd = N * (Q / MIN_PKT_SIZE);
 
@@ -1,5 +1,9 @@
-#define DMEM_BASE            ((volatile unsigned int*)0x150)
-#define PACKET_METADATA_ADDR ((volatile unsigned int*)0x100)
+// DMEM layout of the rank ABI, defined by ../lscript
+extern volatile unsigned int rank_out[];
+extern volatile unsigned int rank_meta[];
+
+#define DMEM_BASE            rank_out
+#define PACKET_METADATA_ADDR rank_meta
 #define DMEM_PACKET_VALID    ((volatile unsigned int*)0x200)
 #define DMEM_PROGRAM_END     ((volatile unsigned int*)0x204)
 
@@ -1,8 +1,15 @@
-#define DMEM_BASE        ((volatile unsigned int*)0x150)
-#define META_ADDR        ((volatile unsigned int*)0x100)
-#define FINISH_TIME_BASE ((volatile unsigned int*)0x80)
-#define WEIGHT_TABLE     ((volatile unsigned int*)0x180)
-#define VIRTUAL_TIME_PTR ((volatile unsigned int*)0x208)
+// DMEM layout of the rank ABI, defined by ../lscript
+extern volatile unsigned int rank_out[];
+extern volatile unsigned int rank_meta[];
+extern volatile unsigned int rank_finish_time[];
+extern volatile unsigned int rank_weight_table[];
+extern volatile unsigned int rank_vtime[];
+
+#define DMEM_BASE        rank_out
+#define META_ADDR        rank_meta
+#define FINISH_TIME_BASE rank_finish_time
+#define WEIGHT_TABLE     rank_weight_table
+#define VIRTUAL_TIME_PTR rank_vtime
 
 void notmain() {
     unsigned int flow_id     = META_ADDR[3] & 0xFFFF;
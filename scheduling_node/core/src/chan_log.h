@@ -0,0 +1,443 @@
+/*
+	@brief
+	Record and replay of the Connections channels between modules
+	(simulation only). With recording on (sim_sc --chan-log <file>), every
+	message is logged once, by the consumer, when it is popped:
+
+		CHAN_LOG(port, msg);   after a successful Pop()/PopNB() on port
+
+	The log is a compact byte stream:
+
+		"DRIMCHN1" period:u64
+		{ varint(0) varint(id) varint(width) varint(name_len) name }   channel
+		{ varint(id) varint(cycle delta) payload[(width + 7) / 8] }    message
+
+	Channels are named <consumer module>.<port>, so a module's inputs
+	are logged under its own name. Its outputs are logged under the
+	names of their consumers. Payloads are the Connections marshalled
+	bits, packed in little-endian order.
+	The reset line of the core is logged as the 1-bit channel "rst", and
+	chan_log_probe logs the signal inputs of the stages (entry_pc, the HPM
+	event lines) as channels of their value changes.
+
+	chan_log_reader streams a log for replay (see core/replay): a module
+	is driven from its inputs alone, and its outputs are compared with
+	the recorded ones.
+
+*/
+
+#ifndef __CHAN_LOG__H
+#define __CHAN_LOG__H
+
+#ifndef __SYNTHESIS__
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <systemc.h>
+#include <mc_connections.h>
+
+class chan_log {
+    public:
+    static chan_log & get() {
+        static chan_log log;
+        return log;
+    }
+
+    static bool recording() {
+        return get().out != NULL;
+    }
+
+    // period is the clock period in sc_time_stamp() units.
+    bool open(const char * path, uint64_t period) {
+        close();
+        out = fopen(path, "wb");
+        if (!out)
+            return false;
+        clk_period = period;
+        last_cycle = 0;
+        ids.clear();
+        buf.clear();
+        buf.insert(buf.end(), "DRIMCHN1", "DRIMCHN1" + 8);
+        for (int i = 0; i < 8; i++)
+            buf.push_back((uint8_t)(period >> (8 * i)));
+        return true;
+    }
+
+    void close() {
+        if (!out)
+            return;
+        flush();
+        fclose(out);
+        out = NULL;
+    }
+
+    // key identifies the channel (the port object), name is used the first
+    // time the channel is seen.
+    template < class T > void record(const void * key, const char * module, const char * port, const T & msg) {
+        unsigned id = channel(key, module, port, Wrapped < T >::width);
+        put_header(id);
+        pack(msg, buf);
+        if (buf.size() >= FLUSH_BYTES)
+            flush();
+    }
+
+    // Appends the payload bytes of a message.
+    template < class T > static void pack(const T & msg, std::vector < uint8_t > & out) {
+        typedef Wrapped < T > wrapped_t;
+        const unsigned W = wrapped_t::width;
+        Marshaller < W > m;
+        wrapped_t w(msg);
+        w.Marshall(m);
+        sc_lv < W > bits = m.GetResult();
+        for (unsigned lo = 0; lo < W; lo += 32) {
+            unsigned hi = lo + 31 < W ? lo + 31 : W - 1;
+            uint32_t v = bits.range(hi, lo).to_uint();
+            for (unsigned b = 0; b < (hi - lo + 8) / 8; b++)
+                out.push_back((uint8_t)(v >> (8 * b)));
+        }
+    }
+
+    void record_reset(bool value) {
+        unsigned id = channel(this, "", "rst", 1);
+        put_header(id);
+        buf.push_back(value);
+    }
+
+    ~chan_log() {
+        close();
+    }
+
+    private:
+    static const size_t FLUSH_BYTES = 1 << 20;
+
+    FILE * out;
+    uint64_t clk_period;
+    uint64_t last_cycle;
+    std::map < const void *, unsigned > ids;
+    std::vector < uint8_t > buf;
+
+    chan_log(): out(NULL), clk_period(1), last_cycle(0) {}
+
+    unsigned channel(const void * key, const char * module, const char * port, unsigned width) {
+        std::map < const void *, unsigned >::iterator it = ids.find(key);
+        if (it != ids.end())
+            return it->second;
+        unsigned id = ids.size() + 1;
+        ids[key] = id;
+        std::string name = * module ? std::string(module) + "." + port : std::string(port);
+        put_varint(0);
+        put_varint(id);
+        put_varint(width);
+        put_varint(name.size());
+        buf.insert(buf.end(), name.begin(), name.end());
+        return id;
+    }
+
+    void put_header(unsigned id) {
+        uint64_t cycle = sc_time_stamp().value() / clk_period;
+        put_varint(id);
+        put_varint(cycle - last_cycle);
+        last_cycle = cycle;
+    }
+
+    void put_varint(uint64_t v) {
+        while (v >= 0x80) {
+            buf.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        buf.push_back((uint8_t) v);
+    }
+
+    void flush() {
+        if (!buf.empty())
+            fwrite(buf.data(), 1, buf.size(), out);
+        buf.clear();
+    }
+};
+
+#define CHAN_LOG(port, msg) \
+    do { if (chan_log::recording()) chan_log::get().record(& (port), name(), #port, msg); } while (0)
+
+// Records the sc_in ports of a module that are driven by signals, not
+// channels (entry_pc, the HPM event lines): every value change is
+// logged as a message of the 1-message channel <module>.<port>, at the
+// rising edge the module reads it on. Only built while recording.
+class chan_log_probe: public sc_module {
+    public:
+    sc_in < bool > clk;
+
+    SC_HAS_PROCESS(chan_log_probe);
+    chan_log_probe(sc_module_name name): sc_module(name), clk("clk") {
+        SC_THREAD(run);
+        sensitive << clk.pos();
+    }
+
+    ~chan_log_probe() {
+        for (size_t i = 0; i < watchers.size(); i++)
+            delete watchers[i];
+    }
+
+    template < class T > void watch(const sc_in < T > & port, const char * module, const char * name) {
+        watchers.push_back(new watcher < T > (port, module, name));
+    }
+
+    private:
+    struct watcher_base {
+        virtual ~watcher_base() {}
+        virtual void sample() = 0;
+    };
+
+    template < class T > struct watcher: public watcher_base {
+        const sc_in < T > & port;
+        std::string module, name;
+        T last;
+        bool first;
+
+        watcher(const sc_in < T > & port, const char * module, const char * name):
+            port(port), module(module), name(name), last(), first(true) {}
+
+        void sample() {
+            T v = port.read();
+            if (!first && v == last)
+                return;
+            chan_log::get().record(this, module.c_str(), name.c_str(), v);
+            last = v;
+            first = false;
+        }
+    };
+
+    std::vector < watcher_base * > watchers;
+
+    void run() {
+        while (true) {
+            wait();
+            if (chan_log::recording())
+                for (size_t i = 0; i < watchers.size(); i++)
+                    watchers[i]->sample();
+        }
+    }
+};
+
+// Streams a recorded log for replay. The channels of interest are
+// subscribed to before the run, by a suffix of their name
+// ("Execute.din"); advance() then decodes the log up to a cycle, keeping
+// only the messages of subscribed channels until they are consumed.
+class chan_log_reader {
+    public:
+    struct message_t {
+        uint64_t cycle;
+        std::vector < uint8_t > payload;
+    };
+
+    struct channel_t {
+        std::string suffix;
+        std::string name;          // empty until declared in the log
+        unsigned width;
+        unsigned long long taken;  // messages consumed so far
+        std::deque < message_t > pending;
+    };
+
+    chan_log_reader(): in(NULL), clk_period(1), cycle(0), held(0), held_cycle(0), at_end(false) {}
+
+    ~chan_log_reader() {
+        if (in)
+            fclose(in);
+    }
+
+    bool open(const std::string & path) {
+        log_path = path;
+        in = fopen(path.c_str(), "rb");
+        if (!in) {
+            err = "cannot open " + path;
+            return false;
+        }
+        uint8_t head[16];
+        if (fread(head, 1, sizeof(head), in) != sizeof(head) || memcmp(head, "DRIMCHN1", 8) != 0) {
+            err = path + ": not a channel log";
+            return false;
+        }
+        clk_period = 0;
+        for (int i = 0; i < 8; i++)
+            clk_period |= (uint64_t) head[8 + i] << (8 * i);
+        return true;
+    }
+
+    // Channel whose name ends with suffix, as a handle for channel().
+    unsigned subscribe(const std::string & suffix) {
+        channel_t c;
+        c.suffix = suffix;
+        c.width = 0;
+        c.taken = 0;
+        channels.push_back(c);
+        return channels.size() - 1;
+    }
+
+    channel_t & channel(unsigned handle) {
+        return channels[handle];
+    }
+
+    // The next message of a channel, if decoded.
+    const message_t * front(unsigned handle) const {
+        const channel_t & c = channels[handle];
+        return c.pending.empty() ? NULL : & c.pending.front();
+    }
+
+    void pop(unsigned handle) {
+        channels[handle].pending.pop_front();
+        channels[handle].taken++;
+    }
+
+    // No message of the channel is left in the log.
+    bool done(unsigned handle) const {
+        return at_end && channels[handle].pending.empty();
+    }
+
+    // Decodes the messages of the log up to cycle included. False on a
+    // malformed log (see error()).
+    bool advance(uint64_t until) {
+        while (!at_end) {
+            if (!held) {
+                uint64_t id, delta;
+                int c = getc(in);
+                if (c == EOF) {
+                    at_end = true;
+                    return true;
+                }
+                ungetc(c, in);
+                if (!get_varint(id))
+                    return truncated();
+                if (id == 0) {
+                    if (!declare())
+                        return false;
+                    continue;
+                }
+                if (!get_varint(delta) || declared.find((unsigned) id) == declared.end())
+                    return truncated();
+                held = id;
+                held_cycle = cycle + delta;
+            }
+            if (held_cycle > until)
+                return true;
+            cycle = held_cycle;
+            const declared_t & d = declared[(unsigned) held];
+            held = 0;
+            message_t m;
+            m.cycle = cycle;
+            m.payload.resize((d.width + 7) / 8);
+            if (fread(m.payload.data(), 1, m.payload.size(), in) != m.payload.size())
+                return truncated();
+            if (d.handle >= 0)
+                channels[d.handle].pending.push_back(m);
+        }
+        return true;
+    }
+
+    bool eof() const {
+        return at_end;
+    }
+
+    // Cycle of the last message decoded.
+    uint64_t last_cycle() const {
+        return cycle;
+    }
+
+    uint64_t period() const {
+        return clk_period;
+    }
+
+    const std::string & error() const {
+        return err;
+    }
+
+    // Decodes a payload into a message of the channel type (chan_log::pack
+    // in reverse).
+    template < class T > static T unpack(const uint8_t * p) {
+        typedef Wrapped < T > wrapped_t;
+        const unsigned W = wrapped_t::width;
+        sc_lv < W > bits;
+        for (unsigned lo = 0; lo < W; lo += 32) {
+            unsigned hi = lo + 31 < W ? lo + 31 : W - 1;
+            uint32_t v = 0;
+            for (unsigned b = 0; b < (hi - lo + 8) / 8; b++)
+                v |= (uint32_t) * p++ << (8 * b);
+            bits.range(hi, lo) = v;
+        }
+        Marshaller < W > m(bits);
+        wrapped_t w;
+        w.Marshall(m);
+        return w.val;
+    }
+
+    private:
+    struct declared_t {
+        unsigned width;
+        int handle; // subscribed channel, or -1
+    };
+
+    FILE * in;
+    std::string log_path;
+    uint64_t clk_period;
+    uint64_t cycle;
+    uint64_t held;       // id of a message whose header is read, or 0
+    uint64_t held_cycle;
+    bool at_end;
+    std::vector < channel_t > channels;
+    std::map < unsigned, declared_t > declared;
+    std::string err;
+
+    // A channel declaration; the first subscriber whose suffix matches
+    // its name gets its messages.
+    bool declare() {
+        uint64_t id, width, len;
+        if (!get_varint(id) || !get_varint(width) || !get_varint(len))
+            return truncated();
+        std::string name(len, '\0');
+        if (len && fread(& name[0], 1, len, in) != len)
+            return truncated();
+        declared_t d;
+        d.width = width;
+        d.handle = -1;
+        for (size_t i = 0; i < channels.size() && d.handle < 0; i++) {
+            channel_t & c = channels[i];
+            if (c.name.empty() && name.size() >= c.suffix.size() &&
+                name.compare(name.size() - c.suffix.size(), c.suffix.size(), c.suffix) == 0) {
+                c.name = name;
+                c.width = width;
+                d.handle = i;
+            }
+        }
+        declared[(unsigned) id] = d;
+        return true;
+    }
+
+    bool get_varint(uint64_t & v) {
+        v = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            int b = getc(in);
+            if (b == EOF)
+                return false;
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool truncated() {
+        err = log_path + ": truncated channel log";
+        return false;
+    }
+};
+
+#else
+#define CHAN_LOG(port, msg)
+#endif // __SYNTHESIS__
+
+#endif // __CHAN_LOG__H
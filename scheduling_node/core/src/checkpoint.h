@@ -0,0 +1,204 @@
+/*
+	@brief
+	Checkpoints of the simulator state (simulation only). A checkpoint is a
+	set of named sections of 32-bit words, written to a compact binary file:
+
+		"DRIMCKPT" version:u32 sections:u32
+		{ name_len:u32 name words:u32 word[words] } * sections
+
+	in host byte order. Every module saves its own state into a section
+	(save_state) and reads it back (load_state). Checkpoints are taken at
+	quiescent points only: the core parked in its end-of-program loop with
+	every channel empty, so that no thread is in the middle of a transfer.
+	A restore is done with reset released and the core processes
+	suspended, so that no reset block or stage overwrites the loaded
+	state; a reset pulse then restarts the program at its entry PC, like
+	at every packet boundary.
+
+*/
+
+#ifndef __CHECKPOINT__H
+#define __CHECKPOINT__H
+
+#ifndef __SYNTHESIS__
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#define CHECKPOINT_VERSION 1
+
+class checkpoint {
+    public:
+    typedef std::vector < uint32_t > section_t;
+
+    // Appends values to a section.
+    class writer {
+        public:
+        writer(section_t & s): words(s) {}
+
+        void put(bool v) { words.push_back(v); }
+        void put(int v) { words.push_back((uint32_t) v); }
+        void put(unsigned v) { words.push_back(v); }
+        void put(long v) { put((unsigned long long) v); }
+        void put(unsigned long long v) {
+            words.push_back((uint32_t) v);
+            words.push_back((uint32_t)(v >> 32));
+        }
+        // sc_uint, sc_int, ac_int: one word up to 32 bits, two above.
+        template < class T > void put(const T & v) {
+            if (v.length() > 32)
+                put((unsigned long long) v.to_uint64());
+            else
+                words.push_back((uint32_t) v.to_uint64());
+        }
+        template < class T > void put_array(const T * a, unsigned n) {
+            for (unsigned i = 0; i < n; i++)
+                put(a[i]);
+        }
+
+        private:
+        section_t & words;
+    };
+
+    // Reads values back in the order they were put. ok() turns false if the
+    // section is missing or too short.
+    class reader {
+        public:
+        reader(const section_t * s): words(s), pos(0), good(s != NULL) {}
+
+        void get(bool & v) { v = word() != 0; }
+        void get(int & v) { v = (int) word(); }
+        void get(unsigned & v) { v = word(); }
+        void get(long & v) {
+            unsigned long long w;
+            get(w);
+            v = (long) w;
+        }
+        void get(unsigned long long & v) {
+            v = word();
+            v |= (unsigned long long) word() << 32;
+        }
+        template < class T > void get(T & v) {
+            if (v.length() > 32) {
+                unsigned long long w;
+                get(w);
+                v = w;
+            } else {
+                v = word();
+            }
+        }
+        template < class T > void get_array(T * a, unsigned n) {
+            for (unsigned i = 0; i < n; i++)
+                get(a[i]);
+        }
+
+        bool ok() const {
+            return good;
+        }
+
+        private:
+        const section_t * words;
+        size_t pos;
+        bool good;
+
+        uint32_t word() {
+            if (!good || pos >= words->size()) {
+                good = false;
+                return 0;
+            }
+            return (*words)[pos++];
+        }
+    };
+
+    // New (or cleared) section.
+    writer add(const std::string & name) {
+        section_t & s = sections[name];
+        s.clear();
+        return writer(s);
+    }
+
+    reader find(const std::string & name) const {
+        std::map < std::string, section_t >::const_iterator it = sections.find(name);
+        return reader(it == sections.end() ? NULL : & it->second);
+    }
+
+    bool save(const std::string & path) {
+        FILE * f = fopen(path.c_str(), "wb");
+        if (!f) {
+            err = "cannot create " + path;
+            return false;
+        }
+        uint32_t head[2] = { CHECKPOINT_VERSION, (uint32_t) sections.size() };
+        bool ok = fwrite("DRIMCKPT", 8, 1, f) == 1 && fwrite(head, sizeof(head), 1, f) == 1;
+        for (std::map < std::string, section_t >::const_iterator it = sections.begin(); ok && it != sections.end(); ++it) {
+            uint32_t len[2] = { (uint32_t) it->first.size(), (uint32_t) it->second.size() };
+            ok = fwrite(& len[0], 4, 1, f) == 1 && fwrite(it->first.data(), 1, len[0], f) == len[0] &&
+                fwrite(& len[1], 4, 1, f) == 1 &&
+                (len[1] == 0 || fwrite(it->second.data(), 4, len[1], f) == len[1]);
+        }
+        if (fclose(f) != 0 || !ok) {
+            err = "cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+
+    // Section lengths are checked against what is left of the file, so a
+    // truncated or corrupt file fails here instead of allocating a bogus
+    // length.
+    bool load(const std::string & path) {
+        sections.clear();
+        FILE * f = fopen(path.c_str(), "rb");
+        if (!f) {
+            err = "cannot open " + path;
+            return false;
+        }
+        long size = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+        rewind(f);
+        char magic[8];
+        uint32_t head[2];
+        if (size < 0 || fread(magic, 8, 1, f) != 1 || std::string(magic, 8) != "DRIMCKPT" ||
+            fread(head, sizeof(head), 1, f) != 1 || head[0] != CHECKPOINT_VERSION) {
+            fclose(f);
+            err = path + ": not a version " + std::to_string(CHECKPOINT_VERSION) + " checkpoint";
+            return false;
+        }
+        bool ok = true;
+        for (uint32_t i = 0; ok && i < head[1]; i++) {
+            uint32_t len;
+            ok = fread(& len, 4, 1, f) == 1 && len < 256;
+            if (!ok)
+                break;
+            std::string name(len, '\0');
+            ok = (len == 0 || fread(& name[0], 1, len, f) == len) && fread(& len, 4, 1, f) == 1 &&
+                len <= (unsigned long)(size - ftell(f)) / 4;
+            if (!ok)
+                break;
+            section_t & s = sections[name];
+            s.resize(len);
+            ok = len == 0 || fread(s.data(), 4, len, f) == len;
+        }
+        fclose(f);
+        if (!ok) {
+            err = path + ": truncated or corrupt checkpoint";
+            sections.clear();
+        }
+        return ok;
+    }
+
+    const std::string & error() const {
+        return err;
+    }
+
+    private:
+    std::map < std::string, section_t > sections;
+    std::string err;
+};
+
+#endif // __SYNTHESIS__
+
+#endif // __CHECKPOINT__H
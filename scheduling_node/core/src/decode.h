@@ -17,14 +17,13 @@
 #ifndef __DEC__H
 #define __DEC__H
 
-#ifndef NDEBUG
-    #include <iostream>
-    #define DPRINT(msg) std::cout << msg;
-#endif
-
 #include "drim4hls_datatypes.h"
 #include "defines.h"
 #include "globals.h"
+#include "checkpoint.h"
+#include "kanata_trace.h"
+#include "trace_ring.h"
+#include "chan_log.h"
 
 #include <mc_connections.h>
 
@@ -33,6 +32,8 @@ SC_MODULE(decode) {
     // Clock and reset signals
     sc_in < bool > CCS_INIT_S1(clk);
     sc_in < bool > CCS_INIT_S1(rst);
+    // First PC after reset, as in fetch
+    sc_in < sc_uint < PC_LEN > > CCS_INIT_S1(entry_pc);
     // FlexChannel initiators
     Connections::Out < de_out_t > CCS_INIT_S1(dout);
     Connections::Out < fe_in_t > CCS_INIT_S1(fetch_dout);
@@ -50,6 +51,9 @@ SC_MODULE(decode) {
     sc_out < long int > CCS_INIT_S1(b_icount);
     sc_out < long int > CCS_INIT_S1(m_icount);
     sc_out < long int > CCS_INIT_S1(o_icount);
+
+    // Performance monitor event lines (bit i = HPM event i), see execute::hpm_th.
+    sc_out < sc_uint < HPM_EV_NUM > > CCS_INIT_S1(hpm_events);
     
     bool jump;
     bool branch;
@@ -66,22 +70,22 @@ SC_MODULE(decode) {
     bool forward_success_rs2;
 
     bool load_instruction;
-    sc_int < PC_LEN > load_pc;
+    drim_int < PC_LEN > load_pc;
 
-    sc_uint < INSN_LEN > insn; // Contains full instruction fetched from IMEM. Used in decoding.
-    sc_int < PC_LEN > pc; // Contains PC for the current instruction that is decoded   
+    drim_uint < INSN_LEN > insn; // Contains full instruction fetched from IMEM. Used in decoding.
+    drim_int < PC_LEN > pc; // Contains PC for the current instruction that is decoded   
     // NB. x0 is included in this regfile so it is not a real hardcoded 0
     // constant. The writeback section of fedec has a guard fro writes on
     // x0. For double protection, some instructions that want to write into
     // x0 will have their regwrite signal forced to false.
-    sc_uint < XLEN > regfile[REG_NUM];
+    drim_uint < XLEN > regfile[REG_NUM];
     // Keeps track of in-flight instructions that are going to overwrite a
     // register. Implements a primitive stall mechanism for RAW hazards.
-    sc_uint < XLEN + 1 > sentinel[REG_NUM];
+    drim_uint < XLEN + 1 > sentinel[REG_NUM];
 
-    sc_uint < TAG_WIDTH > tag;
+    drim_uint < TAG_WIDTH > tag;
     // Stalls processor and sends a nop operation to the execute stage
-    sc_uint < OPCODE_SIZE > opcode;
+    drim_uint < OPCODE_SIZE > opcode;
 
     int position;
     // Member variables (DECODE)
@@ -103,25 +107,27 @@ SC_MODULE(decode) {
    
 	bool freeze_tmp;
 	bool flush_tmp;
-	sc_uint < 32 > addr_tmp;
-	sc_uint < 5 > zero_reg_addr;
+	drim_uint < 32 > addr_tmp;
+	drim_uint < 5 > zero_reg_addr;
      
     bool flush_next;
 	
     SC_CTOR(decode): clk("clk"),
     rst("rst"),
+    entry_pc("entry_pc"),
     dout("dout"),
+    fetch_dout("fetch_dout"),
     feed_from_wb("feed_from_wb"),
+    imem_out("imem_out"),
     fetch_din("fetch_din"),
-    fetch_dout("fetch_dout"),
-    program_end("program_end"),
     fwd_exe("fwd_exe"),
+    program_end("program_end"),
     icount("icount"),
     j_icount("j_icount"),
     b_icount("b_icount"),
     m_icount("m_icount"),
     o_icount("o_icount"),
-    imem_out("imem_out") {
+    hpm_events("hpm_events") {
         
         SC_THREAD(decode_th);
         sensitive << clk.pos();
@@ -129,6 +135,36 @@ SC_MODULE(decode) {
 
     }
 
+    #ifndef __SYNTHESIS__
+    // Checkpoint of the register file and hazard state, see checkpoint.h.
+    void save_state(checkpoint & ckpt) const {
+        checkpoint::writer w = ckpt.add("decode");
+        w.put_array(regfile, REG_NUM);
+        w.put_array(sentinel, REG_NUM);
+        w.put(pc);
+        w.put(insn);
+        w.put(freeze);
+        w.put(flush);
+        w.put(flush_next);
+        w.put(load_instruction);
+        w.put(load_pc);
+    }
+
+    bool load_state(const checkpoint & ckpt) {
+        checkpoint::reader r = ckpt.find("decode");
+        r.get_array(regfile, REG_NUM);
+        r.get_array(sentinel, REG_NUM);
+        r.get(pc);
+        r.get(insn);
+        r.get(freeze);
+        r.get(flush);
+        r.get(flush_next);
+        r.get(load_instruction);
+        r.get(load_pc);
+        return r.ok();
+    }
+    #endif
+
     #ifndef __SYNTHESIS__
     //for debugging purposes
     struct debug_dout { //
@@ -143,13 +179,13 @@ SC_MODULE(decode) {
         bool rs1_forward;
         bool rs2_forward;
         bool branch_taken;
-        sc_uint < XLEN > rs1;
-        sc_uint < XLEN > rs2;
+        drim_uint < XLEN > rs1;
+        drim_uint < XLEN > rs2;
         std::string dest_reg;
         int pc;
         int aligned_pc;
-        sc_uint < XLEN - 12 > imm_u;
-        sc_uint < TAG_WIDTH > tag;
+        drim_uint < XLEN - 12 > imm_u;
+        drim_uint < TAG_WIDTH > tag;
 
     }
     debug_dout_t;
@@ -176,6 +212,7 @@ SC_MODULE(decode) {
             b_icount.write(0); // branch
             m_icount.write(0); // load, store
             o_icount.write(0); // other
+            hpm_events.write(0);
             
             addr_tmp = 0;
             self_feed.jump_address = 0;
@@ -193,7 +230,7 @@ SC_MODULE(decode) {
             insn = 0;
             branch = false;
             jump = false;
-            pc = -4;
+            pc = entry_pc.read().to_int() - 4;
             load_instruction = false;
             load_pc = -4;
 
@@ -206,7 +243,11 @@ SC_MODULE(decode) {
             // Retrieve data from instruction memory and fetch stage.
             // If processor stalls then just clear the channels from new data.
 
+            // No stall event while blocked on the fetch channels.
+            hpm_events.write(0);
+
             if (fwd_exe.PopNB(temp_fwd)) {
+                CHAN_LOG(fwd_exe, temp_fwd);
                 fwd = temp_fwd;
                 
             }else {
@@ -216,29 +257,36 @@ SC_MODULE(decode) {
             if (!flush) {
 
                 fetch_in = fetch_din.Pop();
+                CHAN_LOG(fetch_din, fetch_in);
                 imem_in = imem_out.Pop();
+                CHAN_LOG(imem_out, imem_in);
 
             } else {
-                imem_out.Pop();
-                fetch_din.Pop();
+                imem_out_t dropped_imem = imem_out.Pop();
+                CHAN_LOG(imem_out, dropped_imem);
+                fe_out_t dropped = fetch_din.Pop();
+                CHAN_LOG(fetch_din, dropped);
+                KANATA(flush(dropped.pc.to_uint()));
             }
 
             if (feed_from_wb.PopNB(feedinput_tmp)) {
+                CHAN_LOG(feed_from_wb, feedinput_tmp);
 				feedinput = feedinput_tmp;
 
-                if (feedinput_tmp.pc == load_pc && load_instruction) {
+                if (feedinput_tmp.pc == load_pc.to_uint64() && load_instruction) {
                     load_instruction = false;
                 }
             }else {
 				feedinput.regwrite = 0;
 			}
             
-            if (feedinput.pc == load_pc && load_instruction) {
+            if (feedinput.pc == load_pc.to_uint64() && load_instruction) {
                     load_instruction = false;
             }
             
             if (feedinput.regwrite == 1 && feedinput.regfile_address != 0) { // Actual writeback.
                     regfile[feedinput.regfile_address] = feedinput.regfile_data; // Overwrite register.
+                    TRACE(TR_DECODE, TR_INFO, TR_DE_REGWRITE, feedinput.regfile_address, feedinput.regfile_data, feedinput.pc);
 
 				if ((feedinput.pc == sentinel[feedinput.regfile_address].range(32, 1)) && (sentinel[feedinput.regfile_address][0] == 1)) {
 					sentinel[feedinput.regfile_address][0] = 0;
@@ -248,7 +296,7 @@ SC_MODULE(decode) {
           
             flush_next = false;
             
-            if (!freeze && (((jump) && self_feed.jump_address != fetch_in.pc) || ((branch) && self_feed.branch_address != fetch_in.pc) || (fetch_in.pc != pc + 4 && !branch && !jump))) {
+            if (!freeze && (((jump) && self_feed.jump_address != fetch_in.pc) || ((branch) && self_feed.branch_address != fetch_in.pc) || (fetch_in.pc != pc.to_uint64() + 4 && !branch && !jump))) {
 				flush_next = true;
 			}else if (!freeze) {
 				pc = fetch_in.pc;
@@ -258,9 +306,16 @@ SC_MODULE(decode) {
 			    
 			    forward_success_rs1 = false;
                 forward_success_rs2 = false;
+
+                KANATA(decode((unsigned) pc.to_int(), imem_data));
                 
 			}
 
+            // Fetches popped while frozen or on the wrong path are dropped.
+            if (!flush && (freeze || flush_next)) {
+                KANATA(flush(fetch_in.pc.to_uint()));
+            }
+
             insn = imem_data;
 			
             #ifndef __SYNTHESIS__
@@ -300,12 +355,12 @@ SC_MODULE(decode) {
                 program_end.write(true);
             }
 
-            sc_uint < REG_ADDR > rs1_addr = insn.range(19, 15);
-            sc_uint < REG_ADDR > rs2_addr = insn.range(24, 20);
+            drim_uint < REG_ADDR > rs1_addr = insn.range(19, 15);
+            drim_uint < REG_ADDR > rs2_addr = insn.range(24, 20);
 			
 			
-			sc_uint< 32 > rs1_sent_pc = sentinel[rs1_addr].range(32, 1);
-			sc_uint < 1 > rs1_sent_valid = sentinel[rs1_addr].range(0, 0);
+			drim_uint < 32 > rs1_sent_pc = sentinel[rs1_addr].range(32, 1);
+			drim_uint < 1 > rs1_sent_valid = sentinel[rs1_addr].range(0, 0);
             
             if (!fwd.ldst && fwd.pc == rs1_sent_pc && rs1_sent_valid == 1) {
                 forward_success_rs1 = true;
@@ -327,8 +382,8 @@ SC_MODULE(decode) {
                 
             }
 
-            sc_uint < 32 > rs2_sent_pc = sentinel[rs2_addr].range(32, 1);
-			sc_uint < 1 > rs2_sent_valid = sentinel[rs2_addr].range(0, 0);
+            drim_uint < 32 > rs2_sent_pc = sentinel[rs2_addr].range(32, 1);
+			drim_uint < 1 > rs2_sent_valid = sentinel[rs2_addr].range(0, 0);
 			
             if (!fwd.ldst && fwd.pc == rs2_sent_pc && rs2_sent_valid == 1) {
                 forward_success_rs2 = true;
@@ -352,8 +407,8 @@ SC_MODULE(decode) {
             }
             // *** Feedback to fetch data computation and put() section.
             // -- Address sign extensions.
-            sc_uint < 21 > immjal_tmp = ((sc_uint < 1 > ) insn.range(31, 31), (sc_uint < 8 > ) insn.range(19, 12), (sc_uint < 1 > ) insn.range(20, 20), (sc_uint < 10 > ) insn.range(30, 21), (sc_uint < 1 > )(0));
-            sc_uint < 13 > immbranch_tmp = ((sc_uint < 1 > ) insn.range(31, 31), (sc_uint < 1 > ) insn.range(7, 7), (sc_uint < 6 > ) insn.range(30, 25), (sc_uint < 4 > ) insn.range(11, 8), (sc_uint < 1 > )(0));
+            drim_uint < 21 > immjal_tmp = ((drim_uint < 1 > ) insn.range(31, 31), (drim_uint < 8 > ) insn.range(19, 12), (drim_uint < 1 > ) insn.range(20, 20), (drim_uint < 10 > ) insn.range(30, 21), (drim_uint < 1 > )(0));
+            drim_uint < 13 > immbranch_tmp = ((drim_uint < 1 > ) insn.range(31, 31), (drim_uint < 1 > ) insn.range(7, 7), (drim_uint < 6 > ) insn.range(30, 25), (drim_uint < 4 > ) insn.range(11, 8), (drim_uint < 1 > )(0));
 
             self_feed.branch_address = sign_extend_branch(immbranch_tmp + pc);
             // -- Jump.
@@ -361,7 +416,7 @@ SC_MODULE(decode) {
                 self_feed.jump_address = sign_extend_jump(immjal_tmp + pc);
                 jump = true;
             } else if (insn.range(6,2) == OPC_JALR) {
-                sc_uint < PC_LEN > extended;
+                drim_uint < PC_LEN > extended;
                 if (insn[31] == 0)
                     extended = 0;
                 else
@@ -976,27 +1031,27 @@ SC_MODULE(decode) {
                     output.regwrite = 0;
                     trap = 1;
                     output.alu_op = ALUOP_CSRRWI;
-                    output.imm_u.range(19, 8) = (sc_uint<CSR_ADDR>) MCAUSE_A; // force the CSR address to MCAUSE's
+                    output.imm_u.range(19, 8) = (drim_uint<CSR_ADDR>) MCAUSE_A; // force the CSR address to MCAUSE's
 
                     #ifndef __SYNTHESIS__
                     debug_dout_t.alu_op = "ALUOP_CSRRWI";
-                    debug_dout_t.imm_u.range(19, 8) = (sc_uint<CSR_ADDR>)MCAUSE_A;
+                    debug_dout_t.imm_u.range(19, 8) = (drim_uint<CSR_ADDR>)MCAUSE_A;
                     #endif
                     if (insn[20] == FUNCT7_EBREAK) { // Bit 20 discriminates b/n EBREAK and ECALL
                         // EBREAK and ECALL leverage CSRRWI decoding to write into the MCAUSE register
                         // but keep regwrite to "0" to prevent writeback
                         trap_cause = EBREAK_CAUSE; // may be not necessary but is kept for future implementations
-                        output.imm_u.range(5, 3) = (sc_uint<3>) EBREAK_CAUSE; // force the exception cause on the zimm field
+                        output.imm_u.range(5, 3) = (drim_uint<3>) EBREAK_CAUSE; // force the exception cause on the zimm field
 
                         #ifndef __SYNTHESIS__
-                        debug_dout_t.imm_u.range(5, 3) = (sc_uint<3>) EBREAK_CAUSE;
+                        debug_dout_t.imm_u.range(5, 3) = (drim_uint<3>) EBREAK_CAUSE;
                         #endif
                     } else { // FUNCT7_ECALL
                         trap_cause = ECALL_CAUSE; // may be not necessary but is kept for future implementations
-                        output.imm_u.range(7, 3) = (sc_uint<ZIMM_SIZE>) ECALL_CAUSE; // force the exception cause on the zimm field
+                        output.imm_u.range(7, 3) = (drim_uint<ZIMM_SIZE>) ECALL_CAUSE; // force the exception cause on the zimm field
 
                         #ifndef __SYNTHESIS__
-                        debug_dout_t.imm_u.range(7, 3) = (sc_uint<ZIMM_SIZE>) ECALL_CAUSE;
+                        debug_dout_t.imm_u.range(7, 3) = (drim_uint<ZIMM_SIZE>) ECALL_CAUSE;
                         #endif
                     }
                     break;
@@ -1079,7 +1134,7 @@ SC_MODULE(decode) {
                 trap = 1;
                 trap_cause = ILL_INSN_CAUSE;
                 output.alu_op = ALUOP_CSRRWI;
-                output.imm_u.range(19, 8) = (sc_uint<CSR_ADDR>)MCAUSE_A; // force the CSR address to MCAUSE's
+                output.imm_u.range(19, 8) = (drim_uint<CSR_ADDR>)MCAUSE_A; // force the CSR address to MCAUSE's
 
                 #ifndef __SYNTHESIS__
                 debug_dout_t.alu_src = "ALUSRC_RS2";
@@ -1088,48 +1143,61 @@ SC_MODULE(decode) {
                 debug_dout_t.st = "NO_STORE";
                 debug_dout_t.memtoreg = "MEMTOREG NO";
                 debug_dout_t.alu_op = "ALUOP_CSRRWI";
-                debug_dout_t.imm_u.range(19, 8) = (sc_uint<CSR_ADDR>)MCAUSE_A;
-                debug_dout_t.imm_u.range(7,3) = (sc_uint<5>)ILL_INSN_CAUSE;
+                debug_dout_t.imm_u.range(19, 8) = (drim_uint<CSR_ADDR>)MCAUSE_A;
+                debug_dout_t.imm_u.range(7,3) = (drim_uint<5>)ILL_INSN_CAUSE;
                 #endif
                 
                 SC_REPORT_ERROR(sc_object::name(), "Unimplemented instruction");
                 break;
             } // --- END of OPCODE switch
             // *** END of control word generation.
-            sc_uint <1> sen1_test = sentinel[rs1_addr].range(0, 0);
-            sc_uint <1> sen2_test = sentinel[rs2_addr].range(0, 0);
+            drim_uint <1> sen1_test = sentinel[rs1_addr].range(0, 0);
+            drim_uint <1> sen2_test = sentinel[rs2_addr].range(0, 0);
+            drim_uint < HPM_EV_NUM > de_events = 0;
 
             if ((sen1_test && !forward_success_rs1) || (sen2_test && !forward_success_rs2) || load_instruction) {
                 freeze = true;
                 fetch_out.freeze = true;
                 flush = false;
                 fetch_out.address = pc + 4;
+
+                if (load_instruction)
+                    de_events[HPM_EV_LOAD_WAIT] = 1;
+                else
+                    de_events[HPM_EV_RAW_STALL] = 1;
+
+                KANATA(stall((unsigned) pc.to_int(), kanata_trace::ST_DECODE, load_instruction ? "load" : "raw"));
 				
             } else if(flush_next) {				
 				fetch_out.freeze = false;
 				fetch_out.redirect = false;
+                de_events[HPM_EV_FLUSH] = 1;
 								
-			} else if ((jump) && !flush && self_feed.jump_address != pc + 4) {
+			} else if ((jump) && !flush && self_feed.jump_address != pc.to_uint64() + 4) {
                 freeze = true;
                 fetch_out.freeze = false;
                 flush = true;
                 fetch_out.address = self_feed.jump_address;
                 fetch_out.redirect = true;
+                de_events[HPM_EV_FLUSH] = 1;
+                KANATA(stall((unsigned) pc.to_int(), kanata_trace::ST_DECODE, "redirect"));
 				                
-            } else if ((branch) && !flush && self_feed.branch_address != pc + 4) {
+            } else if ((branch) && !flush && self_feed.branch_address != pc.to_uint64() + 4) {
                 freeze = true;
                 fetch_out.freeze = false;
                 flush = true;
                 fetch_out.address = self_feed.branch_address;
                 fetch_out.redirect = true;
+                de_events[HPM_EV_FLUSH] = 1;
+                KANATA(stall((unsigned) pc.to_int(), kanata_trace::ST_DECODE, "redirect"));
 				                
             } else {
                 freeze = false;
                 flush = false;
             }
 			
-            sc_uint < 1 > out_regwrite = output.regwrite;
-            sc_uint < 33 > sen_input;
+            drim_uint < 1 > out_regwrite = output.regwrite;
+            drim_uint < 33 > sen_input;
             
             if (!freeze && output.regwrite[0] == 1 && output.dest_reg != 0) {
                 sentinel[output.dest_reg].range(32, 1) = pc; // Set corresponding sentinel flag.
@@ -1162,45 +1230,26 @@ SC_MODULE(decode) {
                 load_pc = pc;
             }
 			
+            hpm_events.write(de_events.to_uint64());
+
             fetch_dout.Push(fetch_out);
             if (!freeze) {
 				dout.Push(output);
+
+                #ifndef __SYNTHESIS__
+                // Branches look like nops to execute and complete here.
+                if (!flush_next && insn != 0 && output.regwrite[0] == 0 && output.ld == NO_LOAD &&
+                    output.st == NO_STORE && output.alu_op == ALUOP_NULL) {
+                    KANATA(retire((unsigned) pc.to_int(), kanata_trace::ST_DECODE));
+                }
+                #endif
 			}
             
-            #ifndef __SYNTHESIS__
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "load_instruction=" << load_instruction << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "insn=" << insn << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "freeze= " << freeze << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "flush= " << flush << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << std::hex << "pc= " << debug_dout_t.pc << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "regwrite= " << debug_dout_t.regwrite << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "memtoreg= " << debug_dout_t.memtoreg << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "ld= " << debug_dout_t.ld << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "st= " << debug_dout_t.st << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "alu_op= " << debug_dout_t.alu_op << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "alu_src= " << debug_dout_t.alu_src << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "rs1= " << debug_dout_t.rs1 << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "rs2= " << debug_dout_t.rs2 << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "dest_reg= " << debug_dout_t.dest_reg << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "imm_u= " << debug_dout_t.imm_u << endl);
-            DPRINT(endl);
-
-            for (int i = 0; i < REG_NUM;) {
-                DPRINT(endl);
-                for (int j = 0; j < 8; j++) {
-                    int r = regfile[i].to_int();
-                    DPRINT(" " << std::right << std::setfill(' ') << std::setw(2) << i << ": 0x" << std::hex << std::left << std::setfill(' ') << std::setw(10) << r << std::dec);
-                    i++;
-                    if (i == REG_NUM)
-                        break;
-                }
-                DPRINT(endl);
-                if (i == REG_NUM)
-                    break;
-            }
-            #endif
+            TRACE(TR_DECODE, TR_DEBUG, TR_DE_STATE, pc, insn,
+                freeze | (flush << 1) | (load_instruction << 2) | (flush_next << 3));
+            TRACE(TR_DECODE, TR_VERBOSE, TR_DE_CTRL, output.alu_op, output.alu_src, output.ld, output.st);
+            TRACE(TR_DECODE, TR_VERBOSE, TR_DE_OPS, output.rs1, output.rs2, output.dest_reg, output.imm_u);
 
-            DPRINT(endl);
             wait();
 
         } // *** ENDOF while(true)
@@ -1209,28 +1258,28 @@ SC_MODULE(decode) {
     // --- Utility functions.
 
     // Sign extend UJ insn.
-    sc_uint < PC_LEN > sign_extend_jump(sc_uint < 21 > imm) {
+    drim_uint < PC_LEN > sign_extend_jump(drim_uint < 21 > imm) {
         if (imm[20] == 1) {
-			sc_uint < 32 > ext_imm = 4294967295;
+			drim_uint < 32 > ext_imm = 4294967295;
             ext_imm.range(20, 0) = imm;
             return ext_imm;
         }
         else {
-			sc_uint < 32 > ext_imm = imm;
+			drim_uint < 32 > ext_imm = imm;
 			return ext_imm;
 		}
     }
 
     // Sign extend branch insn.
-    sc_uint < PC_LEN > sign_extend_branch(sc_uint < 13 > imm) {
+    drim_uint < PC_LEN > sign_extend_branch(drim_uint < 13 > imm) {
         
         if (imm[12] == 1) {
-			sc_uint < 32 > ext_imm = 4294967295;
+			drim_uint < 32 > ext_imm = 4294967295;
             ext_imm.range(12, 0) = imm;
             return ext_imm;
         }
         else {
-			sc_uint < 32 > ext_imm = imm;
+			drim_uint < 32 > ext_imm = imm;
 			return ext_imm;
 		}
     }
@@ -35,6 +35,9 @@ SC_MODULE(drim4hls) {
     sc_in < bool > clk;
     sc_in < bool > rst;
 
+    // First PC after reset (see SchedulingNode's resident programs)
+    sc_in < sc_uint < PC_LEN > > CCS_INIT_S1(entry_pc);
+
     //End of simulation signal.
     sc_out < bool > CCS_INIT_S1(program_end);
 
@@ -62,6 +65,11 @@ SC_MODULE(drim4hls) {
     // Forwarding
     Connections::Combinational < reg_forward_t > CCS_INIT_S1(fwd_exe_ch);
 
+    // Performance monitor event lines
+    sc_signal < sc_uint < HPM_EV_NUM > > CCS_INIT_S1(de2exe_hpm_events);
+    sc_signal < bool > CCS_INIT_S1(fe2exe_imem_wait);
+    sc_signal < bool > CCS_INIT_S1(wb2exe_dmem_wait);
+
     // Instantiate the modules
     fetch CCS_INIT_S1(fe);
     decode CCS_INIT_S1(dec);
@@ -74,13 +82,16 @@ SC_MODULE(drim4hls) {
     fe2de_ch("fe2de_ch"),
     de2exe_ch("de2exe_ch"),
     de2fe_ch("de2fe_ch"),
-    exe2mem_ch("exe2mem_ch"),
     wb2de_ch("wb2de_ch"),
-    fwd_exe_ch("fwd_exe_ch"),
+    exe2mem_ch("exe2mem_ch"),
     imem2de_data("imem2de_data"),
     fe2imem_data("fe2imem_data"),
     dmem2wb_data("dmem2wb_data"),
     wb2dmem_data("wb2dmem_data"),
+    fwd_exe_ch("fwd_exe_ch"),
+    de2exe_hpm_events("de2exe_hpm_events"),
+    fe2exe_imem_wait("fe2exe_imem_wait"),
+    wb2exe_dmem_wait("wb2exe_dmem_wait"),
     fe("Fetch"),
     dec("Decode"),
     exe("Execute"),
@@ -88,15 +99,18 @@ SC_MODULE(drim4hls) {
         // FETCH
         fe.clk(clk);
         fe.rst(rst);
+        fe.entry_pc(entry_pc);
         fe.dout(fe2de_ch);
         fe.imem_de(fe2de_imem_ch);
         fe.imem_din(fe2imem_data);
         fe.imem_dout(imem2de_data);
         fe.fetch_din(de2fe_ch);
+        fe.imem_wait(fe2exe_imem_wait);
 
         // DECODE
         dec.clk(clk);
         dec.rst(rst);
+        dec.entry_pc(entry_pc);
         dec.dout(de2exe_ch);
         dec.feed_from_wb(wb2de_ch);
         dec.fetch_din(fe2de_ch);
@@ -109,6 +123,7 @@ SC_MODULE(drim4hls) {
         dec.m_icount(m_icount);
         dec.o_icount(o_icount);
         dec.imem_out(fe2de_imem_ch);
+        dec.hpm_events(de2exe_hpm_events);
 
         // EXE
         exe.clk(clk);
@@ -116,6 +131,9 @@ SC_MODULE(drim4hls) {
         exe.din(de2exe_ch);
         exe.dout(exe2mem_ch);
         exe.fwd_exe(fwd_exe_ch);
+        exe.de_events(de2exe_hpm_events);
+        exe.imem_wait(fe2exe_imem_wait);
+        exe.dmem_wait(wb2exe_dmem_wait);
 
         // MEM
         wb.clk(clk);
@@ -125,7 +143,32 @@ SC_MODULE(drim4hls) {
 
         wb.dmem_in(wb2dmem_data);
         wb.dmem_out(dmem2wb_data);
+        wb.dmem_wait(wb2exe_dmem_wait);
+    }
+
+    #ifndef __SYNTHESIS__
+    // Core state for checkpoint.h. The writeback stage holds nothing but
+    // the in-flight transfer, which is empty at a quiescent point.
+    void save_state(checkpoint & ckpt) const {
+        fe.save_state(ckpt);
+        dec.save_state(ckpt);
+        exe.save_state(ckpt);
+    }
+
+    bool load_state(const checkpoint & ckpt) {
+        return fe.load_state(ckpt) && dec.load_state(ckpt) && exe.load_state(ckpt);
+    }
+
+    // Signal inputs of the stages for the channel log (chan_log.h), so
+    // that sim_replay can drive them.
+    void log_signals(chan_log_probe & probe) {
+        probe.watch(fe.entry_pc, fe.name(), "entry_pc");
+        probe.watch(dec.entry_pc, dec.name(), "entry_pc");
+        probe.watch(exe.de_events, exe.name(), "de_events");
+        probe.watch(exe.imem_wait, exe.name(), "imem_wait");
+        probe.watch(exe.dmem_wait, exe.name(), "dmem_wait");
     }
+    #endif
 
 };
 
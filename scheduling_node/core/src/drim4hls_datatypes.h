@@ -21,6 +21,7 @@
 
 #include "defines.h"
 #include "globals.h"
+#include "drim4hls_types.h"
 
 #include <mc_connections.h>
 
@@ -28,10 +29,10 @@ struct de_in_t {
     //
     // Member declarations.
     //
-    sc_uint < 1 > jump;
-    sc_uint < 1 > branch;
-    sc_uint < PC_LEN > jump_address;
-    sc_uint < PC_LEN > branch_address;
+    drim_uint < 1 > jump;
+    drim_uint < 1 > branch;
+    drim_uint < PC_LEN > jump_address;
+    drim_uint < PC_LEN > branch_address;
 
     static const int width = 2 + 2 * PC_LEN;
 
@@ -127,7 +128,7 @@ struct fe_out_t {
     //
     // Member declarations.
     //
-    sc_uint < PC_LEN > pc;
+    drim_uint < PC_LEN > pc;
 
     static const int width = PC_LEN;
 
@@ -201,18 +202,18 @@ struct de_out_t {
     //
     // Member declarations.
     //
-    sc_uint < 1 > regwrite;
-    sc_uint < 1 > memtoreg;
-    sc_uint < 3 > ld;
-    sc_uint < 2 > st;
-    sc_uint < ALUOP_SIZE > alu_op;
-    sc_uint < ALUSRC_SIZE > alu_src;
-    sc_int < XLEN > rs1;
-    sc_int < XLEN > rs2;
-    sc_uint < REG_ADDR > dest_reg;
-    sc_uint < PC_LEN > pc;
-    sc_uint < XLEN - 12 > imm_u;
-    sc_uint < TAG_WIDTH > tag;
+    drim_uint < 1 > regwrite;
+    drim_uint < 1 > memtoreg;
+    drim_uint < 3 > ld;
+    drim_uint < 2 > st;
+    drim_uint < ALUOP_SIZE > alu_op;
+    drim_uint < ALUSRC_SIZE > alu_src;
+    drim_int < XLEN > rs1;
+    drim_int < XLEN > rs2;
+    drim_uint < REG_ADDR > dest_reg;
+    drim_uint < PC_LEN > pc;
+    drim_uint < XLEN - 12 > imm_u;
+    drim_uint < TAG_WIDTH > tag;
 
     static
     const int width = 1 + 1 + 3 + 2 + ALUOP_SIZE + ALUSRC_SIZE + 3 * XLEN - 12 + REG_ADDR + PC_LEN + TAG_WIDTH;
@@ -377,15 +378,15 @@ struct exe_out_t // TODO: fix all sizes
     //
     // Member declarations.
     //
-    sc_uint < 3 > ld;
-    sc_uint < 2 > st;
-    sc_uint < 1 > memtoreg;
-    sc_uint < 1 > regwrite;
-    sc_uint < XLEN > alu_res;
-    sc_int < DATA_SIZE > mem_datain;
-    sc_uint < REG_ADDR > dest_reg;
-    sc_uint < TAG_WIDTH > tag;
-    sc_uint < PC_LEN > pc;
+    drim_uint < 3 > ld;
+    drim_uint < 2 > st;
+    drim_uint < 1 > memtoreg;
+    drim_uint < 1 > regwrite;
+    drim_uint < XLEN > alu_res;
+    drim_int < DATA_SIZE > mem_datain;
+    drim_uint < REG_ADDR > dest_reg;
+    drim_uint < TAG_WIDTH > tag;
+    drim_uint < PC_LEN > pc;
 
     static const int width = 3 + 2 + 1 + 1 + XLEN + DATA_SIZE + REG_ADDR + TAG_WIDTH + PC_LEN;
 
@@ -522,11 +523,11 @@ struct mem_out_t {
     //
     // Member declarations.
     //
-    sc_uint < 1 > regwrite;
-    sc_uint < REG_ADDR > regfile_address;
-    sc_int < XLEN > regfile_data;
-    sc_uint < TAG_WIDTH > tag;
-    sc_uint < PC_LEN > pc;
+    drim_uint < 1 > regwrite;
+    drim_uint < REG_ADDR > regfile_address;
+    drim_int < XLEN > regfile_data;
+    drim_uint < TAG_WIDTH > tag;
+    drim_uint < PC_LEN > pc;
 
     static const int width = 1 + REG_ADDR + XLEN + TAG_WIDTH + PC_LEN;
     //
@@ -627,11 +628,11 @@ struct reg_forward_t {
     //
     // Member declarations.
     //
-    sc_int < XLEN > regfile_data;
+    drim_int < XLEN > regfile_data;
     bool ldst;
     bool sync_fewb;
-    sc_uint < TAG_WIDTH > tag;
-    sc_uint < PC_LEN > pc;
+    drim_uint < TAG_WIDTH > tag;
+    drim_uint < PC_LEN > pc;
 
     static
     const int width = XLEN + 1 + 1 + TAG_WIDTH + PC_LEN;
@@ -738,7 +739,7 @@ struct imem_in_t {
     //
     // Member declarations.
     //
-    sc_uint < XLEN > instr_addr;
+    drim_uint < XLEN > instr_addr;
 
     static const int width = XLEN;
     //
@@ -806,7 +807,7 @@ struct imem_out_t {
     //
     // Member declarations.
     //
-    sc_uint < XLEN > instr_data;
+    drim_uint < XLEN > instr_data;
 
     static const int width = XLEN;
     //
@@ -875,8 +876,8 @@ struct dmem_in_t {
     //
     // Member declarations.
     //
-    sc_uint < XLEN > data_addr;
-    sc_uint < XLEN > data_in;
+    drim_uint < XLEN > data_addr;
+    drim_uint < XLEN > data_in;
     bool read_en;
     bool write_en;
 
@@ -972,7 +973,7 @@ struct dmem_out_t {
     //
     // Member declarations.
     //
-    sc_uint < XLEN > data_out;
+    drim_uint < XLEN > data_out;
 
     static const int width = XLEN;
     //
@@ -1042,7 +1043,7 @@ struct fe_in_t {
     //
     bool freeze;
     bool redirect;
-    sc_int < PC_LEN > address;
+    drim_int < PC_LEN > address;
 
     static const int width = 1 + 1 + PC_LEN;
     //
@@ -0,0 +1,222 @@
+/*
+	@brief
+	Integer types of the pipeline state and of the stage datatypes.
+
+	drim_uint < W > and drim_int < W > are sc_uint < W > and sc_int < W >,
+	unless the simulator is built with DRIM_NATIVE_TYPES (make
+	NATIVE_TYPES=1). Then they are native 64-bit integers masked (or sign
+	extended) to a width known at compile time, instead of the run-time
+	length kept by sc_uint_base. They behave like the SystemC types:
+
+		- arithmetic goes through the same 64-bit conversion
+		  (uint64 for drim_uint, int64 for drim_int);
+		- range(hi, lo) and [i] read and write bit fields, and (a, b)
+		  concatenates two drim_uint;
+		- Marshall() goes through sc_uint / sc_int, so the Connections bit
+		  layout does not change.
+
+	Synthesis always uses the SystemC types.
+
+*/
+
+#ifndef __DRIM4HLS_TYPES__H
+#define __DRIM4HLS_TYPES__H
+
+#if defined(__SYNTHESIS__) || !defined(DRIM_NATIVE_TYPES)
+
+#include <systemc.h>
+
+template < int W > using drim_uint = sc_uint < W >;
+template < int W > using drim_int = sc_int < W >;
+
+#else
+
+#include <ostream>
+#include <string>
+
+#include <systemc.h>
+#include <mc_connections.h>
+
+inline sc_dt::uint64 drim_mask(int w) {
+    return w >= 64 ? ~0ULL : (1ULL << w) - 1;
+}
+
+// Part select of a drim_uint / drim_int, returned by range() and [].
+template < class P > class drim_subref {
+    public:
+    drim_subref(P & p, int hi, int lo): parent(p), hi(hi), lo(lo) {}
+
+    operator sc_dt::uint64() const {
+        return (parent.bits() >> lo) & drim_mask(hi - lo + 1);
+    }
+
+    drim_subref & operator = (sc_dt::uint64 x) {
+        sc_dt::uint64 m = drim_mask(hi - lo + 1) << lo;
+        parent.set_bits((parent.bits() & ~m) | ((x << lo) & m));
+        return * this;
+    }
+
+    drim_subref & operator = (const drim_subref & o) {
+        return * this = (sc_dt::uint64) o;
+    }
+
+    int length() const { return hi - lo + 1; }
+    unsigned to_uint() const { return (unsigned)(sc_dt::uint64) * this; }
+    int to_int() const { return (int)(sc_dt::uint64) * this; }
+    sc_dt::uint64 to_uint64() const { return * this; }
+    sc_dt::int64 to_int64() const { return (sc_dt::int64)(sc_dt::uint64) * this; }
+
+    private:
+    P & parent;
+    int hi;
+    int lo;
+};
+
+template < int W > class drim_uint {
+    public:
+    static const unsigned int width = W;
+
+    drim_uint(): v(0) {}
+    drim_uint(const drim_uint & o): v(o.v) {}
+    template < class T > drim_uint(const T & x): v((sc_dt::uint64) x & MASK) {}
+
+    drim_uint & operator = (const drim_uint & o) {
+        v = o.v;
+        return * this;
+    }
+    template < class T > drim_uint & operator = (const T & x) {
+        v = (sc_dt::uint64) x & MASK;
+        return * this;
+    }
+
+    operator sc_dt::uint64() const { return v; }
+
+    template < class T > drim_uint & operator += (const T & x) { return * this = v + (sc_dt::uint64) x; }
+    template < class T > drim_uint & operator -= (const T & x) { return * this = v - (sc_dt::uint64) x; }
+    template < class T > drim_uint & operator *= (const T & x) { return * this = v * (sc_dt::uint64) x; }
+    template < class T > drim_uint & operator /= (const T & x) { return * this = v / (sc_dt::uint64) x; }
+    template < class T > drim_uint & operator %= (const T & x) { return * this = v % (sc_dt::uint64) x; }
+    template < class T > drim_uint & operator &= (const T & x) { return * this = v & (sc_dt::uint64) x; }
+    template < class T > drim_uint & operator |= (const T & x) { return * this = v | (sc_dt::uint64) x; }
+    template < class T > drim_uint & operator ^= (const T & x) { return * this = v ^ (sc_dt::uint64) x; }
+    template < class T > drim_uint & operator <<= (const T & x) { return * this = v << (sc_dt::uint64) x; }
+    template < class T > drim_uint & operator >>= (const T & x) { return * this = v >> (sc_dt::uint64) x; }
+    drim_uint & operator ++ () { return * this = v + 1; }
+    drim_uint & operator -- () { return * this = v - 1; }
+    drim_uint operator ++ (int) { drim_uint t = * this; ++ * this; return t; }
+    drim_uint operator -- (int) { drim_uint t = * this; -- * this; return t; }
+
+    drim_subref < drim_uint > range(int hi, int lo) { return drim_subref < drim_uint > (* this, hi, lo); }
+    drim_subref < const drim_uint > range(int hi, int lo) const { return drim_subref < const drim_uint > (* this, hi, lo); }
+    drim_subref < drim_uint > operator [] (int i) { return range(i, i); }
+    drim_subref < const drim_uint > operator [] (int i) const { return range(i, i); }
+
+    int length() const { return W; }
+    unsigned to_uint() const { return (unsigned) v; }
+    int to_int() const { return (int) v; }
+    sc_dt::uint64 to_uint64() const { return v; }
+    sc_dt::int64 to_int64() const { return (sc_dt::int64) v; }
+
+    sc_dt::uint64 bits() const { return v; }
+    void set_bits(sc_dt::uint64 x) { v = x & MASK; }
+    const sc_dt::uint64 & value_ref() const { return v; }
+
+    template < unsigned int Size > void Marshall(Marshaller < Size > & m) {
+        sc_uint < W > t = v;
+        m & t;
+        v = t.to_uint64();
+    }
+
+    private:
+    static const sc_dt::uint64 MASK = W >= 64 ? ~0ULL : (1ULL << (W & 63)) - 1;
+    sc_dt::uint64 v;
+};
+
+template < int W > class drim_int {
+    public:
+    static const unsigned int width = W;
+
+    drim_int(): v(0) {}
+    drim_int(const drim_int & o): v(o.v) {}
+    template < class T > drim_int(const T & x): v(extend((sc_dt::uint64) x)) {}
+
+    drim_int & operator = (const drim_int & o) {
+        v = o.v;
+        return * this;
+    }
+    template < class T > drim_int & operator = (const T & x) {
+        v = extend((sc_dt::uint64) x);
+        return * this;
+    }
+
+    operator sc_dt::int64() const { return v; }
+
+    template < class T > drim_int & operator += (const T & x) { return * this = (sc_dt::uint64) v + (sc_dt::uint64) x; }
+    template < class T > drim_int & operator -= (const T & x) { return * this = (sc_dt::uint64) v - (sc_dt::uint64) x; }
+    template < class T > drim_int & operator *= (const T & x) { return * this = (sc_dt::uint64) v * (sc_dt::uint64) x; }
+    template < class T > drim_int & operator /= (const T & x) { return * this = v / (sc_dt::int64) x; }
+    template < class T > drim_int & operator %= (const T & x) { return * this = v % (sc_dt::int64) x; }
+    template < class T > drim_int & operator &= (const T & x) { return * this = v & (sc_dt::int64) x; }
+    template < class T > drim_int & operator |= (const T & x) { return * this = v | (sc_dt::int64) x; }
+    template < class T > drim_int & operator ^= (const T & x) { return * this = v ^ (sc_dt::int64) x; }
+    template < class T > drim_int & operator <<= (const T & x) { return * this = (sc_dt::uint64) v << (sc_dt::uint64) x; }
+    template < class T > drim_int & operator >>= (const T & x) { return * this = v >> (sc_dt::uint64) x; }
+    drim_int & operator ++ () { return * this = (sc_dt::uint64) v + 1; }
+    drim_int & operator -- () { return * this = (sc_dt::uint64) v - 1; }
+    drim_int operator ++ (int) { drim_int t = * this; ++ * this; return t; }
+    drim_int operator -- (int) { drim_int t = * this; -- * this; return t; }
+
+    drim_subref < drim_int > range(int hi, int lo) { return drim_subref < drim_int > (* this, hi, lo); }
+    drim_subref < const drim_int > range(int hi, int lo) const { return drim_subref < const drim_int > (* this, hi, lo); }
+    drim_subref < drim_int > operator [] (int i) { return range(i, i); }
+    drim_subref < const drim_int > operator [] (int i) const { return range(i, i); }
+
+    int length() const { return W; }
+    unsigned to_uint() const { return (unsigned) v; }
+    int to_int() const { return (int) v; }
+    sc_dt::uint64 to_uint64() const { return (sc_dt::uint64) v; }
+    sc_dt::int64 to_int64() const { return v; }
+
+    // Bits 0..W-1, as seen by range().
+    sc_dt::uint64 bits() const { return (sc_dt::uint64) v & drim_mask(W); }
+    void set_bits(sc_dt::uint64 x) { v = extend(x); }
+    const sc_dt::int64 & value_ref() const { return v; }
+
+    template < unsigned int Size > void Marshall(Marshaller < Size > & m) {
+        sc_int < W > t = v;
+        m & t;
+        v = t.to_int64();
+    }
+
+    private:
+    sc_dt::int64 v;
+
+    static sc_dt::int64 extend(sc_dt::uint64 x) {
+        return (sc_dt::int64)(x << (64 - W)) >> (64 - W);
+    }
+};
+
+// Concatenation, like the comma of sc_uint: a in the high bits.
+template < int A, int B > inline drim_uint < A + B > operator , (const drim_uint < A > & a, const drim_uint < B > & b) {
+    return drim_uint < A + B > ((a.bits() << B) | b.bits());
+}
+
+template < int W > inline std::ostream & operator << (std::ostream & os, const drim_uint < W > & x) {
+    return os << x.to_uint64();
+}
+
+template < int W > inline std::ostream & operator << (std::ostream & os, const drim_int < W > & x) {
+    return os << x.to_int64();
+}
+
+template < int W > inline void sc_trace(sc_trace_file * tf, const drim_uint < W > & x, const std::string & name) {
+    sc_trace(tf, x.value_ref(), name, W);
+}
+
+template < int W > inline void sc_trace(sc_trace_file * tf, const drim_int < W > & x, const std::string & name) {
+    sc_trace(tf, x.value_ref(), name, W);
+}
+
+#endif // DRIM_NATIVE_TYPES
+
+#endif // __DRIM4HLS_TYPES__H
@@ -0,0 +1,247 @@
+/*
+	@brief
+	Minimal read-only view of a 32-bit little-endian RISC-V ELF file, as
+	produced by the scheduler Makefiles (schedulers/<name>/notmain.elf).
+	The file is mmap'ed; symbols are read from .symtab. Simulation only.
+
+*/
+
+#ifndef __ELF_FILE__H
+#define __ELF_FILE__H
+
+#ifndef __SYNTHESIS__
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct elf_symbol_t {
+    std::string name;
+    unsigned value;
+    unsigned size;
+    bool func;
+
+    bool operator < (const elf_symbol_t & other) const {
+        return value < other.value;
+    }
+};
+
+class elf_file {
+    public:
+    elf_file(): base(NULL), length(0), fd(-1) {}
+
+    ~elf_file() {
+        close();
+    }
+
+    // Maps the file and reads its symbol table. Returns false and sets
+    // error() if the file is not a 32-bit RISC-V ELF.
+    bool open(const std::string & path) {
+        close();
+        file_path = path;
+
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return fail("cannot open file");
+
+        struct stat st;
+        if (fstat(fd, & st) != 0 || st.st_size < (off_t) sizeof(Elf32_Ehdr))
+            return fail("file too small");
+
+        length = st.st_size;
+        void * m = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            base = NULL;
+            return fail("mmap failed");
+        }
+        base = (const unsigned char *) m;
+
+        const Elf32_Ehdr * eh = header();
+        if (memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0)
+            return fail("not an ELF file");
+        if (eh->e_ident[EI_CLASS] != ELFCLASS32 || eh->e_ident[EI_DATA] != ELFDATA2LSB)
+            return fail("not a 32-bit little-endian ELF");
+        if (eh->e_machine != EM_RISCV)
+            return fail("not a RISC-V ELF");
+        if ((eh->e_shnum && eh->e_shentsize != sizeof(Elf32_Shdr)) ||
+            (eh->e_phnum && eh->e_phentsize != sizeof(Elf32_Phdr)))
+            return fail("unexpected section or program header size");
+        if (!in_file(eh->e_shoff, (size_t) eh->e_shnum * sizeof(Elf32_Shdr)) ||
+            !in_file(eh->e_phoff, (size_t) eh->e_phnum * sizeof(Elf32_Phdr)))
+            return fail("truncated headers");
+
+        read_symbols();
+        return true;
+    }
+
+    // True if path starts with the ELF magic, so that loaders can accept
+    // both notmain.elf and the older notmain.txt.
+    static bool is_elf(const std::string & path) {
+        unsigned char magic[SELFMAG];
+        int f = ::open(path.c_str(), O_RDONLY);
+        if (f < 0)
+            return false;
+        bool elf = ::read(f, magic, SELFMAG) == SELFMAG && memcmp(magic, ELFMAG, SELFMAG) == 0;
+        ::close(f);
+        return elf;
+    }
+
+    void close() {
+        if (base)
+            munmap((void *) base, length);
+        if (fd >= 0)
+            ::close(fd);
+        base = NULL;
+        length = 0;
+        fd = -1;
+        symbols.clear();
+        all_symbols.clear();
+    }
+
+    const std::string & path() const {
+        return file_path;
+    }
+
+    const std::string & error() const {
+        return err;
+    }
+
+    unsigned entry() const {
+        return header()->e_entry;
+    }
+
+    // Symbol containing addr (FUNC/NOTYPE symbols of the program), or NULL.
+    const elf_symbol_t * find_symbol(unsigned addr) const {
+        std::vector < elf_symbol_t >::const_iterator it = std::upper_bound(symbols.begin(), symbols.end(), key(addr));
+        if (it == symbols.begin())
+            return NULL;
+        --it;
+        if (it->size != 0 && addr >= it->value + it->size)
+            return NULL;
+        return &(*it);
+    }
+
+    // Address of a named symbol (functions and data), false if not found.
+    bool symbol_address(const std::string & name, unsigned & addr) const {
+        for (size_t i = 0; i < all_symbols.size(); i++) {
+            if (all_symbols[i].name == name) {
+                addr = all_symbols[i].value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Calls load(addr, word) for every word of the PT_LOAD segments, zero
+    // past the end of the file data (.bss). Returns false on a truncated
+    // or unaligned segment.
+    template < class F > bool for_each_load_word(F load) const {
+        const Elf32_Ehdr * eh = header();
+        for (unsigned i = 0; i < eh->e_phnum; i++) {
+            const Elf32_Phdr * ph = segment(i);
+            if (ph->p_type != PT_LOAD || ph->p_memsz == 0)
+                continue;
+            if (!in_file(ph->p_offset, ph->p_filesz) || (ph->p_paddr & 3))
+                return false;
+            const unsigned char * src = base + ph->p_offset;
+            for (unsigned off = 0; off < ph->p_memsz; off += 4) {
+                unsigned word = 0;
+                for (unsigned b = 0; b < 4; b++) {
+                    if (off + b < ph->p_filesz)
+                        word |= (unsigned) src[off + b] << (8 * b);
+                }
+                load(ph->p_paddr + off, word);
+            }
+        }
+        return true;
+    }
+
+    protected:
+    const unsigned char * base;
+    size_t length;
+    int fd;
+    std::string file_path;
+    std::string err;
+    std::vector < elf_symbol_t > symbols; // code symbols sorted by address
+    std::vector < elf_symbol_t > all_symbols;
+
+    const Elf32_Ehdr * header() const {
+        return (const Elf32_Ehdr *) base;
+    }
+
+    const Elf32_Shdr * section(unsigned i) const {
+        return (const Elf32_Shdr *)(base + header()->e_shoff) + i;
+    }
+
+    const Elf32_Phdr * segment(unsigned i) const {
+        return (const Elf32_Phdr *)(base + header()->e_phoff) + i;
+    }
+
+    bool in_file(size_t off, size_t len) const {
+        return off <= length && len <= length - off;
+    }
+
+    bool fail(const char * msg) {
+        err = file_path + ": " + msg;
+        close();
+        return false;
+    }
+
+    static elf_symbol_t key(unsigned addr) {
+        elf_symbol_t k;
+        k.value = addr;
+        k.size = 0;
+        k.func = false;
+        return k;
+    }
+
+    void read_symbols() {
+        const Elf32_Ehdr * eh = header();
+        for (unsigned i = 0; i < eh->e_shnum; i++) {
+            const Elf32_Shdr * sh = section(i);
+            if (sh->sh_type != SHT_SYMTAB || sh->sh_link >= eh->e_shnum)
+                continue;
+            const Elf32_Shdr * strtab = section(sh->sh_link);
+            if (!in_file(sh->sh_offset, sh->sh_size) || !in_file(strtab->sh_offset, strtab->sh_size))
+                continue;
+
+            const Elf32_Sym * sym = (const Elf32_Sym *)(base + sh->sh_offset);
+            unsigned count = sh->sh_size / sizeof(Elf32_Sym);
+            for (unsigned j = 0; j < count; j++) {
+                unsigned type = ELF32_ST_TYPE(sym[j].st_info);
+                if (sym[j].st_shndx == SHN_UNDEF || sym[j].st_name >= strtab->sh_size)
+                    continue;
+                if (type != STT_FUNC && type != STT_NOTYPE && type != STT_OBJECT)
+                    continue;
+
+                // The name must end before the string table does.
+                const char * name = (const char *)(base + strtab->sh_offset + sym[j].st_name);
+                if (!memchr(name, '\0', strtab->sh_size - sym[j].st_name))
+                    continue;
+                if (name[0] == '\0' || name[0] == '$') // mapping symbols
+                    continue;
+
+                elf_symbol_t s;
+                s.name = name;
+                s.value = sym[j].st_value;
+                s.size = sym[j].st_size;
+                s.func = (type == STT_FUNC);
+                all_symbols.push_back(s);
+                if (type != STT_OBJECT && sym[j].st_shndx != SHN_ABS)
+                    symbols.push_back(s);
+            }
+        }
+        std::sort(symbols.begin(), symbols.end());
+    }
+};
+
+#endif // __SYNTHESIS__
+
+#endif // __ELF_FILE__H
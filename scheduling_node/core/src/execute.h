@@ -20,28 +20,27 @@
 #ifndef __EXECUTE__H
 #define __EXECUTE__H
 
-#ifndef NDEBUG
-    #include <iostream>
-    #define DPRINT(msg) std::cout << msg;
-#endif
-
 #define BIT(_N)(1 << _N)
 
 #include "drim4hls_datatypes.h"
 #include "defines.h"
 #include "globals.h"
+#include "checkpoint.h"
+#include "kanata_trace.h"
+#include "trace_ring.h"
+#include "chan_log.h"
 
 #include <mc_connections.h>
 // Signed division quotient and remainder struct.
 struct div_res_t {
-    sc_int < XLEN > quotient;
-    sc_int < XLEN > remainder;
+    drim_int < XLEN > quotient;
+    drim_int < XLEN > remainder;
 };
 
 // Unsigned division quotient and remainder struct.
 struct u_div_res_t {
-    sc_uint < XLEN > quotient;
-    sc_uint < XLEN > remainder;
+    drim_uint < XLEN > quotient;
+    drim_uint < XLEN > remainder;
 };
 
 SC_MODULE(execute) {
@@ -59,7 +58,7 @@ SC_MODULE(execute) {
         sc_bv < XLEN > alu_res;
         sc_bv < DATA_SIZE > mem_datain;
         sc_bv < REG_ADDR > dest_reg;
-        sc_uint < TAG_WIDTH > tag;
+        drim_uint < TAG_WIDTH > tag;
         std::string alu_src;
         std::string alu_op;
 
@@ -76,6 +75,11 @@ SC_MODULE(execute) {
     // Forward
     Connections::Out < reg_forward_t > CCS_INIT_S1(fwd_exe);
 
+    // Performance monitor event lines from decode (bit i = event i) and fetch.
+    sc_in < sc_uint < HPM_EV_NUM > > CCS_INIT_S1(de_events);
+    sc_in < bool > CCS_INIT_S1(imem_wait);
+    sc_in < bool > CCS_INIT_S1(dmem_wait);
+
     // Member variables
     de_out_t data_in;
     de_out_t input;
@@ -83,30 +87,73 @@ SC_MODULE(execute) {
     dmem_in_t dmem_din;
     reg_forward_t forward;
 
-    sc_uint < XLEN > csr[CSR_NUM]; // Control and status registers.
+    drim_uint < XLEN > csr[CSR_NUM]; // Control and status registers.
     bool freeze;
+
+    // Hardware performance monitor. The counters are owned by hpm_th, which
+    // runs every clock, so that stalled cycles are counted too.
+    // hpm_counter[0] is mcycle, hpm_counter[i] is mhpmcounter(i + 2).
+    sc_signal < sc_uint < XLEN > > hpm_counter[PRF_CNT_NUM + 1];
+    sc_signal < sc_uint < XLEN > > hpm_event_sel[PRF_CNT_NUM]; // Copy of mhpmevent3..7
+    sc_signal < bool > CCS_INIT_S1(div_busy);
+    // Counter write request from execute_th (CSR instructions): every write
+    // flips hpm_wr_req, so hpm_th applies it exactly once even while
+    // execute_th is stalled on dout.
+    sc_signal < bool > CCS_INIT_S1(hpm_wr_req);
+    sc_signal < sc_uint < CSR_IDX_LEN > > CCS_INIT_S1(hpm_wr_idx);
+    sc_signal < sc_uint < XLEN > > CCS_INIT_S1(hpm_wr_data);
    
     // Constructor
-    SC_CTOR(execute): din("din"), dout("dout"), fwd_exe("fwd_exe"), clk("clk"), rst("rst") {
+    SC_CTOR(execute): clk("clk"), rst("rst"), din("din"), dout("dout"), fwd_exe("fwd_exe"), de_events("de_events"), imem_wait("imem_wait"), dmem_wait("dmem_wait") {
         SC_THREAD(execute_th);
         sensitive << clk.pos();
         async_reset_signal_is(rst, false);
+
+        SC_THREAD(hpm_th);
+        sensitive << clk.pos();
+        async_reset_signal_is(rst, false);
     }
 
-    u_div_res_t udiv_func(sc_uint < XLEN > num, sc_uint < XLEN > den) {
-        sc_uint < XLEN > rem;
-        sc_uint < XLEN > quotient;
+    #ifndef __SYNTHESIS__
+    // Checkpoint of the CSRs and HPM counters, see checkpoint.h. The
+    // counters are signals owned by hpm_th, so they are only loaded while
+    // the core is frozen.
+    void save_state(checkpoint & ckpt) const {
+        checkpoint::writer w = ckpt.add("execute");
+        w.put_array(csr, CSR_NUM);
+        for (int i = 0; i < PRF_CNT_NUM + 1; i++)
+            w.put(hpm_counter[i].read());
+    }
+
+    bool load_state(const checkpoint & ckpt) {
+        checkpoint::reader r = ckpt.find("execute");
+        r.get_array(csr, CSR_NUM);
+        for (int i = 0; i < PRF_CNT_NUM; i++)
+            hpm_event_sel[i].write(csr[MHPMEVENT3_I + i].to_uint64());
+        for (int i = 0; i < PRF_CNT_NUM + 1; i++) {
+            drim_uint < XLEN > count;
+            r.get(count);
+            hpm_counter[i].write(count.to_uint64());
+        }
+        return r.ok();
+    }
+    #endif
+
+    u_div_res_t udiv_func(drim_uint < XLEN > num, drim_uint < XLEN > den) {
+        drim_uint < XLEN > rem;
+        drim_uint < XLEN > quotient;
         u_div_res_t u_div_res;
 
         rem = 0;
         quotient = 0;
+        div_busy.write(true);
 
         DIVIDE_LOOP:
-            for (sc_int < 6 > i = 31; i >= 0; i--) {
+            for (drim_int < 6 > i = 31; i >= 0; i--) {
                 // Break EXE stage protocol for DSE
 
-                const sc_uint < XLEN > mask = BIT(i);
-                const sc_uint < XLEN > lsb = (mask & num) >> i;
+                const drim_uint < XLEN > mask = BIT(i);
+                const drim_uint < XLEN > lsb = (mask & num) >> i;
 
                 rem = rem << 1;
                 rem = rem | lsb;
@@ -118,13 +165,14 @@ SC_MODULE(execute) {
                 wait();
             }
 
+        div_busy.write(false);
         u_div_res.quotient = quotient;
         u_div_res.remainder = rem;
 
         return u_div_res;
     }
 
-    div_res_t div_func(sc_int < XLEN > num, sc_int < XLEN > den) {
+    div_res_t div_func(drim_int < XLEN > num, drim_int < XLEN > den) {
         bool num_neg;
         bool den_neg;
         div_res_t div_res;
@@ -138,9 +186,9 @@ SC_MODULE(execute) {
         if (den_neg)
             den = -den;
 
-        u_div_res = udiv_func((sc_uint < XLEN > ) num, (sc_uint < XLEN > ) den);
-        div_res.quotient = (sc_int < XLEN > ) u_div_res.quotient;
-        div_res.remainder = (sc_int < XLEN > ) u_div_res.remainder;
+        u_div_res = udiv_func((drim_uint < XLEN > ) num, (drim_uint < XLEN > ) den);
+        div_res.quotient = (drim_int < XLEN > ) u_div_res.quotient;
+        div_res.remainder = (drim_int < XLEN > ) u_div_res.remainder;
 
         if (num_neg ^ den_neg)
             div_res.quotient = -div_res.quotient;
@@ -163,7 +211,13 @@ SC_MODULE(execute) {
             csr[MIMPID_I] = 0x0; // Not implemented (processor revision)
             csr[MHARTID_I] = 0x0; // Single thread (always 0)
             csr[MINSTRET_I] = 0x0; // Retired instructions
-            csr[MCYCLE_I] = 0x0; // Cycle count (32-bits only for now)
+            csr[MCYCLE_I] = 0x0; // Cycle count, see hpm_th (32-bits only for now)
+            for (int i = 0; i < PRF_CNT_NUM; i++) {
+                csr[MHPMEVENT3_I + i] = HPM_EV_NONE;
+                hpm_event_sel[i].write(HPM_EV_NONE);
+            }
+            hpm_wr_req.write(false);
+            div_busy.write(false);
 
             wait();
         }
@@ -172,8 +226,7 @@ SC_MODULE(execute) {
         #pragma pipeline_stall_mode flush
         EXE_BODY: while (true) {
             input = din.Pop();
-            
-            csr[MCYCLE_I]++;            
+            CHAN_LOG(din, input);
 
             // Compute
             output.regwrite = input.regwrite;
@@ -192,9 +245,15 @@ SC_MODULE(execute) {
                 input.alu_op == ALUOP_NULL) {
                 nop = true;
             }
+            if (!nop) {
+                KANATA(execute(input.pc.to_uint()));
+                if (input.alu_op >= ALUOP_DIV && input.alu_op <= ALUOP_REMU)
+                    KANATA(stall(input.pc.to_uint(), kanata_trace::ST_EXECUTE, "div"));
+            }
+
             #ifdef MUL64
             // 64-bit temporary multiplication result, for upper 32 bit multiplications (MULH, MULHU, MULHSU).
-            sc_uint <64> tmp_mul_res = 0;
+            drim_uint <64> tmp_mul_res = 0;
             #endif
             #ifdef DIV
             // Temporary division results.
@@ -209,22 +268,22 @@ SC_MODULE(execute) {
             #endif
             #ifdef CSR_LOGIC
             // Temporary CSR index
-            sc_uint < CSR_IDX_LEN > csr_index = 0;
+            drim_uint < CSR_IDX_LEN > csr_index = 0;
             #endif
 
             // Sign extend the immediate operand for I-type instructions.
-            sc_uint < XLEN > tmp_sigext_imm_i = 0;
+            drim_uint < XLEN > tmp_sigext_imm_i = 0;
             if (input.imm_u[19] == 1) {
                 // Extend with 1s
-                tmp_sigext_imm_i = (sc_uint < 20 > (1048575), (sc_uint < 12 > ) input.imm_u.range(19, 8));
+                tmp_sigext_imm_i = (drim_uint < 20 > (1048575), (drim_uint < 12 > ) input.imm_u.range(19, 8));
             } else {
                 // Extend with 0s
-                tmp_sigext_imm_i = (sc_uint < 20 > (0), (sc_uint < 12 > ) input.imm_u.range(19, 8));
+                tmp_sigext_imm_i = (drim_uint < 20 > (0), (drim_uint < 12 > ) input.imm_u.range(19, 8));
             }
             // Zero-fill the immediate operand for U-type instructions.
-            sc_uint < XLEN > tmp_zerofill_imm_u = ((sc_uint < 20 > ) input.imm_u.range(19, 0), sc_uint < 12 > (0));
+            drim_uint < XLEN > tmp_zerofill_imm_u = ((drim_uint < 20 > ) input.imm_u.range(19, 0), drim_uint < 12 > (0));
             // ALU 2nd operand multiplexing based on ALUSRC signal.
-            sc_uint < XLEN > tmp_rs2 = 0;
+            drim_uint < XLEN > tmp_rs2 = 0;
 
             if (input.alu_src == ALUSRC_RS2) {
                 tmp_rs2 = input.rs2;
@@ -242,7 +301,7 @@ SC_MODULE(execute) {
 
             } else if (input.alu_src == ALUSRC_IMM_S) {
                 // reconstructs imm_s from imm_u and rd
-                sc_uint < 12 > imm_s = (sc_uint < 7 > (input.imm_u.range(19, 13)), input.dest_reg);
+                drim_uint < 12 > imm_s = (drim_uint < 7 > (input.imm_u.range(19, 13)), (drim_uint < REG_ADDR > ) input.dest_reg);
                 tmp_rs2 = sign_extend_imm_s(imm_s);
 
                 #ifndef __SYNTHESIS__
@@ -261,7 +320,7 @@ SC_MODULE(execute) {
             // ALU body
             switch (input.alu_op) {
             case ALUOP_ADD: // ADD, ADDI, SB, SH, SW, LB, LH, LW, LBU, LHU.
-                output.alu_res = (sc_uint<32>) input.rs1.to_int() + tmp_rs2.to_int();
+                output.alu_res = (drim_uint<32>) input.rs1.to_int() + tmp_rs2.to_int();
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_ADD";
@@ -269,7 +328,7 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_SLT: // SLT, SLTI
-                if ((sc_int<32>) input.rs1 < (sc_int<32>) tmp_rs2)
+                if ((drim_int<32>) input.rs1 < (drim_int<32>) tmp_rs2)
                     output.alu_res = 1;
                 else
                     output.alu_res = 0;
@@ -280,7 +339,7 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_SLTU: // SLTU, SLTIU
-                if ((sc_int<32>) input.rs1  < (sc_int<32>) tmp_rs2)
+                if ((drim_int<32>) input.rs1  < (drim_int<32>) tmp_rs2)
                     output.alu_res = 1;
                 else
                     output.alu_res = 0;
@@ -315,7 +374,7 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_SLL: // SLL
-                output.alu_res = (sc_uint < XLEN >) input.rs1 << (sc_uint < SHAMT >) tmp_rs2.range(4, 0);
+                output.alu_res = (drim_uint < XLEN >) input.rs1 << (drim_uint < SHAMT >) tmp_rs2.range(4, 0);
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_SLL";
@@ -323,7 +382,7 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_SRL: // SRL
-                output.alu_res = (sc_uint < XLEN >) input.rs1 >> (sc_uint < SHAMT >) tmp_rs2.range(4, 0);
+                output.alu_res = (drim_uint < XLEN >) input.rs1 >> (drim_uint < SHAMT >) tmp_rs2.range(4, 0);
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_SRL";
@@ -331,8 +390,8 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_SRA: // SRA
-                // >> is arith right sh. for sc_int operand
-                output.alu_res = (sc_int < XLEN >) input.rs1 >> (sc_uint < SHAMT >) tmp_rs2.range(4, 0);
+                // >> is arith right sh. for drim_int operand
+                output.alu_res = (drim_int < XLEN >) input.rs1 >> (drim_uint < SHAMT >) tmp_rs2.range(4, 0);
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_SRA";
@@ -340,7 +399,7 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_SUB: // SUB
-                output.alu_res = (sc_uint < XLEN >) ((sc_int < XLEN >) input.rs1 - (sc_int < XLEN >) tmp_rs2);
+                output.alu_res = (drim_uint < XLEN >) ((drim_int < XLEN >) input.rs1 - (drim_int < XLEN >) tmp_rs2);
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_SUB";
@@ -348,7 +407,7 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_SLLI: // SLLI
-                output.alu_res = (sc_uint < XLEN >) input.rs1 << (sc_uint < SHAMT >) tmp_rs2.range(24, 20);
+                output.alu_res = (drim_uint < XLEN >) input.rs1 << (drim_uint < SHAMT >) tmp_rs2.range(24, 20);
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_SLLI";
@@ -356,7 +415,7 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_SRLI: // SRLI
-                output.alu_res = (sc_uint < XLEN >) input.rs1 >> (sc_uint < SHAMT >) tmp_rs2.range(24, 20);
+                output.alu_res = (drim_uint < XLEN >) input.rs1 >> (drim_uint < SHAMT >) tmp_rs2.range(24, 20);
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_SRLI";
@@ -364,8 +423,8 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_SRAI: // SRAI
-                // >> is arith right sh. for sc_int operand
-                output.alu_res = (sc_int < XLEN >) input.rs1 >> (sc_uint < SHAMT >) tmp_rs2.range(24, 20);
+                // >> is arith right sh. for drim_int operand
+                output.alu_res = (drim_int < XLEN >) input.rs1 >> (drim_uint < SHAMT >) tmp_rs2.range(24, 20);
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_SRAI";
@@ -383,7 +442,7 @@ SC_MODULE(execute) {
                 break;
             case ALUOP_AUIPC: // AUIPC
                 // zerofill_imm_u + pc
-                output.alu_res = (sc_int < XLEN >) tmp_rs2 + (sc_int < XLEN >) input.pc;
+                output.alu_res = (drim_int < XLEN >) tmp_rs2 + (drim_int < XLEN >) input.pc;
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_AUIPC";
@@ -392,7 +451,7 @@ SC_MODULE(execute) {
                 break;
             case ALUOP_JAL: // JAL, JALR
                 // link register update
-                output.alu_res = (sc_int < XLEN >) input.pc + 4;
+                output.alu_res = (drim_int < XLEN >) input.pc + 4;
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_JAL";
@@ -401,7 +460,7 @@ SC_MODULE(execute) {
                 break;
                 #ifdef MUL32
             case ALUOP_MUL: // MUL: signed * signed, return lower 32 bits
-                output.alu_res = (sc_int < XLEN >) input.rs1 * (sc_int < XLEN >) tmp_rs2;
+                output.alu_res = (drim_int < XLEN >) input.rs1 * (drim_int < XLEN >) tmp_rs2;
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_MUL";
@@ -412,7 +471,7 @@ SC_MODULE(execute) {
                 #ifdef MUL64
             case ALUOP_MULH: // MULH: signed * signed, return upper 32 bits
                 tmp_mul_res = input.rs1.to_int() * tmp_rs2.to_int();
-                output.alu_res = sc_uint < XLEN * 2 > (sc_int < XLEN * 2 > (tmp_mul_res)).range((XLEN * 2) - 1, XLEN);
+                output.alu_res = drim_uint < XLEN * 2 > (drim_int < XLEN * 2 > (tmp_mul_res)).range((XLEN * 2) - 1, XLEN);
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_MULH";
@@ -421,7 +480,7 @@ SC_MODULE(execute) {
                 break;
             case ALUOP_MULHSU: // MULHSU: signed * unsigned, return upper 32 bits
                 tmp_mul_res = input.rs1 * tmp_rs2.to_uint();
-                output.alu_res = sc_uint < XLEN * 2 > (sc_int < XLEN * 2 > (tmp_mul_res)).range((XLEN * 2) - 1, XLEN);
+                output.alu_res = drim_uint < XLEN * 2 > (drim_int < XLEN * 2 > (tmp_mul_res)).range((XLEN * 2) - 1, XLEN);
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_MULHSU";
@@ -430,7 +489,7 @@ SC_MODULE(execute) {
                 break;
             case ALUOP_MULHU: // MULHU: unsigned * unsigned, return upper 32 bits
                 tmp_mul_res = input.rs1.to_int() * tmp_rs2.to_uint();
-                output.alu_res = sc_uint < XLEN * 2 > (sc_int < XLEN * 2 > (tmp_mul_res)).range((XLEN * 2) - 1, XLEN);
+                output.alu_res = drim_uint < XLEN * 2 > (drim_int < XLEN * 2 > (tmp_mul_res)).range((XLEN * 2) - 1, XLEN);
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_MULHU";
@@ -440,7 +499,7 @@ SC_MODULE(execute) {
                 #endif
                 #ifdef DIV
             case ALUOP_DIV: // DIV calls div_func
-                div_res = div_func((sc_int < XLEN >) input.rs1, (sc_int < XLEN >) tmp_rs2);
+                div_res = div_func((drim_int < XLEN >) input.rs1, (drim_int < XLEN >) tmp_rs2);
                 output.alu_res = div_res.quotient;
 
                 #ifndef __SYNTHESIS__
@@ -460,7 +519,7 @@ SC_MODULE(execute) {
                 #endif
                 #ifdef REM
             case ALUOP_REM: // REM calls div_func
-                div_res = div_func((sc_int < XLEN >) input.rs1, (sc_int < XLEN >) tmp_rs2);
+                div_res = div_func((drim_int < XLEN >) input.rs1, (drim_int < XLEN >) tmp_rs2);
                 output.alu_res = div_res.remainder;
 
                 #ifndef __SYNTHESIS__
@@ -483,8 +542,8 @@ SC_MODULE(execute) {
                 // This avoids having 12 more bits on the FEDEC-EXE Flex Channel.
                 // The same goes for imm_u[7:3] i.e. zimm for the 3 CSRxI instructions.
             case ALUOP_CSRRW: // CSRRW
-                csr_index = get_csr_index(input.imm_u.range(19, 8));
-                output.alu_res = csr[csr_index];
+                csr_index = get_csr_index(input.imm_u.range(19, 8).to_uint());
+                output.alu_res = read_csr(csr_index);
                 set_csr_value(csr_index, input.rs1.to_uint(), CSR_OP_WR, input.imm_u.range(19, 18).to_uint());
 
                 #ifndef __SYNTHESIS__
@@ -493,8 +552,8 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_CSRRS: // CSRRS
-                csr_index = get_csr_index(input.imm_u.range(19, 8));
-                output.alu_res = csr[csr_index];
+                csr_index = get_csr_index(input.imm_u.range(19, 8).to_uint());
+                output.alu_res = read_csr(csr_index);
                 set_csr_value(csr_index, input.rs1.to_uint(), CSR_OP_SET, input.imm_u.range(19, 18).to_uint());
 
                 #ifndef __SYNTHESIS__
@@ -503,8 +562,8 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_CSRRC: // CSRRC
-                csr_index = get_csr_index(input.imm_u.range(19, 8));
-                output.alu_res = csr[csr_index];
+                csr_index = get_csr_index(input.imm_u.range(19, 8).to_uint());
+                output.alu_res = read_csr(csr_index);
                 set_csr_value(csr_index, input.rs1.to_uint(), CSR_OP_CLR, input.imm_u.range(19, 8).to_uint());
 
                 #ifndef __SYNTHESIS__
@@ -513,8 +572,8 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_CSRRWI: // CSRRWI
-                csr_index = get_csr_index(input.imm_u.range(19, 8));
-                output.alu_res = csr[csr_index];
+                csr_index = get_csr_index(input.imm_u.range(19, 8).to_uint());
+                output.alu_res = read_csr(csr_index);
                 set_csr_value(csr_index, input.imm_u.range(7, 3).to_uint(), CSR_OP_WR, input.imm_u.range(19, 18).to_uint());
 
                 #ifndef __SYNTHESIS__
@@ -523,8 +582,8 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_CSRRSI: // CSRRSI
-                csr_index = get_csr_index(input.imm_u.range(19, 8));
-                output.alu_res = csr[csr_index];
+                csr_index = get_csr_index(input.imm_u.range(19, 8).to_uint());
+                output.alu_res = read_csr(csr_index);
                 set_csr_value(csr_index, input.imm_u.range(7, 3).to_uint(), CSR_OP_SET, input.imm_u.range(19, 18).to_uint());
 
                 #ifndef __SYNTHESIS__
@@ -533,9 +592,9 @@ SC_MODULE(execute) {
 
                 break;
             case ALUOP_CSRRCI: // CSRRCI
-                csr_index = get_csr_index(input.imm_u.range(19, 8));
-                output.alu_res = csr[csr_index];
-                set_csr_value(csr_index, input.imm_u.range(7, 3), CSR_OP_CLR, input.imm_u.range(19, 18));
+                csr_index = get_csr_index(input.imm_u.range(19, 8).to_uint());
+                output.alu_res = read_csr(csr_index);
+                set_csr_value(csr_index, input.imm_u.range(7, 3).to_uint(), CSR_OP_CLR, input.imm_u.range(19, 18).to_uint());
 
                 #ifndef __SYNTHESIS__
                 debug_exe_out_t.alu_op = "ALUOP_CSRRCI";
@@ -579,19 +638,51 @@ SC_MODULE(execute) {
                 dout.Push(output);
             }
 
-            #ifndef __SYNTHESIS__
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "nop " << nop << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << std::hex << "pc= " << input.pc << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "forward.regfile_data " << forward.regfile_data << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "forward.tag " << forward.tag << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "output.alu_op " << debug_exe_out_t.alu_op << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "output.alu_res " << output.alu_res << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "output.ld " << output.ld << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "output.st " << output.st << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "output.regwrite  " << output.regwrite << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "output.dest_reg  " << output.dest_reg << endl);
-            DPRINT(endl);
-            #endif
+            TRACE(TR_EXECUTE, TR_DEBUG, TR_EXE_OP, input.pc, input.alu_op, output.alu_res, nop);
+            TRACE(TR_EXECUTE, TR_VERBOSE, TR_EXE_OUT, output.ld, output.st, output.regwrite, output.dest_reg);
+            TRACE(TR_EXECUTE, TR_VERBOSE, TR_EXE_FWD, forward.pc, forward.tag, forward.regfile_data);
+
+            wait();
+        }
+    }
+
+    // Free-running performance monitor: mcycle plus PRF_CNT_NUM counters
+    // that increment whenever their selected event line is active.
+    void hpm_th(void) {
+        bool hpm_wr_ack;
+
+        HPM_RST: {
+            for (int i = 0; i < PRF_CNT_NUM + 1; i++) {
+                hpm_counter[i].write(0);
+            }
+            hpm_wr_ack = false;
+            wait();
+        }
+
+        #pragma hls_pipeline_init_interval 1
+        HPM_BODY: while (true) {
+            drim_uint < HPM_EV_NUM > events = de_events.read();
+            events[HPM_EV_DIV_BUSY] = div_busy.read();
+            events[HPM_EV_IMEM_WAIT] = imem_wait.read();
+            events[HPM_EV_DMEM_WAIT] = dmem_wait.read();
+            events[HPM_EV_NONE] = 0;
+
+            bool hpm_wr = hpm_wr_req.read() != hpm_wr_ack;
+            hpm_wr_ack = hpm_wr_req.read();
+
+            HPM_COUNT: for (int i = 0; i < PRF_CNT_NUM + 1; i++) {
+                drim_uint < XLEN > count = hpm_counter[i].read();
+                if (hpm_wr && hpm_slot(hpm_wr_idx.read()) == (unsigned) i) {
+                    count = hpm_wr_data.read();
+                } else if (i == 0) {
+                    count++;
+                } else {
+                    drim_uint < XLEN > sel = hpm_event_sel[i - 1].read();
+                    if (sel < HPM_EV_NUM && events[sel.to_uint()] == 1)
+                        count++;
+                }
+                hpm_counter[i].write(count.to_uint64());
+            }
 
             wait();
         }
@@ -600,26 +691,26 @@ SC_MODULE(execute) {
     /* Support functions */
 
     // Sign extend immS.
-    sc_uint < XLEN > sign_extend_imm_s(sc_uint < 12 > imm) {
-        sc_uint <XLEN> imm_ext = 0;
+    drim_uint < XLEN > sign_extend_imm_s(drim_uint < 12 > imm) {
+        drim_uint <XLEN> imm_ext = 0;
         if (imm[11] == 1) {
 			// Extend with 1s
-            return (sc_uint < 20 > (1048575), imm);
+            return (drim_uint < 20 > (1048575), imm);
         }
         else { 
 			// Extend with 0s
-			return (sc_uint < 20 > (0), imm);
+			return (drim_uint < 20 > (0), imm);
         }
     }
 
     #ifdef CSR_LOGIC
     // Zero extends the zimm immediate field of CSRRWI, CSRRSI, CSRRCI
-    sc_uint < XLEN > zero_ext_zimm(sc_uint < ZIMM_SIZE > zimm) {
-		return (sc_uint < 27 > (0), zimm);
+    drim_uint < XLEN > zero_ext_zimm(drim_uint < ZIMM_SIZE > zimm) {
+		return (drim_uint < 27 > (0), zimm);
     }
 
     // Return index given a csr address.
-    sc_uint < CSR_IDX_LEN > get_csr_index(sc_uint < CSR_ADDR > csr_addr) {
+    drim_uint < CSR_IDX_LEN > get_csr_index(drim_uint < CSR_ADDR > csr_addr) {
         switch (csr_addr) {
         case USTATUS_A:
             return USTATUS_I;
@@ -643,6 +734,28 @@ SC_MODULE(execute) {
             return MINSTRET_I;
         case MHARTID_A:
             return MHARTID_I;
+        case CYCLE_A:
+            return MCYCLE_I;
+        case INSTRET_A:
+            return MINSTRET_I;
+        case MHPMCOUNTER3_A:
+        case MHPMCOUNTER3_A + 1:
+        case MHPMCOUNTER3_A + 2:
+        case MHPMCOUNTER3_A + 3:
+        case MHPMCOUNTER3_A + 4:
+            return MHPMCOUNTER3_I + (csr_addr - MHPMCOUNTER3_A);
+        case HPMCOUNTER3_A:
+        case HPMCOUNTER3_A + 1:
+        case HPMCOUNTER3_A + 2:
+        case HPMCOUNTER3_A + 3:
+        case HPMCOUNTER3_A + 4:
+            return MHPMCOUNTER3_I + (csr_addr - HPMCOUNTER3_A);
+        case MHPMEVENT3_A:
+        case MHPMEVENT3_A + 1:
+        case MHPMEVENT3_A + 2:
+        case MHPMEVENT3_A + 3:
+        case MHPMEVENT3_A + 4:
+            return MHPMEVENT3_I + (csr_addr - MHPMEVENT3_A);
         default:
             return 6; // TODO: this is not ideal. I default unsupported CSRs to MARCHID as it's not a critical register.
         }
@@ -652,21 +765,54 @@ SC_MODULE(execute) {
     // TODO: respect unwritable fields, see manual for each individual implemented CSR.
     // TODO: for now any bits of every register are fully readable/writeable.
     // TODO: This must be changed in future implementations.
-    void set_csr_value(sc_uint < CSR_IDX_LEN > csr_index, sc_uint < XLEN > rs1, sc_uint < LOG2_CSR_OP_NUM > operation, sc_uint < 2 > rw_permission) {
-        if (rw_permission != 3)
-            switch (operation) {
-            case CSR_OP_WR:
-                csr[csr_index] = rs1.to_uint();
-                break;
-            case CSR_OP_SET:
-                csr[csr_index] |= rs1.to_uint();
-                break;
-            case CSR_OP_CLR:
-                csr[csr_index] &= ~(rs1.to_uint());
-                break;
-            default:
-                break;
-            }
+    void set_csr_value(drim_uint < CSR_IDX_LEN > csr_index, drim_uint < XLEN > rs1, drim_uint < LOG2_CSR_OP_NUM > operation, drim_uint < 2 > rw_permission) {
+        // Set/clear with a zero mask (e.g. csrr) must not write, otherwise a
+        // counter would be reloaded with the value read one cycle earlier.
+        if (rw_permission == 3 || (operation != CSR_OP_WR && rs1 == 0))
+            return;
+
+        drim_uint < XLEN > value = read_csr(csr_index);
+        switch (operation) {
+        case CSR_OP_WR:
+            value = rs1.to_uint();
+            break;
+        case CSR_OP_SET:
+            value |= rs1.to_uint();
+            break;
+        case CSR_OP_CLR:
+            value &= ~(rs1.to_uint());
+            break;
+        default:
+            return;
+        }
+
+        if (is_hpm_counter(csr_index)) {
+            // Counters are owned by hpm_th, which applies the write next cycle.
+            hpm_wr_req.write(!hpm_wr_req.read());
+            hpm_wr_idx.write(csr_index.to_uint64());
+            hpm_wr_data.write(value.to_uint64());
+        } else {
+            csr[csr_index] = value;
+            if (csr_index >= MHPMEVENT3_I && csr_index < MHPMEVENT3_I + PRF_CNT_NUM)
+                hpm_event_sel[csr_index - MHPMEVENT3_I].write(value.to_uint64());
+        }
+    }
+
+    // mcycle and mhpmcounter3..7 are counted by hpm_th.
+    bool is_hpm_counter(drim_uint < CSR_IDX_LEN > csr_index) {
+        return csr_index == MCYCLE_I ||
+            (csr_index >= MHPMCOUNTER3_I && csr_index < MHPMCOUNTER3_I + PRF_CNT_NUM);
+    }
+
+    // Maps a counter CSR index to its slot in hpm_counter.
+    unsigned hpm_slot(drim_uint < CSR_IDX_LEN > csr_index) {
+        return (csr_index == MCYCLE_I) ? 0 : (unsigned)(csr_index - MHPMCOUNTER3_I + 1);
+    }
+
+    drim_uint < XLEN > read_csr(drim_uint < CSR_IDX_LEN > csr_index) {
+        if (is_hpm_counter(csr_index))
+            return hpm_counter[hpm_slot(csr_index)].read();
+        return csr[csr_index];
     }
     #endif
 };
@@ -16,15 +16,13 @@
 #ifndef __FETCH__H
 #define __FETCH__H
 
-#ifndef NDEBUG
-    #include <iostream>
-    #define DPRINT(msg) std::cout << msg;
-#endif
-
-
 #include "drim4hls_datatypes.h"
 #include "defines.h"
 #include "globals.h"
+#include "checkpoint.h"
+#include "kanata_trace.h"
+#include "trace_ring.h"
+#include "chan_log.h"
 
 #include <mc_connections.h>
 
@@ -33,6 +31,8 @@ SC_MODULE(fetch) {
     // Clock and reset signals
     sc_in < bool > CCS_INIT_S1(clk);
     sc_in < bool > CCS_INIT_S1(rst);
+    // First PC after reset, the entry of the resident program to run
+    sc_in < sc_uint < PC_LEN > > CCS_INIT_S1(entry_pc);
     // Channel ports
     Connections::In < fe_in_t > CCS_INIT_S1(fetch_din);
     Connections::In < imem_out_t > CCS_INIT_S1(imem_dout);
@@ -40,14 +40,17 @@ SC_MODULE(fetch) {
     Connections::Out < fe_out_t > CCS_INIT_S1(dout);
     Connections::Out < imem_out_t > CCS_INIT_S1(imem_de);
 
+    // High while waiting for the instruction memory (HPM_EV_IMEM_WAIT).
+    sc_out < bool > CCS_INIT_S1(imem_wait);
+
     // Trap signals. TODO: not used. Left for future implementations.
     sc_signal < bool > CCS_INIT_S1(trap); //sc_out
     sc_signal < ac_int < LOG2_NUM_CAUSES, false > > CCS_INIT_S1(trap_cause); //sc_out
 
     // *** Internal variables
-    sc_int < PC_LEN > pc; // Init. to -4, then before first insn fetch it will be updated to 0.	 
-    sc_uint < PC_LEN > imem_pc; // Used in fetching from instruction memory
-	sc_uint < PC_LEN > pc_tmp; // Init. to -4, then before first insn fetch it will be updated to 0.	 
+    drim_int < PC_LEN > pc; // Init. to -4, then before first insn fetch it will be updated to 0.	 
+    drim_uint < PC_LEN > imem_pc; // Used in fetching from instruction memory
+	drim_uint < PC_LEN > pc_tmp; // Init. to -4, then before first insn fetch it will be updated to 0.	 
     // Custom datatypes used for retrieving and sending data through the channels
     imem_in_t imem_in; // Contains data for fetching from the instruction memory
     fe_out_t fe_out; // Contains data for the decode stage
@@ -57,25 +60,47 @@ SC_MODULE(fetch) {
     bool redirect;
     bool redirect_tmp;
     
-    sc_uint < PC_LEN > redirect_addr;
-	sc_uint < PC_LEN > redirect_addr_tmp;
+    drim_uint < PC_LEN > redirect_addr;
+	drim_uint < PC_LEN > redirect_addr_tmp;
 	
     bool freeze;
 	bool freeze_tmp;
 	int position;
-    SC_CTOR(fetch): imem_din("imem_din"),
+    SC_CTOR(fetch): clk("clk"),
+    rst("rst"),
+    entry_pc("entry_pc"),
     fetch_din("fetch_din"),
-    dout("dout"),
     imem_dout("imem_dout"),
+    imem_din("imem_din"),
+    dout("dout"),
     imem_de("imem_de"),
-    clk("clk"),
-    rst("rst") {
+    imem_wait("imem_wait") {
         SC_THREAD(fetch_th);
         sensitive << clk.pos();
         async_reset_signal_is(rst, false);
 
     }
 
+    #ifndef __SYNTHESIS__
+    // Checkpoint of the PC logic, see checkpoint.h.
+    void save_state(checkpoint & ckpt) const {
+        checkpoint::writer w = ckpt.add("fetch");
+        w.put(pc);
+        w.put(redirect);
+        w.put(redirect_addr);
+        w.put(freeze);
+    }
+
+    bool load_state(const checkpoint & ckpt) {
+        checkpoint::reader r = ckpt.find("fetch");
+        r.get(pc);
+        r.get(redirect);
+        r.get(redirect_addr);
+        r.get(freeze);
+        return r.ok();
+    }
+    #endif
+
     void fetch_th(void) {
         FETCH_RST: {
             dout.Reset();
@@ -83,6 +108,7 @@ SC_MODULE(fetch) {
             imem_din.Reset();
             imem_dout.Reset();
             imem_de.Reset();
+            imem_wait.write(false);
 									
             trap = 0;
             trap_cause = NULL_CAUSE;
@@ -91,9 +117,9 @@ SC_MODULE(fetch) {
             redirect_addr = 0;
 			freeze = false;
 			redirect = false;
-            //  Init. pc to START_ADDRESS - 4 as on first fetch it will be incremented by
-            //  4, thus fetching instruction at address 0
-            pc = -4;
+            //  Init. pc to entry_pc - 4 as on first fetch it will be incremented by
+            //  4, thus fetching the instruction at entry_pc (0 for a single program)
+            pc = entry_pc.read().to_int() - 4;
             pc_tmp = -4;
             position = 0;
             
@@ -105,6 +131,7 @@ SC_MODULE(fetch) {
             //sc_assert(sc_time_stamp().to_double() < 1500000);
             
             if (fetch_din.PopNB(fetch_in)) {
+                CHAN_LOG(fetch_din, fetch_in);
                 // Mechanism for incrementing PC
                 redirect = fetch_in.redirect;
                 redirect_addr = fetch_in.address;
@@ -112,7 +139,7 @@ SC_MODULE(fetch) {
             }
 
             // Mechanism for incrementing PC
-            if ((redirect && redirect_addr != pc) || freeze) {
+            if ((redirect && redirect_addr != pc.to_uint64()) || freeze) {
                 pc = redirect_addr;
             } else if (!freeze) {
                 pc = (pc + 4);
@@ -124,15 +151,17 @@ SC_MODULE(fetch) {
 
 			imem_din.Push(imem_in);
 
+            // Stays high for every cycle Pop() blocks; cleared in the same
+            // delta when the response is already there.
+            imem_wait.write(true);
             imem_out = imem_dout.Pop();
+            CHAN_LOG(imem_dout, imem_out);
+            imem_wait.write(false);
 
             imem_de.Push(imem_out);
             dout.Push(fe_out);
-			
-			#ifndef __SYNTHESIS__
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << std::hex << "pc= " << pc << endl);
-            DPRINT(endl);
-            #endif
+            KANATA(fetch((unsigned) pc.to_int()));
+            TRACE(TR_FETCH, TR_DEBUG, TR_FE_PC, pc);
             wait();
 
         } // *** ENDOF while(true)
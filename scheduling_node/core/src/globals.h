@@ -27,9 +27,9 @@
 
 // Values for CSR and traps
 #define LOG2_NUM_CAUSES 3   // Log2 of number of trap causes
-#define CSR_NUM         11  // Number of CSR registers (including Performance Counters).
-#define CSR_IDX_LEN     4   // Log2 of CSR_NUM      // TODO: this should be rewritten into something like log2(CSR_NUM)
-#define PRF_CNT_NUM     1   // Number of Performance Counters.
+#define CSR_NUM         21  // Number of CSR registers (including Performance Counters).
+#define CSR_IDX_LEN     5   // Log2 of CSR_NUM      // TODO: this should be rewritten into something like log2(CSR_NUM)
+#define PRF_CNT_NUM     5   // Number of programmable Performance Counters (mhpmcounter3..7).
 #define CSR_ADDR        12  // CSRs are on a 12-bit addressing space.
 #define LOG2_CSR_OP_NUM 2   // Log2 of number of operations on CSR.
 #define CSR_OP_WR       1   // CSR write operation.
@@ -302,8 +302,13 @@
 #define MCYCLE_A      0xB00
 #define MARCHID_A     0xF12
 #define MIMPID_A      0xF13
-#define MINSTRET_A    0xF02
+#define MINSTRET_A    0xB02
 #define MHARTID_A     0xF14
+#define MHPMCOUNTER3_A 0xB03 // mhpmcounter3..7 at 0xB03..0xB07
+#define MHPMEVENT3_A  0x323 // mhpmevent3..7 at 0x323..0x327
+#define CYCLE_A       0xC00 // Read-only user shadows of mcycle, minstret and mhpmcounter3..7
+#define INSTRET_A     0xC02
+#define HPMCOUNTER3_A 0xC03
 
 #define USTATUS_I     0
 #define MSTATUS_I     1
@@ -316,5 +321,19 @@
 #define MIMPID_I      8
 #define MINSTRET_I    9
 #define MHARTID_I     10
+#define MHPMCOUNTER3_I 11   // mhpmcounter3..7 -> 11..15
+#define MHPMEVENT3_I  16    // mhpmevent3..7 -> 16..20
+
+/* Hardware performance monitor events. Writing one of these ids in mhpmeventN
+*  makes mhpmcounterN count the cycles in which the event is active.
+*/
+#define HPM_EV_NONE       0
+#define HPM_EV_RAW_STALL  1 // Decode frozen on a RAW hazard that could not be forwarded
+#define HPM_EV_FLUSH      2 // Bubble caused by a taken branch/jump redirect
+#define HPM_EV_DIV_BUSY   3 // Execute busy in the iterative divider
+#define HPM_EV_LOAD_WAIT  4 // Decode frozen until an in-flight load writes back
+#define HPM_EV_IMEM_WAIT  5 // Fetch waiting for the instruction memory
+#define HPM_EV_DMEM_WAIT  6 // Writeback waiting for a load response from the data memory
+#define HPM_EV_NUM        7
 
 #endif
@@ -0,0 +1,499 @@
+/*
+	@brief
+	Instruction-accurate RV32IM simulator for the rank programs (simulation
+	only, no SystemC dependency).
+
+	It sees the same memories as the drim4hls testbench: separate word-
+	addressed IMEM and DMEM of ICACHE_SIZE / DCACHE_SIZE words, both loaded
+	from notmain.elf (or notmain.txt), execution from PC 0 until the "jump
+	to yourself" that decode treats as the end of the program. Instructions
+	are decoded once with the opcode/funct tables of globals.h, so the
+	interpreter loop only dispatches on a small op code.
+
+	Semantics follow the RV32IM specification. Timing is not modelled: the
+	cycle CSRs read as the number of retired instructions and the
+	programmable counters read as zero.
+
+	step() reports what each instruction writes back so that the testbench
+	can run the ISS in lockstep with the cycle-accurate core.
+
+*/
+
+#ifndef __ISS__H
+#define __ISS__H
+
+#ifndef __SYNTHESIS__
+
+#include <stdint.h>
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "defines.h"
+#include "elf_file.h"
+#include "globals.h"
+#include "rank_abi.h"
+
+class iss {
+    public:
+    enum stop_t {
+        ISS_END = 0, // reached the end-of-program self jump
+        ISS_LIMIT, // instruction budget exhausted
+        ISS_TRAP, // ecall / ebreak
+        ISS_ILLEGAL, // undecodable instruction
+        ISS_BAD_ADDR // fetch or data access outside the memories
+    };
+
+    // Architectural effect of one instruction.
+    struct retire_t {
+        uint32_t pc;
+        uint32_t insn;
+        bool wb; // reaches writeback on drim4hls (branches complete in decode)
+        unsigned rd; // 0 if no register is written
+        uint32_t rd_data;
+        bool store;
+        uint32_t addr; // DMEM word index of a store
+        uint32_t mem_data; // word in DMEM after the store
+    };
+
+    enum op_kind_t {
+        K_ILLEGAL = 0, K_END, K_TRAP,
+        K_LUI, K_AUIPC, K_JAL, K_JALR,
+        K_BEQ, K_BNE, K_BLT, K_BGE, K_BLTU, K_BGEU,
+        K_LB, K_LH, K_LW, K_LBU, K_LHU,
+        K_SB, K_SH, K_SW,
+        K_ADDI, K_SLTI, K_SLTIU, K_XORI, K_ORI, K_ANDI, K_SLLI, K_SRLI, K_SRAI,
+        K_ADD, K_SUB, K_SLL, K_SLT, K_SLTU, K_XOR, K_SRL, K_SRA, K_OR, K_AND,
+        K_MUL, K_MULH, K_MULHSU, K_MULHU, K_DIV, K_DIVU, K_REM, K_REMU,
+        K_CSRRW, K_CSRRS, K_CSRRC, K_CSRRWI, K_CSRRSI, K_CSRRCI
+    };
+
+    // Predecoded instruction. Writes to x0 go to the scratch register
+    // REG_NUM; branch and jump targets are absolute.
+    struct op_t {
+        uint8_t kind;
+        uint8_t rd;
+        uint8_t rs1;
+        uint8_t rs2;
+        int32_t imm;
+    };
+
+    // Decodes one instruction at pc (also used by the translator in tools/rank_aot).
+    static op_t decode(uint32_t insn, uint32_t pc) {
+        op_t o;
+        o.kind = K_ILLEGAL;
+        o.rd = (insn >> 7) & 0x1F;
+        o.rs1 = (insn >> 15) & 0x1F;
+        o.rs2 = (insn >> 20) & 0x1F;
+        o.imm = 0;
+        if (o.rd == 0)
+            o.rd = REG_NUM;
+
+        unsigned opcode = (insn >> 2) & 0x1F;
+        unsigned funct3 = (insn >> 12) & 0x7;
+        unsigned funct7 = insn >> 25;
+        int32_t imm_i = (int32_t) insn >> 20;
+        int32_t imm_s = ((int32_t) insn >> 25 << 5) | ((insn >> 7) & 0x1F);
+        int32_t imm_b = ((int32_t) insn >> 31 << 12) | ((insn << 4) & 0x800) | ((insn >> 20) & 0x7E0) | ((insn >> 7) & 0x1E);
+        int32_t imm_j = ((int32_t) insn >> 31 << 20) | (insn & 0xFF000) | ((insn >> 9) & 0x800) | ((insn >> 20) & 0x7FE);
+
+        if ((insn & 0x3) != 0x3)
+            return o;
+        if (insn == 0x0000006f) { // jump to yourself (end of program), as in decode
+            o.kind = K_END;
+            return o;
+        }
+
+        switch (opcode) {
+        case OPC_LUI:
+            o.kind = K_LUI;
+            o.imm = insn & 0xFFFFF000;
+            break;
+        case OPC_AUIPC:
+            o.kind = K_AUIPC;
+            o.imm = pc + (insn & 0xFFFFF000);
+            break;
+        case OPC_JAL:
+            o.kind = K_JAL;
+            o.imm = pc + imm_j;
+            break;
+        case OPC_JALR:
+            if (funct3 == FUNCT3_JALR) {
+                o.kind = K_JALR;
+                o.imm = imm_i;
+            }
+            break;
+        case OPC_BEQ: {
+            static const uint8_t k[8] = { K_BEQ, K_BNE, K_ILLEGAL, K_ILLEGAL, K_BLT, K_BGE, K_BLTU, K_BGEU };
+            o.kind = k[funct3];
+            o.imm = pc + imm_b;
+            break;
+        }
+        case OPC_LB: {
+            static const uint8_t k[8] = { K_LB, K_LH, K_LW, K_ILLEGAL, K_LBU, K_LHU, K_ILLEGAL, K_ILLEGAL };
+            o.kind = k[funct3];
+            o.imm = imm_i;
+            break;
+        }
+        case OPC_SB:
+            if (funct3 == FUNCT3_SB)
+                o.kind = K_SB;
+            else if (funct3 == FUNCT3_SH)
+                o.kind = K_SH;
+            else if (funct3 == FUNCT3_SW)
+                o.kind = K_SW;
+            o.imm = imm_s;
+            break;
+        case OPC_ADDI:
+            o.imm = imm_i;
+            switch (funct3) {
+            case FUNCT3_ADDI: o.kind = K_ADDI; break;
+            case FUNCT3_SLTI: o.kind = K_SLTI; break;
+            case FUNCT3_SLTIU: o.kind = K_SLTIU; break;
+            case FUNCT3_XORI: o.kind = K_XORI; break;
+            case FUNCT3_ORI: o.kind = K_ORI; break;
+            case FUNCT3_ANDI: o.kind = K_ANDI; break;
+            case FUNCT3_SLLI:
+                if (funct7 == FUNCT7_SLLI)
+                    o.kind = K_SLLI;
+                o.imm = o.rs2;
+                break;
+            case FUNCT3_SRLI: // FUNCT3_SRAI
+                if (funct7 == FUNCT7_SRLI)
+                    o.kind = K_SRLI;
+                else if (funct7 == FUNCT7_SRAI)
+                    o.kind = K_SRAI;
+                o.imm = o.rs2;
+                break;
+            }
+            break;
+        case OPC_ADD:
+            if (funct7 == FUNCT7_ADD) {
+                static const uint8_t k[8] = { K_ADD, K_SLL, K_SLT, K_SLTU, K_XOR, K_SRL, K_OR, K_AND };
+                o.kind = k[funct3];
+            } else if (funct7 == FUNCT7_SUB) {
+                if (funct3 == FUNCT3_SUB)
+                    o.kind = K_SUB;
+                else if (funct3 == FUNCT3_SRA)
+                    o.kind = K_SRA;
+            } else if (funct7 == FUNCT7_MUL) {
+                static const uint8_t k[8] = { K_MUL, K_MULH, K_MULHSU, K_MULHU, K_DIV, K_DIVU, K_REM, K_REMU };
+                o.kind = k[funct3];
+            }
+            break;
+        case OPC_SYSTEM:
+            o.imm = insn >> 20; // CSR address
+            switch (funct3) {
+            case FUNCT3_ECALL: // FUNCT3_EBREAK
+                o.kind = K_TRAP;
+                break;
+            case FUNCT3_CSRRW: o.kind = K_CSRRW; break;
+            case FUNCT3_CSRRS: o.kind = K_CSRRS; break;
+            case FUNCT3_CSRRC: o.kind = K_CSRRC; break;
+            case FUNCT3_CSRRWI: o.kind = K_CSRRWI; break;
+            case FUNCT3_CSRRSI: o.kind = K_CSRRSI; break;
+            case FUNCT3_CSRRCI: o.kind = K_CSRRCI; break;
+            }
+            break;
+        }
+        return o;
+    }
+
+    iss(): imem(ICACHE_SIZE, 0), dmem(DCACHE_SIZE, 0), code(ICACHE_SIZE) {
+        for (size_t i = 0; i < code.size(); i++)
+            code[i] = decode(0, i << 2);
+        memset(csr, 0, sizeof(csr));
+        instret = 0;
+        entry = 0;
+        reset();
+    }
+
+    // Loads a program into IMEM and DMEM, as the testbench does: the PT_LOAD
+    // segments of an ELF, or the "<address> <word>" lines of notmain.txt.
+    // layout, if given, is set from the ELF symbols (the defaults for a
+    // .txt program). Returns false on a bad file.
+    bool load_program(const std::string & path, rank_layout_t * layout = NULL) {
+        if (layout)
+            * layout = rank_layout_t();
+        if (elf_file::is_elf(path)) {
+            elf_file elf;
+            bool fits = true;
+            if (!elf.open(path) || !elf.for_each_load_word([this, &fits](unsigned addr, unsigned word) {
+                    fits = fits && (addr >> 2) < imem.size();
+                    write_imem(addr, word);
+                    write_dmem(addr, word);
+                }))
+                return false;
+            if (layout)
+                layout->from_symbols(elf);
+            return fits;
+        }
+        std::ifstream in(path.c_str());
+        if (!in.is_open())
+            return false;
+        unsigned address, data;
+        while (in >> std::hex >> address) {
+            if (!(in >> data) || (address >> 2) >= imem.size())
+                return false;
+            write_imem(address, data);
+            write_dmem(address, data);
+        }
+        return true;
+    }
+
+    // Clears the registers and restarts from the entry PC. Memories are
+    // kept, as on a reset of the core.
+    void reset() {
+        memset(regs, 0, sizeof(regs));
+        pc_reg = entry;
+        stop_reason = ISS_LIMIT;
+    }
+
+    // PC of the next reset(), the core's entry_pc (0 by default).
+    void set_entry(uint32_t pc) {
+        entry = pc;
+    }
+
+    void write_imem(uint32_t addr, uint32_t data) {
+        if ((addr >> 2) >= imem.size())
+            return;
+        imem[addr >> 2] = data;
+        code[addr >> 2] = decode(data, addr & ~3u);
+    }
+
+    uint32_t read_imem(uint32_t addr) const {
+        return (addr >> 2) < imem.size() ? imem[addr >> 2] : 0;
+    }
+
+    void write_dmem(uint32_t addr, uint32_t data) {
+        if ((addr >> 2) < dmem.size())
+            dmem[addr >> 2] = data;
+    }
+
+    uint32_t read_dmem(uint32_t addr) const {
+        return (addr >> 2) < dmem.size() ? dmem[addr >> 2] : 0;
+    }
+
+    std::vector < uint32_t > & data() {
+        return dmem;
+    }
+
+    uint32_t reg(unsigned i) const {
+        return i < REG_NUM ? regs[i] : 0;
+    }
+
+    uint32_t pc() const {
+        return pc_reg;
+    }
+
+    uint64_t retired() const {
+        return instret;
+    }
+
+    stop_t stopped() const {
+        return stop_reason;
+    }
+
+    // Runs until the program ends or max_insns instructions have retired.
+    stop_t run(uint64_t max_insns = ~(uint64_t) 0) {
+        return exec < false > (max_insns, NULL);
+    }
+
+    // Executes one instruction. Returns false if the program has stopped
+    // (see stopped()), in which case r is not written.
+    bool step(retire_t & r) {
+        return exec < true > (1, & r) == ISS_LIMIT;
+    }
+
+    private:
+    std::vector < uint32_t > imem;
+    std::vector < uint32_t > dmem;
+    std::vector < op_t > code;
+    uint32_t regs[REG_NUM + 1];
+    uint32_t csr[1 << CSR_ADDR];
+    uint32_t pc_reg;
+    uint32_t entry;
+    uint64_t instret;
+    stop_t stop_reason;
+
+    uint32_t csr_read(unsigned a, uint64_t now) const {
+        switch (a) {
+        case MCYCLE_A:
+        case CYCLE_A:
+        case MINSTRET_A:
+        case INSTRET_A:
+            return (uint32_t) now;
+        }
+        if ((a >= MHPMCOUNTER3_A && a < MHPMCOUNTER3_A + PRF_CNT_NUM) ||
+            (a >= HPMCOUNTER3_A && a < HPMCOUNTER3_A + PRF_CNT_NUM))
+            return 0;
+        return csr[a];
+    }
+
+    void csr_write(unsigned a, uint32_t v) {
+        // User counters (0xC00-0xCFF) and machine info (0xF00-0xFFF) are read-only.
+        if ((a >> 8) != 0xC && (a >> 8) != 0xF)
+            csr[a] = v;
+    }
+
+    template < bool RECORD > stop_t exec(uint64_t max_insns, retire_t * r) {
+        uint32_t * x = regs;
+        uint32_t p = pc_reg;
+        uint64_t n = 0;
+        stop_t reason = ISS_LIMIT;
+
+        if (stop_reason != ISS_LIMIT)
+            return stop_reason;
+
+        while (n < max_insns) {
+            uint32_t idx = p >> 2;
+            if (idx >= code.size() || (p & 3)) {
+                reason = ISS_BAD_ADDR;
+                break;
+            }
+            const op_t & o = code[idx];
+            uint32_t next = p + 4;
+            uint32_t a = x[o.rs1];
+            uint32_t b = x[o.rs2];
+            uint32_t addr = 0;
+            bool store = false;
+
+            switch (o.kind) {
+            case K_END: reason = ISS_END; break;
+            case K_TRAP: reason = ISS_TRAP; break;
+            case K_ILLEGAL: reason = ISS_ILLEGAL; break;
+
+            case K_LUI: x[o.rd] = o.imm; break;
+            case K_AUIPC: x[o.rd] = o.imm; break;
+            case K_JAL: x[o.rd] = next; next = o.imm; break;
+            case K_JALR: x[o.rd] = next; next = (a + o.imm) & ~1u; break;
+
+            case K_BEQ: if (a == b) next = o.imm; break;
+            case K_BNE: if (a != b) next = o.imm; break;
+            case K_BLT: if ((int32_t) a < (int32_t) b) next = o.imm; break;
+            case K_BGE: if ((int32_t) a >= (int32_t) b) next = o.imm; break;
+            case K_BLTU: if (a < b) next = o.imm; break;
+            case K_BGEU: if (a >= b) next = o.imm; break;
+
+            // Loads ignore the low address bits for the word, as writeback does.
+            case K_LB: case K_LH: case K_LW: case K_LBU: case K_LHU: {
+                addr = a + o.imm;
+                if ((addr >> 2) >= dmem.size()) {
+                    reason = ISS_BAD_ADDR;
+                    break;
+                }
+                uint32_t w = dmem[addr >> 2];
+                switch (o.kind) {
+                case K_LB: x[o.rd] = (int32_t)(int8_t)(w >> ((addr & 3) * 8)); break;
+                case K_LH: x[o.rd] = (int32_t)(int16_t)(w >> ((addr & 2) * 8)); break;
+                case K_LW: x[o.rd] = w; break;
+                case K_LBU: x[o.rd] = (uint8_t)(w >> ((addr & 3) * 8)); break;
+                default: x[o.rd] = (uint16_t)(w >> ((addr & 2) * 8)); break;
+                }
+                break;
+            }
+            case K_SB: case K_SH: case K_SW: {
+                addr = a + o.imm;
+                if ((addr >> 2) >= dmem.size()) {
+                    reason = ISS_BAD_ADDR;
+                    break;
+                }
+                uint32_t & w = dmem[addr >> 2];
+                if (o.kind == K_SW) {
+                    w = b;
+                } else {
+                    unsigned sh = (o.kind == K_SB) ? (addr & 3) * 8 : (addr & 2) * 8;
+                    uint32_t mask = ((o.kind == K_SB) ? 0xFFu : 0xFFFFu) << sh;
+                    w = (w & ~mask) | ((b << sh) & mask);
+                }
+                store = true;
+                break;
+            }
+
+            case K_ADDI: x[o.rd] = a + o.imm; break;
+            case K_SLTI: x[o.rd] = (int32_t) a < o.imm; break;
+            case K_SLTIU: x[o.rd] = a < (uint32_t) o.imm; break;
+            case K_XORI: x[o.rd] = a ^ o.imm; break;
+            case K_ORI: x[o.rd] = a | o.imm; break;
+            case K_ANDI: x[o.rd] = a & o.imm; break;
+            case K_SLLI: x[o.rd] = a << o.imm; break;
+            case K_SRLI: x[o.rd] = a >> o.imm; break;
+            case K_SRAI: x[o.rd] = (int32_t) a >> o.imm; break;
+
+            case K_ADD: x[o.rd] = a + b; break;
+            case K_SUB: x[o.rd] = a - b; break;
+            case K_SLL: x[o.rd] = a << (b & 31); break;
+            case K_SLT: x[o.rd] = (int32_t) a < (int32_t) b; break;
+            case K_SLTU: x[o.rd] = a < b; break;
+            case K_XOR: x[o.rd] = a ^ b; break;
+            case K_SRL: x[o.rd] = a >> (b & 31); break;
+            case K_SRA: x[o.rd] = (int32_t) a >> (b & 31); break;
+            case K_OR: x[o.rd] = a | b; break;
+            case K_AND: x[o.rd] = a & b; break;
+
+            case K_MUL: x[o.rd] = a * b; break;
+            case K_MULH: x[o.rd] = (uint32_t)(((int64_t)(int32_t) a * (int64_t)(int32_t) b) >> 32); break;
+            case K_MULHSU: x[o.rd] = (uint32_t)(((int64_t)(int32_t) a * (int64_t)(uint64_t) b) >> 32); break;
+            case K_MULHU: x[o.rd] = (uint32_t)(((uint64_t) a * (uint64_t) b) >> 32); break;
+            case K_DIV:
+                if (b == 0)
+                    x[o.rd] = ~0u;
+                else if (a == 0x80000000u && b == ~0u)
+                    x[o.rd] = a;
+                else
+                    x[o.rd] = (int32_t) a / (int32_t) b;
+                break;
+            case K_DIVU: x[o.rd] = b ? a / b : ~0u; break;
+            case K_REM:
+                if (b == 0)
+                    x[o.rd] = a;
+                else if (a == 0x80000000u && b == ~0u)
+                    x[o.rd] = 0;
+                else
+                    x[o.rd] = (int32_t) a % (int32_t) b;
+                break;
+            case K_REMU: x[o.rd] = b ? a % b : a; break;
+
+            case K_CSRRW: case K_CSRRS: case K_CSRRC:
+            case K_CSRRWI: case K_CSRRSI: case K_CSRRCI: {
+                unsigned c = o.imm;
+                uint32_t old = csr_read(c, instret + n);
+                uint32_t src = (o.kind >= K_CSRRWI) ? o.rs1 : a; // zimm for the immediate forms
+                if (o.kind == K_CSRRW || o.kind == K_CSRRWI)
+                    csr_write(c, src);
+                else if (o.rs1 != 0)
+                    csr_write(c, (o.kind == K_CSRRS || o.kind == K_CSRRSI) ? (old | src) : (old & ~src));
+                x[o.rd] = old;
+                break;
+            }
+            }
+
+            if (reason != ISS_LIMIT)
+                break;
+
+            if (RECORD) {
+                r->pc = p;
+                r->insn = imem[idx];
+                r->wb = !(o.kind >= K_BEQ && o.kind <= K_BGEU);
+                r->rd = (o.rd == REG_NUM || store || (o.kind >= K_BEQ && o.kind <= K_BGEU)) ? 0 : o.rd;
+                r->rd_data = x[o.rd];
+                r->store = store;
+                r->addr = addr >> 2;
+                r->mem_data = store ? dmem[addr >> 2] : 0;
+            }
+            p = next;
+            n++;
+        }
+
+        pc_reg = p;
+        instret += n;
+        stop_reason = reason;
+        return reason;
+    }
+};
+
+#endif // __SYNTHESIS__
+
+#endif // __ISS__H
@@ -0,0 +1,203 @@
+/*
+	@brief
+	Per-instruction pipeline trace in the Kanata log format (version 0004),
+	viewable with Konata. Simulation only.
+
+	Every fetched instruction gets a sequence id. The stages report their
+	progress by PC through the KANATA() hook and the trace matches it with
+	the oldest in-flight instruction that has that PC and is in the stage
+	before:
+
+		F (fetch) -> D (decode) -> X (execute) -> W (writeback) -> retire
+
+	Wrong-path and replayed fetches are retired as flushed, stall reasons are
+	attached to the instruction as hover labels.
+
+	The trace is enabled at runtime with kanata_trace::get().open(); when it
+	is closed each hook costs a single load and branch.
+
+*/
+
+#ifndef __KANATA_TRACE__H
+#define __KANATA_TRACE__H
+
+#ifndef __SYNTHESIS__
+
+#include <systemc.h>
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#define KANATA(call) do { if (kanata_state < void >::on) kanata_trace::get().call; } while (0)
+
+// Header-only storage for the enable flag.
+template < class T > struct kanata_state {
+    static bool on;
+};
+template < class T > bool kanata_state < T >::on = false;
+
+class kanata_trace {
+    public:
+    enum stage_t { ST_FETCH = 0, ST_DECODE, ST_EXECUTE, ST_WRITEBACK };
+
+    static kanata_trace & get() {
+        static kanata_trace trace;
+        return trace;
+    }
+
+    // Opens the log; period is the core clock period used to number cycles.
+    bool open(const std::string & path, const sc_time & period) {
+        log.open(path.c_str(), std::ios::out | std::ios::trunc);
+        if (!log.is_open())
+            return false;
+        clk_period = period;
+        log << "Kanata\t0004\n";
+        log << "C=\t" << now() << "\n";
+        last_cycle = now();
+        kanata_state < void >::on = true;
+        return true;
+    }
+
+    void close() {
+        if (!kanata_state < void >::on)
+            return;
+        kanata_state < void >::on = false;
+        log.close();
+    }
+
+    // New instruction fetched.
+    void fetch(unsigned pc) {
+        sync();
+        entry_t e;
+        e.id = next_id++;
+        e.pc = pc;
+        e.stage = ST_FETCH;
+        e.stall = "";
+        inflight[e.id] = e;
+        by_pc[ST_FETCH][pc].insert(e.id);
+        log << "I\t" << e.id << "\t" << e.id << "\t0\n";
+        log << "L\t" << e.id << "\t0\t" << std::hex << pc << std::dec << "\n";
+        log << "S\t" << e.id << "\t0\tF\n";
+    }
+
+    // Fetched instruction accepted by decode.
+    void decode(unsigned pc, unsigned insn) {
+        entry_t * e = find(pc, ST_FETCH);
+        if (!e)
+            return;
+        sync();
+        move(e, ST_DECODE);
+        log << "L\t" << e->id << "\t0\t: " << std::hex << insn << std::dec << "\n";
+        log << "S\t" << e->id << "\t0\tD\n";
+    }
+
+    // Instruction held in a stage; the reason is logged when it changes.
+    void stall(unsigned pc, stage_t stage, const char * reason) {
+        entry_t * e = find(pc, stage);
+        if (!e || e->stall == reason)
+            return;
+        sync();
+        e->stall = reason;
+        log << "L\t" << e->id << "\t1\t" << reason << " stall @" << last_cycle << "\\n\n";
+    }
+
+    // Fetched instruction dropped (wrong path or replayed while decode was frozen).
+    void flush(unsigned pc) {
+        retire_entry(find(pc, ST_FETCH), 1);
+    }
+
+    void execute(unsigned pc) {
+        advance(pc, ST_DECODE, ST_EXECUTE, "X");
+    }
+
+    void writeback(unsigned pc) {
+        advance(pc, ST_EXECUTE, ST_WRITEBACK, "W");
+    }
+
+    // Instruction completes in the given stage (writeback, or decode for
+    // branches that never reach execute as they do not write anything).
+    void retire(unsigned pc, stage_t stage) {
+        retire_entry(find(pc, stage), 0);
+    }
+
+    private:
+    struct entry_t {
+        unsigned long long id;
+        unsigned pc;
+        stage_t stage;
+        std::string stall;
+    };
+
+    std::ofstream log;
+    sc_time clk_period;
+    unsigned long long last_cycle;
+    unsigned long long next_id;
+    unsigned long long retire_id;
+    // In-flight instructions by id, and their ids by stage and PC.
+    std::map < unsigned long long, entry_t > inflight;
+    std::unordered_map < unsigned, std::set < unsigned long long > > by_pc[ST_WRITEBACK + 1];
+
+    kanata_trace(): clk_period(10, SC_NS), last_cycle(0), next_id(0), retire_id(0) {}
+
+    unsigned long long now() const {
+        return (unsigned long long)(sc_time_stamp() / clk_period);
+    }
+
+    // Emits the cycle advance since the previous record.
+    void sync() {
+        unsigned long long c = now();
+        if (c > last_cycle) {
+            log << "C\t" << (c - last_cycle) << "\n";
+            last_cycle = c;
+        }
+    }
+
+    // Oldest in-flight instruction with this PC in this stage.
+    entry_t * find(unsigned pc, stage_t stage) {
+        std::unordered_map < unsigned, std::set < unsigned long long > >::iterator it = by_pc[stage].find(pc);
+        if (it == by_pc[stage].end())
+            return NULL;
+        return &inflight[*it->second.begin()];
+    }
+
+    void unindex(const entry_t & e) {
+        std::unordered_map < unsigned, std::set < unsigned long long > >::iterator it = by_pc[e.stage].find(e.pc);
+        it->second.erase(e.id);
+        if (it->second.empty())
+            by_pc[e.stage].erase(it);
+    }
+
+    void move(entry_t * e, stage_t to) {
+        unindex(*e);
+        e->stage = to;
+        by_pc[to][e->pc].insert(e->id);
+    }
+
+    void advance(unsigned pc, stage_t from, stage_t to, const char * name) {
+        entry_t * e = find(pc, from);
+        if (!e)
+            return;
+        sync();
+        move(e, to);
+        e->stall = "";
+        log << "S\t" << e->id << "\t0\t" << name << "\n";
+    }
+
+    void retire_entry(entry_t * e, int type) {
+        if (!e)
+            return;
+        sync();
+        log << "R\t" << e->id << "\t" << (type ? 0 : retire_id++) << "\t" << type << "\n";
+        unindex(*e);
+        inflight.erase(e->id);
+    }
+};
+
+#else
+#define KANATA(call)
+#endif // __SYNTHESIS__
+
+#endif // __KANATA_TRACE__H
@@ -9,10 +9,30 @@
 #include "drim4hls_datatypes.h"
 #include "globals.h"
 #include "packet.h"
+#include "checkpoint.h"
+#include "paged_mem.h"
+#include "chan_log.h"
+#include "packet_sink.h"
+#include "rank_abi.h"
 
 #define MEM_SIZE 256
-// Add a DMEM address for the rank result
-#define DMEM_RANK_ADDR (0x150 >> 2)
+// Cycles a control-plane table access may wait for a free DMEM port
+#define TABLE_MAX_WAIT 8
+// Resident rank programs and packet classes (see program_cfg_t)
+#define RESIDENT_PROGRAMS 4
+#define PROGRAM_CLASSES 16
+// Rank stages of node_th, one packet at a time
+#define NODE_IDLE 0   // core held in reset, waiting for a packet
+#define NODE_RUN 1    // rank program running from entry_pc
+#define NODE_DRAIN 2  // end loop reached, the last stores writing back
+// End loop of the rank programs (hang: j hang), see decode's program_end
+#define NODE_END_LOOP 0x0000006f
+// Cycles the drained state must hold before the rank is read: a store
+// handed to DMEM as the end loop retires is performed in the next cycle
+#define NODE_DRAIN_CYCLES 2
+// Cycles the core stays in reset between two packets, enough to flush
+// its memory channels
+#define NODE_RESET_CYCLES 2
 
 /**
  * SchedulingNode class
@@ -22,6 +42,13 @@
  *
  * A process for the DMEM and IMEM is included in order to simulate the CPU's
  * memory interface.
+ *
+ * In simulation the node runs the drim4hls core: every packet taken from
+ * in_pkt is written to DMEM, the core is released from reset at the entry
+ * PC of the packet's program, and once the program reaches its end loop
+ * the rank it stored at layout.out goes to the queue primitive with the
+ * packet. The core is then held in reset until the next packet, so each
+ * packet starts from its own program's entry (see node_th).
  */
 #pragma hls_design top
 SC_MODULE(SchedulingNode) {
@@ -33,13 +60,41 @@ SC_MODULE(SchedulingNode) {
   Connections::In<packet_metadata_t> CCS_INIT_S1(in_pkt);
   Connections::Out<packet_metadata_t> CCS_INIT_S1(out_pkt);
 
-  // IMEM and DMEM
-  sc_uint<XLEN> imem[ICACHE_SIZE];
+  // IMEM (two banks) and DMEM, sparse in simulation (see paged_mem.h)
+#ifdef __SYNTHESIS__
+  sc_uint<XLEN> imem[2][ICACHE_SIZE];
   sc_uint<XLEN> dmem[DCACHE_SIZE];
+#else
+  paged_mem<sc_uint<XLEN>, ICACHE_SIZE> imem[2];
+  paged_mem<sc_uint<XLEN>, DCACHE_SIZE> dmem;
+#endif
+  // The core fetches from imem[active_bank]; writes go to the other one.
+  // node_th switches the bank between packets, imemory_th sees it through
+  // fetch_bank.
+  sc_uint<1> active_bank;
+  sc_signal<sc_uint<1> > fetch_bank;
 
-  // IMEM runtime write interface
+  // IMEM runtime write interface (shadow bank)
   Connections::In<imem_write_req_t> CCS_INIT_S1(imem_write_port);
 
+  // Bank switch, applied between packets (see node_th)
+  Connections::In<imem_swap_req_t> CCS_INIT_S1(imem_swap_port);
+  Connections::Out<imem_swap_done_t> CCS_INIT_S1(imem_swap_done_port);
+
+  // Burst DMA load of IMEM/DMEM (see dma_th): request, DMA_BEAT_WORDS words
+  // per beat, and the reconfiguration latency once the burst is written
+  Connections::In<dma_load_req_t> CCS_INIT_S1(dma_req_port);
+  Connections::In<dma_beat_t> CCS_INIT_S1(dma_data_port);
+  Connections::Out<dma_done_t> CCS_INIT_S1(dma_done_port);
+
+  // Entry and class tables of the resident programs
+  Connections::In<program_cfg_t> CCS_INIT_S1(program_cfg_port);
+
+  // Control-plane table reads at any time, sharing the DMEM port with the
+  // rank program, and writes between packets (see dmemory_th)
+  Connections::In<table_req_t> CCS_INIT_S1(table_req_port);
+  Connections::Out<table_resp_t> CCS_INIT_S1(table_resp_port);
+
   // Channels for memory primitive interface
   Connections::Out<packet_enqueue_t> CCS_INIT_S1(
       mem_primitive_enqueue_ch);  // enqueue: metadata+rank
@@ -54,16 +109,54 @@ SC_MODULE(SchedulingNode) {
   Connections::Combinational<dmem_out_t> dmem2wb_ch;
   Connections::Combinational<dmem_in_t> wb2dmem_ch;
   Connections::Combinational<packet_metadata_t> pkt2dmem_ch;
+  Connections::Combinational<dma_write_t> CCS_INIT_S1(dma2imem_ch);
+  Connections::Combinational<dma_write_t> CCS_INIT_S1(dma2dmem_ch);
 
   /* CPU IS REMOVED FOR THE NODE'S SYNTH */
   /* FOR CPU SYNTH RESULTS, RUN A CPU ONLY SYNTH (See README)*/
+#ifndef __SYNTHESIS__
   // CPU instance
-  // drim4hls m_dut;
+  drim4hls m_dut;
+#endif
 
   // Instruction counters and program_end
   sc_signal<bool> program_end;
   sc_signal<long int> icount, j_icount, b_icount, m_icount, o_icount;
 
+  // Active-low reset of the core, driven by node_th: released for the
+  // program of one packet, held between packets
+  sc_signal<bool> core_rst;
+  // High from the ingest of a packet to the enqueue of its rank
+  sc_signal<bool> core_busy;
+  // Last word the core stored at layout.out, the rank (dmemory_th)
+  sc_signal<sc_uint<XLEN> > rank_word;
+  // High while dmemory_th holds no DMEM access of the core
+  sc_signal<bool> core_mem_idle;
+
+  // Control-plane table accesses, and cycles in which one of them held a
+  // DMEM access of the rank program
+  sc_signal<long int> table_reads, table_writes, table_stall_cycles;
+  // High while a table write waits for the packet boundary: node_th takes
+  // no packet until it is written
+  sc_signal<bool> table_hold;
+  // High while a DMEM burst waits for, or is written at, the packet
+  // boundary: node_th takes no packet until the burst is done
+  sc_signal<bool> dma_hold;
+  // Bound of the wait of a table read for a free DMEM port
+  sc_uint<4> table_max_wait;
+
+  // Entry PC of the core, set at ingest from the packet's class
+  sc_signal<sc_uint<PC_LEN> > entry_pc;
+
+  // Resident programs: class -> program -> entry PC, one entry table per
+  // IMEM bank
+  sc_uint<PC_LEN> entry_table[2][RESIDENT_PROGRAMS];
+  sc_uint<2> class_table[PROGRAM_CLASSES];
+  sc_uint<2> program_select;
+
+  // DMEM layout of the rank programs: packet metadata and rank words
+  rank_layout_t layout;
+
   // Internal state for scheduling node
   packet_metadata_t memory[MEM_SIZE];
   // Parent registers
@@ -73,6 +166,31 @@ SC_MODULE(SchedulingNode) {
 
   sc_signal<bool> rank_ready;  // Flag to indicate rank is ready
   sc_uint<32> rank_value;      // Store the computed rank
+  packet_metadata_t rank_pkt;  // Packet being ranked
+  sc_uint<2> node_state;       // NODE_IDLE, NODE_RUN or NODE_DRAIN
+  sc_uint<3> node_cycles;      // Cycles drained in NODE_DRAIN, or in reset in NODE_IDLE
+  sc_uint<16> queued;          // Packets enqueued and not yet dequeued
+  bool deq_pending;            // Dequeue request sent, response not yet in
+  bool out_pending;            // Dequeued packet waiting for out_pkt
+  packet_metadata_t out_meta;
+  bool swap_pending;           // Bank switch waiting for NODE_IDLE
+  imem_swap_req_t swap_req;
+  sc_uint<XLEN> swap_cycles;   // Cycles swap_req has waited
+
+#ifndef __SYNTHESIS__
+  // DMA loads so far (print_memory_stats)
+  unsigned long long dma_bursts, dma_words, dma_cycles;
+  // Bank switches so far and the cycles they waited for
+  unsigned long long imem_swaps, imem_swap_cycles;
+  // Egress log fed with the ingress and enqueue of every packet, or NULL
+  packet_sink* egress;
+  // Idle skip (set_idle_skip): the clocked processes of the core, and
+  // whether they are suspended
+  bool idle_skip, core_frozen;
+  std::vector<sc_process_handle> core_procs;
+  // Cycles in NODE_IDLE, and those of them with the core suspended
+  unsigned long long idle_cycles, skipped_cycles;
+#endif
 
   SC_HAS_PROCESS(SchedulingNode);
   SchedulingNode(sc_module_name name)
@@ -80,33 +198,49 @@ SC_MODULE(SchedulingNode) {
         rst("rst"),
         in_pkt("in_pkt"),
         out_pkt("out_pkt"),
+        mem_primitive_enqueue_ch("mem_primitive_enqueue_ch"),
+        mem_primitive_dequeue_req_ch("mem_primitive_dequeue_req_ch"),
+        mem_primitive_dequeue_resp_ch("mem_primitive_dequeue_resp_ch"),
         imem2de_ch("imem2de_ch"),
         fe2imem_ch("fe2imem_ch"),
         dmem2wb_ch("dmem2wb_ch"),
-        wb2dmem_ch("wb2dmem_ch"),
-        // m_dut("drim4hls"),
-        mem_primitive_enqueue_ch("mem_primitive_enqueue_ch"),
-        mem_primitive_dequeue_req_ch("mem_primitive_dequeue_req_ch"),
-        mem_primitive_dequeue_resp_ch("mem_primitive_dequeue_resp_ch") {
+        wb2dmem_ch("wb2dmem_ch")
+#ifndef __SYNTHESIS__
+        ,
+        m_dut("drim4hls")
+#endif
+  {
+    table_max_wait = TABLE_MAX_WAIT;
+#ifndef __SYNTHESIS__
+    dma_bursts = dma_words = dma_cycles = 0;
+    imem_swaps = imem_swap_cycles = 0;
+    egress = NULL;
+    idle_skip = core_frozen = false;
+    idle_cycles = skipped_cycles = 0;
+#endif
     /* CPU IS REMOVED FOR THE NODE'S SYNTH */
     /* FOR CPU SYNTH RESULTS, RUN A CPU ONLY SYNTH (See README)*/
+#ifndef __SYNTHESIS__
     // Connect CPU ports to local signals/channels
-    // m_dut.clk(clk);
-    // m_dut.rst(rst);
-
-    // m_dut.program_end(program_end);
-
-    // m_dut.icount(icount);
-    // m_dut.j_icount(j_icount);
-    // m_dut.b_icount(b_icount);
-    // m_dut.m_icount(m_icount);
-    // m_dut.o_icount(o_icount);
-
-    // m_dut.imem2de_data(imem2de_ch);
-    // m_dut.fe2imem_data(fe2imem_ch);
-    // m_dut.dmem2wb_data(dmem2wb_ch);
-    // m_dut.wb2dmem_data(wb2dmem_ch);
+    m_dut.clk(clk);
+    m_dut.rst(core_rst);
+
+    m_dut.program_end(program_end);
+
+    m_dut.icount(icount);
+    m_dut.j_icount(j_icount);
+    m_dut.b_icount(b_icount);
+    m_dut.m_icount(m_icount);
+    m_dut.o_icount(o_icount);
+    m_dut.entry_pc(entry_pc);
+
+    m_dut.imem2de_data(imem2de_ch);
+    m_dut.fe2imem_data(fe2imem_ch);
+    m_dut.dmem2wb_data(dmem2wb_ch);
+    m_dut.wb2dmem_data(wb2dmem_ch);
+#else
     program_end.write(true);
+#endif
 
     SC_CTHREAD(node_th, clk.pos());
     async_reset_signal_is(rst, false);
@@ -116,89 +250,292 @@ SC_MODULE(SchedulingNode) {
 
     SC_CTHREAD(dmemory_th, clk.pos());
     async_reset_signal_is(rst, false);
+
+    SC_CTHREAD(dma_th, clk.pos());
+    async_reset_signal_is(rst, false);
+  }
+
+#ifndef __SYNTHESIS__
+  // Layout of the loaded programs (rank_layout_t::from_symbols of their
+  // ELF), before the simulation starts. The defaults match schedulers/.
+  void set_layout(const rank_layout_t& l) { layout = l; }
+
+  // The sink bound to out_pkt, for its per-packet log (packet_sink.h).
+  void set_egress_log(packet_sink* sink) { egress = sink; }
+
+  // Bound of the wait of a table read, TABLE_MAX_WAIT by default; 0 lets
+  // every read take the DMEM port at once.
+  void set_table_max_wait(unsigned cycles) { table_max_wait = cycles; }
+
+  // Between packets the core is held in reset. With idle skip its
+  // processes are suspended once it has settled there, and resumed when
+  // the next packet is taken, so an idle node costs the kernel only its
+  // own threads. Ranks and cycle counts are the same either way.
+  void set_idle_skip(bool on) { idle_skip = on; }
+
+  void end_of_elaboration() { collect_core_processes(&m_dut); }
+
+  // The clocked processes below m_dut (named *_th).
+  void collect_core_processes(sc_object* parent) {
+    const std::vector<sc_object*>& children = parent->get_child_objects();
+    for (size_t i = 0; i < children.size(); i++) {
+      sc_process_handle h(children[i]);
+      std::string name = children[i]->basename();
+      if (!h.valid())
+        collect_core_processes(children[i]);
+      else if (name.size() > 3 && name.compare(name.size() - 3, 3, "_th") == 0)
+        core_procs.push_back(h);
+    }
+  }
+
+  void freeze_core(bool frozen) {
+    if (frozen == core_frozen) return;
+    for (size_t i = 0; i < core_procs.size(); i++) {
+      if (frozen)
+        core_procs[i].suspend();
+      else
+        core_procs[i].resume();
+    }
+    core_frozen = frozen;
+  }
+#endif
+
+  // Program of a packet, from its class. Every class runs program 0 (entry
+  // 0) until the tables are configured, so a single program needs no setup.
+  sc_uint<2> program_of(const packet_metadata_t& pkt) const {
+    sc_uint<4> cls;
+    if (program_select == PROGRAM_SEL_TOS)
+      cls = pkt.tos.range(7, 4);
+    else if (program_select == PROGRAM_SEL_PRIORITY)
+      cls = pkt.priority;
+    else
+      cls = pkt.flow_id.range(3, 0);
+    return class_table[cls];
   }
 
+  // True once the core has written back its end loop, so that every store
+  // of the program was handed to DMEM, and dmemory_th holds none of them.
+  // Without the core (synthesis of the node) program_end is tied high.
+  bool core_drained() {
+#ifndef __SYNTHESIS__
+    unsigned pc = m_dut.wb.retired_pc.read().to_uint() >> 2;
+    return pc < ICACHE_SIZE && imem[active_bank][pc] == NODE_END_LOOP &&
+           core_mem_idle.read();
+#else
+    return true;
+#endif
+  }
+
+  // One packet at a time: NODE_IDLE takes a packet, writes it to DMEM and
+  // releases the core at the entry of the packet's program; NODE_RUN waits
+  // for the end loop (program_end); NODE_DRAIN waits for the pipeline to
+  // write the end loop back and for DMEM to perform the last store (a
+  // table read can hold it, see dmemory_th), enqueues the rank and puts
+  // the core back in reset. The core thus restarts at every packet, from
+  // the entry of that packet's program. The enqueue blocks while the
+  // queue primitive refuses it, which stalls the ranking of the next
+  // packet.
+  //
+  // The dequeue side asks the primitive for one packet at a time, only
+  // while it holds packets of this node and out_pkt has taken the last one.
+  // A packet that out_pkt refuses waits in out_meta, so backpressure on
+  // out_pkt stops the dequeues but never the ranking.
+  //
+  // A bank switch (imem_swap_port) is applied in NODE_IDLE, with the core
+  // in reset and before the next packet is taken: that packet runs from
+  // the new bank, at the entries of that bank's entry table. No packet is
+  // taken either while a table write (table_hold, see dmemory_th) or a
+  // DMEM burst (dma_hold, see dma_th) waits.
   void node_th() {
     in_pkt.Reset();
     out_pkt.Reset();
+    program_cfg_port.Reset();
+    imem_swap_port.Reset();
+    imem_swap_done_port.Reset();
+    mem_primitive_enqueue_ch.Reset();
+    mem_primitive_dequeue_req_ch.Reset();
+    mem_primitive_dequeue_resp_ch.Reset();
+    core_rst.write(false);
+    core_busy.write(false);
+    rank_ready.write(false);
+    node_state = NODE_IDLE;
+    node_cycles = 0;
+    queued = 0;
+    deq_pending = false;
+    out_pending = false;
+#ifndef __SYNTHESIS__
+    freeze_core(false);
+#endif
+    active_bank = 0;
+    fetch_bank.write(0);
+    swap_pending = false;
+    swap_cycles = 0;
+    entry_pc.write(0);
+#pragma hls_unroll yes
+    for (unsigned i = 0; i < RESIDENT_PROGRAMS; i++) {
+      entry_table[0][i] = 0;
+      entry_table[1][i] = 0;
+    }
+#pragma hls_unroll yes
+    for (unsigned i = 0; i < PROGRAM_CLASSES; i++) class_table[i] = 0;
+    program_select = PROGRAM_SEL_FLOW;
     wait();
 
     while (true) {
       if (rst.read() == false) {
         rank_ready.write(false);
       } else {
-        // ENQ part
-        // Normal packet handling
-        packet_metadata_t pkt;
-        if (in_pkt.PopNB(pkt)) {
-          pkt2dmem_ch.Push(pkt);
+        program_cfg_t cfg;
+        if (program_cfg_port.PopNB(cfg)) {
+          CHAN_LOG(program_cfg_port, cfg);
+          if (cfg.kind == PROGRAM_CFG_ENTRY)
+            entry_table[active_bank][cfg.index % RESIDENT_PROGRAMS] = cfg.value;
+          else if (cfg.kind == PROGRAM_CFG_SHADOW_ENTRY)
+            entry_table[active_bank ^ 1][cfg.index % RESIDENT_PROGRAMS] =
+                cfg.value;
+          else if (cfg.kind == PROGRAM_CFG_CLASS)
+            class_table[cfg.index] = cfg.value;
+          else if (cfg.kind == PROGRAM_CFG_SELECT)
+            program_select = cfg.value;
         }
 
-        // Only act when program_end transitions from 0 to 1 (rising edge)
-        static bool prev_program_end = false;
-        bool curr_program_end = program_end.read();
+        if (!swap_pending && imem_swap_port.PopNB(swap_req)) {
+          CHAN_LOG(imem_swap_port, swap_req);
+          swap_pending = true;
+          swap_cycles = 0;
+        }
+        if (swap_pending) swap_cycles++;
 
-        if (curr_program_end && !prev_program_end) {
-          // Fetch rank
-          // rank_value = dmem[DMEM_RANK_ADDR];
-          rank_value = 0;
+        // ENQ part
+        if (node_state == NODE_IDLE && swap_pending) {
+          // Atomic bank switch between two packets
+          active_bank = swap_req.bank;
+          fetch_bank.write(swap_req.bank);
+          swap_pending = false;
+          imem_swap_done_t done;
+          done.bank = swap_req.bank;
+          done.cycles = swap_cycles;
+          imem_swap_done_port.Push(done);
+#ifndef __SYNTHESIS__
+          imem_swaps++;
+          imem_swap_cycles += swap_cycles.to_uint64();
+#endif
+        } else if (node_state == NODE_IDLE) {
+          if (node_cycles < NODE_RESET_CYCLES) {
+            node_cycles++;
+          } else if (!table_hold.read() && !dma_hold.read() &&
+                     in_pkt.PopNB(rank_pkt)) {
+            CHAN_LOG(in_pkt, rank_pkt);
+#ifndef __SYNTHESIS__
+            if (egress) egress->ingress(rank_pkt);
+            freeze_core(false);
+#endif
+            // The core starts the packet's program directly at its entry
+            entry_pc.write(entry_table[active_bank][program_of(rank_pkt)]);
+            core_busy.write(true);
+            rank_ready.write(false);
+            pkt2dmem_ch.Push(rank_pkt);
+            core_rst.write(true);
+            node_state = NODE_RUN;
+          }
+#ifndef __SYNTHESIS__
+          if (node_state == NODE_IDLE) {
+            idle_cycles++;
+            if (idle_skip && node_cycles == NODE_RESET_CYCLES)
+              freeze_core(true);
+            if (core_frozen) skipped_cycles++;
+          }
+#endif
+        } else if (node_state == NODE_RUN) {
+          // Low from the reset of the core until its end loop
+          if (program_end.read()) {
+            node_state = NODE_DRAIN;
+            node_cycles = 0;
+          }
+        } else if (!core_drained()) {
+          node_cycles = 0;
+        } else if (++node_cycles == NODE_DRAIN_CYCLES) {
+          rank_value = rank_word.read();
+          rank_ready.write(true);
 
-          // Enqueue to primitive: send metadata + rank (here rank_value, or
-          // compute as needed)
+          // Enqueue to primitive: send metadata + rank
           packet_enqueue_t enq;
-          enq.metadata = pkt;
+          enq.metadata = rank_pkt;
           enq.rank = rank_value;
           mem_primitive_enqueue_ch.Push(enq);
+          queued++;
+#ifndef __SYNTHESIS__
+          if (egress) egress->enqueue(enq.rank.to_uint());
+#endif
+          core_rst.write(false);
+          core_busy.write(false);
+          node_state = NODE_IDLE;
+          node_cycles = 0;
         }
-        prev_program_end = curr_program_end;
 
-        // DQ part
-        packet_dequeue_req_t deq_req;
-        deq_req.rank = 0;  // Need to change based on primitive's strategy
-        mem_primitive_dequeue_req_ch.Push(deq_req);  // Send dequeue request
-        // Find a packet with matching rank (simple example: first match)
+        // DQ part, without blocking the ENQ part
+        if (out_pending && out_pkt.PushNB(out_meta)) out_pending = false;
+        if (!deq_pending && !out_pending && queued > 0) {
+          packet_dequeue_req_t deq_req;
+          deq_req.rank = 0;  // Need to change based on primitive's strategy
+          deq_pending = mem_primitive_dequeue_req_ch.PushNB(deq_req);
+        }
         packet_dequeue_resp_t deq_resp;
-
-        // TO BE IMPLEMENTED with the desired memory primitive
-
-        if (mem_primitive_dequeue_resp_ch.PopNB(deq_resp)) {
-          out_pkt.Push(deq_resp.metadata);
+        if (deq_pending && mem_primitive_dequeue_resp_ch.PopNB(deq_resp)) {
+          CHAN_LOG(mem_primitive_dequeue_resp_ch, deq_resp);
+          deq_pending = false;
+          queued--;
+          out_meta = deq_resp.metadata;
+          out_pending = !out_pkt.PushNB(out_meta);
         }
       }
       wait();
     }
   }
 
+  // The new program of a hot swap is written to the shadow bank while the
+  // core keeps running from the active one (the banks are separate, so a
+  // write and a fetch can happen in the same cycle). A swap request waits
+  // in node_th for the end of the current packet, then the next
+  // packet runs entirely from the new bank. No packet is held back and none
+  // can run a half-written program. The control plane issues the swap once
+  // its writes are done (after dma_done for a DMA load).
   void imemory_th() {
     imem2de_ch.ResetWrite();
     fe2imem_ch.ResetRead();
     imem_write_port.Reset();
+    dma2imem_ch.ResetRead();
     wait();
 
     while (true) {
       if (rst.read() == false) {
         // clear IMEM on reset
       } else {
-        // Reconfiguration of the scheduler
-        // Only allowed once the program is completed
-        // Even if looping the program, it will set/reset program end
-        if (program_end.read()) {
-          imem_write_req_t req;
-          if (imem_write_port.PopNB(req)) {
-            unsigned addr = req.addr >> 2;
-            if (addr < ICACHE_SIZE) {
-              imem[addr] = req.data;
-              wait();  // Prioritize IMEM write
-              continue;
-            }
+        sc_uint<1> bank = fetch_bank.read();
+        sc_uint<1> shadow = bank ^ 1;
+
+        // Reconfiguration of the scheduler, in the background
+        imem_write_req_t req;
+        dma_write_t dw;
+        if (imem_write_port.PopNB(req)) {
+          CHAN_LOG(imem_write_port, req);
+          unsigned addr = req.addr >> 2;
+          if (addr < ICACHE_SIZE) imem[shadow][addr] = req.data;
+        } else if (dma2imem_ch.PopNB(dw)) {
+          CHAN_LOG(dma2imem_ch, dw);
+#pragma hls_unroll yes
+          for (unsigned i = 0; i < DMA_BEAT_WORDS; i++) {
+            if (i < dw.words && dw.addr + i < ICACHE_SIZE)
+              imem[shadow][dw.addr + i] = dw.beat.data[i];
           }
         }
 
         imem_in_t imem_in;
         if (fe2imem_ch.PopNB(imem_in)) {
+          CHAN_LOG(fe2imem_ch, imem_in);
           unsigned int addr_aligned = imem_in.instr_addr >> 2;
           imem_out_t imem_dout;
-          imem_dout.instr_data = imem[addr_aligned];
+          imem_dout.instr_data = imem[bank][addr_aligned];
           imem2de_ch.Push(imem_dout);
         }
       }
@@ -209,15 +546,46 @@ SC_MODULE(SchedulingNode) {
   void dmemory_th() {
     wb2dmem_ch.ResetRead();
     dmem2wb_ch.ResetWrite();
+    dma2dmem_ch.ResetRead();
+    table_req_port.Reset();
+    table_resp_port.Reset();
+    table_reads.write(0);
+    table_writes.write(0);
+    table_stall_cycles.write(0);
+    table_hold.write(false);
+    rank_word.write(0);
+    core_mem_idle.write(true);
+
+    bool core_pending = false;
+    dmem_in_t core_req;
+    bool table_pending = false;
+    table_req_t table_req;
+    sc_uint<4> table_wait = 0;
+    bool resp_pending = false;
+    table_resp_t table_resp;
     wait();
 
     while (true) {
       if (rst.read() == false) {
         // Clear DMEM on reset
       } else {
+        // DMEM bursts come only between packets, under dma_hold
+        dma_write_t dw;
+        if (dma2dmem_ch.PopNB(dw)) {
+          CHAN_LOG(dma2dmem_ch, dw);
+#pragma hls_unroll yes
+          for (unsigned i = 0; i < DMA_BEAT_WORDS; i++) {
+            if (i < dw.words && dw.addr + i < DCACHE_SIZE)
+              dmem[dw.addr + i] = dw.beat.data[i];
+          }
+          wait();
+          continue;
+        }
+
         packet_metadata_t pkt;
         if (pkt2dmem_ch.PopNB(pkt)) {
-          unsigned base_addr = 0x100 >> 2;
+          CHAN_LOG(pkt2dmem_ch, pkt);
+          unsigned base_addr = layout.meta >> 2;
           dmem[base_addr + 0] = pkt.src;
           dmem[base_addr + 1] = pkt.dst;
           dmem[base_addr + 2] = (pkt.length & 0xFFFF) |
@@ -228,22 +596,142 @@ SC_MODULE(SchedulingNode) {
           dmem[base_addr + 4] = pkt.payload_ptr;
         }
 
-        dmem_in_t dmem_din = wb2dmem_ch.Pop();  // Blocking pop
-        unsigned int addr = dmem_din.data_addr;
+        if (!core_pending && wb2dmem_ch.PopNB(core_req)) {
+          CHAN_LOG(wb2dmem_ch, core_req);
+          core_pending = true;
+        }
+        // The read response waits in table_resp, so a slow reader never
+        // stalls this thread; the next request is taken once it is out.
+        if (resp_pending && table_resp_port.PushNB(table_resp))
+          resp_pending = false;
+        if (!table_pending && !resp_pending &&
+            table_req_port.PopNB(table_req)) {
+          CHAN_LOG(table_req_port, table_req);
+          table_pending = true;
+          if (table_req.write) table_hold.write(true);
+        }
 
-        dmem_out_t dmem_dout;
-        if (dmem_din.read_en) {
-          dmem_dout.data_out = dmem[addr];
-          dmem2wb_ch.Push(dmem_dout);
-        } else if (dmem_din.write_en) {
-          dmem[addr] = dmem_din.data_in;
-          dmem_dout.data_out = dmem_din.data_in;
+        // One access per cycle. A write waits for the packet boundary: it
+        // raises table_hold, and goes in once node_th has seen it (so no
+        // packet can start meanwhile) and no packet is ranked. A rank thus
+        // sees a table either before or after a write, never half-way.
+        // Reads share the port with the rank program, which has priority:
+        // a read takes the port when it is free or after table_max_wait
+        // cycles, stalling the program for that cycle.
+        bool table_go;
+        if (table_req.write)
+          table_go = table_pending && table_hold.read() && !core_busy.read() &&
+                     !core_pending;
+        else
+          table_go = table_pending &&
+                     (!core_pending || table_wait == table_max_wait);
+        if (table_go) {
+          unsigned addr = table_req.addr >> 2;
+          if (table_req.write) {
+            if (addr < DCACHE_SIZE) dmem[addr] = table_req.data;
+            table_writes.write(table_writes.read() + 1);
+            table_hold.write(false);
+          } else {
+            table_resp.data =
+                addr < DCACHE_SIZE ? dmem[addr] : sc_uint<XLEN>(0);
+            resp_pending = !table_resp_port.PushNB(table_resp);
+            table_reads.write(table_reads.read() + 1);
+          }
+          if (core_pending)
+            table_stall_cycles.write(table_stall_cycles.read() + 1);
+          table_pending = false;
+          table_wait = 0;
+        } else if (core_pending) {
+          unsigned int addr = core_req.data_addr;
+
+          dmem_out_t dmem_dout;
+          if (core_req.read_en) {
+            dmem_dout.data_out = dmem[addr];
+            dmem2wb_ch.Push(dmem_dout);
+          } else if (core_req.write_en) {
+            dmem[addr] = core_req.data_in;
+            dmem_dout.data_out = core_req.data_in;
+            if (addr == (layout.out >> 2)) rank_word.write(core_req.data_in.to_uint64());
+          }
+          core_pending = false;
+          if (table_pending && !table_req.write) table_wait++;
         }
+        core_mem_idle.write(!core_pending);
       }
       wait();
     }
   }
 
+  // Burst loads: one request, then one beat per cycle handed to the memory
+  // thread of the target, which writes it to the shadow IMEM bank or to
+  // DMEM. A DMEM burst is written whole between two packets: dma_hold
+  // keeps node_th from taking the next packet, and the beats start once
+  // the packet being ranked is enqueued. The done message carries the
+  // cycles from the request to the hand-over of the last beat (the memory
+  // writes it in the same or the next cycle), including the wait for the
+  // boundary, i.e. the dead time of the reconfiguration; a word-by-word
+  // imem_write_port load of the same program takes one cycle per word.
+  void dma_th() {
+    dma_req_port.Reset();
+    dma_data_port.Reset();
+    dma_done_port.Reset();
+    dma2imem_ch.ResetWrite();
+    dma2dmem_ch.ResetWrite();
+    dma_hold.write(false);
+    wait();
+
+    while (true) {
+      dma_load_req_t req = dma_req_port.Pop();
+      CHAN_LOG(dma_req_port, req);
+
+      dma_write_t dw;
+      dw.addr = req.base >> 2;
+      sc_uint<XLEN> left = req.length;
+      sc_uint<XLEN> cycles = 1;
+      bool have_beat = false;
+      bool to_dmem = req.target == DMA_TARGET_DMEM;
+      if (to_dmem) dma_hold.write(true);
+      wait();
+
+      // node_th has seen dma_hold once it reads back high; a packet it
+      // took meanwhile sets core_busy
+      while (to_dmem && core_busy.read()) {
+        cycles++;
+        wait();
+      }
+
+      while (left > 0) {
+        if (!have_beat && dma_data_port.PopNB(dw.beat)) {
+          CHAN_LOG(dma_data_port, dw.beat);
+          dw.words = left < DMA_BEAT_WORDS ? (unsigned)left : DMA_BEAT_WORDS;
+          have_beat = true;
+        }
+        if (have_beat) {
+          bool sent = to_dmem ? dma2dmem_ch.PushNB(dw) : dma2imem_ch.PushNB(dw);
+          if (sent) {
+            dw.addr += DMA_BEAT_WORDS;
+            left -= dw.words;
+            have_beat = false;
+          }
+        }
+        cycles++;
+        wait();
+      }
+
+      dma_hold.write(false);
+
+      dma_done_t done;
+      done.words = req.length;
+      done.cycles = cycles;
+      dma_done_port.Push(done);
+#ifndef __SYNTHESIS__
+      dma_bursts++;
+      dma_words += req.length.to_uint64();
+      dma_cycles += cycles.to_uint64();
+#endif
+    }
+  }
+
   // Set coordinates (x, y) for the node's parent (if any)
   void set_parent(sc_uint<4> x, sc_uint<4> y) {
     parent_id[0] = x;
@@ -251,6 +739,140 @@ SC_MODULE(SchedulingNode) {
   }
 
 #ifndef __SYNTHESIS__
+  // Checkpoint of the node state, see checkpoint.h: memories, the packet
+  // store, parent and scheduling registers, the rank stage and the core.
+  void save_state(checkpoint& ckpt) const {
+    checkpoint::writer w = ckpt.add("node");
+    imem[0].save(w);
+    imem[1].save(w);
+    w.put(active_bank);
+    dmem.save(w);
+    for (unsigned i = 0; i < MEM_SIZE; ++i) {
+      const packet_metadata_t& pkt = memory[i];
+      w.put(pkt.src);
+      w.put(pkt.dst);
+      w.put(pkt.length);
+      w.put(pkt.tos);
+      w.put(pkt.priority);
+      w.put(pkt.flow_id);
+      w.put(pkt.arrival_time);
+      w.put(pkt.payload_ptr);
+    }
+    w.put_array(parent_id, 2);
+    w.put_array(scheduling_registers, 32);
+    w.put(rank_value);
+    w.put(rank_ready.read());
+    w.put(rank_pkt.src);
+    w.put(rank_pkt.dst);
+    w.put(rank_pkt.length);
+    w.put(rank_pkt.tos);
+    w.put(rank_pkt.priority);
+    w.put(rank_pkt.flow_id);
+    w.put(rank_pkt.arrival_time);
+    w.put(rank_pkt.payload_ptr);
+    w.put(node_state);
+    w.put(node_cycles);
+    w.put_array(entry_table[0], RESIDENT_PROGRAMS);
+    w.put_array(entry_table[1], RESIDENT_PROGRAMS);
+    w.put(swap_pending);
+    w.put(swap_req.bank);
+    w.put(swap_cycles);
+    w.put_array(class_table, PROGRAM_CLASSES);
+    w.put(program_select);
+    w.put(queued);
+    w.put(deq_pending);
+    w.put(out_pending);
+    w.put(out_meta.src);
+    w.put(out_meta.dst);
+    w.put(out_meta.length);
+    w.put(out_meta.tos);
+    w.put(out_meta.priority);
+    w.put(out_meta.flow_id);
+    w.put(out_meta.arrival_time);
+    w.put(out_meta.payload_ptr);
+    m_dut.save_state(ckpt);
+  }
+
+  bool load_state(const checkpoint& ckpt) {
+    checkpoint::reader r = ckpt.find("node");
+    imem[0].load(r);
+    imem[1].load(r);
+    r.get(active_bank);
+    fetch_bank.write(active_bank);
+    dmem.load(r);
+    for (unsigned i = 0; i < MEM_SIZE; ++i) {
+      packet_metadata_t& pkt = memory[i];
+      r.get(pkt.src);
+      r.get(pkt.dst);
+      r.get(pkt.length);
+      r.get(pkt.tos);
+      r.get(pkt.priority);
+      r.get(pkt.flow_id);
+      r.get(pkt.arrival_time);
+      r.get(pkt.payload_ptr);
+    }
+    r.get_array(parent_id, 2);
+    r.get_array(scheduling_registers, 32);
+    r.get(rank_value);
+    bool ready;
+    r.get(ready);
+    rank_ready.write(ready);
+    r.get(rank_pkt.src);
+    r.get(rank_pkt.dst);
+    r.get(rank_pkt.length);
+    r.get(rank_pkt.tos);
+    r.get(rank_pkt.priority);
+    r.get(rank_pkt.flow_id);
+    r.get(rank_pkt.arrival_time);
+    r.get(rank_pkt.payload_ptr);
+    r.get(node_state);
+    r.get(node_cycles);
+    core_rst.write(node_state != NODE_IDLE);
+    core_busy.write(node_state != NODE_IDLE);
+    rank_word.write(dmem[layout.out >> 2]);
+    table_hold.write(false);
+    dma_hold.write(false);
+    r.get_array(entry_table[0], RESIDENT_PROGRAMS);
+    r.get_array(entry_table[1], RESIDENT_PROGRAMS);
+    r.get(swap_pending);
+    r.get(swap_req.bank);
+    r.get(swap_cycles);
+    r.get_array(class_table, PROGRAM_CLASSES);
+    r.get(program_select);
+    r.get(queued);
+    r.get(deq_pending);
+    r.get(out_pending);
+    r.get(out_meta.src);
+    r.get(out_meta.dst);
+    r.get(out_meta.length);
+    r.get(out_meta.tos);
+    r.get(out_meta.priority);
+    r.get(out_meta.flow_id);
+    r.get(out_meta.arrival_time);
+    r.get(out_meta.payload_ptr);
+    return r.ok() && m_dut.load_state(ckpt);
+  }
+
+  // Pages of IMEM and DMEM the node has touched.
+  void print_memory_stats(std::ostream& os) const {
+    os << "[" << name() << "] memory:" << std::endl;
+    imem[0].print_stats(os, active_bank == 0 ? "  IMEM 0 (active): " : "  IMEM 0: ");
+    imem[1].print_stats(os, active_bank == 1 ? "  IMEM 1 (active): " : "  IMEM 1: ");
+    os << "  IMEM swaps: " << imem_swaps << ", " << imem_swap_cycles
+       << " cycles waited" << std::endl;
+    dmem.print_stats(os, "  DMEM: ");
+    os << "  table: " << table_reads.read() << " reads, "
+       << table_writes.read() << " writes, " << table_stall_cycles.read()
+       << " rank program stall cycles" << std::endl;
+    os << "  idle: " << idle_cycles << " cycles, " << skipped_cycles
+       << " with the core suspended" << std::endl;
+    os << "  DMA: " << dma_bursts << " bursts, " << dma_words << " words in "
+       << dma_cycles << " cycles";
+    if (dma_cycles)
+      os << " (" << (double)dma_words / dma_cycles << " words/cycle)";
+    os << std::endl;
+  }
+
   void dump_memory() const {
     std::cout << "[SchedulingNode] Dumping internal memory:\n";
     for (unsigned i = 0; i < MEM_SIZE; ++i) {
@@ -0,0 +1,231 @@
+/*
+	@brief
+	Loosely-timed TLM-2.0 model of SchedulingNode for fabric-level studies
+	(simulation only). The pin-level Connections ports become two sockets
+	carrying one packet per blocking transport:
+
+		in_socket   target, TLM_WRITE of the RANK_META_WORDS metadata words
+		            (rank_meta_words layout, host byte order) = in_pkt
+		out_socket  initiator, the same payload for every dequeued packet
+		            = out_pkt
+
+	Ranking and queueing are those of the untimed model (node_model.h,
+	pifo.h) with the rank program on the ISS. Time is annotated instead of
+	simulated: a packet occupies the node for
+
+		overhead_cycles + cpi * (instructions of its rank program)
+
+	clock periods after its arrival (or after the previous packet), and
+	only then enters the PIFO. cpi and overhead_cycles are measurements of
+	the pin-level SchedulingNode with its core, made by tests/node_lt_tb.cpp
+	(make node_lt_tb): the defaults are those of DRR. The dequeue
+	thread runs ahead of the simulation time with a tlm_quantumkeeper and
+	only synchronises once per global quantum (set_quantum), so a fabric of
+	many nodes costs about one context switch per node and quantum.
+
+*/
+
+#ifndef __NODE_LT__H
+#define __NODE_LT__H
+
+#ifndef __SYNTHESIS__
+
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <ostream>
+#include <string>
+
+#include <systemc.h>
+#include <tlm.h>
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/simple_target_socket.h>
+#include <tlm_utils/tlm_quantumkeeper.h>
+
+#include "node_model.h"
+#include "rank_abi.h"
+
+#define NODE_LT_PACKET_BYTES (4 * RANK_META_WORDS)
+
+// Timing annotations of SchedulingNodeLT, in cycles of period.
+struct node_lt_timing {
+    sc_time period;
+    double cpi;               // core CPI on the rank program, stalls included
+    unsigned overhead_cycles; // restart, drain and enqueue around every packet
+    unsigned accept_cycles;   // delay of in_socket seen by the sender
+    unsigned dequeue_cycles;  // interval between two packets on out_socket
+
+    // Measured by node_lt_tb on DRR (SP 6.67, WFQ 8.18)
+    node_lt_timing(): period(10, SC_NS), cpi(7.74), overhead_cycles(22), accept_cycles(1), dequeue_cycles(1) {}
+};
+
+class SchedulingNodeLT: public sc_module {
+    public:
+    tlm_utils::simple_target_socket < SchedulingNodeLT > in_socket;
+    tlm_utils::simple_initiator_socket < SchedulingNodeLT > out_socket;
+
+    SC_HAS_PROCESS(SchedulingNodeLT);
+    SchedulingNodeLT(sc_module_name name, const node_lt_timing & t = node_lt_timing()):
+        sc_module(name),
+        in_socket("in_socket"),
+        out_socket("out_socket"),
+        timing(t),
+        model(ranker),
+        busy_until(SC_ZERO_TIME),
+        busy_cycles(0),
+        sent(0) {
+        in_socket.register_b_transport(this, & SchedulingNodeLT::b_transport);
+        SC_THREAD(dequeue_th);
+    }
+
+    // Global quantum of every loosely-timed node.
+    static void set_quantum(const sc_time & q) {
+        tlm::tlm_global_quantum::instance().set(q);
+    }
+
+    // Rank program, notmain.elf or notmain.txt (iss::load_program).
+    bool load_program(const std::string & path) {
+        bool ok = ranker.cpu().load_program(path, & program_layout);
+        model.set_layout(program_layout);
+        return ok;
+    }
+
+    // DMEM layout of the loaded program, for write_dmem().
+    const rank_layout_t & layout() const {
+        return program_layout;
+    }
+
+    // Weight table and other scheduler state, before the first packet.
+    void write_dmem(uint32_t addr, uint32_t data) {
+        ranker.cpu().write_dmem(addr, data);
+    }
+
+    // Timing annotations, before the first packet (e.g. once calibrated).
+    void set_timing(const node_lt_timing & t) {
+        timing = t;
+    }
+
+    // Cycles annotated so far, overhead_cycles + cpi * instructions per
+    // packet.
+    unsigned long long cycles() const {
+        return busy_cycles;
+    }
+
+    void print_stats(std::ostream & os) const {
+        os << "[" << name() << "] " << model.packets() << " packets ranked, " << sent << " sent, "
+           << busy_cycles << " busy cycles";
+        if (model.packets())
+            os << " (" << (double) busy_cycles / model.packets() << " per packet)";
+        os << std::endl;
+    }
+
+    private:
+    // A ranked packet, waiting for the end of its rank program.
+    struct ranked_packet_t {
+        sc_time ready;
+        rank_packet_t pkt;
+        uint32_t rank;
+    };
+
+    node_lt_timing timing;
+    iss_ranker ranker;
+    rank_layout_t program_layout;
+    node_model < rank_packet_t, iss_ranker > model;
+    std::deque < ranked_packet_t > pending; // in ready order
+    sc_time busy_until;
+    sc_event enqueued;
+    unsigned long long busy_cycles;
+    unsigned long long sent;
+
+    void b_transport(tlm::tlm_generic_payload & trans, sc_time & delay) {
+        if (trans.get_command() != tlm::TLM_WRITE_COMMAND) {
+            trans.set_response_status(tlm::TLM_COMMAND_ERROR_RESPONSE);
+            return;
+        }
+        if (trans.get_data_length() != NODE_LT_PACKET_BYTES || trans.get_byte_enable_ptr()) {
+            trans.set_response_status(tlm::TLM_BURST_ERROR_RESPONSE);
+            return;
+        }
+
+        uint32_t w[RANK_META_WORDS];
+        memcpy(w, trans.get_data_ptr(), sizeof(w));
+        ranked_packet_t r;
+        r.pkt = rank_packet_from_words(w);
+
+        uint64_t insns = ranker.cpu().retired();
+        if (!model.compute_rank(r.pkt, r.rank)) {
+            SC_REPORT_ERROR(name(), "Rank program did not end.");
+            trans.set_response_status(tlm::TLM_GENERIC_ERROR_RESPONSE);
+            return;
+        }
+        insns = ranker.cpu().retired() - insns;
+        unsigned long long cycles = timing.overhead_cycles + (unsigned long long) std::ceil(timing.cpi * insns);
+        busy_cycles += cycles;
+
+        // The core ranks one packet at a time.
+        sc_time arrival = sc_time_stamp() + delay;
+        sc_time start = arrival > busy_until ? arrival : busy_until;
+        busy_until = start + timing.period * (double) cycles;
+        r.ready = busy_until;
+        pending.push_back(r);
+        enqueued.notify(SC_ZERO_TIME);
+
+        delay += timing.period * (double) timing.accept_cycles;
+        trans.set_response_status(tlm::TLM_OK_RESPONSE);
+    }
+
+    // out_pkt: one packet every dequeue_cycles while the PIFO holds ranked
+    // packets, running ahead of the simulation time within the quantum.
+    void dequeue_th() {
+        tlm_utils::tlm_quantumkeeper qk;
+        qk.reset();
+        while (true) {
+            sc_time now = qk.get_current_time();
+            while (!pending.empty() && pending.front().ready <= now) {
+                model.enqueue_ranked(pending.front().pkt, pending.front().rank);
+                pending.pop_front();
+            }
+
+            rank_packet_t pkt;
+            if (model.dequeue(pkt)) {
+                send(pkt, qk);
+                qk.inc(timing.period * (double) timing.dequeue_cycles);
+            } else if (!pending.empty()) {
+                // Idle until the next rank program ends.
+                qk.set(pending.front().ready - sc_time_stamp());
+            } else {
+                qk.sync();
+                wait(enqueued);
+                continue;
+            }
+            if (qk.need_sync())
+                qk.sync();
+        }
+    }
+
+    void send(const rank_packet_t & pkt, tlm_utils::tlm_quantumkeeper & qk) {
+        uint32_t w[RANK_META_WORDS];
+        rank_meta_words(pkt, w);
+
+        tlm::tlm_generic_payload trans;
+        trans.set_command(tlm::TLM_WRITE_COMMAND);
+        trans.set_address(0);
+        trans.set_data_ptr((unsigned char *) w);
+        trans.set_data_length(NODE_LT_PACKET_BYTES);
+        trans.set_streaming_width(NODE_LT_PACKET_BYTES);
+        trans.set_byte_enable_ptr(NULL);
+        trans.set_dmi_allowed(false);
+        trans.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+
+        sc_time delay = qk.get_local_time();
+        out_socket->b_transport(trans, delay);
+        if (trans.is_response_error())
+            SC_REPORT_ERROR(name(), trans.get_response_string().c_str());
+        qk.set(delay);
+        sent++;
+    }
+};
+
+#endif // __SYNTHESIS__
+
+#endif // __NODE_LT__H
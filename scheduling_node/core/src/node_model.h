@@ -0,0 +1,118 @@
+/*
+	@brief
+	Untimed model of SchedulingNode for policy studies: ingest, rank,
+	queue and dequeue with no clock. A packet is written to the metadata
+	words of the DMEM (rank_meta_words, the layout of
+	SchedulingNode::dmemory_th), the rank program runs functionally to its
+	end loop, and the rank read at rank_layout_t::out goes with the packet into
+	the queue primitive, a pifo_queue (pifo.h). The DMEM state of the
+	program carries over between packets, as on the node.
+
+	M is the packet type: packet_metadata_t in SystemC code (rank_meta_words
+	is in packet.h) or rank_packet_t in native code. RANKER runs the rank
+	program once on a word-addressed DMEM:
+
+		uint32_t * dmem();
+		unsigned dmem_words();
+		bool run();
+
+	iss_ranker interprets the program with the ISS; tools/node_untimed also
+	runs programs translated by rank_aot.
+
+*/
+
+#ifndef __NODE_MODEL__H
+#define __NODE_MODEL__H
+
+#include "iss.h"
+#include "pifo.h"
+#include "rank_abi.h"
+
+// Rank programs on the instruction-accurate ISS.
+class iss_ranker {
+    public:
+    static const uint64_t MAX_INSNS_PER_PACKET = 1000000;
+
+    iss & cpu() {
+        return core;
+    }
+
+    uint32_t * dmem() {
+        return core.data().data();
+    }
+
+    unsigned dmem_words() {
+        return core.data().size();
+    }
+
+    bool run() {
+        core.reset();
+        return core.run(MAX_INSNS_PER_PACKET) == iss::ISS_END;
+    }
+
+    private:
+    iss core;
+};
+
+template < class M, class RANKER > class node_model {
+    public:
+    node_model(RANKER & r): ranker(r), ranked(0) {}
+
+    // DMEM layout of the program (rank_layout_t::from_symbols), the
+    // defaults until set.
+    void set_layout(const rank_layout_t & l) {
+        layout = l;
+    }
+
+    // Ranks a packet and enqueues it; false if the rank program did not
+    // reach its end.
+    bool enqueue(const M & pkt, uint32_t * rank = NULL) {
+        uint32_t r;
+        if (!compute_rank(pkt, r))
+            return false;
+        enqueue_ranked(pkt, r);
+        if (rank)
+            * rank = r;
+        return true;
+    }
+
+    // The two halves of enqueue(), for models that delay a packet between
+    // its rank computation and its insertion in the queue.
+    bool compute_rank(const M & pkt, uint32_t & rank) {
+        uint32_t * dmem = ranker.dmem();
+        uint32_t w[RANK_META_WORDS];
+        rank_meta_words(pkt, w);
+        for (int i = 0; i < RANK_META_WORDS; i++)
+            dmem[(layout.meta >> 2) + i] = w[i];
+        if (!ranker.run())
+            return false;
+        rank = dmem[layout.out >> 2];
+        ranked++;
+        return true;
+    }
+
+    void enqueue_ranked(const M & pkt, uint32_t rank) {
+        queue.enqueue(pkt, rank);
+    }
+
+    // Head of the queue, see pifo_queue::dequeue.
+    bool dequeue(M & pkt, uint32_t * rank = NULL, uint64_t * enq_seq = NULL) {
+        return queue.dequeue(pkt, rank, enq_seq);
+    }
+
+    size_t backlog() const {
+        return queue.size();
+    }
+
+    unsigned long long packets() const {
+        return ranked;
+    }
+
+    private:
+    RANKER & ranker;
+    rank_layout_t layout;
+    pifo_queue < M > queue;
+    unsigned long long ranked;
+};
+
+#endif // __NODE_MODEL__H
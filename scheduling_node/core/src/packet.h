@@ -4,6 +4,8 @@
 #include <ac_int.h>
 #include <mc_connections.h>
 
+#include "rank_abi.h"
+
 // Metadata structure for packets descriptors in the traffic manager.
 // Total size is 155 bits
 struct packet_metadata_t {
@@ -75,6 +77,118 @@ inline std::ostream& operator<<(std::ostream& os,
   return os;
 }
 
+// Metadata words at RANK_META_ADDR, as written by SchedulingNode::dmemory_th.
+inline void rank_meta_words(const packet_metadata_t& pkt,
+                            uint32_t w[RANK_META_WORDS]) {
+  rank_packet_t p;
+  p.src = pkt.src.to_uint();
+  p.dst = pkt.dst.to_uint();
+  p.length = pkt.length.to_uint();
+  p.tos = pkt.tos.to_uint();
+  p.priority = pkt.priority.to_uint();
+  p.flow_id = pkt.flow_id.to_uint();
+  p.arrival_time = pkt.arrival_time.to_uint();
+  p.payload_ptr = pkt.payload_ptr.to_uint();
+  rank_meta_words(p, w);
+}
+
+// Inverse of the above, for drivers that read rank_packet_t streams
+// (packet_source.h).
+inline packet_metadata_t packet_metadata_from(const rank_packet_t& p) {
+  packet_metadata_t pkt;
+  pkt.src = p.src;
+  pkt.dst = p.dst;
+  pkt.length = p.length;
+  pkt.tos = p.tos;
+  pkt.priority = p.priority;
+  pkt.flow_id = p.flow_id;
+  pkt.arrival_time = p.arrival_time;
+  pkt.payload_ptr = p.payload_ptr;
+  return pkt;
+}
+
+// Queue primitive interface of the node: enqueue of a ranked packet,
+// dequeue request and the dequeued packet.
+struct packet_enqueue_t {
+  packet_metadata_t metadata;
+  sc_uint<32> rank;
+
+  static const unsigned int width = packet_metadata_t::width + 32;
+
+  template <unsigned int Size>
+  void Marshall(Marshaller<Size>& m) {
+    m & metadata;
+    m & rank;
+  }
+
+  bool operator==(const packet_enqueue_t& rhs) const {
+    return metadata == rhs.metadata && rank == rhs.rank;
+  }
+};
+
+struct packet_dequeue_req_t {
+  sc_uint<32> rank;  // Rank bound, interpreted by the primitive
+
+  static const unsigned int width = 32;
+
+  template <unsigned int Size>
+  void Marshall(Marshaller<Size>& m) {
+    m & rank;
+  }
+
+  bool operator==(const packet_dequeue_req_t& rhs) const {
+    return rank == rhs.rank;
+  }
+};
+
+struct packet_dequeue_resp_t {
+  packet_metadata_t metadata;
+
+  static const unsigned int width = packet_metadata_t::width;
+
+  template <unsigned int Size>
+  void Marshall(Marshaller<Size>& m) {
+    m & metadata;
+  }
+
+  bool operator==(const packet_dequeue_resp_t& rhs) const {
+    return metadata == rhs.metadata;
+  }
+};
+
+inline void sc_trace(sc_trace_file* tf, const packet_enqueue_t& enq,
+                     const std::string& name) {
+  sc_trace(tf, enq.metadata, name + ".metadata");
+  sc_trace(tf, enq.rank, name + ".rank");
+}
+
+inline void sc_trace(sc_trace_file* tf, const packet_dequeue_req_t& req,
+                     const std::string& name) {
+  sc_trace(tf, req.rank, name + ".rank");
+}
+
+inline void sc_trace(sc_trace_file* tf, const packet_dequeue_resp_t& resp,
+                     const std::string& name) {
+  sc_trace(tf, resp.metadata, name + ".metadata");
+}
+
+inline std::ostream& operator<<(std::ostream& os, const packet_enqueue_t& enq) {
+  os << "(metadata=" << enq.metadata << ", rank=" << enq.rank << ")";
+  return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os,
+                                const packet_dequeue_req_t& req) {
+  os << "(rank=" << req.rank << ")";
+  return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os,
+                                const packet_dequeue_resp_t& resp) {
+  os << "(metadata=" << resp.metadata << ")";
+  return os;
+}
+
 // IMEM runtime data
 struct imem_write_req_t {
   sc_uint<XLEN> addr;  // Word-aligned address
@@ -109,4 +223,314 @@ inline std::ostream& operator<<(std::ostream& os, const imem_write_req_t& req) {
   return os;
 }
 
+// Resident rank programs of SchedulingNode: a packet's class (flow_id,
+// tos or priority, see PROGRAM_SEL_*) selects a program, whose entry PC
+// the core starts from.
+#define PROGRAM_CFG_ENTRY 0   // entry_table[index] = value, active IMEM bank
+#define PROGRAM_CFG_CLASS 1   // class_table[index] = value (program)
+#define PROGRAM_CFG_SELECT 2  // program_select = value (PROGRAM_SEL_*)
+#define PROGRAM_CFG_SHADOW_ENTRY 3  // entry_table of the shadow IMEM bank,
+                                    // live from the next bank switch
+
+#define PROGRAM_SEL_FLOW 0      // class = flow_id[3:0]
+#define PROGRAM_SEL_TOS 1       // class = tos[7:4]
+#define PROGRAM_SEL_PRIORITY 2  // class = priority
+
+struct program_cfg_t {
+  sc_uint<2> kind;  // PROGRAM_CFG_*
+  sc_uint<4> index;
+  sc_uint<XLEN> value;
+
+  static const unsigned int width = 2 + 4 + XLEN;
+
+  program_cfg_t() : kind(0), index(0), value(0) {}
+
+  template <unsigned int Size>
+  void Marshall(Marshaller<Size>& m) {
+    m & kind;
+    m & index;
+    m & value;
+  }
+
+  bool operator==(const program_cfg_t& rhs) const {
+    return kind == rhs.kind && index == rhs.index && value == rhs.value;
+  }
+};
+
+inline void sc_trace(sc_trace_file* tf, const program_cfg_t& cfg,
+                     const std::string& name) {
+  sc_trace(tf, cfg.kind, name + ".kind");
+  sc_trace(tf, cfg.index, name + ".index");
+  sc_trace(tf, cfg.value, name + ".value");
+}
+
+inline std::ostream& operator<<(std::ostream& os, const program_cfg_t& cfg) {
+  os << "(kind=" << cfg.kind << ", index=" << cfg.index << ", value=0x"
+     << std::hex << cfg.value << std::dec << ")";
+  return os;
+}
+
+// Switch of the active IMEM bank (SchedulingNode::node_th), applied
+// between packets and acknowledged with the cycles it waited for.
+struct imem_swap_req_t {
+  sc_uint<1> bank;  // Bank to run from
+
+  static const unsigned int width = 1;
+
+  imem_swap_req_t() : bank(0) {}
+
+  template <unsigned int Size>
+  void Marshall(Marshaller<Size>& m) {
+    m & bank;
+  }
+
+  bool operator==(const imem_swap_req_t& rhs) const { return bank == rhs.bank; }
+};
+
+struct imem_swap_done_t {
+  sc_uint<1> bank;
+  sc_uint<XLEN> cycles;  // From the request to the switch
+
+  static const unsigned int width = 1 + XLEN;
+
+  imem_swap_done_t() : bank(0), cycles(0) {}
+
+  template <unsigned int Size>
+  void Marshall(Marshaller<Size>& m) {
+    m & bank;
+    m & cycles;
+  }
+
+  bool operator==(const imem_swap_done_t& rhs) const {
+    return bank == rhs.bank && cycles == rhs.cycles;
+  }
+};
+
+inline void sc_trace(sc_trace_file* tf, const imem_swap_req_t& req,
+                     const std::string& name) {
+  sc_trace(tf, req.bank, name + ".bank");
+}
+
+inline void sc_trace(sc_trace_file* tf, const imem_swap_done_t& done,
+                     const std::string& name) {
+  sc_trace(tf, done.bank, name + ".bank");
+  sc_trace(tf, done.cycles, name + ".cycles");
+}
+
+inline std::ostream& operator<<(std::ostream& os, const imem_swap_req_t& req) {
+  os << "(bank=" << req.bank << ")";
+  return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os,
+                                const imem_swap_done_t& done) {
+  os << "(bank=" << done.bank << ", cycles=" << done.cycles << ")";
+  return os;
+}
+
+// Control-plane access to a DMEM table entry (SchedulingNode::dmemory_th),
+// e.g. WEIGHT_TABLE[flow_id]. Reads are answered with a table_resp_t,
+// writes are not.
+struct table_req_t {
+  sc_uint<1> write;    // 1: write data, 0: read
+  sc_uint<XLEN> addr;  // Word-aligned byte address in DMEM
+  sc_uint<XLEN> data;
+
+  static const unsigned int width = 1 + XLEN + XLEN;
+
+  table_req_t() : write(0), addr(0), data(0) {}
+
+  template <unsigned int Size>
+  void Marshall(Marshaller<Size>& m) {
+    m & write;
+    m & addr;
+    m & data;
+  }
+
+  bool operator==(const table_req_t& rhs) const {
+    return write == rhs.write && addr == rhs.addr && data == rhs.data;
+  }
+};
+
+struct table_resp_t {
+  sc_uint<XLEN> data;
+
+  static const unsigned int width = XLEN;
+
+  table_resp_t() : data(0) {}
+
+  template <unsigned int Size>
+  void Marshall(Marshaller<Size>& m) {
+    m & data;
+  }
+
+  bool operator==(const table_resp_t& rhs) const { return data == rhs.data; }
+};
+
+inline void sc_trace(sc_trace_file* tf, const table_req_t& req,
+                     const std::string& name) {
+  sc_trace(tf, req.write, name + ".write");
+  sc_trace(tf, req.addr, name + ".addr");
+  sc_trace(tf, req.data, name + ".data");
+}
+
+inline void sc_trace(sc_trace_file* tf, const table_resp_t& resp,
+                     const std::string& name) {
+  sc_trace(tf, resp.data, name + ".data");
+}
+
+inline std::ostream& operator<<(std::ostream& os, const table_req_t& req) {
+  os << "(" << (req.write ? "write" : "read") << ", addr=0x" << std::hex
+     << req.addr << ", data=0x" << req.data << std::dec << ")";
+  return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const table_resp_t& resp) {
+  os << "(data=0x" << std::hex << resp.data << std::dec << ")";
+  return os;
+}
+
+// Burst DMA load of IMEM or DMEM (SchedulingNode::dma_th): a request, then
+// ceil(length / DMA_BEAT_WORDS) beats on the data port, then one done
+// message with the reconfiguration latency.
+#define DMA_BEAT_WORDS 4  // 128-bit beats
+#define DMA_TARGET_IMEM 0
+#define DMA_TARGET_DMEM 1
+
+struct dma_load_req_t {
+  sc_uint<1> target;    // DMA_TARGET_IMEM or DMA_TARGET_DMEM
+  sc_uint<XLEN> base;   // Word-aligned byte address
+  sc_uint<XLEN> length; // Words
+
+  static const unsigned int width = 1 + XLEN + XLEN;
+
+  dma_load_req_t() : target(0), base(0), length(0) {}
+
+  template <unsigned int Size>
+  void Marshall(Marshaller<Size>& m) {
+    m & target;
+    m & base;
+    m & length;
+  }
+
+  bool operator==(const dma_load_req_t& rhs) const {
+    return target == rhs.target && base == rhs.base && length == rhs.length;
+  }
+};
+
+// One beat of the stream, words in address order. The last beat of a burst
+// may be partial; its extra words are ignored.
+struct dma_beat_t {
+  sc_uint<XLEN> data[DMA_BEAT_WORDS];
+
+  static const unsigned int width = XLEN * DMA_BEAT_WORDS;
+
+  dma_beat_t() {
+    for (unsigned i = 0; i < DMA_BEAT_WORDS; i++) data[i] = 0;
+  }
+
+  template <unsigned int Size>
+  void Marshall(Marshaller<Size>& m) {
+    for (unsigned i = 0; i < DMA_BEAT_WORDS; i++) m & data[i];
+  }
+
+  bool operator==(const dma_beat_t& rhs) const {
+    for (unsigned i = 0; i < DMA_BEAT_WORDS; i++)
+      if (data[i] != rhs.data[i]) return false;
+    return true;
+  }
+};
+
+struct dma_done_t {
+  sc_uint<XLEN> words;   // Words written
+  sc_uint<XLEN> cycles;  // From the request to the hand-over of the last beat
+
+  static const unsigned int width = XLEN + XLEN;
+
+  dma_done_t() : words(0), cycles(0) {}
+
+  template <unsigned int Size>
+  void Marshall(Marshaller<Size>& m) {
+    m & words;
+    m & cycles;
+  }
+
+  bool operator==(const dma_done_t& rhs) const {
+    return words == rhs.words && cycles == rhs.cycles;
+  }
+};
+
+// A beat on its way from dma_th to the memory thread of its target.
+struct dma_write_t {
+  sc_uint<XLEN> addr;   // Word index of data[0]
+  sc_uint<3> words;     // Valid words, 1..DMA_BEAT_WORDS
+  dma_beat_t beat;
+
+  static const unsigned int width = XLEN + 3 + dma_beat_t::width;
+
+  dma_write_t() : addr(0), words(0) {}
+
+  template <unsigned int Size>
+  void Marshall(Marshaller<Size>& m) {
+    m & addr;
+    m & words;
+    m & beat;
+  }
+
+  bool operator==(const dma_write_t& rhs) const {
+    return addr == rhs.addr && words == rhs.words && beat == rhs.beat;
+  }
+};
+
+inline void sc_trace(sc_trace_file* tf, const dma_load_req_t& req,
+                     const std::string& name) {
+  sc_trace(tf, req.target, name + ".target");
+  sc_trace(tf, req.base, name + ".base");
+  sc_trace(tf, req.length, name + ".length");
+}
+
+inline void sc_trace(sc_trace_file* tf, const dma_beat_t& beat,
+                     const std::string& name) {
+  for (unsigned i = 0; i < DMA_BEAT_WORDS; i++)
+    sc_trace(tf, beat.data[i], name + ".data_" + std::to_string(i));
+}
+
+inline void sc_trace(sc_trace_file* tf, const dma_done_t& done,
+                     const std::string& name) {
+  sc_trace(tf, done.words, name + ".words");
+  sc_trace(tf, done.cycles, name + ".cycles");
+}
+
+inline void sc_trace(sc_trace_file* tf, const dma_write_t& w,
+                     const std::string& name) {
+  sc_trace(tf, w.addr, name + ".addr");
+  sc_trace(tf, w.words, name + ".words");
+  sc_trace(tf, w.beat, name + ".beat");
+}
+
+inline std::ostream& operator<<(std::ostream& os, const dma_load_req_t& req) {
+  os << "(" << (req.target == DMA_TARGET_IMEM ? "imem" : "dmem") << ", base=0x"
+     << std::hex << req.base << std::dec << ", length=" << req.length << ")";
+  return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const dma_beat_t& beat) {
+  os << "(" << std::hex;
+  for (unsigned i = 0; i < DMA_BEAT_WORDS; i++)
+    os << (i ? " 0x" : "0x") << beat.data[i];
+  os << std::dec << ")";
+  return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const dma_done_t& done) {
+  os << "(words=" << done.words << ", cycles=" << done.cycles << ")";
+  return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const dma_write_t& w) {
+  os << "(addr=" << w.addr << ", words=" << w.words << ", beat=" << w.beat
+     << ")";
+  return os;
+}
+
 #endif  // PACKET_H_
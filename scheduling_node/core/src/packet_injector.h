@@ -0,0 +1,151 @@
+/*
+	@brief
+	Traffic source for SchedulingNode::in_pkt (simulation only): pushes the
+	packets of a packet_source (text file, CSV or pcap trace, seeded
+	workload, synthetic stream) as packet_metadata_t, each on its arrival
+	cycle counted from the end of reset, or one every set_rate() cycles.
+	The source is read one packet ahead, so a trace of any size is
+	streamed.
+
+	With a workload (open_generator()), the weights of its flows are first
+	written to WEIGHT_TABLE and QUANTUM_TABLE through table_out, bound to
+	SchedulingNode::table_req_port; arrivals count from the last write.
+
+	A packet that in_pkt cannot take on its arrival cycle is pushed as soon
+	as it can; print_stats() reports how many were delayed and by how much
+	in total.
+
+*/
+
+#ifndef __PACKET_INJECTOR__H
+#define __PACKET_INJECTOR__H
+
+#ifndef __SYNTHESIS__
+
+#include <ostream>
+#include <string>
+
+#include <systemc.h>
+#include <mc_connections.h>
+
+#include "packet.h"
+#include "packet_source.h"
+
+SC_MODULE(packet_injector) {
+    public:
+    sc_in < bool > CCS_INIT_S1(clk);
+    sc_in < bool > CCS_INIT_S1(rst);
+    Connections::Out < packet_metadata_t > CCS_INIT_S1(out);
+    Connections::Out < table_req_t > CCS_INIT_S1(table_out);
+
+    // High once the last packet has been pushed.
+    sc_signal < bool > CCS_INIT_S1(done);
+
+    SC_CTOR(packet_injector): clk("clk"),
+    rst("rst"),
+    out("out"),
+    table_out("table_out"),
+    done("done"),
+    have_workload(false),
+    weight_table(0),
+    quantum_table(0),
+    injected(0),
+    delayed(0),
+    delay_cycles(0) {
+        SC_THREAD(inject_th);
+        sensitive << clk.pos();
+        async_reset_signal_is(rst, false);
+    }
+
+    // Before the simulation starts. ns is the clock period, for the
+    // timestamps of traces.
+    bool open(const std::string & path, double ns) {
+        source.set_cycle_ns(ns);
+        return source.open(path);
+    }
+
+    // cfg is checked by traffic_config::parse. The weights go to the
+    // WEIGHT_TABLE and QUANTUM_TABLE of layout, that of the node's rank
+    // program.
+    void open_generator(const traffic_config & cfg, const rank_layout_t & layout) {
+        workload = cfg;
+        have_workload = true;
+        weight_table = layout.weight;
+        quantum_table = layout.quantum;
+        source.open_generator(cfg);
+    }
+
+    void open_synthetic(unsigned long long count, unsigned flows) {
+        source.open_synthetic(count, flows);
+    }
+
+    void set_rate(unsigned long long interval) {
+        source.set_rate(interval);
+    }
+
+    void print_stats(std::ostream & os) const {
+        os << "[" << name() << "] " << injected << " packets injected, " << delayed << " delayed by "
+           << delay_cycles << " cycles in total";
+        if (source.failed())
+            os << " (stopped on a bad record)";
+        os << std::endl;
+    }
+
+    private:
+    packet_source source;
+    traffic_config workload;
+    bool have_workload;
+    unsigned weight_table;
+    unsigned quantum_table;
+    unsigned long long injected;
+    unsigned long long delayed;
+    unsigned long long delay_cycles;
+
+    void inject_th() {
+        out.Reset();
+        table_out.Reset();
+        done.write(false);
+        wait();
+
+        if (have_workload) {
+            for (unsigned f = 0; f < RANK_MAX_FLOWS; f++) {
+                table_req_t req;
+                req.write = 1;
+                req.addr = weight_table + 4 * f;
+                req.data = workload.weight(f);
+                table_out.Push(req);
+                req.addr = quantum_table + 4 * f;
+                table_out.Push(req);
+            }
+        }
+
+        unsigned long long cycle = 0;
+        rank_packet_t p;
+        unsigned long long arrival;
+        while (source.next(p, & arrival)) {
+            while (cycle < arrival) {
+                wait();
+                cycle++;
+            }
+            packet_metadata_t pkt = packet_metadata_from(p);
+            while (!out.PushNB(pkt)) {
+                wait();
+                cycle++;
+            }
+            if (cycle > arrival) {
+                delayed++;
+                delay_cycles += cycle - arrival;
+            }
+            injected++;
+            wait();
+            cycle++;
+        }
+        done.write(true);
+        while (true)
+            wait();
+    }
+};
+
+#endif // __SYNTHESIS__
+
+#endif // __PACKET_INJECTOR__H
@@ -0,0 +1,314 @@
+/*
+	@brief
+	Per-packet egress log (simulation only): one record per departing
+	packet with its ingress, enqueue and dequeue cycles and its rank, for
+	comparing the latency of schedulers and configurations.
+
+		sojourn   = dequeue - ingress   time in the node
+		queueing  = dequeue - enqueue   time in the queue primitive
+
+	The simulation thread only copies the record into the record_ring of
+	trace_ring.h; its drain thread formats and writes it. Unlike trace
+	events, records are never dropped, and the simulation never waits for
+	the writer either: a record that finds the ring full goes to an
+	overflow queue of the producer, moved into the ring by the next writes
+	and by close(). Those records are counted.
+
+	A path ending in ".csv" gets a CSV file with a header line,
+
+		seq,flow_id,length,priority,tos,payload_ptr,rank,ingress,enqueue,dequeue,sojourn,queueing
+
+	anything else the binary format: a packet_log_hdr_t, then
+	packet_log_rec_t records in host byte order.
+
+	packet_log_reader streams a log of either format back, for
+	tools/pkt_analyze. This header has no SystemC dependency so that the
+	native tools can use it.
+
+*/
+
+#ifndef __PACKET_LOG__H
+#define __PACKET_LOG__H
+
+#ifndef __SYNTHESIS__
+
+#include <stdint.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+
+#include "trace_ring.h"
+
+struct packet_log_rec_t {
+    uint64_t seq;     // ingress index
+    uint64_t ingress; // cycle the packet entered the node
+    uint64_t enqueue; // cycle its rank entered the queue
+    uint64_t dequeue; // cycle it left the node
+    uint32_t rank;
+    uint32_t payload_ptr;
+    uint16_t flow_id;
+    uint16_t length;
+    uint8_t priority;
+    uint8_t tos;
+    uint16_t pad;
+
+    packet_log_rec_t(): seq(0), ingress(0), enqueue(0), dequeue(0), rank(0), payload_ptr(0), flow_id(0), length(0),
+        priority(0), tos(0), pad(0) {}
+
+    uint64_t sojourn() const {
+        return dequeue - ingress;
+    }
+
+    uint64_t queueing() const {
+        return dequeue - enqueue;
+    }
+};
+
+struct packet_log_hdr_t {
+    char magic[8]; // "DRIMPKT1"
+    uint32_t version;
+    uint32_t rec_size;
+    uint64_t records;
+};
+
+class packet_log {
+    public:
+    packet_log(): written(0), deferred(0), overflow_max(0), csv(false), out(NULL) {}
+
+    ~packet_log() {
+        close();
+    }
+
+    // Opens the output file and starts the writer thread. capacity is
+    // rounded up to a power of two records.
+    bool open(const std::string & path, size_t capacity = 1 << 16) {
+        close();
+        out = fopen(path.c_str(), "wb");
+        if (!out)
+            return false;
+        written = 0;
+        deferred = 0;
+        overflow_max = 0;
+
+        csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+        if (csv) {
+            fputs("seq,flow_id,length,priority,tos,payload_ptr,rank,ingress,enqueue,dequeue,sojourn,queueing\n", out);
+        } else {
+            memset(& hdr, 0, sizeof(hdr));
+            memcpy(hdr.magic, "DRIMPKT1", 8);
+            hdr.version = 1;
+            hdr.rec_size = sizeof(packet_log_rec_t);
+            fwrite(& hdr, sizeof(hdr), 1, out);
+        }
+
+        FILE * f = out;
+        if (csv)
+            ring.open(capacity, [f](const packet_log_rec_t * r, size_t n) {
+                for (size_t i = 0; i < n; i++)
+                    put_csv(f, r[i]);
+            });
+        else
+            ring.open(capacity, [f](const packet_log_rec_t * r, size_t n) { fwrite(r, sizeof(packet_log_rec_t), n, f); });
+        return true;
+    }
+
+    bool is_open() const {
+        return out != NULL;
+    }
+
+    // Writes the remaining records and finalizes the header. Only here does
+    // the producer wait, for the ring to take the overflow queue.
+    void close() {
+        if (!out)
+            return;
+        while (!flush_overflow())
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        ring.close();
+        if (!csv) {
+            hdr.records = written;
+            fseek(out, 0, SEEK_SET);
+            fwrite(& hdr, sizeof(hdr), 1, out);
+        }
+        fclose(out);
+        out = NULL;
+    }
+
+    // Producer side: never blocks. The record is queued behind the
+    // overflow, if any, so the log keeps the write order.
+    void write(const packet_log_rec_t & r) {
+        written++;
+        if (flush_overflow() && ring.push(r))
+            return;
+        deferred++;
+        overflow.push_back(r);
+        if (overflow.size() > overflow_max)
+            overflow_max = overflow.size();
+    }
+
+    unsigned long long records() const {
+        return written;
+    }
+
+    // Records that found the ring full (the writer fell behind) and went
+    // through the overflow queue, and the most it held at once.
+    unsigned long long deferred_records() const {
+        return deferred;
+    }
+
+    size_t max_overflow() const {
+        return overflow_max;
+    }
+
+    private:
+    record_ring < packet_log_rec_t > ring;
+    std::deque < packet_log_rec_t > overflow;
+    unsigned long long written;
+    unsigned long long deferred;
+    size_t overflow_max;
+    bool csv;
+    FILE * out;
+    packet_log_hdr_t hdr;
+
+    // Moves the overflow queue into the ring while it has room; true once
+    // the queue is empty.
+    bool flush_overflow() {
+        while (!overflow.empty() && ring.push(overflow.front()))
+            overflow.pop_front();
+        return overflow.empty();
+    }
+
+    // One CSV line, formatted by hand: fprintf made the writer thread
+    // fall far behind the untimed model.
+    static void put_csv(FILE * f, const packet_log_rec_t & r) {
+        char line[12 * 21];
+        char * p = line;
+        const unsigned long long v[12] = { r.seq, r.flow_id, r.length, r.priority, r.tos, r.payload_ptr, r.rank,
+            r.ingress, r.enqueue, r.dequeue, r.sojourn(), r.queueing() };
+        for (int i = 0; i < 12; i++) {
+            char d[20];
+            int k = 20;
+            unsigned long long x = v[i];
+            do {
+                d[--k] = '0' + x % 10;
+                x /= 10;
+            } while (x);
+            memcpy(p, d + k, 20 - k);
+            p += 20 - k;
+            * p++ = i < 11 ? ',' : '\n';
+        }
+        fwrite(line, 1, p - line, f);
+    }
+};
+
+// Sequential reader of a log written by packet_log.
+class packet_log_reader {
+    public:
+    packet_log_reader(): in(NULL), csv(false), line_no(0) {}
+
+    ~packet_log_reader() {
+        close();
+    }
+
+    bool open(const std::string & path) {
+        close();
+        err.clear();
+        file_path = path;
+        in = fopen(path.c_str(), "rb");
+        if (!in)
+            return fail("cannot open " + path);
+        setvbuf(in, NULL, _IOFBF, 1 << 20);
+
+        packet_log_hdr_t hdr;
+        if (fread(& hdr, sizeof(hdr), 1, in) == 1 && memcmp(hdr.magic, "DRIMPKT1", 8) == 0) {
+            if (hdr.rec_size != sizeof(packet_log_rec_t))
+                return fail(path + ": unsupported record size");
+            csv = false;
+            return true;
+        }
+        // CSV: skip the header line.
+        rewind(in);
+        csv = true;
+        line_no = 0;
+        char line[LINE_MAX_CHARS];
+        if (fgets(line, sizeof(line), in) && strncmp(line, "seq,", 4) == 0) {
+            line_no = 1;
+            return true;
+        }
+        return fail(path + ": not a packet log");
+    }
+
+    void close() {
+        if (in)
+            fclose(in);
+        in = NULL;
+    }
+
+    // Next record; false at the end of the log or on a bad record (error()).
+    bool next(packet_log_rec_t & r) {
+        if (!in)
+            return false;
+        if (!csv)
+            return fread(& r, sizeof(r), 1, in) == 1;
+
+        char line[LINE_MAX_CHARS];
+        if (!fgets(line, sizeof(line), in))
+            return false;
+        line_no++;
+        unsigned long long v[10];
+        char * p = line;
+        for (int i = 0; i < 10; i++) {
+            char * end;
+            v[i] = strtoull(p, & end, 10);
+            if (end == p || (* end != ',' && i < 9))
+                return bad_line();
+            p = end + 1;
+        }
+        r = packet_log_rec_t();
+        r.seq = v[0];
+        r.flow_id = v[1];
+        r.length = v[2];
+        r.priority = v[3];
+        r.tos = v[4];
+        r.payload_ptr = v[5];
+        r.rank = v[6];
+        r.ingress = v[7];
+        r.enqueue = v[8];
+        r.dequeue = v[9];
+        return true;
+    }
+
+    const std::string & error() const {
+        return err;
+    }
+
+    private:
+    static const int LINE_MAX_CHARS = 256;
+
+    FILE * in;
+    bool csv;
+    unsigned long long line_no;
+    std::string file_path;
+    std::string err;
+
+    bool fail(const std::string & msg) {
+        err = msg;
+        close();
+        return false;
+    }
+
+    bool bad_line() {
+        char msg[32];
+        snprintf(msg, sizeof(msg), ":%llu: bad record", line_no);
+        err = file_path + msg;
+        return false;
+    }
+};
+
+#endif // __SYNTHESIS__
+
+#endif // __PACKET_LOG__H
@@ -0,0 +1,167 @@
+/*
+	@brief
+	Egress sink for SchedulingNode::out_pkt (simulation only). Takes every
+	departing packet on the cycle it is offered, so it never backpressures
+	the node, and writes its packet_log record (packet_log.h).
+
+	The ingress and enqueue cycles and the rank come from the node: with
+	SchedulingNode::set_egress_log(&sink), node_th reports each packet it
+	takes from in_pkt (ingress()) and each rank it hands to the queue
+	primitive (enqueue()). The node ranks one packet at a time, so an
+	enqueue belongs to the oldest packet not yet ranked. A departure is
+	matched to its packet by payload_ptr. Departures that match nothing
+	(no node reports) are logged with ingress = enqueue = dequeue and
+	counted as unmatched.
+
+	Cycles count from the end of reset, as in packet_injector.
+
+*/
+
+#ifndef __PACKET_SINK__H
+#define __PACKET_SINK__H
+
+#ifndef __SYNTHESIS__
+
+#include <deque>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include <systemc.h>
+#include <mc_connections.h>
+
+#include "packet.h"
+#include "packet_log.h"
+
+SC_MODULE(packet_sink) {
+    public:
+    sc_in < bool > CCS_INIT_S1(clk);
+    sc_in < bool > CCS_INIT_S1(rst);
+    Connections::In < packet_metadata_t > CCS_INIT_S1(in);
+
+    SC_CTOR(packet_sink): clk("clk"),
+    rst("rst"),
+    in("in"),
+    cycle(0),
+    ingressed(0),
+    departed(0),
+    unmatched(0),
+    sojourn_total(0),
+    sojourn_max(0) {
+        SC_THREAD(sink_th);
+        sensitive << clk.pos();
+        async_reset_signal_is(rst, false);
+    }
+
+    ~packet_sink() {
+        log.close();
+    }
+
+    // Before the simulation starts; ".csv" or binary (packet_log.h).
+    bool open(const std::string & path) {
+        return log.open(path);
+    }
+
+    // Writes the rest of the log, after the simulation.
+    void close() {
+        log.close();
+    }
+
+    unsigned long long departures() const {
+        return departed;
+    }
+
+    // Departures without an ingress and enqueue report from the node.
+    unsigned long long unmatched_departures() const {
+        return unmatched;
+    }
+
+    // Called by the node when it takes pkt from in_pkt.
+    void ingress(const packet_metadata_t & pkt) {
+        packet_log_rec_t r;
+        r.seq = ingressed++;
+        r.ingress = cycle;
+        r.flow_id = pkt.flow_id.to_uint();
+        r.length = pkt.length.to_uint();
+        r.priority = pkt.priority.to_uint();
+        r.tos = pkt.tos.to_uint();
+        r.payload_ptr = pkt.payload_ptr.to_uint();
+        unranked.push_back(r);
+    }
+
+    // Called by the node when the rank of its oldest unranked packet goes
+    // to the queue primitive.
+    void enqueue(uint32_t rank) {
+        if (unranked.empty())
+            return;
+        packet_log_rec_t r = unranked.front();
+        unranked.pop_front();
+        r.rank = rank;
+        r.enqueue = cycle;
+        queued[r.payload_ptr] = r;
+    }
+
+    void print_stats(std::ostream & os) const {
+        os << "[" << name() << "] " << departed << " packets departed";
+        if (departed)
+            os << ", sojourn " << (double) sojourn_total / departed << " cycles average, " << sojourn_max << " max";
+        if (unmatched)
+            os << ", " << unmatched << " unmatched";
+        if (log.deferred_records())
+            os << ", " << log.deferred_records() << " log records deferred (at most " << log.max_overflow()
+               << " queued)";
+        os << std::endl;
+    }
+
+    private:
+    packet_log log;
+    unsigned long long cycle;
+    unsigned long long ingressed;
+    unsigned long long departed;
+    unsigned long long unmatched;
+    unsigned long long sojourn_total;
+    unsigned long long sojourn_max;
+    std::deque < packet_log_rec_t > unranked;
+    std::unordered_map < uint32_t, packet_log_rec_t > queued; // by payload_ptr
+
+    void sink_th() {
+        in.Reset();
+        cycle = 0;
+        wait();
+
+        while (true) {
+            packet_metadata_t pkt;
+            if (in.PopNB(pkt)) {
+                packet_log_rec_t r;
+                std::unordered_map < uint32_t, packet_log_rec_t >::iterator it =
+                    queued.find(pkt.payload_ptr.to_uint());
+                if (it != queued.end()) {
+                    r = it->second;
+                    queued.erase(it);
+                } else {
+                    r.seq = ingressed;
+                    r.ingress = r.enqueue = cycle;
+                    r.flow_id = pkt.flow_id.to_uint();
+                    r.length = pkt.length.to_uint();
+                    r.priority = pkt.priority.to_uint();
+                    r.tos = pkt.tos.to_uint();
+                    r.payload_ptr = pkt.payload_ptr.to_uint();
+                    unmatched++;
+                }
+                r.dequeue = cycle;
+                departed++;
+                sojourn_total += r.sojourn();
+                if (r.sojourn() > sojourn_max)
+                    sojourn_max = r.sojourn();
+                if (log.is_open())
+                    log.write(r);
+            }
+            wait();
+            cycle++;
+        }
+    }
+};
+
+#endif // __SYNTHESIS__
+
+#endif // __PACKET_SINK__H
@@ -0,0 +1,173 @@
+/*
+	@brief
+	Packet streams for the testbench and the native rank tools: a text
+	file with one "flow_id length [priority [arrival]]" line per packet
+	('#' starts a comment), a CSV or pcap trace (packet_trace.h, streamed
+	from an mmap'ed file), a seeded synthetic workload (traffic_gen.h), or
+	a synthetic stream of n packets spread over the flows.
+	The arrival is also returned at full width, for drivers that schedule
+	packets on it (the 16-bit metadata field wraps). set_rate() replaces
+	the arrivals of a file, or spaces the synthetic stream, with one
+	packet every n cycles. payload_ptr is the index of the packet in the
+	stream (unless a trace has the column), so that it tells the packets
+	apart, as a buffer address would (packet_sink matches on it).
+
+*/
+
+#ifndef __PACKET_SOURCE__H
+#define __PACKET_SOURCE__H
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "packet_trace.h"
+#include "rank_abi.h"
+#include "traffic_gen.h"
+
+class packet_source {
+    public:
+    packet_source(): synthetic(0), flows(8), generated(0), bad(false), use_trace(false), use_gen(false),
+        cycle_ns(10.0), rate(0), read(0) {}
+
+    // Length of a cycle in ns, for the timestamps of traces; before open().
+    void set_cycle_ns(double ns) {
+        cycle_ns = ns;
+    }
+
+    // One packet every interval cycles instead of the file arrivals (0:
+    // use the arrivals).
+    void set_rate(unsigned long long interval) {
+        rate = interval;
+    }
+
+    bool open(const std::string & path) {
+        file_path = path;
+        use_trace = packet_trace::is_trace(path);
+        if (use_trace) {
+            if (trace.open(path, cycle_ns))
+                return true;
+            fprintf(stderr, "%s\n", trace.error().c_str());
+            use_trace = false;
+            return false;
+        }
+        in.open(path.c_str());
+        return in.is_open();
+    }
+
+    // Streams the workload of cfg (checked by traffic_config::parse), after
+    // any file.
+    void open_generator(const traffic_config & cfg) {
+        gen.open(cfg);
+        use_gen = true;
+    }
+
+    // Also the flows that pcap packets are hashed over.
+    void open_synthetic(unsigned long long count, unsigned num_flows) {
+        synthetic = count;
+        flows = num_flows ? num_flows : 1;
+    }
+
+    // Next packet; false at the end of the stream or on a malformed line
+    // (reported on stderr). The arrival is also stored in *when if given.
+    bool next(rank_packet_t & p, unsigned long long * when = NULL) {
+        p = rank_packet_t();
+        if (use_trace) {
+            unsigned long long arrival;
+            if (trace.next(p, arrival, flows)) {
+                if (rate) {
+                    arrival = read * rate;
+                    p.arrival_time = arrival;
+                }
+                read++;
+                if (when)
+                    *when = arrival;
+                return true;
+            }
+            if (!trace.error().empty()) {
+                fprintf(stderr, "%s\n", trace.error().c_str());
+                bad = true;
+                return false;
+            }
+            trace.close();
+            use_trace = false;
+        }
+        if (in.is_open()) {
+            std::string line;
+            while (std::getline(in, line)) {
+                if (line.empty() || line[0] == '#')
+                    continue;
+                std::istringstream fields(line);
+                unsigned flow_id, length, priority = 0;
+                unsigned long long arrival = 0;
+                if (!(fields >> flow_id >> length)) {
+                    fprintf(stderr, "%s: bad line: %s\n", file_path.c_str(), line.c_str());
+                    bad = true;
+                    return false;
+                }
+                fields >> priority >> arrival;
+                if (rate)
+                    arrival = read * rate;
+                p.flow_id = flow_id;
+                p.length = length;
+                p.priority = priority;
+                p.payload_ptr = read++;
+                p.arrival_time = arrival;
+                if (when)
+                    *when = arrival;
+                return true;
+            }
+            in.close();
+        }
+        if (use_gen) {
+            unsigned long long arrival;
+            if (gen.next(p, arrival)) {
+                if (rate) {
+                    arrival = read * rate;
+                    p.arrival_time = arrival;
+                }
+                read++;
+                if (when)
+                    *when = arrival;
+                return true;
+            }
+            use_gen = false;
+        }
+        if (generated < synthetic) {
+            p.flow_id = generated % flows;
+            p.length = 64 + (generated * 37) % 1437;
+            p.priority = generated & 0x7;
+            p.payload_ptr = generated;
+            unsigned long long arrival = rate ? generated * rate : generated;
+            p.arrival_time = arrival;
+            if (when)
+                *when = arrival;
+            generated++;
+            return true;
+        }
+        return false;
+    }
+
+    // True if the stream ended on a malformed line.
+    bool failed() const {
+        return bad;
+    }
+
+    private:
+    std::string file_path;
+    std::ifstream in;
+    unsigned long long synthetic;
+    unsigned flows;
+    unsigned long long generated;
+    bool bad;
+    packet_trace trace;
+    bool use_trace;
+    traffic_gen gen;
+    bool use_gen;
+    double cycle_ns;
+    unsigned long long rate;
+    unsigned long long read; // packets read from the file
+};
+
+#endif // __PACKET_SOURCE__H
@@ -0,0 +1,433 @@
+/*
+	@brief
+	Streaming reader of packet traces for packet_source: CSV logs (such as
+	the packet_log_in*.csv of the BMv2 prototype) and pcap captures. The
+	file is mmap'ed and read front to back; pages behind the cursor are
+	dropped every RELEASE_BYTES, so multi-GB traces run in constant memory.
+
+	CSV: one packet per line, '#' starts a comment. A first line that does
+	not start with a number is a header naming the columns (case-
+	insensitive, unknown columns are ignored):
+
+		src, dst, length|len|size, tos, priority|prio,
+		flow_id|flow|flowid, payload_ptr,
+		arrival_time|arrival|cycle   arrival in cycles
+		time|timestamp|ts            arrival in seconds
+
+	Without a header the columns are those of the text format:
+	flow_id,length,priority,arrival. Numbers are decimal or 0x hex; a
+	field may be quoted, as spreadsheets export it.
+
+	pcap: classic libpcap files (microsecond or nanosecond, either byte
+	order) with Ethernet, raw IP or Linux cooked (SLL) frames. Non-IPv4
+	frames are skipped. A packet gets its addresses and TOS, the IP
+	precedence as priority, the wire length (capped to 16 bits) and a
+	flow_id hashed from the 5-tuple over the flows of the stream.
+
+	Timestamps are converted to cycles of cycle_ns, relative to the first
+	packet. payload_ptr is the index of the packet in the trace unless the
+	CSV has that column. Native code, no SystemC dependency.
+
+*/
+
+#ifndef __PACKET_TRACE__H
+#define __PACKET_TRACE__H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "rank_abi.h"
+
+class packet_trace {
+    public:
+    packet_trace(): base(NULL), length(0), pos(0), released(0), fd(-1), pcap(false), count(0),
+        skipped(0), have_t0(false), t0(0), cycle_ns(10.0) {}
+
+    ~packet_trace() {
+        close();
+    }
+
+    // True for a pcap file (by its magic) or a .csv file.
+    static bool is_trace(const std::string & path) {
+        uint32_t magic = 0;
+        int f = ::open(path.c_str(), O_RDONLY);
+        if (f >= 0) {
+            bool ok = ::read(f, & magic, sizeof(magic)) == sizeof(magic);
+            ::close(f);
+            if (ok && pcap_magic(magic))
+                return true;
+        }
+        return path.size() > 4 && strcasecmp(path.c_str() + path.size() - 4, ".csv") == 0;
+    }
+
+    // ns is the length of a cycle, for the timestamps.
+    bool open(const std::string & path, double ns) {
+        close();
+        file_path = path;
+        cycle_ns = ns > 0 ? ns : 1.0;
+
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return fail("cannot open file");
+        struct stat st;
+        if (fstat(fd, & st) != 0)
+            return fail("cannot stat file");
+        length = st.st_size;
+        if (length) {
+            void * m = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m == MAP_FAILED)
+                return fail("mmap failed");
+            base = (const unsigned char *) m;
+            madvise(m, length, MADV_SEQUENTIAL);
+        }
+
+        uint32_t magic = 0;
+        if (length >= 4)
+            memcpy(& magic, base, 4);
+        pcap = pcap_magic(magic);
+        return pcap ? open_pcap() : open_csv();
+    }
+
+    void close() {
+        if (base)
+            munmap((void *) base, length);
+        if (fd >= 0)
+            ::close(fd);
+        base = NULL;
+        length = pos = released = 0;
+        fd = -1;
+        count = skipped = 0;
+        have_t0 = false;
+        columns.clear();
+    }
+
+    // Next packet and its arrival cycle; false at the end of the trace or
+    // on a malformed record (error() is then set). flows is the number of
+    // flows pcap flow_ids are hashed over.
+    bool next(rank_packet_t & p, unsigned long long & arrival, unsigned flows) {
+        if (!base)
+            return false;
+        bool ok = pcap ? next_pcap(p, arrival, flows ? flows : 1) : next_csv(p, arrival);
+        if (ok)
+            count++;
+        release();
+        return ok;
+    }
+
+    const std::string & error() const {
+        return err;
+    }
+
+    // Records skipped so far (non-IPv4 frames).
+    unsigned long long skipped_records() const {
+        return skipped;
+    }
+
+    private:
+    static const size_t RELEASE_BYTES = 16 << 20;
+
+    enum field_t {
+        F_IGNORE, F_SRC, F_DST, F_LENGTH, F_TOS, F_PRIORITY, F_FLOW, F_PAYLOAD, F_ARRIVAL, F_TIME
+    };
+
+    const unsigned char * base;
+    size_t length;
+    size_t pos;
+    size_t released;
+    int fd;
+    bool pcap;
+    std::string file_path;
+    std::string err;
+    unsigned long long count;
+    unsigned long long skipped;
+
+    // Timestamps
+    bool have_t0;
+    double t0;
+    double cycle_ns;
+
+    // CSV
+    std::vector < field_t > columns;
+    std::string field;
+
+    // pcap
+    bool swapped;
+    bool nsec;
+    uint32_t linktype;
+
+    static bool pcap_magic(uint32_t m) {
+        return m == 0xa1b2c3d4 || m == 0xd4c3b2a1 || m == 0xa1b23c4d || m == 0x4d3cb2a1;
+    }
+
+    bool fail(const char * msg) {
+        err = file_path + ": " + msg;
+        return false;
+    }
+
+    // Drops the mapped pages behind the cursor.
+    void release() {
+        if (pos - released < RELEASE_BYTES)
+            return;
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t end = pos / page * page;
+        madvise((void *)(base + released), end - released, MADV_DONTNEED);
+        released = end;
+    }
+
+    unsigned long long cycles(double seconds) {
+        if (!have_t0) {
+            t0 = seconds;
+            have_t0 = true;
+        }
+        double c = (seconds - t0) * 1e9 / cycle_ns;
+        return c > 0 ? (unsigned long long)(c + 0.5) : 0;
+    }
+
+    // --- CSV
+
+    static field_t column(std::string name) {
+        for (size_t i = 0; i < name.size(); i++)
+            name[i] = tolower(name[i]);
+        size_t b = name.find_first_not_of(" \t\"");
+        size_t e = name.find_last_not_of(" \t\"\r");
+        name = b == std::string::npos ? "" : name.substr(b, e - b + 1);
+        if (name == "src") return F_SRC;
+        if (name == "dst") return F_DST;
+        if (name == "length" || name == "len" || name == "size") return F_LENGTH;
+        if (name == "tos") return F_TOS;
+        if (name == "priority" || name == "prio") return F_PRIORITY;
+        if (name == "flow_id" || name == "flow" || name == "flowid") return F_FLOW;
+        if (name == "payload_ptr") return F_PAYLOAD;
+        if (name == "arrival_time" || name == "arrival" || name == "cycle") return F_ARRIVAL;
+        if (name == "time" || name == "timestamp" || name == "ts") return F_TIME;
+        return F_IGNORE;
+    }
+
+    // Next non-empty, non-comment line as [b, e).
+    bool next_line(const char * & b, const char * & e) {
+        while (pos < length) {
+            b = (const char *)(base + pos);
+            const char * nl = (const char *) memchr(b, '\n', length - pos);
+            e = nl ? nl : (const char *)(base + length);
+            pos = e - (const char *) base + (nl ? 1 : 0);
+            const char * t = e;
+            while (t > b && (t[-1] == '\r' || t[-1] == ' '))
+                t--;
+            e = t;
+            if (b != e && * b != '#')
+                return true;
+        }
+        return false;
+    }
+
+    bool open_csv() {
+        const char * b, * e;
+        size_t start = pos;
+        if (!next_line(b, e)) {
+            pos = start;
+            return true; // empty trace
+        }
+        const char * c = b;
+        while (c < e && (* c == ' ' || * c == '"'))
+            c++;
+        if (c < e && isdigit((unsigned char) * c)) {
+            pos = start;
+            columns.push_back(F_FLOW);
+            columns.push_back(F_LENGTH);
+            columns.push_back(F_PRIORITY);
+            columns.push_back(F_ARRIVAL);
+            return true;
+        }
+        while (true) {
+            const char * c = (const char *) memchr(b, ',', e - b);
+            columns.push_back(column(std::string(b, c ? c : e)));
+            if (!c)
+                break;
+            b = c + 1;
+        }
+        return true;
+    }
+
+    // One pass over the line: a number field is parsed up to its end,
+    // only ignored and time fields are searched for the next comma.
+    bool next_csv(rank_packet_t & p, unsigned long long & arrival) {
+        const char * b, * e;
+        if (!next_line(b, e))
+            return false;
+        const char * line = b;
+        p = rank_packet_t();
+        p.payload_ptr = count;
+        arrival = 0;
+        unsigned n = 0;
+        for (size_t i = 0; i < columns.size(); i++) {
+            const char * f = b;
+            while (f < e && (* f == ' ' || * f == '"'))
+                f++;
+            const char * end = f;
+            if (columns[i] == F_IGNORE || columns[i] == F_TIME || f == e || * f == ',') {
+                const char * c = (const char *) memchr(f, ',', e - f);
+                const char * fe = c ? c : e;
+                if (columns[i] == F_TIME && f != fe) {
+                    field.assign(f, fe);
+                    char * t_end;
+                    arrival = cycles(strtod(field.c_str(), & t_end));
+                    end = f + (t_end - field.c_str());
+                    n++;
+                } else {
+                    end = fe;
+                }
+            } else {
+                unsigned long long v;
+                end = parse_uint(f, e, v);
+                store(p, arrival, columns[i], v);
+                n++;
+            }
+            while (end < e && (* end == ' ' || * end == '"'))
+                end++;
+            if (end < e && * end != ',')
+                return bad_line(line, e);
+            if (end == e)
+                break;
+            b = end + 1;
+        }
+        if (!n)
+            return bad_line(line, e);
+        p.arrival_time = arrival;
+        return true;
+    }
+
+    // Decimal or 0x hex number at the start of [f, e), without the copy
+    // and locale handling of strtoull. Returns the end of the digits.
+    static const char * parse_uint(const char * f, const char * e, unsigned long long & v) {
+        v = 0;
+        if (e - f > 2 && f[0] == '0' && (f[1] == 'x' || f[1] == 'X')) {
+            const char * d = f + 2;
+            for (; d < e; d++) {
+                unsigned c = (unsigned char) * d;
+                unsigned x = c - '0' < 10 ? c - '0' : (c | 0x20) - 'a' < 6 ? (c | 0x20) - 'a' + 10 : 16;
+                if (x > 15)
+                    break;
+                v = v << 4 | x;
+            }
+            return d == f + 2 ? f + 1 : d;
+        }
+        for (; f < e && (unsigned)(* f - '0') < 10; f++)
+            v = v * 10 + (unsigned)(* f - '0');
+        return f;
+    }
+
+    static void store(rank_packet_t & p, unsigned long long & arrival, field_t f, unsigned long long v) {
+        switch (f) {
+        case F_SRC: p.src = v; break;
+        case F_DST: p.dst = v; break;
+        case F_LENGTH: p.length = v; break;
+        case F_TOS: p.tos = v; break;
+        case F_PRIORITY: p.priority = v; break;
+        case F_FLOW: p.flow_id = v; break;
+        case F_PAYLOAD: p.payload_ptr = v; break;
+        case F_ARRIVAL: arrival = v; break;
+        default: break;
+        }
+    }
+
+    bool bad_line(const char * b, const char * e) {
+        err = file_path + ": bad line: " + std::string(b, e);
+        return false;
+    }
+
+    // --- pcap
+
+    uint32_t u32(size_t off) const {
+        uint32_t v;
+        memcpy(& v, base + off, 4);
+        return swapped ? __builtin_bswap32(v) : v;
+    }
+
+    static uint32_t be32(const unsigned char * p) {
+        return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+    }
+
+    bool open_pcap() {
+        if (length < 24)
+            return fail("truncated pcap header");
+        uint32_t magic;
+        memcpy(& magic, base, 4);
+        swapped = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+        nsec = magic == 0xa1b23c4d || magic == 0x4d3cb2a1;
+        linktype = u32(20) & 0xFFFF;
+        if (linktype != 1 && linktype != 101 && linktype != 228 && linktype != 113)
+            return fail("unsupported pcap link type");
+        pos = 24;
+        return true;
+    }
+
+    bool next_pcap(rank_packet_t & p, unsigned long long & arrival, unsigned flows) {
+        while (pos + 16 <= length) {
+            uint32_t sec = u32(pos), frac = u32(pos + 4), incl = u32(pos + 8), orig = u32(pos + 12);
+            const unsigned char * frame = base + pos + 16;
+            if (incl > length - pos - 16) {
+                pos = length;
+                return fail("truncated pcap record");
+            }
+            pos += 16 + incl;
+
+            // IPv4 header
+            const unsigned char * ip = frame;
+            size_t caplen = incl;
+            if (linktype == 1 || linktype == 113) {
+                size_t l2 = linktype == 1 ? 14 : 16;
+                if (caplen < l2)
+                    continue;
+                unsigned type = (frame[l2 - 2] << 8) | frame[l2 - 1];
+                if (linktype == 1 && type == 0x8100 && caplen >= 18) {
+                    type = (frame[16] << 8) | frame[17];
+                    l2 = 18;
+                }
+                if (type != 0x0800) {
+                    skipped++;
+                    continue;
+                }
+                ip += l2;
+                caplen -= l2;
+            }
+            if (caplen < 20 || (ip[0] >> 4) != 4) {
+                skipped++;
+                continue;
+            }
+
+            p = rank_packet_t();
+            p.src = be32(ip + 12);
+            p.dst = be32(ip + 16);
+            p.tos = ip[1];
+            p.priority = ip[1] >> 5;
+            p.length = orig > 0xFFFF ? 0xFFFF : orig;
+            p.payload_ptr = count;
+
+            unsigned ihl = (ip[0] & 0xF) * 4;
+            unsigned proto = ip[9];
+            uint32_t ports = 0;
+            if ((proto == 6 || proto == 17) && caplen >= ihl + 4)
+                ports = be32(ip + ihl);
+            uint32_t h = p.src * 0x9E3779B1u;
+            h = (h ^ p.dst) * 0x85EBCA6Bu;
+            h = (h ^ ports) * 0xC2B2AE35u;
+            h = (h ^ proto) * 0x9E3779B1u;
+            p.flow_id = (h >> 16) % flows;
+
+            arrival = cycles(sec + frac * (nsec ? 1e-9 : 1e-6));
+            p.arrival_time = arrival;
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif // __PACKET_TRACE__H
@@ -0,0 +1,111 @@
+/*
+	@brief
+	Sparse word memory for the simulation models of IMEM and DMEM
+	(simulation only). It has the interface of a flat array,
+	mem[i] with i a word index, but storage is split in pages of
+	PAGE_WORDS words that are allocated, zeroed, on their first access.
+	A rank program touches a few pages of the 51200-word memories, so a
+	node costs kilobytes instead of the full 200 KiB per memory, and many
+	nodes fit in one simulation.
+
+	Access through the non-const operator[] (any read or write by the
+	memory threads) allocates the page. The const operator[], read() and
+	write() of a zero into an absent page do not, and are meant for the
+	testbench copies of the whole memory (ISS, checkpoints).
+
+	Synthesis keeps the flat arrays.
+
+*/
+
+#ifndef __PAGED_MEM__H
+#define __PAGED_MEM__H
+
+#ifndef __SYNTHESIS__
+
+#include <memory>
+#include <ostream>
+#include <vector>
+
+template < class T, unsigned N, unsigned PAGE_BITS = 8 > class paged_mem {
+    public:
+    static const unsigned PAGE_WORDS = 1u << PAGE_BITS;
+    static const unsigned PAGES = (N + PAGE_WORDS - 1) >> PAGE_BITS;
+
+    paged_mem(): page(PAGES), touched_pages(0), zero() {}
+
+    T & operator [] (unsigned i) {
+        std::unique_ptr < T[] > & p = page[i >> PAGE_BITS];
+        if (!p) {
+            p.reset(new T[PAGE_WORDS]());
+            touched_pages++;
+        }
+        return p[i & (PAGE_WORDS - 1)];
+    }
+
+    const T & operator [] (unsigned i) const {
+        const std::unique_ptr < T[] > & p = page[i >> PAGE_BITS];
+        return p ? p[i & (PAGE_WORDS - 1)] : zero;
+    }
+
+    T read(unsigned i) const {
+        return (* this)[i];
+    }
+
+    void write(unsigned i, const T & v) {
+        if (v != 0 || touched(i))
+            (* this)[i] = v;
+    }
+
+    bool touched(unsigned i) const {
+        return (bool) page[i >> PAGE_BITS];
+    }
+
+    unsigned size() const {
+        return N;
+    }
+
+    unsigned pages() const {
+        return touched_pages;
+    }
+
+    // Frees every page: the memory reads as zero again.
+    void clear() {
+        for (unsigned i = 0; i < PAGES; i++)
+            page[i].reset();
+        touched_pages = 0;
+    }
+
+    // Checkpoint section layout of a flat array (checkpoint::writer::put_array),
+    // so checkpoints do not depend on the memory model.
+    template < class W > void save(W & w) const {
+        for (unsigned i = 0; i < N; i++)
+            w.put((* this)[i]);
+    }
+
+    template < class R > void load(R & r) {
+        clear();
+        for (unsigned i = 0; i < N; i++) {
+            T v;
+            r.get(v);
+            write(i, v);
+        }
+    }
+
+    void print_stats(std::ostream & os, const char * name) const {
+        os << name << touched_pages << " of " << PAGES << " pages touched ("
+           << touched_pages * PAGE_WORDS * sizeof(T) / 1024 << " KiB, "
+           << PAGE_WORDS << " words/page)" << std::endl;
+    }
+
+    private:
+    std::vector < std::unique_ptr < T[] > > page;
+    unsigned touched_pages;
+    T zero;
+
+    paged_mem(const paged_mem &);
+    paged_mem & operator = (const paged_mem &);
+};
+
+#endif // __SYNTHESIS__
+
+#endif // __PAGED_MEM__H
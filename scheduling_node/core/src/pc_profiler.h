@@ -0,0 +1,288 @@
+/*
+	@brief
+	Per-PC cycle profiler (simulation only). Every cycle sampled by the
+	testbench is charged at retirement, as the top-down PC ranges: the
+	cycles since the previous write-back (classified as in topdown.h) go
+	to the PC written back.
+
+	The report resolves PCs against the ELF symbol table and, when the
+	RISC-V binutils are in $PATH, against the line table with addr2line.
+	It contains a flat profile per function and an annotated listing.
+
+*/
+
+#ifndef __PC_PROFILER__H
+#define __PC_PROFILER__H
+
+#ifndef __SYNTHESIS__
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "defines.h"
+#include "elf_file.h"
+#include "topdown.h"
+
+class pc_profiler {
+    public:
+    pc_profiler(): stats(ICACHE_SIZE), total_cycles(0) {}
+
+    void sample(const topdown_sample_t & s) {
+        pending.cycles[topdown_classify(s)]++;
+        if (!s.retire)
+            return;
+        unsigned idx = s.retire_pc >> 2;
+        if (idx < stats.size()) {
+            for (int i = 0; i < TD_NUM; i++) {
+                stats[idx].cycles[i] += pending.cycles[i];
+                total_cycles += pending.cycles[i];
+            }
+        }
+        end_packet();
+    }
+
+    // Drops the cycles after the last retirement, see topdown_report.
+    void end_packet() {
+        pending = pc_stat_t();
+    }
+
+    // Writes the flat profile and the annotated listing. elf may be NULL,
+    // insn_at returns the instruction word at a PC (for the listing).
+    void report(std::ostream & os, const elf_file * elf, std::function < unsigned(unsigned) > insn_at) const {
+        std::vector < unsigned > pcs;
+        for (unsigned i = 0; i < stats.size(); i++) {
+            if (stats[i].total())
+                pcs.push_back(i << 2);
+        }
+
+        std::vector < std::string > lines;
+        if (elf)
+            lines = addr2line(elf->path(), pcs);
+
+        flat_profile(os, elf, pcs);
+        os << std::endl;
+        listing(os, elf, pcs, lines, insn_at);
+    }
+
+    private:
+    struct pc_stat_t {
+        unsigned long long cycles[TD_NUM];
+
+        pc_stat_t() {
+            for (int i = 0; i < TD_NUM; i++)
+                cycles[i] = 0;
+        }
+
+        unsigned long long total() const {
+            unsigned long long t = 0;
+            for (int i = 0; i < TD_NUM; i++)
+                t += cycles[i];
+            return t;
+        }
+    };
+
+    std::vector < pc_stat_t > stats; // indexed by word address
+    unsigned long long total_cycles;
+    pc_stat_t pending; // cycles since the last retirement
+
+    static std::string symbol_name(const elf_file * elf, unsigned pc) {
+        const elf_symbol_t * sym = elf ? elf->find_symbol(pc) : NULL;
+        return sym ? sym->name : "??";
+    }
+
+    double pct(unsigned long long c) const {
+        return total_cycles ? 100.0 * c / total_cycles : 0.0;
+    }
+
+    static void header(std::ostream & os) {
+        static const char * const column[TD_NUM] = { "retire", "frontend", "bad-spec", "be-mem", "be-core" };
+        os << std::setw(10) << "cycles" << std::setw(8) << "%";
+        for (int i = 0; i < TD_NUM; i++)
+            os << std::setw(10) << column[i];
+    }
+
+    void row(std::ostream & os, const pc_stat_t & st) const {
+        os << std::setw(10) << st.total() << std::setw(8) << std::fixed << std::setprecision(2) << pct(st.total());
+        for (int i = 0; i < TD_NUM; i++)
+            os << std::setw(10) << st.cycles[i];
+        os.unsetf(std::ios::fixed);
+    }
+
+    void flat_profile(std::ostream & os, const elf_file * elf, const std::vector < unsigned > & pcs) const {
+        std::map < std::string, pc_stat_t > funcs;
+        for (size_t i = 0; i < pcs.size(); i++) {
+            pc_stat_t & f = funcs[symbol_name(elf, pcs[i])];
+            const pc_stat_t & st = stats[pcs[i] >> 2];
+            for (int b = 0; b < TD_NUM; b++)
+                f.cycles[b] += st.cycles[b];
+        }
+
+        // Sort by cycles, descending.
+        std::multimap < unsigned long long, std::string, std::greater < unsigned long long > > order;
+        for (std::map < std::string, pc_stat_t >::const_iterator it = funcs.begin(); it != funcs.end(); ++it)
+            order.insert(std::make_pair(it->second.total(), it->first));
+
+        os << "FLAT PROFILE (" << total_cycles << " cycles)" << std::endl;
+        header(os);
+        os << "  function" << std::endl;
+        for (std::multimap < unsigned long long, std::string >::const_iterator it = order.begin(); it != order.end(); ++it) {
+            row(os, funcs[it->second]);
+            os << "  " << it->second << std::endl;
+        }
+    }
+
+    void listing(std::ostream & os, const elf_file * elf, const std::vector < unsigned > & pcs,
+        const std::vector < std::string > & lines, std::function < unsigned(unsigned) > insn_at) const {
+        std::map < std::string, std::vector < std::string > > sources;
+        std::string last_sym, last_line;
+        std::string elf_dir;
+        if (elf && elf->path().rfind('/') != std::string::npos)
+            elf_dir = elf->path().substr(0, elf->path().rfind('/') + 1);
+
+        os << "ANNOTATED LISTING" << std::endl;
+        for (size_t i = 0; i < pcs.size(); i++) {
+            std::string sym = symbol_name(elf, pcs[i]);
+            if (sym != last_sym) {
+                os << std::endl << "<" << sym << ">:" << std::endl;
+                os << std::setw(10) << "pc" << std::setw(10) << "insn";
+                header(os);
+                os << std::endl;
+                last_sym = sym;
+                last_line.clear();
+            }
+
+            std::string loc = (i < lines.size()) ? lines[i] : "";
+            if (!loc.empty() && loc != last_line) {
+                os << "  " << loc << ": " << source_line(sources, loc, elf_dir) << std::endl;
+                last_line = loc;
+            }
+
+            os << std::hex << std::setfill('0') << "  " << std::setw(8) << pcs[i] << "  "
+               << std::setw(8) << insn_at(pcs[i]) << std::dec << std::setfill(' ');
+            row(os, stats[pcs[i] >> 2]);
+            os << std::endl;
+        }
+    }
+
+    // Text of "file:line", cached per file. Relative paths are also looked up next to the ELF.
+    static std::string source_line(std::map < std::string, std::vector < std::string > > & sources, const std::string & loc,
+        const std::string & elf_dir) {
+        size_t colon = loc.rfind(':');
+        if (colon == std::string::npos)
+            return "";
+        std::string file = loc.substr(0, colon);
+        unsigned line = strtoul(loc.c_str() + colon + 1, NULL, 10);
+
+        if (!sources.count(file)) {
+            std::ifstream in(file.c_str());
+            if (!in.is_open() && !file.empty() && file[0] != '/')
+                in.open((elf_dir + file).c_str());
+            std::string text;
+            std::vector < std::string > & v = sources[file];
+            while (std::getline(in, text))
+                v.push_back(text);
+        }
+        const std::vector < std::string > & v = sources[file];
+        if (line == 0 || line > v.size())
+            return "";
+        std::string text = v[line - 1];
+        size_t first = text.find_first_not_of(" \t");
+        return first == std::string::npos ? "" : text.substr(first);
+    }
+
+    // Resolves PCs to "file:line" with <RISCV_PREFIX>-addr2line.
+    // Returns an empty vector if the tool is not available.
+    // Runs args[0] (looked up in $PATH, no shell) and appends its output
+    // lines to out. False if it cannot be run or exits with an error.
+    static bool run_lines(const std::vector < std::string > & args, std::vector < std::string > & out) {
+        std::vector < char * > argv;
+        for (size_t i = 0; i < args.size(); i++)
+            argv.push_back(const_cast < char * > (args[i].c_str()));
+        argv.push_back(NULL);
+
+        int fd[2];
+        if (pipe(fd) != 0)
+            return false;
+        pid_t pid = fork();
+        if (pid < 0) {
+            close(fd[0]);
+            close(fd[1]);
+            return false;
+        }
+        if (pid == 0) {
+            dup2(fd[1], STDOUT_FILENO);
+            int null_fd = open("/dev/null", O_WRONLY);
+            if (null_fd >= 0)
+                dup2(null_fd, STDERR_FILENO);
+            close(fd[0]);
+            close(fd[1]);
+            execvp(argv[0], argv.data());
+            _exit(127);
+        }
+        close(fd[1]);
+
+        FILE * pipe_in = fdopen(fd[0], "r");
+        if (pipe_in) {
+            char buf[1024];
+            while (fgets(buf, sizeof(buf), pipe_in)) {
+                std::string l(buf);
+                l.erase(l.find_last_not_of("\r\n") + 1);
+                size_t disc = l.find(" (discriminator");
+                if (disc != std::string::npos)
+                    l.erase(disc);
+                out.push_back(l.compare(0, 2, "??") == 0 ? "" : l);
+            }
+            fclose(pipe_in);
+        } else {
+            close(fd[0]);
+        }
+        int status;
+        if (waitpid(pid, &status, 0) != pid)
+            return false;
+        return pipe_in && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    static std::vector < std::string > addr2line(const std::string & elf_path, const std::vector < unsigned > & pcs) {
+        const char * env = getenv("RISCV_PREFIX");
+        std::vector < std::string > prefixes;
+        if (env)
+            prefixes.push_back(env);
+        prefixes.push_back("riscv32-unknown-elf");
+        prefixes.push_back("riscv64-unknown-elf");
+
+        for (size_t p = 0; p < prefixes.size(); p++) {
+            std::vector < std::string > result;
+            bool ok = true;
+            for (size_t i = 0; i < pcs.size() && ok; i += 256) {
+                std::vector < std::string > args;
+                args.push_back(prefixes[p] + "-addr2line");
+                args.push_back("-e");
+                args.push_back(elf_path);
+                for (size_t j = i; j < pcs.size() && j < i + 256; j++) {
+                    std::ostringstream a;
+                    a << "0x" << std::hex << pcs[j];
+                    args.push_back(a.str());
+                }
+                ok = run_lines(args, result);
+            }
+            if (ok && result.size() == pcs.size())
+                return result;
+        }
+        return std::vector < std::string > ();
+    }
+};
+
+#endif // __SYNTHESIS__
+
+#endif // __PC_PROFILER__H
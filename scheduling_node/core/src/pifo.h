@@ -0,0 +1,124 @@
+/*
+	@brief
+	Untimed push-in first-out queue: the ordering of the node's queue
+	primitive (packet_enqueue_t in, packet_dequeue_resp_t out, see
+	packet.h). Dequeue returns the packet of smallest rank, and packets
+	of equal rank in enqueue order. Plain C++, shared by the testbench
+	(which orders the ranks computed by the core) and the untimed node
+	model (node_model.h), so both produce the same dequeue order.
+
+*/
+
+#ifndef __PIFO__H
+#define __PIFO__H
+
+#include <stdint.h>
+
+#include <queue>
+#include <vector>
+
+template < class M > class pifo_queue {
+    public:
+    pifo_queue(): seq(0) {}
+
+    void enqueue(const M & metadata, uint32_t rank) {
+        entry e;
+        e.metadata = metadata;
+        e.rank = rank;
+        e.seq = seq++;
+        heap.push(e);
+    }
+
+    // A packet_enqueue_t, or anything with metadata and rank fields.
+    template < class E > void enqueue(const E & enq) {
+        enqueue(enq.metadata, enq.rank);
+    }
+
+    // Pops the head. seq is the enqueue index of the packet (0 for the
+    // first packet ever enqueued).
+    bool dequeue(M & metadata, uint32_t * rank = NULL, uint64_t * enq_seq = NULL) {
+        if (heap.empty())
+            return false;
+        const entry & e = heap.top();
+        metadata = e.metadata;
+        if (rank)
+            * rank = e.rank;
+        if (enq_seq)
+            * enq_seq = e.seq;
+        heap.pop();
+        return true;
+    }
+
+    size_t size() const {
+        return heap.size();
+    }
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    // Enqueue index the next packet will get.
+    uint64_t next_seq() const {
+        return seq;
+    }
+
+    // Checkpoint of the queue (checkpoint.h writer and reader, or anything
+    // with the same put and get): the next enqueue index, then every entry
+    // with its rank and enqueue index, so that a restored queue dequeues in
+    // the same order. put_meta(w, m) and get_meta(r, m) write and read one
+    // metadata.
+    template < class W, class F > void save(W & w, F put_meta) const {
+        w.put((unsigned long long) seq);
+        w.put((unsigned) heap.size());
+        std::priority_queue < entry > copy(heap);
+        for (; !copy.empty(); copy.pop()) {
+            put_meta(w, copy.top().metadata);
+            w.put((unsigned) copy.top().rank);
+            w.put((unsigned long long) copy.top().seq);
+        }
+    }
+
+    // Replaces the content; false (and an empty queue) if the section is
+    // short.
+    template < class R, class F > bool load(R & r, F get_meta) {
+        heap = std::priority_queue < entry > ();
+        unsigned long long next;
+        unsigned n;
+        r.get(next);
+        r.get(n);
+        for (unsigned i = 0; i < n && r.ok(); i++) {
+            entry e;
+            unsigned rank;
+            unsigned long long enq_seq;
+            get_meta(r, e.metadata);
+            r.get(rank);
+            r.get(enq_seq);
+            e.rank = rank;
+            e.seq = enq_seq;
+            heap.push(e);
+        }
+        if (!r.ok()) {
+            heap = std::priority_queue < entry > ();
+            return false;
+        }
+        seq = next;
+        return true;
+    }
+
+    private:
+    struct entry {
+        M metadata;
+        uint32_t rank;
+        uint64_t seq;
+
+        // Heap order: the head has the smallest (rank, seq).
+        bool operator < (const entry & o) const {
+            return rank != o.rank ? rank > o.rank : seq > o.seq;
+        }
+    };
+
+    std::priority_queue < entry > heap;
+    uint64_t seq;
+};
+
+#endif // __PIFO__H
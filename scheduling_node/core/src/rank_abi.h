@@ -0,0 +1,131 @@
+/*
+	@brief
+	DMEM layout shared by the rank programs (schedulers/<name>/notmain.c)
+	and everything that feeds them packets: the testbench, the node and the
+	native tools. Byte addresses; the DMEM is word-addressed (addr >> 2).
+
+	The packet metadata words follow SchedulingNode::dmemory_th. The
+	RANK_*_ADDR values are the defaults of rank_layout_t and must match the
+	symbols of schedulers/lscript.
+
+*/
+
+#ifndef __RANK_ABI__H
+#define __RANK_ABI__H
+
+#include <stdint.h>
+
+#define RANK_META_ADDR        0x100 // packet metadata, RANK_META_WORDS words
+#define RANK_OUT_ADDR         0x150 // rank written by the program ([1]: DRR round)
+#define RANK_WEIGHT_ADDR      0x180 // WFQ: weight per flow
+#define RANK_SRV_CNTR_ADDR    0x1D0 // DRR: service counter per flow
+#define RANK_VTIME_ADDR       0x208 // WFQ: virtual time
+#define RANK_DEQ_CYCLE_ADDR   0x210 // DRR: global dequeue cycle
+#define RANK_QUANTUM_ADDR     0x220 // DRR: quantum per flow
+#define RANK_FINISH_TIME_ADDR 0x260 // WFQ: last finish time per flow
+
+#define RANK_META_WORDS 5
+#define RANK_MAX_FLOWS  16 // entries of the per-flow tables
+
+// Packet fields seen by the rank programs, without the SystemC types of
+// packet_metadata_t so that native tools can use it.
+struct rank_packet_t {
+    uint32_t src;
+    uint32_t dst;
+    uint16_t length;
+    uint8_t tos;
+    uint8_t priority;
+    uint16_t flow_id;
+    uint16_t arrival_time;
+    uint32_t payload_ptr;
+
+    rank_packet_t(): src(0), dst(0), length(0), tos(0), priority(0), flow_id(0), arrival_time(0), payload_ptr(0) {}
+};
+
+// Metadata words as stored at RANK_META_ADDR.
+inline void rank_meta_words(const rank_packet_t & p, uint32_t w[RANK_META_WORDS]) {
+    w[0] = p.src;
+    w[1] = p.dst;
+    w[2] = (uint32_t) p.length | ((uint32_t) p.tos << 16) | ((uint32_t)(p.priority & 0x7) << 24);
+    w[3] = (uint32_t) p.flow_id | ((uint32_t) p.arrival_time << 16);
+    w[4] = p.payload_ptr;
+}
+
+// Inverse of rank_meta_words().
+inline rank_packet_t rank_packet_from_words(const uint32_t w[RANK_META_WORDS]) {
+    rank_packet_t p;
+    p.src = w[0];
+    p.dst = w[1];
+    p.length = w[2] & 0xFFFF;
+    p.tos = (w[2] >> 16) & 0xFF;
+    p.priority = (w[2] >> 24) & 0x7;
+    p.flow_id = w[3] & 0xFFFF;
+    p.arrival_time = w[3] >> 16;
+    p.payload_ptr = w[4];
+    return p;
+}
+
+// DMEM layout of a program: the words fed to it (meta, weight, quantum,
+// deq_cycle),
+// the rank it writes (out) and its state tables, RANK_*_ADDR by default.
+// Scheduler ELFs carry the absolute symbols of schedulers/lscript
+// (rank_meta, rank_out, ...), which notmain.c also addresses through, so
+// from_symbols() gives the layout a program was linked against; ELF is any
+// type with symbol_address(name, addr), such as elf_file. Code that feeds
+// or checks a program goes through this and never through RANK_*_ADDR.
+struct rank_layout_t {
+    uint32_t meta;
+    uint32_t out;
+    uint32_t weight;
+    uint32_t quantum;
+    uint32_t deq_cycle;
+    uint32_t finish_time;
+    uint32_t srv_cntr;
+    uint32_t vtime;
+
+    rank_layout_t(): meta(RANK_META_ADDR), out(RANK_OUT_ADDR), weight(RANK_WEIGHT_ADDR), quantum(RANK_QUANTUM_ADDR),
+        deq_cycle(RANK_DEQ_CYCLE_ADDR),
+        finish_time(RANK_FINISH_TIME_ADDR), srv_cntr(RANK_SRV_CNTR_ADDR), vtime(RANK_VTIME_ADDR) {}
+
+    // Returns the number of addresses found in the symbols.
+    template < class ELF > unsigned from_symbols(const ELF & elf) {
+        return lookup(elf, "rank_meta", meta) + lookup(elf, "rank_out", out) +
+            lookup(elf, "rank_weight_table", weight) + lookup(elf, "rank_quantum_table", quantum) +
+            lookup(elf, "rank_deq_cycle", deq_cycle) +
+            lookup(elf, "rank_finish_time", finish_time) + lookup(elf, "rank_srv_cntr", srv_cntr) +
+            lookup(elf, "rank_vtime", vtime);
+    }
+
+    // Byte range [state_lo(), state_hi()) covering the scheduler state: the
+    // per-flow tables (RANK_MAX_FLOWS words) and the single words.
+    uint32_t state_lo() const {
+        return min4(finish_time, srv_cntr, vtime, deq_cycle);
+    }
+
+    uint32_t state_hi() const {
+        return max4(finish_time + 4 * RANK_MAX_FLOWS, srv_cntr + 4 * RANK_MAX_FLOWS, vtime + 4, deq_cycle + 4);
+    }
+
+    private:
+    template < class ELF > static unsigned lookup(const ELF & elf, const char * name, uint32_t & addr) {
+        unsigned a;
+        if (!elf.symbol_address(name, a))
+            return 0;
+        addr = a;
+        return 1;
+    }
+
+    static uint32_t min4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        uint32_t m = a < b ? a : b;
+        m = m < c ? m : c;
+        return m < d ? m : d;
+    }
+
+    static uint32_t max4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        uint32_t m = a > b ? a : b;
+        m = m > c ? m : c;
+        return m > d ? m : d;
+    }
+};
+
+#endif // __RANK_ABI__H
@@ -0,0 +1,140 @@
+/*
+	@brief
+	Golden models of the rank programs in schedulers/ (native code, no
+	SystemC dependency), for differential checking of the programs, the
+	core and the tools that run them (tools/rank_diff).
+
+	Each model works on the program's own DMEM words, at the addresses of
+	the program's rank_layout_t (the rank_* symbols of its ELF):
+
+		sp   rank = priority
+		drr  QUANTUM_TABLE    quantum         quantum per flow
+		     SRV_CNTR_BASE    srv_cntr        service counter per flow
+		     DEQ_CYCLE_PTR    deq_cycle       global dequeue cycle
+		wfq  WEIGHT_TABLE     weight          weight per flow
+		     FINISH_TIME_BASE finish_time     last finish time per flow
+		     VIRTUAL_TIME_PTR vtime           virtual time
+
+	and performs the same loads and stores in the same order, with 32-bit
+	wrap-around and the RV32M division (x / 0 = 0xFFFFFFFF). The tables are
+	indexed with the raw 16-bit flow_id, as in the programs, so aliasing
+	between tables is reproduced too. An access outside the DMEM stops the
+	model like the ISS stops the program (ISS_BAD_ADDR).
+
+	A change to a program's algorithm must be mirrored here; a change to
+	its code generation, the core or the tools must not change any rank.
+
+*/
+
+#ifndef __RANK_REF__H
+#define __RANK_REF__H
+
+#include <stdint.h>
+
+#include <string>
+
+#include "rank_abi.h"
+
+// DMEM of a model run: word-addressed, byte addresses as in the programs.
+class rank_ref_mem {
+    public:
+    rank_ref_mem(uint32_t * dmem, unsigned dmem_words): mem(dmem), words(dmem_words), bad(false) {}
+
+    uint32_t load(uint32_t addr) {
+        if ((addr >> 2) >= words) {
+            bad = true;
+            return 0;
+        }
+        return mem[addr >> 2];
+    }
+
+    void store(uint32_t addr, uint32_t data) {
+        if ((addr >> 2) >= words) {
+            bad = true;
+            return;
+        }
+        mem[addr >> 2] = data;
+    }
+
+    // False once an access fell outside the DMEM.
+    bool ok() const {
+        return !bad;
+    }
+
+    private:
+    uint32_t * mem;
+    unsigned words;
+    bool bad;
+};
+
+inline uint32_t rank_ref_divu(uint32_t a, uint32_t b) {
+    return b ? a / b : ~0u;
+}
+
+// schedulers/sp: strict priority, the rank is the packet's priority.
+inline bool rank_ref_sp(rank_ref_mem & m, const rank_layout_t & l) {
+    uint32_t priority = (m.load(l.meta + 8) >> 24) & 0x7;
+    m.store(l.out, priority);
+    return m.ok();
+}
+
+// schedulers/drr: deficit round robin over N flows.
+inline bool rank_ref_drr(rank_ref_mem & m, const rank_layout_t & l) {
+    const uint32_t N = 8, MIN_PKT_SIZE = 64;
+    uint32_t flow_id = m.load(l.meta + 12) & 0xFFFF;
+    uint32_t pkt_len = m.load(l.meta + 8) & 0xFFFF;
+    uint32_t q = m.load(l.quantum + 4 * flow_id);
+    uint32_t deq_cycle = m.load(l.deq_cycle);
+    uint32_t pkts_per_rnd = N * (q / MIN_PKT_SIZE);
+    if (!m.ok())
+        return false;
+
+    uint32_t srv_cntr = m.load(l.srv_cntr + 4 * flow_id);
+    if (!m.ok())
+        return false;
+    if (srv_cntr < deq_cycle * q)
+        srv_cntr = deq_cycle * q;
+    srv_cntr += pkt_len;
+    m.store(l.srv_cntr + 4 * flow_id, srv_cntr);
+
+    uint32_t virtual_round_id = rank_ref_divu(srv_cntr - 1, q);
+    uint32_t rank = flow_id + pkts_per_rnd * virtual_round_id;
+    m.store(l.out, rank);
+    m.store(l.out + 4, virtual_round_id);
+    if (deq_cycle < virtual_round_id)
+        m.store(l.deq_cycle, virtual_round_id);
+    return m.ok();
+}
+
+// schedulers/wfq: weighted fair queueing on finish times.
+inline bool rank_ref_wfq(rank_ref_mem & m, const rank_layout_t & l) {
+    uint32_t flow_id = m.load(l.meta + 12) & 0xFFFF;
+    uint32_t packet_len = m.load(l.meta + 8) & 0xFFFF;
+    uint32_t flow_weight = m.load(l.weight + 4 * flow_id);
+    uint32_t last_finish = m.load(l.finish_time + 4 * flow_id);
+    uint32_t virtual_time = m.load(l.vtime);
+    if (!m.ok())
+        return false;
+
+    uint32_t start_time = last_finish > virtual_time ? last_finish : virtual_time;
+    uint32_t finish_time = start_time + rank_ref_divu(packet_len, flow_weight);
+    m.store(l.finish_time + 4 * flow_id, finish_time);
+    m.store(l.vtime, finish_time);
+    m.store(l.out, finish_time);
+    return m.ok();
+}
+
+typedef bool (* rank_ref_model_t)(rank_ref_mem &, const rank_layout_t &);
+
+// Model of schedulers/<name>, or NULL.
+inline rank_ref_model_t rank_ref_model(const std::string & name) {
+    if (name == "sp")
+        return rank_ref_sp;
+    if (name == "drr")
+        return rank_ref_drr;
+    if (name == "wfq")
+        return rank_ref_wfq;
+    return NULL;
+}
+
+#endif // __RANK_REF__H
@@ -0,0 +1,124 @@
+/*
+	@brief
+	Sampled simulation of packet streams (simulation only), after SMARTS.
+	Packets are the sampling units: one window of n consecutive packets
+	out of every k is run on the cycle-accurate core, all others on the
+	ISS, which only keeps the DMEM (scheduler state) up to date. Before a
+	window the DMEM of the ISS is copied into the testbench memory, after
+	it the core's DMEM is copied back. The pipeline restarts from reset for
+	every packet, so the DMEM is the only state that needs warming.
+
+	The windows give per-packet latency (cycles from injection to the end
+	loop) and CPI, reported as a mean with a 95% confidence interval,
+	which is extrapolated to the whole stream.
+
+*/
+
+#ifndef __SAMPLING__H
+#define __SAMPLING__H
+
+#ifndef __SYNTHESIS__
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Running mean and variance (Welford).
+class sample_stat {
+    public:
+    sample_stat(): n(0), m(0), m2(0) {}
+
+    void add(double v) {
+        n++;
+        double d = v - m;
+        m += d / n;
+        m2 += d * (v - m);
+    }
+
+    unsigned long long count() const {
+        return n;
+    }
+
+    double mean() const {
+        return m;
+    }
+
+    double stddev() const {
+        return n > 1 ? std::sqrt(m2 / (n - 1)) : 0;
+    }
+
+    // Half-width of the 95% confidence interval of the mean.
+    double ci95() const {
+        return n > 1 ? 1.96 * stddev() / std::sqrt((double) n) : 0;
+    }
+
+    private:
+    unsigned long long n;
+    double m;
+    double m2;
+};
+
+class packet_sampler {
+    public:
+    packet_sampler(): period(0), window(1), total(0) {}
+
+    // Spec is "k[:n]": n packets in detail out of every k (n defaults to 1).
+    bool configure(const std::string & spec) {
+        char * end;
+        period = strtoull(spec.c_str(), & end, 0);
+        window = 1;
+        if (* end == ':')
+            window = strtoull(end + 1, & end, 0);
+        return * end == '\0' && period > 0 && window > 0 && window <= period;
+    }
+
+    bool enabled() const {
+        return period != 0;
+    }
+
+    // True if packet i of the stream is simulated in detail.
+    bool detailed(unsigned long long i) const {
+        return i % period < window;
+    }
+
+    void add_detailed(unsigned long long cycles, unsigned long long insns) {
+        latency.add((double) cycles);
+        if (insns)
+            cpi.add((double) cycles / insns);
+    }
+
+    void add_packet() {
+        total++;
+    }
+
+    void print(std::ostream & os) const {
+        os << "SAMPLED: " << latency.count() << " of " << total << " packets in detail ("
+           << window << " every " << period << ")" << std::endl;
+        print_stat(os, "   CPI          : ", cpi, "");
+        print_stat(os, "   LATENCY      : ", latency, " cycles");
+        os << "   EST. CYCLES  : " << std::fixed << std::setprecision(0) << latency.mean() * total
+           << " +- " << latency.ci95() * total << std::endl;
+        os.unsetf(std::ios::floatfield);
+        os << std::setprecision(6);
+    }
+
+    private:
+    unsigned long long period;
+    unsigned long long window;
+    unsigned long long total;
+    sample_stat cpi;
+    sample_stat latency;
+
+    static void print_stat(std::ostream & os, const char * label, const sample_stat & s, const char * unit) {
+        os << label << std::fixed << std::setprecision(3) << s.mean() << " +- " << s.ci95() << unit;
+        if (s.mean() != 0)
+            os << " (95%, +-" << std::setprecision(2) << 100 * s.ci95() / s.mean() << "%)";
+        os << std::endl;
+    }
+};
+
+#endif // __SYNTHESIS__
+
+#endif // __SAMPLING__H
@@ -1,9 +1,30 @@
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
 
 #include "drim4hls_datatypes.h"
 #include "defines.h"
 #include "globals.h"
 #include "drim4hls.h"
+#include "topdown.h"
+#include "kanata_trace.h"
+#include "pc_profiler.h"
+#include "trace_ring.h"
+#include "iss.h"
+#include "rank_abi.h"
+#include "packet_source.h"
+#include "checkpoint.h"
+#include "sampling.h"
+#include "paged_mem.h"
+#include "pifo.h"
+#include "packet_log.h"
+#include "rank_ref.h"
+#include "chan_log.h"
 
 #include <mc_scverify.h>
 #include <ac_int.h>
@@ -32,6 +53,10 @@ class Top: public sc_module {
     #pragma hls_direct_input
     sc_signal < long int > CCS_INIT_S1(o_icount);
 
+    // First PC after reset: the ELF entry point, 0 for a .txt program
+    #pragma hls_direct_input
+    sc_signal < sc_uint < PC_LEN > > CCS_INIT_S1(entry_pc);
+
     /* The testbench, DUT, IMEM and DMEM modules. */
     Connections::Combinational < imem_out_t > CCS_INIT_S1(imem2de_ch);
     Connections::Combinational < imem_in_t > CCS_INIT_S1(fe2imem_ch);
@@ -39,12 +64,13 @@ class Top: public sc_module {
     Connections::Combinational < dmem_out_t > CCS_INIT_S1(dmem2wb_ch);
     Connections::Combinational < dmem_in_t > CCS_INIT_S1(wb2dmem_ch);
 
-    sc_uint < XLEN > imem[ICACHE_SIZE];
+    // Sparse models of the memories, see paged_mem.h
+    paged_mem < sc_uint < XLEN > , ICACHE_SIZE > imem;
 
     imem_out_t imem_dout;
     imem_in_t imem_din;
 
-    sc_uint < XLEN > dmem[DCACHE_SIZE];
+    paged_mem < sc_uint < XLEN > , DCACHE_SIZE > dmem;
 
     dmem_out_t dmem_dout;
     dmem_in_t dmem_din;
@@ -54,17 +80,119 @@ class Top: public sc_module {
     
     int wait_stalls;
 
+    // Top-down cycle accounting, see topdown.h
+    topdown_report topdown;
+    long last_retired;
+
+    // Per-PC profile, enabled with --profile. Symbols come from --elf, or
+    // from the program itself when it is loaded from an ELF.
+    pc_profiler * profiler;
+    std::string profile_path;
+    elf_file elf;
+
+    // DMEM addresses of the rank ABI, from the program symbols if any.
+    rank_layout_t layout;
+
+    // Instruction-accurate model run in lockstep with the core (--lockstep).
+    iss * checker;
+    unsigned long long lockstep_checked;
+    bool lockstep_failed;
+
+    // Golden model of the scheduler (--ref), see rank_ref.h, checked after
+    // every ranked packet. Its DMEM starts as a copy of the core's.
+    rank_ref_model_t ref_model;
+    std::vector < uint32_t > ref_dmem;
+    unsigned long long ref_checked;
+    unsigned long long ref_errors;
+
+    // Packets injected on their arrival cycle (--packets, --gen). Without
+    // either the example packet of run() is ranked once.
+    packet_source packets;
+    bool have_packets;
+
+    // Synthetic workload (--gen); its weights are written to WEIGHT_TABLE
+    // and QUANTUM_TABLE.
+    traffic_config workload;
+    bool have_workload;
+
+    // Idle fast-forward (--idle-skip). Between packets the core is parked in
+    // the end-of-program loop; its processes are suspended and run() sleeps
+    // until the next arrival instead of stepping every cycle. The skipped
+    // cycles are still counted in cycle_count.
+    bool idle_skip;
+    std::vector < sc_process_handle > core_procs;
+    unsigned long long idle_cycles;
+    unsigned long long skipped_cycles;
+
+    // State saved (--checkpoint) once the last packet is ranked, or at the
+    // point of --checkpoint-at, and restored in place of the warm-up
+    // (--restore), see checkpoint.h. The point is a packet count or a cycle
+    // (checkpoint_at_cycle); checkpoint_at 0 is the end of the run.
+    std::string checkpoint_path;
+    std::string restore_path;
+    unsigned long long checkpoint_at;
+    bool checkpoint_at_cycle;
+    bool checkpoint_taken;
+
+    // Sampled simulation (--sample), see sampling.h. Packets outside the
+    // detailed windows run on the functional ISS.
+    packet_sampler sampler;
+    iss * functional;
+
+    // Dequeue order of the ranked packets (--pifo), see pifo.h. A packet is
+    // dequeued whenever the PIFO holds pifo_depth packets, the rest after
+    // the last one; tools/node_untimed prints the same order.
+    pifo_queue < rank_packet_t > pifo;
+    unsigned pifo_depth;
+
+    // --link: the PIFO drains instead onto a link of link bytes per cycle,
+    // as in tools/node_untimed. A packet is dequeued when its transmission
+    // starts, the link being free from link_free.
+    double link;
+    double link_free;
+
+    // Per-packet egress log of the PIFO (--pkt-log, with --link), see
+    // packet_log.h: arrival cycle, cycle the rank was read, cycle the
+    // transmission started. Records of the queued packets, by enqueue
+    // index.
+    packet_log egress_log;
+    std::unordered_map < uint64_t, packet_log_rec_t > egress_pending;
+
+    static const int PARK_DRAIN_CYCLES = 5;
+    static const uint64_t MAX_INSNS_PER_PACKET = 1000000;
+
     SC_CTOR(Top);
     Top(const sc_module_name &name, const std::string &testing_program): 
-    clk("clk", 10, SC_NS, 5, 0, SC_NS, true),
     m_dut("drim4hls"),
-    testing_program(testing_program) {
+    clk("clk", 10, SC_NS, 5, 0, SC_NS, true),
+    cycle_count(0),
+    testing_program(testing_program),
+    profiler(NULL),
+    checker(NULL),
+    lockstep_checked(0),
+    lockstep_failed(false),
+    ref_model(NULL),
+    ref_checked(0),
+    ref_errors(0),
+    have_packets(false),
+    have_workload(false),
+    idle_skip(false),
+    idle_cycles(0),
+    skipped_cycles(0),
+    checkpoint_at(0),
+    checkpoint_at_cycle(false),
+    checkpoint_taken(false),
+    functional(NULL),
+    pifo_depth(0),
+    link(0),
+    link_free(0) {
         
         Connections::set_sim_clk( & clk);
 
         // Connect the design module
         m_dut.clk(clk);
         m_dut.rst(rst);
+        m_dut.entry_pc(entry_pc);
         m_dut.program_end(program_end);
 
         m_dut.icount(icount);
@@ -89,6 +217,168 @@ class Top: public sc_module {
         async_reset_signal_is(rst, false);
     }
 
+    ~Top() {
+        delete profiler;
+        delete checker;
+        delete functional;
+    }
+
+    bool open_packets(const std::string & path) {
+        packets.set_cycle_ns(clk.period().to_seconds() * 1e9);
+        have_packets = packets.open(path);
+        return have_packets;
+    }
+
+    bool open_workload(const std::string & spec) {
+        if (!workload.parse(spec))
+            return false;
+        packets.open_generator(workload);
+        have_packets = have_workload = true;
+        return true;
+    }
+
+    // The clocked processes of the core and of the memories: every process
+    // below Top named *_th (run() is the testbench itself).
+    void collect_core_processes(sc_object * parent) {
+        const std::vector < sc_object * > & children = parent->get_child_objects();
+        for (size_t i = 0; i < children.size(); i++) {
+            sc_process_handle h(children[i]);
+            std::string name = children[i]->basename();
+            if (!h.valid())
+                collect_core_processes(children[i]);
+            else if (name.size() > 3 && name.compare(name.size() - 3, 3, "_th") == 0)
+                core_procs.push_back(h);
+        }
+    }
+
+    void end_of_elaboration() {
+        collect_core_processes(this);
+    }
+
+    // --checkpoint-at <cycle|packet>: "cycle:<n>" or "packet:<n>", n > 0.
+    bool parse_checkpoint_at(const std::string & spec) {
+        size_t colon = spec.find(':');
+        if (colon == std::string::npos)
+            return false;
+        std::string kind = spec.substr(0, colon);
+        char * end;
+        checkpoint_at = strtoull(spec.c_str() + colon + 1, & end, 0);
+        checkpoint_at_cycle = kind == "cycle";
+        return (checkpoint_at_cycle || kind == "packet") && * end == '\0' && end != spec.c_str() + colon + 1 &&
+            checkpoint_at > 0;
+    }
+
+    // The queued packets (with their --pkt-log records) and the link.
+    void save_queue(checkpoint & ckpt) const {
+        checkpoint::writer w = ckpt.add("pifo");
+        pifo.save(w, [](checkpoint::writer & w, const rank_packet_t & p) {
+            uint32_t meta[RANK_META_WORDS];
+            rank_meta_words(p, meta);
+            w.put_array(meta, RANK_META_WORDS);
+        });
+        uint64_t link_bits;
+        memcpy(& link_bits, & link_free, sizeof(link_bits));
+        w.put((unsigned long long) link_bits);
+        w.put((unsigned) egress_pending.size());
+        for (std::unordered_map < uint64_t, packet_log_rec_t >::const_iterator it = egress_pending.begin();
+             it != egress_pending.end(); ++it) {
+            const packet_log_rec_t & r = it->second;
+            w.put((unsigned long long) r.seq);
+            w.put((unsigned long long) r.ingress);
+            w.put((unsigned long long) r.enqueue);
+            w.put((unsigned) r.rank);
+            w.put((unsigned) r.payload_ptr);
+            w.put((unsigned) r.flow_id | ((unsigned) r.length << 16));
+            w.put((unsigned) r.priority | ((unsigned) r.tos << 8));
+        }
+    }
+
+    // A checkpoint saved before the queue was had none queued.
+    bool load_queue(const checkpoint & ckpt) {
+        checkpoint::reader r = ckpt.find("pifo");
+        if (!r.ok())
+            return true;
+        bool ok = pifo.load(r, [](checkpoint::reader & r, rank_packet_t & p) {
+            uint32_t meta[RANK_META_WORDS];
+            r.get_array(meta, RANK_META_WORDS);
+            p = rank_packet_from_words(meta);
+        });
+        unsigned long long link_bits;
+        unsigned pending;
+        r.get(link_bits);
+        memcpy(& link_free, & link_bits, sizeof(link_free));
+        r.get(pending);
+        egress_pending.clear();
+        for (unsigned i = 0; i < pending && r.ok(); i++) {
+            packet_log_rec_t rec;
+            unsigned long long seq, ingress, enqueue;
+            unsigned rank, payload_ptr, flow_length, priority_tos;
+            r.get(seq);
+            r.get(ingress);
+            r.get(enqueue);
+            r.get(rank);
+            r.get(payload_ptr);
+            r.get(flow_length);
+            r.get(priority_tos);
+            rec.seq = seq;
+            rec.ingress = ingress;
+            rec.enqueue = enqueue;
+            rec.rank = rank;
+            rec.payload_ptr = payload_ptr;
+            rec.flow_id = flow_length & 0xFFFF;
+            rec.length = flow_length >> 16;
+            rec.priority = priority_tos & 0xFF;
+            rec.tos = priority_tos >> 8;
+            egress_pending[rec.seq] = rec;
+        }
+        return ok && r.ok();
+    }
+
+    bool save_checkpoint() {
+        checkpoint_taken = true;
+        checkpoint ckpt;
+        checkpoint::writer w = ckpt.add("top");
+        w.put(cycle_count);
+        w.put(idle_cycles);
+        w.put(skipped_cycles);
+        imem.save(w);
+        dmem.save(w);
+        save_queue(ckpt);
+        m_dut.save_state(ckpt);
+        if (!ckpt.save(checkpoint_path)) {
+            std::cerr << ckpt.error() << std::endl;
+            return false;
+        }
+        std::cout << "Checkpoint written to " << checkpoint_path << " at cycle " << cycle_count << " ("
+                  << pifo.size() << " packets queued)" << std::endl;
+        return true;
+    }
+
+    // Called with the core frozen (see run()).
+    bool restore_checkpoint() {
+        checkpoint ckpt;
+        if (!ckpt.load(restore_path)) {
+            std::cerr << ckpt.error() << std::endl;
+            return false;
+        }
+        checkpoint::reader r = ckpt.find("top");
+        r.get(cycle_count);
+        r.get(idle_cycles);
+        r.get(skipped_cycles);
+        imem.load(r);
+        dmem.load(r);
+        if (!r.ok() || !load_queue(ckpt) || !m_dut.load_state(ckpt)) {
+            std::cerr << restore_path << ": incomplete checkpoint" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void enable_lockstep() {
+        checker = new iss();
+        m_dut.wb.log_retire = true;
+    }
+
     void imemory_th() {
         IMEM_RST: {
             imem2de_ch.ResetWrite();
@@ -98,11 +388,13 @@ class Top: public sc_module {
         }
         IMEM_BODY: while (true) {
             imem_din = fe2imem_ch.Pop();
+            CHAN_LOG(fe2imem_ch, imem_din);
 
             unsigned int addr_aligned = imem_din.instr_addr >> 2;
 			//std::cout << "imem addr= " << addr_aligned << endl;
             
             imem_dout.instr_data = imem[addr_aligned];
+            TRACE(TR_IMEM, TR_VERBOSE, TR_IMEM_READ, imem_din.instr_addr, imem_dout.instr_data);
 			
             // unsigned int random_stalls = (rand() % 2) + 1;
             //unsigned int random_stalls = 1;
@@ -123,6 +415,7 @@ class Top: public sc_module {
         }
         DMEM_BODY: while (true) {
             dmem_din = wb2dmem_ch.Pop();
+            CHAN_LOG(wb2dmem_ch, dmem_din);
             unsigned int addr = dmem_din.data_addr;
 			//std::cout << "dmem addr= " << addr << endl;
             // unsigned int random_stalls = (rand() % 25) + 1;
@@ -132,104 +425,553 @@ class Top: public sc_module {
             // wait_stalls += random_stalls;
             // wait(random_stalls);
             wait(1);
-            // std::cout << "wait= " << random_stalls << endl;
-            std::cout << "wait= 1" << endl;
             
             if (dmem_din.read_en) {
-				std::cout << "dmem read" << endl;
                 dmem_dout.data_out = dmem[addr];
+                TRACE(TR_DMEM, TR_DEBUG, TR_DMEM_READ, addr, dmem_dout.data_out);
                 dmem2wb_ch.Push(dmem_dout);
             } else if (dmem_din.write_en) {
-				std::cout << "dmem write" << endl;
                 dmem[addr] = dmem_din.data_in;
                 dmem_dout.data_out = dmem_din.data_in;
+                TRACE(TR_DMEM, TR_DEBUG, TR_DMEM_WRITE, addr, dmem_din.data_in);
             }
 
-            // REMOVE
-            std::cout << "dmem[" << addr << "]=" << dmem[addr] << endl;
             wait();
         }
 
     }
 
+    // Samples the core state of the current cycle for the top-down report.
+    topdown_sample_t sample_core() {
+        topdown_sample_t s;
+        long retired = m_dut.wb.retired.read();
+
+        s.retire = (retired != last_retired);
+        s.retire_pc = m_dut.wb.retired_pc.read().to_uint();
+        last_retired = retired;
+
+        s.events = m_dut.de2exe_hpm_events.read().to_uint();
+        if (m_dut.fe2exe_imem_wait.read())
+            s.events |= 1u << HPM_EV_IMEM_WAIT;
+        if (m_dut.wb2exe_dmem_wait.read())
+            s.events |= 1u << HPM_EV_DMEM_WAIT;
+        if (m_dut.exe.div_busy.read())
+            s.events |= 1u << HPM_EV_DIV_BUSY;
+        return s;
+    }
+
+    // Steps the ISS over every instruction written back by the core since
+    // the last cycle and compares their effects. Branches complete in decode
+    // on the core, so the ISS steps over them. Checking stops at the first
+    // divergence, after which the two models no longer share a state.
+    void lockstep_check() {
+        std::deque < writeback::retire_rec_t > & log = m_dut.wb.retire_log;
+        while (!log.empty() && !lockstep_failed) {
+            writeback::retire_rec_t core = log.front();
+            log.pop_front();
+
+            // The core keeps running the end-of-program loop the ISS stops at.
+            if (checker->stopped() == iss::ISS_END && core.pc == checker->pc())
+                continue;
+
+            iss::retire_t ref = iss::retire_t();
+            do {
+                if (!checker->step(ref)) {
+                    if (checker->stopped() == iss::ISS_END && core.pc == checker->pc())
+                        break;
+                    std::cout << "LOCKSTEP: ISS stopped at pc 0x" << std::hex << checker->pc()
+                              << " while the core wrote back pc 0x" << core.pc << std::dec << std::endl;
+                    lockstep_failed = true;
+                    return;
+                }
+            } while (!ref.wb);
+            if (!ref.wb)
+                continue;
+
+            std::ostringstream diff;
+            diff << std::hex;
+            if (ref.pc != core.pc)
+                diff << " pc: iss 0x" << ref.pc << " core 0x" << core.pc;
+            if (ref.rd != core.rd)
+                diff << " rd: iss x" << std::dec << ref.rd << " core x" << core.rd << std::hex;
+            else if (ref.rd != 0 && ref.rd_data != core.rd_data)
+                diff << " x" << std::dec << ref.rd << std::hex << ": iss 0x" << ref.rd_data << " core 0x" << core.rd_data;
+            if (ref.store != core.store)
+                diff << " store: iss " << ref.store << " core " << core.store;
+            else if (ref.store && (ref.addr != core.addr || ref.mem_data != core.mem_data))
+                diff << " dmem: iss [0x" << ref.addr << "]=0x" << ref.mem_data << " core [0x" << core.addr << "]=0x" << core.mem_data;
+
+            if (!diff.str().empty()) {
+                std::cout << "LOCKSTEP: divergence at instruction " << std::dec << lockstep_checked
+                          << " (pc 0x" << std::hex << ref.pc << ", insn 0x" << ref.insn << "):" << diff.str()
+                          << std::dec << std::endl;
+                lockstep_failed = true;
+                return;
+            }
+            lockstep_checked++;
+        }
+    }
+
     // Scheduling node add
+    // Runs the golden model on the packet just ranked by the core and
+    // compares the scheduler state words, rank included. After a mismatch
+    // the model continues from the core's state.
+    void ref_check(const rank_packet_t & pkt, unsigned long long n) {
+        uint32_t w[RANK_META_WORDS];
+        rank_meta_words(pkt, w);
+        for (int i = 0; i < RANK_META_WORDS; i++)
+            ref_dmem[(layout.meta >> 2) + i] = w[i];
+        rank_ref_mem m(ref_dmem.data(), ref_dmem.size());
+        bool ok = ref_model(m, layout);
+        ref_checked++;
+
+        bool diverged = false;
+        if (!ok && ref_errors < 10)
+            std::cout << "REF: packet " << n << " flow " << (unsigned) pkt.flow_id
+                      << ": model stopped on an access outside the DMEM" << std::endl;
+        for (unsigned addr = layout.state_lo(); addr < layout.state_hi(); addr += 4) {
+            uint32_t core = dmem.read(addr >> 2).to_uint();
+            if (core == ref_dmem[addr >> 2])
+                continue;
+            if (ok && !diverged && ref_errors < 10)
+                std::cout << "REF: packet " << n << " flow " << (unsigned) pkt.flow_id << ": DMEM[0x" << std::hex
+                          << addr << "] core 0x" << core << " model 0x" << ref_dmem[addr >> 2] << std::dec
+                          << std::endl;
+            diverged = true;
+            ref_dmem[addr >> 2] = core;
+        }
+        if (diverged || !ok)
+            ref_errors++;
+    }
+
     void inject_packet_metadata(unsigned addr, sc_uint<XLEN> value) {
         if (addr < DCACHE_SIZE) {
         dmem[addr] = value;
         }
     }
 
-    void run() {
+    // Runs the core until the rank program reaches its end loop.
+    void run_packet() {
+        do {
+            wait();
+            cycle_count++;
+            topdown_sample_t s = sample_core();
+            topdown.sample(s);
+            if (profiler)
+                profiler->sample(s);
+            if (checker)
+                lockstep_check();
+        } while (!program_end.read());
+        topdown.end_packet();
+        if (profiler)
+            profiler->end_packet();
+    }
+
+    // Lets the instructions behind program_end drain (the end loop is
+    // fetched before the last stores write back).
+    void drain_core() {
+        for (int i = 0; i < PARK_DRAIN_CYCLES; i++) {
+            wait();
+            cycle_count++;
+            idle_cycles++;
+            if (checker)
+                lockstep_check();
+        }
+    }
+
+    // Idles the parked core up to cycle `until`. With --idle-skip the core
+    // processes are suspended meanwhile, so the kernel only advances the
+    // clock.
+    void idle_until(unsigned long long until) {
+        if (until <= cycle_count)
+            return;
+
+        unsigned long long n = until - cycle_count;
+        if (idle_skip) {
+            freeze_core(true);
+            skipped_cycles += n;
+        }
+        cycle_count += n;
+        idle_cycles += n;
+        while (n > 0) {
+            int step = n > INT_MAX ? INT_MAX : (int) n;
+            wait(step);
+            n -= step;
+        }
+        if (idle_skip)
+            freeze_core(false);
+    }
+
+    // Suspends (or resumes) the core and memory processes.
+    void freeze_core(bool frozen) {
+        for (size_t i = 0; i < core_procs.size(); i++) {
+            if (frozen)
+                core_procs[i].suspend();
+            else
+                core_procs[i].resume();
+        }
+    }
+
+    // Drives the active-low reset of the core, logged for replay.
+    void set_reset(bool active) {
+        rst.write(!active);
+        if (chan_log::recording())
+            chan_log::get().record_reset(!active);
+    }
+
+    // Reset pulse that restarts the rank program from PC 0. IMEM and DMEM
+    // keep their contents, as in the scheduling node.
+    void restart_core() {
+        set_reset(true);
+        wait();
+        set_reset(false);
+        wait();
+        cycle_count += 2;
+        idle_cycles += 2;
+        last_retired = m_dut.wb.retired.read();
+        if (checker) {
+            m_dut.wb.retire_log.clear();
+            checker->reset();
+        }
+    }
+
+    void inject_packet(const rank_packet_t & pkt) {
+        uint32_t meta[RANK_META_WORDS];
+        rank_meta_words(pkt, meta);
+        for (int i = 0; i < RANK_META_WORDS; i++) {
+            inject_packet_metadata((layout.meta >> 2) + i, meta[i]);
+            if (checker)
+                checker->write_dmem(layout.meta + 4 * i, meta[i]);
+        }
+    }
+
+    bool queueing() const {
+        return pifo_depth || link > 0;
+    }
+
+    void queue_ranked(const rank_packet_t & pkt, unsigned rank, unsigned long long ingress) {
+        if (!queueing())
+            return;
+        if (link > 0) {
+            transmit(cycle_count);
+            if (link_free < cycle_count)
+                link_free = cycle_count;
+        }
+        if (egress_log.is_open()) {
+            packet_log_rec_t r;
+            r.seq = pifo.next_seq(); // the PIFO's enqueue index
+            r.ingress = ingress;
+            r.enqueue = cycle_count;
+            r.rank = rank;
+            r.flow_id = pkt.flow_id;
+            r.length = pkt.length;
+            r.priority = pkt.priority;
+            r.tos = pkt.tos;
+            r.payload_ptr = pkt.payload_ptr;
+            egress_pending[r.seq] = r;
+        }
+        pifo.enqueue(pkt, rank);
+        if (!(link > 0))
+            dequeue_packets(pifo_depth - 1);
+    }
+
+    // Dequeues until at most keep packets are left.
+    void dequeue_packets(size_t keep) {
+        rank_packet_t p;
+        uint32_t rank;
+        uint64_t seq;
+        while (pifo.size() > keep && pifo.dequeue(p, & rank, & seq))
+            depart(p, rank, seq, cycle_count);
+    }
+
+    // --link: dequeues the packets whose transmission starts before cycle
+    // until.
+    void transmit(double until) {
+        rank_packet_t p;
+        uint32_t rank;
+        uint64_t seq;
+        while (link_free < until && pifo.dequeue(p, & rank, & seq)) {
+            depart(p, rank, seq, (unsigned long long) link_free);
+            link_free += p.length / link;
+        }
+    }
 
+    void depart(const rank_packet_t & p, uint32_t rank, uint64_t seq, unsigned long long cycle) {
+        std::cout << "DEQ " << seq << " " << (unsigned) p.flow_id << " " << (unsigned) p.length << " " << rank
+                  << std::endl;
+        std::unordered_map < uint64_t, packet_log_rec_t >::iterator it = egress_pending.find(seq);
+        if (it != egress_pending.end()) {
+            it->second.dequeue = cycle;
+            egress_log.write(it->second);
+            egress_pending.erase(it);
+        }
+    }
+
+    // --checkpoint-at: with the core parked after packet `ranked`, saves the
+    // checkpoint if the packet count is reached, or idles to the cycle if it
+    // falls before the next arrival.
+    void checkpoint_between(unsigned long long ranked, unsigned long long next_arrival) {
+        if (checkpoint_path.empty() || checkpoint_taken || checkpoint_at == 0)
+            return;
+        if (checkpoint_at_cycle) {
+            if (checkpoint_at >= next_arrival)
+                return;
+            idle_until(checkpoint_at);
+        } else if (ranked < checkpoint_at) {
+            return;
+        }
+        save_checkpoint();
+    }
+
+    // Packet loop on the core. The first packet (the example one without
+    // --packets) is injected right after reset, later ones on their
+    // arrival cycle once the core is parked.
+    void run_timed(rank_packet_t & pkt) {
+        unsigned long long arrival = cycle_count;
+        unsigned long long ranked = 0;
+        if (have_packets && !packets.next(pkt, & arrival))
+            return;
+        while (true) {
+            inject_packet(pkt);
+            run_packet();
+            if (!have_packets)
+                break;
+            drain_core();
+            unsigned rank = dmem[layout.out >> 2].to_uint();
+            if (ref_model)
+                ref_check(pkt, ranked);
+            std::cout << "RANK " << ranked++ << " flow " << (unsigned) pkt.flow_id << " " << rank << std::endl;
+            queue_ranked(pkt, rank, arrival);
+            if (!packets.next(pkt, & arrival))
+                break;
+            checkpoint_between(ranked, arrival);
+            idle_until(arrival);
+            restart_core();
+        }
+    }
+
+    // Packet loop of --sample: detailed windows on the core, functional
+    // execution on the ISS in between, DMEM handed over at the boundaries.
+    // Arrival times are ignored, packets are ranked back to back.
+    void run_sampled() {
+        functional = new iss();
+        functional->set_entry(entry_pc.read().to_uint());
+        for (unsigned i = 0; i < ICACHE_SIZE; i++)
+            functional->write_imem(i << 2, imem.read(i).to_uint());
+        for (unsigned i = 0; i < DCACHE_SIZE; i++)
+            functional->write_dmem(i << 2, dmem.read(i).to_uint());
+
+        rank_packet_t pkt;
+        unsigned long long n = 0;
+        bool core_fresh = true; // just out of reset
+        bool in_window = true; // DMEM of the core is current
+        while (packets.next(pkt)) {
+            unsigned rank;
+            if (sampler.detailed(n)) {
+                if (!in_window) {
+                    for (unsigned i = 0; i < DCACHE_SIZE; i++)
+                        dmem.write(i, functional->read_dmem(i << 2));
+                    in_window = true;
+                }
+                if (!core_fresh)
+                    restart_core();
+                core_fresh = false;
+
+                unsigned long long start = cycle_count;
+                inject_packet(pkt);
+                run_packet();
+                sampler.add_detailed(cycle_count - start, icount.read());
+                drain_core();
+                rank = dmem[layout.out >> 2].to_uint();
+            } else {
+                if (in_window) {
+                    for (unsigned i = 0; i < DCACHE_SIZE; i++)
+                        functional->write_dmem(i << 2, dmem.read(i).to_uint());
+                    in_window = false;
+                }
+                uint32_t meta[RANK_META_WORDS];
+                rank_meta_words(pkt, meta);
+                for (int i = 0; i < RANK_META_WORDS; i++)
+                    functional->write_dmem(layout.meta + 4 * i, meta[i]);
+                functional->reset();
+                if (functional->run(MAX_INSNS_PER_PACKET) != iss::ISS_END) {
+                    SC_REPORT_ERROR(sc_object::name(), "Rank program did not end on the ISS.");
+                    break;
+                }
+                rank = functional->read_dmem(layout.out);
+            }
+            sampler.add_packet();
+            std::cout << "RANK " << n++ << " flow " << (unsigned) pkt.flow_id << " " << rank << std::endl;
+            queue_ranked(pkt, rank, cycle_count);
+        }
+        if (!in_window) {
+            for (unsigned i = 0; i < DCACHE_SIZE; i++)
+                dmem.write(i, functional->read_dmem(i << 2));
+        }
+    }
+
+    void load_word(unsigned index, unsigned data) {
+        imem[index] = (ac_int<32, false>) data;
+        TRACE(TR_LOADER, TR_INFO, TR_LOAD_WORD, index, data);
+        dmem[index] = imem[index];
+    }
+
+    // notmain.txt, "<address> <word>" per line (schedulers/srec2text.py).
+    bool load_text() {
         std::ifstream load_program;
         load_program.open(testing_program, std::ifstream:: in );
-        unsigned index;
         unsigned address;
         unsigned data;
-        
-        while (load_program >> std::hex >> address) {
 
-            index = address >> 2;
-            if (index >= ICACHE_SIZE) {
+        while (load_program >> std::hex >> address) {
+            if ((address >> 2) >= ICACHE_SIZE) {
                 SC_REPORT_ERROR(sc_object::name(), "Program larger than memory size.");
-                sc_stop();
-                return;
+                return false;
             }
             load_program >> data;
-            imem[index] = (ac_int<32, false>) data;
-            std::cout << "imem[" << index << "]=" << imem[index] << endl;
-            dmem[index] = imem[index];
+            load_word(address >> 2, data);
+        }
+        return true;
+    }
+
+    // notmain.elf, mapped and copied from its PT_LOAD segments in one pass.
+    // The same file serves the profile symbols (unless --elf names another
+    // one) and the rank ABI addresses.
+    bool load_elf() {
+        elf_file other;
+        elf_file & program = elf.path().empty() || elf.path() == testing_program ? elf : other;
+        if (program.path() != testing_program && !program.open(testing_program)) {
+            SC_REPORT_ERROR(sc_object::name(), program.error().c_str());
+            return false;
         }
+        entry_pc.write(program.entry());
 
-        load_program.close();
+        bool fits = true;
+        bool ok = program.for_each_load_word([this, &fits](unsigned addr, unsigned word) {
+            if ((addr >> 2) >= ICACHE_SIZE)
+                fits = false;
+            else
+                load_word(addr >> 2, word);
+        });
+        if (!ok) {
+            SC_REPORT_ERROR(sc_object::name(), "Truncated or unaligned ELF segment.");
+            return false;
+        }
+        if (!fits) {
+            SC_REPORT_ERROR(sc_object::name(), "Program larger than memory size.");
+            return false;
+        }
+        layout.from_symbols(program);
+        return true;
+    }
 
-        rst.write(0);
+    void run() {
+
+        std::chrono::steady_clock::time_point wall_start = std::chrono::steady_clock::now();
+        if (!(elf_file::is_elf(testing_program) ? load_elf() : load_text())) {
+            sc_stop();
+            return;
+        }
+
+        set_reset(true);
         wait(5);
-        rst.write(1);
+        if (!restore_path.empty()) {
+            // The state is loaded with reset released and the core frozen,
+            // so neither the reset code nor the pipeline races the load.
+            // A reset pulse then starts the first packet at the entry PC,
+            // like at every packet boundary of the saved run.
+            freeze_core(true);
+            set_reset(false);
+            wait();
+            bool restored = restore_checkpoint();
+            set_reset(true);
+            wait();
+            freeze_core(false);
+            if (!restored) {
+                sc_stop();
+                return;
+            }
+        }
+        set_reset(false);
         wait();
 
         // Packet injection
-        unsigned base_addr = 0x100 >> 2;
-        unsigned weight_addr = 0x180 >> 2;
-        unsigned deq_cycle_addr = 0x210 >> 2;
-        sc_uint<16> flow_id = 0x01;
         sc_uint<32> quantum = 128;      // Example quantum value
         sc_uint<32> deq_cycle = 0x10;   // Example dequeue cycle value
 
         // Example packet fields
-        sc_uint<32> src         = 0x01;
-        sc_uint<32> dst         = 0x02;
-        sc_uint<16> length      = 64;
-        sc_uint<8>  tos         = 0x1;
-        sc_uint<3>  priority    = 5;
-        sc_uint<16> arrival     = 0x10;
-        sc_uint<32> payload_ptr = 0xDEADBEEF;
-
-        // Inject packet metadata
-        inject_packet_metadata(base_addr + 0, src);
-        inject_packet_metadata(base_addr + 1, dst);
-        inject_packet_metadata(base_addr + 2, (length & 0xFFFF) | ((tos & 0xFF) << 16) | ((priority & 0x7) << 24));
-        inject_packet_metadata(base_addr + 3, (flow_id & 0xFFFF) | ((arrival & 0xFFFF) << 16));
-        inject_packet_metadata(base_addr + 4, payload_ptr);
-
-        // Inject quantum (weight) for the flow
-        inject_packet_metadata(weight_addr + flow_id, quantum);
-
-        // Inject dequeue cycle
-        inject_packet_metadata(deq_cycle_addr, deq_cycle);
-
-        cycle_count = 0;
-        do {
-            wait();
-            cycle_count++;
-        } while (!program_end.read());
+        rank_packet_t pkt;
+        pkt.src          = 0x01;
+        pkt.dst          = 0x02;
+        pkt.length       = 64;
+        pkt.tos          = 0x1;
+        pkt.priority     = 5;
+        pkt.flow_id      = 0x01;
+        pkt.arrival_time = 0x10;
+        pkt.payload_ptr  = 0xDEADBEEF;
+
+        // A restored DMEM already holds the weights and dequeue cycle
+        if (restore_path.empty()) {
+            // Inject the flows' weight (WFQ) and quantum (DRR)
+            if (have_packets) {
+                for (unsigned f = 0; f < RANK_MAX_FLOWS; f++) {
+                    sc_uint<32> w = have_workload ? sc_uint<32>(workload.weight(f)) : quantum;
+                    inject_packet_metadata((layout.weight >> 2) + f, w);
+                    inject_packet_metadata((layout.quantum >> 2) + f, w);
+                }
+            } else {
+                inject_packet_metadata((layout.weight >> 2) + pkt.flow_id, quantum);
+                inject_packet_metadata((layout.quantum >> 2) + pkt.flow_id, quantum);
+            }
+
+            // Inject dequeue cycle
+            inject_packet_metadata(layout.deq_cycle >> 2, deq_cycle);
+        }
+
+        if (checker) {
+            checker->set_entry(entry_pc.read().to_uint());
+            checker->reset();
+            for (unsigned i = 0; i < ICACHE_SIZE; i++)
+                checker->write_imem(i << 2, imem.read(i).to_uint());
+            for (unsigned i = 0; i < DCACHE_SIZE; i++)
+                checker->write_dmem(i << 2, dmem.read(i).to_uint());
+        }
+
+        if (ref_model) {
+            ref_dmem.resize(DCACHE_SIZE);
+            for (unsigned i = 0; i < DCACHE_SIZE; i++)
+                ref_dmem[i] = dmem.read(i).to_uint();
+        }
+
+        last_retired = 0;
+
+        if (sampler.enabled())
+            run_sampled();
+        else
+            run_timed(pkt);
         wait(5);
         // cycle_count += 5; // Final 5 cycles
+        // The queued packets are saved before the final drain, so a
+        // restored run dequeues them with its own packets.
+        if (!checkpoint_path.empty() && !checkpoint_taken) {
+            if (checkpoint_at == 0)
+                save_checkpoint();
+            else
+                std::cout << "Checkpoint point not reached, " << checkpoint_path << " not written" << std::endl;
+        }
+        if (link > 0)
+            transmit(HUGE_VAL);
+        else
+            dequeue_packets(0);
         
         sc_stop();
+        kanata_trace::get().close();
+        trace_ring::get().close();
+        chan_log::get().close();
+        egress_log.close();
         int dmem_index;
         for (dmem_index = 0; dmem_index < 400; dmem_index++) {
-            std::cout << "dmem[" << dmem_index << "]=" << dmem[dmem_index] << endl;
+            std::cout << "dmem[" << dmem_index << "]=" << dmem.read(dmem_index) << endl;
         }
         std::cout << "wait_stalls " << wait_stalls << endl;
 
@@ -249,22 +991,248 @@ class Top: public sc_module {
         std::cout << "   MEM   : " << m_icount_end << std::endl;
         std::cout << "   OTHER : " << o_icount_end << std::endl;
         std::cout << "   CYCLES COUNT: " << cycle_count << std::endl;
+        if (have_packets)
+            std::cout << "   IDLE CYCLES : " << idle_cycles << " (skipped " << skipped_cycles << ")" << std::endl;
+        imem.print_stats(std::cout, "   IMEM PAGES  : ");
+        dmem.print_stats(std::cout, "   DMEM PAGES  : ");
+        double wall = std::chrono::duration < double > (std::chrono::steady_clock::now() - wall_start).count();
+        if (wall > 0)
+            std::cout << "   SIM SPEED   : " << (unsigned long long)((cycle_count - skipped_cycles) / wall) << " cycles/s" << std::endl;
+
+        topdown.print(std::cout, testing_program);
+
+        if (sampler.enabled())
+            sampler.print(std::cout);
+
+        if (checker && !lockstep_failed)
+            std::cout << "LOCKSTEP: " << lockstep_checked << " instructions match the ISS" << std::endl;
+
+        if (ref_model)
+            std::cout << "REF: " << ref_checked - ref_errors << " of " << ref_checked
+                      << " packets match the golden model" << std::endl;
+
+        if (profiler) {
+            std::ofstream out(profile_path.c_str());
+            profiler->report(out, elf.path().empty() ? NULL : &elf, [this](unsigned pc) {
+                return (pc >> 2) < ICACHE_SIZE ? imem.read(pc >> 2).to_uint() : 0u;
+            });
+            std::cout << "Profile written to " << profile_path << std::endl;
+        }
 
     }
 
 };
 
+// Category list for --trace-mask: "all", a hex mask, or names separated by ','.
+static bool parse_trace_mask(const std::string & spec, uint32_t & mask) {
+    if (spec == "all") {
+        mask = (1u << TR_CAT_NUM) - 1;
+        return true;
+    }
+    if (spec.compare(0, 2, "0x") == 0) {
+        mask = strtoul(spec.c_str(), NULL, 16);
+        return true;
+    }
+    mask = 0;
+    size_t start = 0;
+    while (start <= spec.size()) {
+        size_t comma = spec.find(',', start);
+        std::string name = spec.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        int cat = 0;
+        while (cat < TR_CAT_NUM && name != trace_cat_names[cat])
+            cat++;
+        if (cat == TR_CAT_NUM)
+            return false;
+        mask |= 1u << cat;
+        if (comma == std::string::npos)
+            break;
+        start = comma + 1;
+    }
+    return true;
+}
+
 int sc_main(int argc, char * argv[]) {
 
     if (argc == 1) {
-        std::cerr << "Usage: " << argv[0] << " <testing_program>" << std::endl;
-        std::cerr << "where:  <testing_program> - path to .txt file of the testing program" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <testing_program> [options]" << std::endl;
+        std::cerr << "where:  <testing_program> - notmain.elf of the testing program, or its .txt image" << std::endl;
+        std::cerr << "options:" << std::endl;
+        std::cerr << "  --topdown <lo>:<hi>[:name]  - also report top-down cycles for a PC range (repeatable)" << std::endl;
+        std::cerr << "  --kanata <file>             - write a Kanata pipeline trace (view with Konata)" << std::endl;
+        std::cerr << "  --profile <file>            - write a per-PC cycle profile" << std::endl;
+        std::cerr << "  --elf <notmain.elf>         - resolve profile PCs against the ELF symbols and line info" << std::endl;
+        std::cerr << "                                (default: the testing program if it is an ELF)" << std::endl;
+        std::cerr << "  --lockstep                  - check every written-back instruction against the ISS" << std::endl;
+        std::cerr << "  --ref <sp|drr|wfq>          - with --packets, check every rank and the scheduler state" << std::endl;
+        std::cerr << "                                against the golden model (rank_ref.h)" << std::endl;
+        std::cerr << "  --packets <file>            - rank these packets (flow_id length [priority [arrival]]," << std::endl;
+        std::cerr << "                                or a .csv or pcap trace), each injected on its arrival cycle" << std::endl;
+        std::cerr << "  --gen <spec>                - rank a seeded synthetic workload, e.g. flows=8,load=0.7," << std::endl;
+        std::cerr << "                                arrival=onoff,length=imix,weights=1:2:4:8 (see traffic_gen.h);" << std::endl;
+        std::cerr << "                                its weights are written to WEIGHT_TABLE and QUANTUM_TABLE" << std::endl;
+        std::cerr << "  --rate <cycles>             - with --packets, one arrival every <cycles> instead" << std::endl;
+        std::cerr << "  --idle-skip                 - fast-forward the parked core between packets" << std::endl;
+        std::cerr << "  --sample <k>[:<n>]          - with --packets, simulate n packets of every k on the core" << std::endl;
+        std::cerr << "                                and the others on the ISS; report CPI and latency estimates" << std::endl;
+        std::cerr << "  --pifo <depth>              - with --packets, queue the ranked packets in a PIFO and print" << std::endl;
+        std::cerr << "                                the dequeue order (one dequeue per packet once <depth> are held)" << std::endl;
+        std::cerr << "  --link <b>                  - with --packets, queue the ranked packets in a PIFO that drains" << std::endl;
+        std::cerr << "                                onto a link of b bytes per cycle instead of at a fixed depth" << std::endl;
+        std::cerr << "  --pkt-log <file>            - with --link, log every dequeued packet with its arrival, rank," << std::endl;
+        std::cerr << "                                enqueue and dequeue cycles (.csv, or binary, see packet_log.h)" << std::endl;
+        std::cerr << "  --checkpoint <file>         - save the simulator state once the last packet is ranked" << std::endl;
+        std::cerr << "  --checkpoint-at <cycle|packet>" << std::endl;
+        std::cerr << "                              - save it instead at cycle:<n> (the first parked cycle from n)" << std::endl;
+        std::cerr << "                                or after packet:<n> packets" << std::endl;
+        std::cerr << "  --restore <file>            - start from a saved state instead of a fresh DMEM" << std::endl;
+        std::cerr << "  --chan-log <file>           - record every inter-module channel for replay (see replay/)" << std::endl;
+        std::cerr << "  --trace <file>              - write a binary event trace (decode with tools/trace_decode)" << std::endl;
+        std::cerr << "  --trace-mask <cats>         - traced categories: all, 0x<mask> or a list of" << std::endl;
+        std::cerr << "                                fetch,decode,execute,writeback,imem,dmem,loader (default all)" << std::endl;
+        std::cerr << "  --trace-level <1-3>         - 1 info, 2 debug, 3 verbose (default 2)" << std::endl;
         return -1;
     }
 
     std::string testing_program = argv[1];
 
     Top top("top", testing_program);
+
+    std::string trace_path;
+    std::string chan_log_path;
+    std::string pkt_log_path;
+    uint32_t trace_mask = (1u << TR_CAT_NUM) - 1;
+    int trace_level = TR_DEBUG;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--topdown" && i + 1 < argc) {
+            if (!top.topdown.add_range(argv[++i])) {
+                std::cerr << "Invalid PC range: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--kanata" && i + 1 < argc) {
+            if (!kanata_trace::get().open(argv[++i], top.clk.period())) {
+                std::cerr << "Cannot open " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--profile" && i + 1 < argc) {
+            top.profile_path = argv[++i];
+            top.profiler = new pc_profiler();
+        } else if (arg == "--elf" && i + 1 < argc) {
+            if (!top.elf.open(argv[++i])) {
+                std::cerr << top.elf.error() << std::endl;
+                return -1;
+            }
+        } else if (arg == "--lockstep") {
+            top.enable_lockstep();
+        } else if (arg == "--ref" && i + 1 < argc) {
+            top.ref_model = rank_ref_model(argv[++i]);
+            if (!top.ref_model) {
+                std::cerr << "No golden model for " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--packets" && i + 1 < argc) {
+            if (!top.open_packets(argv[++i])) {
+                std::cerr << "Cannot open " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--gen" && i + 1 < argc) {
+            if (!top.open_workload(argv[++i])) {
+                std::cerr << "Invalid workload: " << top.workload.error() << std::endl;
+                return -1;
+            }
+        } else if (arg == "--rate" && i + 1 < argc) {
+            top.packets.set_rate(strtoull(argv[++i], NULL, 0));
+        } else if (arg == "--idle-skip") {
+            top.idle_skip = true;
+        } else if (arg == "--sample" && i + 1 < argc) {
+            if (!top.sampler.configure(argv[++i])) {
+                std::cerr << "Invalid sampling: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--pifo" && i + 1 < argc) {
+            top.pifo_depth = atoi(argv[++i]);
+        } else if (arg == "--link" && i + 1 < argc) {
+            top.link = strtod(argv[++i], NULL);
+        } else if (arg == "--pkt-log" && i + 1 < argc) {
+            pkt_log_path = argv[++i];
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            top.checkpoint_path = argv[++i];
+        } else if (arg == "--checkpoint-at" && i + 1 < argc) {
+            if (!top.parse_checkpoint_at(argv[++i])) {
+                std::cerr << "Invalid checkpoint point: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--restore" && i + 1 < argc) {
+            top.restore_path = argv[++i];
+        } else if (arg == "--chan-log" && i + 1 < argc) {
+            chan_log_path = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--trace-mask" && i + 1 < argc) {
+            if (!parse_trace_mask(argv[++i], trace_mask)) {
+                std::cerr << "Invalid trace mask: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--trace-level" && i + 1 < argc) {
+            trace_level = atoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return -1;
+        }
+    }
+
+    if (top.sampler.enabled() && (!top.have_packets || top.checker)) {
+        std::cerr << "--sample needs --packets or --gen and excludes --lockstep" << std::endl;
+        return -1;
+    }
+
+    if (top.ref_model && (!top.have_packets || top.sampler.enabled())) {
+        std::cerr << "--ref needs --packets or --gen and excludes --sample" << std::endl;
+        return -1;
+    }
+
+    if (top.queueing() && !top.have_packets) {
+        std::cerr << "--pifo and --link need --packets or --gen" << std::endl;
+        return -1;
+    }
+
+    if (top.link > 0 && top.sampler.enabled()) {
+        std::cerr << "--link excludes --sample" << std::endl;
+        return -1;
+    }
+
+    if (top.checkpoint_at && (top.checkpoint_path.empty() || !top.have_packets || top.sampler.enabled())) {
+        std::cerr << "--checkpoint-at needs --checkpoint and --packets or --gen, and excludes --sample" << std::endl;
+        return -1;
+    }
+
+    if (!pkt_log_path.empty()) {
+        // Without a link, the dequeue cycles would only reflect --pifo.
+        if (!(top.link > 0)) {
+            std::cerr << "--pkt-log needs --link" << std::endl;
+            return -1;
+        }
+        if (!top.egress_log.open(pkt_log_path)) {
+            std::cerr << "Cannot open " << pkt_log_path << std::endl;
+            return -1;
+        }
+    }
+
+    if (!trace_path.empty() &&
+        !trace_ring::get().open(trace_path.c_str(), top.clk.period().value(), trace_mask, trace_level)) {
+        std::cerr << "Cannot open " << trace_path << std::endl;
+        return -1;
+    }
+    if (!chan_log_path.empty()) {
+        if (!chan_log::get().open(chan_log_path.c_str(), top.clk.period().value())) {
+            std::cerr << "Cannot open " << chan_log_path << std::endl;
+            return -1;
+        }
+        chan_log_probe * probe = new chan_log_probe("chan_log_probe");
+        probe->clk(top.clk);
+        top.m_dut.log_signals(* probe);
+    }
     sc_start();
     return 0;
 }
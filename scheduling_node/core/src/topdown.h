@@ -0,0 +1,175 @@
+/*
+	@brief
+	Top-down cycle accounting for the DRIM pipeline (simulation only).
+	Every simulated cycle is attributed to exactly one bucket, using the
+	performance monitor event lines of the core (see execute::hpm_th):
+
+		retiring        - an instruction was written back
+		bad speculation - bubble caused by a taken branch/jump
+		backend memory  - load in flight / writeback waiting on DMEM
+		backend core    - divider busy or unforwardable RAW hazard
+		frontend        - everything else (IMEM wait, pipeline empty)
+
+	Cycles are accumulated for the whole program and for any number of
+	user-defined PC ranges. A range is charged at retirement, like the
+	per-PC profile (pc_profiler.h): the cycles since the previous
+	write-back go to the PC of the instruction that retires, so stall
+	cycles land on the instruction that waited for them. Cycles after the
+	last retirement of a packet only count for the whole program.
+
+*/
+
+#ifndef __TOPDOWN__H
+#define __TOPDOWN__H
+
+#ifndef __SYNTHESIS__
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "globals.h"
+
+enum topdown_bucket_t {
+    TD_RETIRING = 0,
+    TD_FRONTEND,
+    TD_BAD_SPEC,
+    TD_BACKEND_MEM,
+    TD_BACKEND_CORE,
+    TD_NUM
+};
+
+static const char * const topdown_bucket_name[TD_NUM] = {
+    "retiring",
+    "frontend",
+    "bad-speculation",
+    "backend-memory",
+    "backend-core"
+};
+
+// State of the core in one cycle, as sampled by the testbench.
+struct topdown_sample_t {
+    bool retire;
+    unsigned retire_pc; // PC written back, valid if retire
+    unsigned events; // HPM event lines, bit i = event i
+
+    topdown_sample_t(): retire(false), retire_pc(0), events(0) {}
+};
+
+inline topdown_bucket_t topdown_classify(const topdown_sample_t & s) {
+    if (s.retire)
+        return TD_RETIRING;
+    if (s.events & (1u << HPM_EV_FLUSH))
+        return TD_BAD_SPEC;
+    if (s.events & ((1u << HPM_EV_LOAD_WAIT) | (1u << HPM_EV_DMEM_WAIT)))
+        return TD_BACKEND_MEM;
+    if (s.events & ((1u << HPM_EV_DIV_BUSY) | (1u << HPM_EV_RAW_STALL)))
+        return TD_BACKEND_CORE;
+    return TD_FRONTEND;
+}
+
+class topdown_report {
+    public:
+    topdown_report() {
+        clear(total);
+        end_packet();
+        total.name = "program";
+        total.lo = 0;
+        total.hi = 0xFFFFFFFF;
+    }
+
+    // Adds a [lo, hi] PC range. Spec is "lo:hi[:name]", addresses in hex or dec.
+    bool add_range(const std::string & spec) {
+        std::vector < std::string > f;
+        size_t start = 0, colon;
+        while ((colon = spec.find(':', start)) != std::string::npos) {
+            f.push_back(spec.substr(start, colon - start));
+            start = colon + 1;
+        }
+        f.push_back(spec.substr(start));
+        if (f.size() < 2 || f.size() > 3 || f[0].empty() || f[1].empty())
+            return false;
+
+        range_t r;
+        clear(r);
+        r.lo = strtoul(f[0].c_str(), NULL, 0);
+        r.hi = strtoul(f[1].c_str(), NULL, 0);
+        r.name = (f.size() == 3) ? f[2] : spec;
+        if (r.lo > r.hi)
+            return false;
+        ranges.push_back(r);
+        return true;
+    }
+
+    void sample(const topdown_sample_t & s) {
+        topdown_bucket_t b = topdown_classify(s);
+        total.cycles[b]++;
+        pending[b]++;
+        if (!s.retire)
+            return;
+        for (size_t i = 0; i < ranges.size(); i++) {
+            if (s.retire_pc >= ranges[i].lo && s.retire_pc <= ranges[i].hi) {
+                for (int j = 0; j < TD_NUM; j++)
+                    ranges[i].cycles[j] += pending[j];
+            }
+        }
+        end_packet();
+    }
+
+    // Drops the cycles after the last retirement (the core is restarted
+    // before the next packet).
+    void end_packet() {
+        for (int i = 0; i < TD_NUM; i++)
+            pending[i] = 0;
+    }
+
+    unsigned long long cycles(topdown_bucket_t b) const {
+        return total.cycles[b];
+    }
+
+    void print(std::ostream & os, const std::string & program) const {
+        os << "TOP-DOWN: " << program << std::endl;
+        print_range(os, total);
+        for (size_t i = 0; i < ranges.size(); i++)
+            print_range(os, ranges[i]);
+    }
+
+    private:
+    struct range_t {
+        std::string name;
+        unsigned lo;
+        unsigned hi;
+        unsigned long long cycles[TD_NUM];
+    };
+
+    range_t total;
+    std::vector < range_t > ranges;
+    unsigned long long pending[TD_NUM]; // cycles since the last retirement
+
+    static void clear(range_t & r) {
+        for (int i = 0; i < TD_NUM; i++)
+            r.cycles[i] = 0;
+    }
+
+    static void print_range(std::ostream & os, const range_t & r) {
+        unsigned long long sum = 0;
+        for (int i = 0; i < TD_NUM; i++)
+            sum += r.cycles[i];
+
+        os << "  " << r.name << " [0x" << std::hex << r.lo << "-0x" << r.hi << std::dec << "] "
+           << sum << " cycles" << std::endl;
+        for (int i = 0; i < TD_NUM; i++) {
+            double pct = sum ? 100.0 * r.cycles[i] / sum : 0.0;
+            os << "    " << std::left << std::setw(16) << topdown_bucket_name[i] << std::right
+               << std::setw(12) << r.cycles[i] << std::setw(8) << std::fixed << std::setprecision(1)
+               << pct << " %" << std::endl;
+        }
+        os.unsetf(std::ios::fixed);
+    }
+};
+
+#endif // __SYNTHESIS__
+
+#endif // __TOPDOWN__H
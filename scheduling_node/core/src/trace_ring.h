@@ -0,0 +1,292 @@
+/*
+	@brief
+	Binary event trace (simulation only). Replaces the per-cycle std::cout
+	logging of the pipeline stages and memories.
+
+	Events are fixed-size records pushed into a lock-free single-producer /
+	single-consumer ring (record_ring, also used by packet_log.h); a
+	background thread drains the ring to a binary file which is decoded
+	offline with tools/trace_decode. Which events are
+	recorded is selected at runtime with a category mask and a verbosity
+	level. When an event is filtered out, TRACE() costs one load and branch.
+
+	Compile with -DTRACE_DISABLE (or for synthesis) to remove every TRACE().
+
+	This header has no SystemC dependency so that the decoder can use the
+	record format and the event tables.
+
+*/
+
+#ifndef __TRACE_RING__H
+#define __TRACE_RING__H
+
+#ifndef __SYNTHESIS__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Categories, one bit each in the runtime mask.
+#define TR_FETCH      0
+#define TR_DECODE     1
+#define TR_EXECUTE    2
+#define TR_WRITEBACK  3
+#define TR_IMEM       4
+#define TR_DMEM       5
+#define TR_LOADER     6
+#define TR_CAT_NUM    7
+
+// Levels: an event is kept if its level is <= the runtime level.
+#define TR_INFO       1
+#define TR_DEBUG      2
+#define TR_VERBOSE    3
+
+// Event codes. The argument layout of each code is in trace_events below.
+#define TR_FE_PC         0
+#define TR_DE_STATE      1
+#define TR_DE_CTRL       2
+#define TR_DE_OPS        3
+#define TR_DE_REGWRITE   4
+#define TR_EXE_OP        5
+#define TR_EXE_OUT       6
+#define TR_EXE_FWD       7
+#define TR_WB_MEM        8
+#define TR_WB_OUT        9
+#define TR_IMEM_READ     10
+#define TR_DMEM_READ     11
+#define TR_DMEM_WRITE    12
+#define TR_LOAD_WORD     13
+#define TR_CODE_NUM      14
+
+struct trace_rec_t {
+    uint64_t time; // simulation time, in time resolution units (see period)
+    uint16_t code;
+    uint8_t cat;
+    uint8_t level;
+    uint32_t arg[4];
+    uint32_t pad;
+};
+
+struct trace_file_hdr_t {
+    char magic[8]; // "DRIMTRC1"
+    uint32_t version;
+    uint32_t rec_size;
+    uint64_t period; // clock period, in time resolution units
+    uint64_t dropped; // events lost because the ring was full
+};
+
+// Argument format: name followed by ':' and x (hex), d (decimal) or a (ALU op).
+struct trace_event_t {
+    const char * name;
+    const char * args[4];
+};
+
+static const char * const trace_cat_names[TR_CAT_NUM] = {
+    "fetch", "decode", "execute", "writeback", "imem", "dmem", "loader"
+};
+
+static const trace_event_t trace_events[TR_CODE_NUM] = {
+    { "pc",       { "pc:x", NULL, NULL, NULL } },
+    { "state",    { "pc:x", "insn:x", "flags:x", NULL } }, // flags: 1 freeze, 2 flush, 4 load pending, 8 flush next
+    { "ctrl",     { "alu_op:a", "alu_src:d", "ld:d", "st:d" } },
+    { "ops",      { "rs1:x", "rs2:x", "dest_reg:d", "imm_u:x" } },
+    { "regwrite", { "reg:d", "data:x", "pc:x", NULL } },
+    { "op",       { "pc:x", "alu_op:a", "alu_res:x", "nop:d" } },
+    { "out",      { "ld:d", "st:d", "regwrite:d", "dest_reg:d" } },
+    { "forward",  { "pc:x", "tag:d", "data:x", NULL } },
+    { "mem",      { "pc:x", "addr:x", "load_data:x", "store_data:x" } },
+    { "out",      { "pc:x", "rd:d", "data:x", "regwrite:d" } },
+    { "read",     { "addr:x", "data:x", NULL, NULL } },
+    { "read",     { "addr:x", "data:x", NULL, NULL } },
+    { "write",    { "addr:x", "data:x", NULL, NULL } },
+    { "word",     { "index:x", "data:x", NULL, NULL } }
+};
+
+// Header-only storage for the runtime filter.
+template < class T > struct trace_state {
+    static uint32_t mask;
+    static int level;
+};
+template < class T > uint32_t trace_state < T >::mask = 0;
+template < class T > int trace_state < T >::level = 0;
+
+inline bool trace_on(int cat, int level) {
+    return ((trace_state < void >::mask >> cat) & 1) && level <= trace_state < void >::level;
+}
+
+// Lock-free single-producer / single-consumer ring of fixed-size records
+// with its drain thread, which hands the published records to a writer in
+// at most two contiguous runs.
+template < class R > class record_ring {
+    public:
+    typedef std::function < void (const R *, size_t) > writer_t;
+
+    record_ring(): cap_mask(0), head(0), tail(0), stop(false), running(false) {}
+
+    ~record_ring() {
+        close();
+    }
+
+    // Starts the drain thread. capacity is rounded up to a power of two
+    // records.
+    void open(size_t capacity, const writer_t & w) {
+        close();
+        size_t cap = 1;
+        while (cap < capacity)
+            cap <<= 1;
+        recs.assign(cap, R());
+        cap_mask = cap - 1;
+        head.store(0);
+        tail.store(0);
+        writer = w;
+        stop.store(false);
+        drainer = std::thread(& record_ring::drain, this);
+        running = true;
+    }
+
+    // Drains the remaining records and stops the thread.
+    void close() {
+        if (!running)
+            return;
+        stop.store(true);
+        drainer.join();
+        running = false;
+    }
+
+    // Producer side: never blocks, false if the ring is full.
+    bool push(const R & r) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) > cap_mask)
+            return false;
+        recs[h & cap_mask] = r;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    private:
+    std::vector < R > recs;
+    uint64_t cap_mask;
+    std::atomic < uint64_t > head;
+    std::atomic < uint64_t > tail;
+    std::atomic < bool > stop;
+    bool running;
+    writer_t writer;
+    std::thread drainer;
+
+    // Consumer side.
+    void drain() {
+        while (true) {
+            bool stopping = stop.load(std::memory_order_acquire);
+            uint64_t t = tail.load(std::memory_order_relaxed);
+            uint64_t h = head.load(std::memory_order_acquire);
+
+            if (t == h) {
+                if (stopping)
+                    return;
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+
+            uint64_t start = t & cap_mask;
+            uint64_t n = h - t;
+            uint64_t first = (start + n > cap_mask + 1) ? cap_mask + 1 - start : n;
+            writer(& recs[start], first);
+            if (n > first)
+                writer(& recs[0], n - first);
+            tail.store(h, std::memory_order_release);
+        }
+    }
+};
+
+class trace_ring {
+    public:
+    static trace_ring & get() {
+        static trace_ring ring;
+        return ring;
+    }
+
+    // Opens the output file and starts the drain thread. capacity is
+    // rounded up to a power of two records.
+    bool open(const char * path, uint64_t period, uint32_t mask, int level, size_t capacity = 1 << 16) {
+        close();
+        out = fopen(path, "wb");
+        if (!out)
+            return false;
+        dropped = 0;
+
+        memset(& hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, "DRIMTRC1", 8);
+        hdr.version = 1;
+        hdr.rec_size = sizeof(trace_rec_t);
+        hdr.period = period;
+        fwrite(& hdr, sizeof(hdr), 1, out);
+
+        FILE * f = out;
+        ring.open(capacity, [f](const trace_rec_t * r, size_t n) { fwrite(r, sizeof(trace_rec_t), n, f); });
+
+        trace_state < void >::mask = mask;
+        trace_state < void >::level = level;
+        return true;
+    }
+
+    // Drains the remaining records and finalizes the header.
+    void close() {
+        if (!out)
+            return;
+        trace_state < void >::mask = 0;
+        ring.close();
+
+        hdr.dropped = dropped;
+        fseek(out, 0, SEEK_SET);
+        fwrite(& hdr, sizeof(hdr), 1, out);
+        fclose(out);
+        out = NULL;
+    }
+
+    // Producer side: never blocks, drops the event if the ring is full.
+    void emit(uint64_t time, int cat, int level, int code, uint32_t a0 = 0, uint32_t a1 = 0, uint32_t a2 = 0, uint32_t a3 = 0) {
+        trace_rec_t r;
+        r.time = time;
+        r.code = code;
+        r.cat = cat;
+        r.level = level;
+        r.arg[0] = a0;
+        r.arg[1] = a1;
+        r.arg[2] = a2;
+        r.arg[3] = a3;
+        r.pad = 0;
+        if (!ring.push(r))
+            dropped++;
+    }
+
+    ~trace_ring() {
+        close();
+    }
+
+    private:
+    record_ring < trace_rec_t > ring;
+    uint64_t dropped;
+    FILE * out;
+    trace_file_hdr_t hdr;
+
+    trace_ring(): dropped(0), out(NULL) {}
+};
+
+#if defined(TRACE_DISABLE)
+#define TRACE(cat, level, code, ...)
+#else
+#define TRACE(cat, level, code, ...) \
+    do { if (trace_on(cat, level)) trace_ring::get().emit(sc_time_stamp().value(), cat, level, code, __VA_ARGS__); } while (0)
+#endif
+
+#else
+#define TRACE(cat, level, code, ...)
+#endif // __SYNTHESIS__
+
+#endif // __TRACE_RING__H
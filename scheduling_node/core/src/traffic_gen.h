@@ -0,0 +1,330 @@
+/*
+	@brief
+	Seeded synthetic workloads for comparing the schedulers (native code,
+	no SystemC dependency). Every flow is an independent arrival process;
+	the generator merges them in time order. A configuration is a list of
+	key=value pairs, e.g.
+
+		flows=8,load=0.7,arrival=onoff,length=imix,weights=1:2:4:8,seed=3
+
+	flows     number of flows (1..RANK_MAX_FLOWS, default 8)
+	packets   packets to generate (default 100000)
+	load      offered load, fraction of the link rate (default 0.5)
+	link      link rate in bytes per cycle (default 1)
+	arrival   poisson    exponential gaps per flow
+	          onoff      exponential on and off periods (on=, off= mean
+	                     cycles, default 1000 each), at the peak rate
+	                     while on: a packet's wire time plus an
+	                     exponential gap. A peak rate above the link rate
+	                     is rejected.
+	          burst      bursts of burst= packets (default 16) back to back,
+	                     then an exponential gap such that a burst starts
+	                     every burst * the mean gap of the load
+	length    64         fixed 64 B
+	          imix       64 / 594 / 1518 B in 7:4:1
+	          pareto     bounded Pareto, alpha 1.2, 64..1518 B
+	weights   WEIGHT_TABLE values of the flows, repeated if shorter than
+	          flows (default 128, the DRR quantum of the examples)
+
+	The load is shared evenly between the flows, so the schedulers see the
+	same offered traffic and differ only in their weights. A packet's
+	priority is its flow_id modulo 8, for SP.
+
+*/
+
+#ifndef __TRAFFIC_GEN__H
+#define __TRAFFIC_GEN__H
+
+#include <stdint.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "rank_abi.h"
+
+struct traffic_config {
+    enum arrival_t { ARRIVAL_POISSON, ARRIVAL_ONOFF, ARRIVAL_BURST };
+    enum length_t { LENGTH_64, LENGTH_IMIX, LENGTH_PARETO };
+
+    unsigned flows;
+    unsigned long long packets;
+    uint64_t seed;
+    double load;
+    double link;
+    arrival_t arrival;
+    double on_cycles;
+    double off_cycles;
+    unsigned burst;
+    length_t length;
+    std::vector < uint32_t > weights;
+
+    traffic_config(): flows(8), packets(100000), seed(1), load(0.5), link(1.0), arrival(ARRIVAL_POISSON),
+        on_cycles(1000), off_cycles(1000), burst(16), length(LENGTH_64), weights(1, 128) {}
+
+    // Applies a "key=value,..." list; false and error() on a bad entry.
+    bool parse(const std::string & spec) {
+        std::istringstream in(spec);
+        std::string item;
+        while (std::getline(in, item, ',')) {
+            size_t eq = item.find('=');
+            if (eq == std::string::npos)
+                return fail("missing '=' in " + item);
+            std::string key = item.substr(0, eq), value = item.substr(eq + 1);
+            char * end;
+            if (key == "flows")
+                flows = strtoul(value.c_str(), & end, 0);
+            else if (key == "packets")
+                packets = strtoull(value.c_str(), & end, 0);
+            else if (key == "seed")
+                seed = strtoull(value.c_str(), & end, 0);
+            else if (key == "load")
+                load = strtod(value.c_str(), & end);
+            else if (key == "link")
+                link = strtod(value.c_str(), & end);
+            else if (key == "on")
+                on_cycles = strtod(value.c_str(), & end);
+            else if (key == "off")
+                off_cycles = strtod(value.c_str(), & end);
+            else if (key == "burst")
+                burst = strtoul(value.c_str(), & end, 0);
+            else if (key == "arrival") {
+                end = (char *) "";
+                if (value == "poisson")
+                    arrival = ARRIVAL_POISSON;
+                else if (value == "onoff")
+                    arrival = ARRIVAL_ONOFF;
+                else if (value == "burst")
+                    arrival = ARRIVAL_BURST;
+                else
+                    return fail("unknown arrival " + value);
+            } else if (key == "length") {
+                end = (char *) "";
+                if (value == "64")
+                    length = LENGTH_64;
+                else if (value == "imix")
+                    length = LENGTH_IMIX;
+                else if (value == "pareto")
+                    length = LENGTH_PARETO;
+                else
+                    return fail("unknown length " + value);
+            } else if (key == "weights") {
+                weights.clear();
+                std::istringstream w(value);
+                std::string v;
+                while (std::getline(w, v, ':')) {
+                    weights.push_back(strtoul(v.c_str(), & end, 0));
+                    if (* end)
+                        return fail("bad weight " + v);
+                }
+                if (weights.empty())
+                    return fail("empty weights");
+            } else
+                return fail("unknown key " + key);
+            if (* end || value.empty())
+                return fail("bad value for " + key);
+        }
+        if (flows == 0 || flows > RANK_MAX_FLOWS)
+            return fail("flows must be 1..16");
+        if (!(load > 0) || !(link > 0) || !(on_cycles > 0) || !(off_cycles > 0) || burst == 0)
+            return fail("load, link, on, off and burst must be positive");
+        // A flow sends at most at the link rate: while on, or in a burst
+        double flow_load = load / flows;
+        if (arrival == ARRIVAL_ONOFF && flow_load * (on_cycles + off_cycles) / on_cycles > 1)
+            return fail("onoff peak rate above the link rate, raise on or lower load");
+        if (arrival == ARRIVAL_BURST && flow_load * (burst - 1) >= burst)
+            return fail("load too high for back-to-back bursts of burst packets");
+        return true;
+    }
+
+    uint32_t weight(unsigned flow) const {
+        return weights[flow % weights.size()];
+    }
+
+    // Mean packet length of the distribution, for the load.
+    double mean_length() const {
+        switch (length) {
+        case LENGTH_IMIX:
+            return (7 * 64 + 4 * 594 + 1518) / 12.0;
+        case LENGTH_PARETO: {
+            double a = PARETO_ALPHA, l = 64, h = 1518;
+            return std::pow(l, a) / (1 - std::pow(l / h, a)) * a / (a - 1) *
+                (1 / std::pow(l, a - 1) - 1 / std::pow(h, a - 1));
+        }
+        default:
+            return 64;
+        }
+    }
+
+    const std::string & error() const {
+        return err;
+    }
+
+    static constexpr double PARETO_ALPHA = 1.2;
+
+    private:
+    std::string err;
+
+    bool fail(const std::string & msg) {
+        err = msg;
+        return false;
+    }
+};
+
+class traffic_gen {
+    public:
+    traffic_gen(): generated(0) {}
+
+    void open(const traffic_config & c) {
+        cfg = c;
+        rng.seed(cfg.seed);
+        generated = 0;
+        heads = std::priority_queue < head_t > ();
+        flows.assign(cfg.flows, flow_t());
+
+        // Mean cycles between two packets of a flow at the offered load, and
+        // mean wire time of a packet.
+        gap = cfg.mean_length() * cfg.flows / (cfg.load * cfg.link);
+        wire = cfg.mean_length() / cfg.link;
+        for (unsigned f = 0; f < cfg.flows; f++) {
+            flow_t & fl = flows[f];
+            if (cfg.arrival == traffic_config::ARRIVAL_ONOFF) {
+                // Start in a random phase of the on/off cycle.
+                bool on = uniform() < cfg.on_cycles / (cfg.on_cycles + cfg.off_cycles);
+                fl.time = on ? 0 : exponential(cfg.off_cycles);
+                fl.period_end = fl.time + exponential(cfg.on_cycles);
+                onoff_step(fl, 0);
+            } else {
+                fl.time = exponential(cfg.arrival == traffic_config::ARRIVAL_BURST ? gap * cfg.burst : gap);
+            }
+            push(f);
+        }
+    }
+
+    bool next(rank_packet_t & p, unsigned long long & arrival) {
+        if (generated >= cfg.packets || heads.empty())
+            return false;
+        head_t h = heads.top();
+        heads.pop();
+
+        p = rank_packet_t();
+        p.flow_id = h.flow;
+        p.length = h.length;
+        p.priority = h.flow & 0x7;
+        p.payload_ptr = generated;
+        arrival = (unsigned long long) h.time;
+        p.arrival_time = arrival;
+        generated++;
+
+        advance(h.flow, h.length);
+        push(h.flow);
+        return true;
+    }
+
+    private:
+    struct flow_t {
+        double time;       // next arrival
+        double period_end; // onoff: end of the current or next on period
+        unsigned left;     // burst: packets sent in the burst
+
+        flow_t(): time(0), period_end(0), left(0) {}
+    };
+
+    struct head_t {
+        double time;
+        unsigned flow;
+        uint16_t length;
+
+        bool operator < (const head_t & o) const {
+            return time != o.time ? time > o.time : flow > o.flow;
+        }
+    };
+
+    traffic_config cfg;
+    std::mt19937_64 rng;
+    std::vector < flow_t > flows;
+    std::priority_queue < head_t > heads;
+    double gap;
+    double wire;
+    unsigned long long generated;
+
+    double uniform() {
+        return std::uniform_real_distribution < double > (0.0, 1.0)(rng);
+    }
+
+    double exponential(double mean) {
+        return -mean * std::log(1.0 - uniform());
+    }
+
+    uint16_t sample_length() {
+        switch (cfg.length) {
+        case traffic_config::LENGTH_IMIX: {
+            unsigned r = std::uniform_int_distribution < unsigned > (0, 11)(rng);
+            return r < 7 ? 64 : r < 11 ? 594 : 1518;
+        }
+        case traffic_config::LENGTH_PARETO: {
+            // Inverse transform of the bounded Pareto distribution.
+            double a = traffic_config::PARETO_ALPHA, l = 64, h = 1518;
+            double u = uniform();
+            double x = std::pow(-(u * std::pow(h, a) - u * std::pow(l, a) - std::pow(h, a)) /
+                (std::pow(h, a) * std::pow(l, a)), -1 / a);
+            return (uint16_t)(x + 0.5);
+        }
+        default:
+            return 64;
+        }
+    }
+
+    void push(unsigned f) {
+        head_t h;
+        h.time = flows[f].time;
+        h.flow = f;
+        h.length = sample_length();
+        heads.push(h);
+    }
+
+    // Arrivals during the on periods only. At the peak rate the flow
+    // averages its share of the load over on + off: the previous packet's
+    // wire time, then an exponential gap of the rest of the mean (parse()
+    // keeps it positive). A gap that runs past the end of an on period
+    // continues in the next one (memoryless).
+    void onoff_step(flow_t & fl, double last_wire) {
+        double peak_gap = gap * cfg.on_cycles / (cfg.on_cycles + cfg.off_cycles);
+        fl.time += last_wire + exponential(peak_gap - wire);
+        while (fl.time >= fl.period_end) {
+            double over = fl.time - fl.period_end;
+            double start = fl.period_end + exponential(cfg.off_cycles);
+            fl.period_end = start + exponential(cfg.on_cycles);
+            fl.time = start + over;
+        }
+    }
+
+    // Arrival of the flow's next packet, after one of len bytes.
+    void advance(unsigned f, unsigned len) {
+        flow_t & fl = flows[f];
+        double last_wire = len / cfg.link; // back-to-back spacing
+        switch (cfg.arrival) {
+        case traffic_config::ARRIVAL_ONOFF:
+            onoff_step(fl, last_wire);
+            break;
+        case traffic_config::ARRIVAL_BURST:
+            if (++fl.left < cfg.burst) {
+                fl.time += last_wire;
+            } else {
+                // A burst every gap * burst on average, its own wire time
+                // included
+                fl.left = 0;
+                fl.time += exponential(gap * cfg.burst - (cfg.burst - 1) * wire);
+            }
+            break;
+        default:
+            fl.time += exponential(gap);
+        }
+    }
+};
+
+#endif // __TRAFFIC_GEN__H
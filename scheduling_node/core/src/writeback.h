@@ -15,18 +15,16 @@
 #define __WRITEBACK__H
 
 #ifndef __SYNTHESIS__
+    #include <deque>
     #include <sstream>
 #endif
 
-#ifndef NDEBUG
-    #include <iostream>
-    #define DPRINT(msg) std::cout << msg;
-#endif
-
-
 #include "drim4hls_datatypes.h"
 #include "defines.h"
 #include "globals.h"
+#include "kanata_trace.h"
+#include "trace_ring.h"
+#include "chan_log.h"
 
 #include <mc_connections.h>
 
@@ -38,8 +36,8 @@ SC_MODULE(writeback) {
         // Member declarations.
         //		
         unsigned int aligned_address;
-        sc_uint < XLEN > load_data;
-        sc_uint < XLEN > store_data;
+        drim_uint < XLEN > load_data;
+        drim_uint < XLEN > store_data;
         std::string load;
         std::string store;
 
@@ -54,6 +52,9 @@ SC_MODULE(writeback) {
     Connections::Out < mem_out_t > CCS_INIT_S1(dout);
     Connections::Out < dmem_in_t > CCS_INIT_S1(dmem_in);
 
+    // High while waiting for a load response (HPM_EV_DMEM_WAIT).
+    sc_out < bool > CCS_INIT_S1(dmem_wait);
+
     // Clock and reset signals
     sc_in < bool > CCS_INIT_S1(clk);
     sc_in < bool > CCS_INIT_S1(rst);
@@ -64,14 +65,37 @@ SC_MODULE(writeback) {
     dmem_out_t dmem_din;
     mem_out_t output;
 
-    sc_uint < DATA_SIZE > mem_dout;
-    sc_uint < XLEN > dmem_data;
+    drim_uint < DATA_SIZE > mem_dout;
+    drim_uint < XLEN > dmem_data;
+
+    #ifndef __SYNTHESIS__
+    // Number of instructions written back and PC of the last one, sampled by the testbench.
+    sc_signal < long int > CCS_INIT_S1(retired);
+    sc_signal < sc_uint < PC_LEN > > CCS_INIT_S1(retired_pc);
+
+    // Effect of every written-back instruction, queued for the testbench
+    // lockstep check while log_retire is set.
+    struct retire_rec_t {
+        unsigned pc;
+        unsigned rd; // 0 if no register is written
+        unsigned rd_data;
+        bool store;
+        unsigned addr; // DMEM word index of a store
+        unsigned mem_data;
+    };
+    bool log_retire;
+    std::deque < retire_rec_t > retire_log;
+    #endif
     
     // Constructor
-    SC_CTOR(writeback): din("din"), dout("dout"), dmem_in("dmem_in"), dmem_out("dmem_out"), clk("clk"), rst("rst") {
+    SC_CTOR(writeback): din("din"), dmem_out("dmem_out"), dout("dout"), dmem_in("dmem_in"), dmem_wait("dmem_wait"), clk("clk"), rst("rst") {
         SC_THREAD(writeback_th);
         sensitive << clk.pos();
         async_reset_signal_is(rst, false);
+
+        #ifndef __SYNTHESIS__
+        log_retire = false;
+        #endif
     }
 
     void writeback_th(void) {
@@ -90,6 +114,12 @@ SC_MODULE(writeback) {
             
             dmem_data = 0;
             mem_dout = 0;
+            dmem_wait.write(false);
+
+            #ifndef __SYNTHESIS__
+            retired.write(0);
+            retired_pc.write(0);
+            #endif
         }
 
         #pragma hls_pipeline_init_interval 1
@@ -98,6 +128,8 @@ SC_MODULE(writeback) {
 
             // Get
             input = din.Pop();
+            CHAN_LOG(din, input);
+            KANATA(writeback(input.pc.to_uint()));
 
             #ifndef __SYNTHESIS__
                 writeback_out_t.aligned_address = 0;
@@ -114,13 +146,13 @@ SC_MODULE(writeback) {
             // Preprocess address
 			
             unsigned int aligned_address = input.alu_res.to_uint();
-            sc_uint< 5 > byte_index = (sc_uint< 5 >)((aligned_address & 0x3) << 3);
-            sc_uint< 5 > halfword_index = (sc_uint< 5 >)((aligned_address & 0x2) << 3);
+            drim_uint< 5 > byte_index = (drim_uint< 5 >)((aligned_address & 0x3) << 3);
+            drim_uint< 5 > halfword_index = (drim_uint< 5 >)((aligned_address & 0x2) << 3);
 
             aligned_address = aligned_address >> 2;
-            sc_uint < BYTE > db = (sc_uint < BYTE >) 0;
-            sc_uint < 2 * BYTE > dh = (sc_uint < 2 * BYTE >) 0;
-            sc_uint < XLEN > dw = (sc_uint < XLEN >) 0;
+            drim_uint < BYTE > db = (drim_uint < BYTE >) 0;
+            drim_uint < 2 * BYTE > dh = (drim_uint < 2 * BYTE >) 0;
+            drim_uint < XLEN > dw = (drim_uint < XLEN >) 0;
 
             dmem_dout.data_addr = aligned_address;
 
@@ -129,7 +161,7 @@ SC_MODULE(writeback) {
             
 
             #ifndef __SYNTHESIS__
-            if (sc_uint < 3 > (input.ld) != NO_LOAD || sc_uint < 2 > (input.st) != NO_STORE) {
+            if (drim_uint < 3 > (input.ld) != NO_LOAD || drim_uint < 2 > (input.st) != NO_STORE) {
                 if (input.mem_datain.to_uint() == 0x11111111 ||
                     input.mem_datain.to_uint() == 0x22222222 ||
                     input.mem_datain.to_uint() == 0x11223344 ||
@@ -148,7 +180,11 @@ SC_MODULE(writeback) {
                 dmem_dout.read_en = true;
                 dmem_in.Push(dmem_dout);
 
+                dmem_wait.write(true);
+                KANATA(stall(input.pc.to_uint(), kanata_trace::ST_WRITEBACK, "dmem"));
                 dmem_din = dmem_out.Pop();
+                CHAN_LOG(dmem_out, dmem_din);
+                dmem_wait.write(false);
                 dmem_data = dmem_din.data_out;
                 //freeze = false;
                 switch (input.ld) { // LOAD
@@ -272,22 +308,27 @@ SC_MODULE(writeback) {
             output.tag = input.tag;
             output.pc = input.pc;
 		
-            // Put
-		    dout.Push(output);
             #ifndef __SYNTHESIS__
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "load= " << writeback_out_t.load << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "store= " << writeback_out_t.store << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << std::hex << "input.regwrite=" << input.regwrite << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "regwrite=" << output.regwrite << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << "aligned_address=" << aligned_address << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << std::hex << "mem_dout=" << mem_dout << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << std::hex << "input.alu_res=" << input.alu_res << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << std::hex << "output.regfile_address=" << output.regfile_address << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << std::hex << "output.regfile_data=" << output.regfile_data << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << std::hex << "input.memtoreg=" << input.memtoreg << endl);
-            DPRINT("@" << sc_time_stamp() << "\t" << name() << "\t" << std::hex << "writeback_out_t.store_data =" << writeback_out_t.store_data  << endl);
-            DPRINT(endl);
+            retired.write(retired.read() + 1);
+            retired_pc.write(input.pc.to_uint());
+            if (log_retire) {
+                retire_rec_t r;
+                r.pc = input.pc.to_uint();
+                r.rd = (output.regwrite[0] == 1) ? output.regfile_address.to_uint() : 0;
+                r.rd_data = output.regfile_data.to_uint();
+                r.store = (input.st != NO_STORE);
+                r.addr = aligned_address;
+                r.mem_data = dmem_data.to_uint();
+                retire_log.push_back(r);
+            }
             #endif
+
+            // Put
+		    dout.Push(output);
+            KANATA(retire(input.pc.to_uint(), kanata_trace::ST_WRITEBACK));
+            if (input.ld != NO_LOAD || input.st != NO_STORE)
+                TRACE(TR_WRITEBACK, TR_DEBUG, TR_WB_MEM, input.pc, aligned_address, mem_dout, dmem_data);
+            TRACE(TR_WRITEBACK, TR_DEBUG, TR_WB_OUT, input.pc, output.regfile_address, output.regfile_data, output.regwrite);
             wait();
         }
     }
@@ -295,41 +336,41 @@ SC_MODULE(writeback) {
     /* Support functions */
 
     // Sign extend byte read from memory. For LB
-    sc_uint < XLEN > ext_sign_byte(sc_uint < BYTE > read_data) {
+    drim_uint < XLEN > ext_sign_byte(drim_uint < BYTE > read_data) {
 		if (read_data[7] == 1) {
 			
-			return (sc_uint < BYTE * 3 > (16777216), read_data);
+			return (drim_uint < BYTE * 3 > (16777216), read_data);
 
 		}
 		else {
 
-			return (sc_uint < BYTE * 3 > (0), read_data);
+			return (drim_uint < BYTE * 3 > (0), read_data);
 		}
     }
 
     // Zero extend byte read from memory. For LBU
-    sc_uint < XLEN > ext_unsign_byte(sc_uint < BYTE > read_data) {
+    drim_uint < XLEN > ext_unsign_byte(drim_uint < BYTE > read_data) {
 
-		return (sc_uint < BYTE * 3 > (0), read_data);       
+		return (drim_uint < BYTE * 3 > (0), read_data);       
     }
 
     // Sign extend half-word read from memory. For LH
-    sc_uint < XLEN > ext_sign_halfword(sc_uint < BYTE * 2 > read_data) {
+    drim_uint < XLEN > ext_sign_halfword(drim_uint < BYTE * 2 > read_data) {
 		        
         if (read_data[15] == 1) {
 
-            return (sc_uint < BYTE * 2 > (65535), read_data);
+            return (drim_uint < BYTE * 2 > (65535), read_data);
         }
         else {
 
-            return (sc_uint < BYTE * 2 > (0), read_data);
+            return (drim_uint < BYTE * 2 > (0), read_data);
         }
     }
 
     // Zero extend half-word read from memory. For LHU
-    sc_uint < XLEN > ext_unsign_halfword(sc_uint < BYTE * 2 > read_data) {
+    drim_uint < XLEN > ext_unsign_halfword(drim_uint < BYTE * 2 > read_data) {
 
-		return (sc_uint < BYTE * 2 > (0), read_data);
+		return (drim_uint < BYTE * 2 > (0), read_data);
     }
 
 };
@@ -0,0 +1,492 @@
+/*
+	@brief
+	Calibration of the loosely-timed node (node_lt.h) against the cycle
+	model (simulation only).
+
+	Each scheduler (SP, DRR, WFQ) runs on a pin-level SchedulingNode with
+	its core, fed a back-to-back synthetic stream by a packet_injector, so
+	the node never waits for a packet: the cycles between two enqueues are
+	the cost of one packet. The ISS counts the instructions of the same
+	packets. A fourth node runs the null program, entered at the end loop
+	of the DRR one: no instruction, so its cost per packet is the node's
+	overhead_cycles (restart, fetch, drain and enqueue). The cpi of a
+	scheduler is then
+
+		cpi = (cycles - packets * overhead_cycles) / instructions
+
+	over its packets, stalls included; the instruction count barely
+	varies between packets of one program, so the two cannot be fitted
+	from one program alone. A SchedulingNodeLT per scheduler is set to
+	this node_lt_timing and fed the same packets over TLM, and its
+	annotated cycles are compared with the cycle model's.
+
+	Usage: node_lt_tb [--packets <n>] [--sp <elf>] [--drr <elf>] [--wfq <elf>]
+
+	The defaults are the ELF files of core/schedulers, relative to
+	scheduling_node/. The output gives the overhead, then per scheduler
+	the instructions and cycles per packet, the cpi and the largest
+	per-packet error of overhead_cycles + cpi * instructions. The exit status is 0 if every
+	LT node ranked and sent every packet and its cycles are within 1% of
+	the cycle model's.
+
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <systemc.h>
+#include <mc_connections.h>
+#include <tlm.h>
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/simple_target_socket.h>
+
+#include "node.h"
+#include "node_lt.h"
+#include "node_model.h"
+#include "packet_injector.h"
+#include "packet_source.h"
+#include "rank_abi.h"
+
+// Flows of the synthetic packet stream
+#define LT_TB_FLOWS 8
+// Cycles a packet may take in the cycle model
+#define LT_TB_PACKET_CYCLES 500
+// Largest error of the LT cycles against the cycle model, in percent
+#define LT_TB_MAX_ERROR 1.0
+
+// Receives the packets of a SchedulingNodeLT.
+class lt_sink: public sc_module {
+    public:
+    tlm_utils::simple_target_socket < lt_sink > socket;
+    unsigned long long received;
+
+    lt_sink(sc_module_name name): sc_module(name), socket("socket"), received(0) {
+        socket.register_b_transport(this, & lt_sink::b_transport);
+    }
+
+    private:
+    void b_transport(tlm::tlm_generic_payload & trans, sc_time & delay) {
+        received++;
+        trans.set_response_status(tlm::TLM_OK_RESPONSE);
+    }
+};
+
+// One scheduler: its cycle-model node and LT node, and the measurements.
+// The null program has no LT node.
+struct lt_lane {
+    std::string model;
+    std::string path;
+    rank_layout_t layout;
+    unsigned entry;
+
+    SchedulingNode * node;
+    packet_injector * injector;
+    Connections::Combinational < packet_metadata_t > * in_pkt_ch;
+    Connections::Combinational < packet_metadata_t > * out_pkt_ch;
+    Connections::Combinational < table_req_t > * inj_table_ch;
+    Connections::Combinational < imem_write_req_t > * imem_write_ch;
+    Connections::Combinational < imem_swap_req_t > * swap_ch;
+    Connections::Combinational < imem_swap_done_t > * swap_done_ch;
+    Connections::Combinational < dma_load_req_t > * dma_req_ch;
+    Connections::Combinational < dma_beat_t > * dma_data_ch;
+    Connections::Combinational < dma_done_t > * dma_done_ch;
+    Connections::Combinational < program_cfg_t > * cfg_ch;
+    Connections::Combinational < table_req_t > * table_req_ch;
+    Connections::Combinational < table_resp_t > * table_resp_ch;
+    Connections::Combinational < packet_enqueue_t > * enq_ch;
+    Connections::Combinational < packet_dequeue_req_t > * deq_req_ch;
+    Connections::Combinational < packet_dequeue_resp_t > * deq_resp_ch;
+
+    SchedulingNodeLT * lt;
+    lt_sink * sink;
+    tlm_utils::simple_initiator_socket < lt_lane > * feed;
+
+    // Cycle of every enqueue, and instructions of every packet
+    std::vector < unsigned long long > enqueued;
+    std::vector < unsigned long long > insns;
+    double cpi;
+};
+
+class lt_bench: public sc_module {
+    public:
+    sc_clock clk;
+    sc_signal < bool > rst;
+    // Reset of the injectors, released once the nodes are configured
+    sc_signal < bool > inj_rst;
+
+    std::vector < lt_lane > lanes;
+
+    SC_HAS_PROCESS(lt_bench);
+    lt_bench(sc_module_name name, const std::vector < std::pair < std::string, std::string > > & programs,
+        unsigned long long packets):
+        sc_module(name),
+        clk("clk", 10, SC_NS, 0.5, 0, SC_NS, true),
+        rst("rst"),
+        inj_rst("inj_rst"),
+        lanes(programs.size()),
+        packets(packets),
+        overhead(0),
+        failed(false) {
+        Connections::set_sim_clk(& clk);
+
+        for (size_t i = 0; i < lanes.size(); i++) {
+            lt_lane & l = lanes[i];
+            l.model = programs[i].first;
+            l.path = programs[i].second;
+            l.entry = 0;
+            std::string n = l.model;
+            l.node = new SchedulingNode((n + "_node").c_str());
+            l.injector = new packet_injector((n + "_injector").c_str());
+            l.in_pkt_ch = new Connections::Combinational < packet_metadata_t > ((n + "_in_pkt_ch").c_str());
+            l.out_pkt_ch = new Connections::Combinational < packet_metadata_t > ((n + "_out_pkt_ch").c_str());
+            l.inj_table_ch = new Connections::Combinational < table_req_t > ((n + "_inj_table_ch").c_str());
+            l.imem_write_ch = new Connections::Combinational < imem_write_req_t > ((n + "_imem_write_ch").c_str());
+            l.swap_ch = new Connections::Combinational < imem_swap_req_t > ((n + "_swap_ch").c_str());
+            l.swap_done_ch = new Connections::Combinational < imem_swap_done_t > ((n + "_swap_done_ch").c_str());
+            l.dma_req_ch = new Connections::Combinational < dma_load_req_t > ((n + "_dma_req_ch").c_str());
+            l.dma_data_ch = new Connections::Combinational < dma_beat_t > ((n + "_dma_data_ch").c_str());
+            l.dma_done_ch = new Connections::Combinational < dma_done_t > ((n + "_dma_done_ch").c_str());
+            l.cfg_ch = new Connections::Combinational < program_cfg_t > ((n + "_cfg_ch").c_str());
+            l.table_req_ch = new Connections::Combinational < table_req_t > ((n + "_table_req_ch").c_str());
+            l.table_resp_ch = new Connections::Combinational < table_resp_t > ((n + "_table_resp_ch").c_str());
+            l.enq_ch = new Connections::Combinational < packet_enqueue_t > ((n + "_enq_ch").c_str());
+            l.deq_req_ch = new Connections::Combinational < packet_dequeue_req_t > ((n + "_deq_req_ch").c_str());
+            l.deq_resp_ch = new Connections::Combinational < packet_dequeue_resp_t > ((n + "_deq_resp_ch").c_str());
+
+            SchedulingNode & node = * l.node;
+            node.clk(clk);
+            node.rst(rst);
+            node.in_pkt(* l.in_pkt_ch);
+            node.out_pkt(* l.out_pkt_ch);
+            node.imem_write_port(* l.imem_write_ch);
+            node.imem_swap_port(* l.swap_ch);
+            node.imem_swap_done_port(* l.swap_done_ch);
+            node.dma_req_port(* l.dma_req_ch);
+            node.dma_data_port(* l.dma_data_ch);
+            node.dma_done_port(* l.dma_done_ch);
+            node.program_cfg_port(* l.cfg_ch);
+            node.table_req_port(* l.table_req_ch);
+            node.table_resp_port(* l.table_resp_ch);
+            node.mem_primitive_enqueue_ch(* l.enq_ch);
+            node.mem_primitive_dequeue_req_ch(* l.deq_req_ch);
+            node.mem_primitive_dequeue_resp_ch(* l.deq_resp_ch);
+
+            l.injector->clk(clk);
+            l.injector->rst(inj_rst);
+            l.injector->out(* l.in_pkt_ch);
+            l.injector->table_out(* l.inj_table_ch);
+
+            l.lt = NULL;
+            l.sink = NULL;
+            l.feed = NULL;
+            l.cpi = 0;
+            if (l.model == "null")
+                continue;
+            l.lt = new SchedulingNodeLT((n + "_lt").c_str());
+            l.sink = new lt_sink((n + "_sink").c_str());
+            l.feed = new tlm_utils::simple_initiator_socket < lt_lane > ((n + "_feed").c_str());
+            l.lt->out_socket(l.sink->socket);
+            (* l.feed)(l.lt->in_socket);
+        }
+
+        SC_THREAD(run);
+        sensitive << clk.posedge_event();
+
+        SC_THREAD(queue_th);
+        sensitive << clk.posedge_event();
+        async_reset_signal_is(rst, false);
+    }
+
+    // Loads every program into its two nodes and the ISS, with the tables
+    // of node_tb: weight f + 1, quantum 256 * (f + 1).
+    bool load() {
+        for (size_t i = 0; i < lanes.size(); i++) {
+            lt_lane & l = lanes[i];
+            elf_file elf;
+            if (!elf.open(l.path)) {
+                std::cerr << l.path << ": " << elf.error() << std::endl;
+                return false;
+            }
+            bool fits = true;
+            bool have_end = false;
+            unsigned end = 0;
+            SchedulingNode & node = * l.node;
+            bool ok = elf.for_each_load_word([&](unsigned addr, unsigned word) {
+                if ((addr >> 2) >= ICACHE_SIZE) {
+                    fits = false;
+                    return;
+                }
+                node.imem[0][addr >> 2] = word;
+                node.dmem[addr >> 2] = word;
+                if (word == 0x0000006f && !have_end) {
+                    // hang: j hang
+                    end = addr;
+                    have_end = true;
+                }
+            });
+            if (!ok || !fits || elf.entry() != 0 || (l.lt && !l.lt->load_program(l.path))) {
+                std::cerr << l.path << ": bad program, or not linked at 0" << std::endl;
+                return false;
+            }
+            if (l.model == "null") {
+                if (!have_end) {
+                    std::cerr << l.path << ": no end loop" << std::endl;
+                    return false;
+                }
+                l.entry = end;
+            }
+            l.layout.from_symbols(elf);
+            node.set_layout(l.layout);
+            for (unsigned f = 0; f < RANK_MAX_FLOWS; f++) {
+                node.dmem[(l.layout.weight >> 2) + f] = f + 1;
+                node.dmem[(l.layout.quantum >> 2) + f] = 256 * (f + 1);
+                if (l.lt) {
+                    l.lt->write_dmem(l.layout.weight + 4 * f, f + 1);
+                    l.lt->write_dmem(l.layout.quantum + 4 * f, 256 * (f + 1));
+                }
+            }
+            node.dmem[l.layout.deq_cycle >> 2] = 0x10;
+            if (l.lt)
+                l.lt->write_dmem(l.layout.deq_cycle, 0x10);
+            l.injector->open_synthetic(packets, LT_TB_FLOWS);
+            if (!count_instructions(l))
+                return false;
+        }
+        return true;
+    }
+
+    bool passed() const {
+        return !failed;
+    }
+
+    private:
+    unsigned long long packets;
+    unsigned overhead;
+    bool failed;
+
+    // Instructions of every packet, on the ISS from the same DMEM.
+    bool count_instructions(lt_lane & l) {
+        iss_ranker ranker;
+        if (!ranker.cpu().load_program(l.path))
+            return false;
+        ranker.cpu().set_entry(l.entry);
+        for (unsigned f = 0; f < RANK_MAX_FLOWS; f++) {
+            ranker.cpu().write_dmem(l.layout.weight + 4 * f, f + 1);
+            ranker.cpu().write_dmem(l.layout.quantum + 4 * f, 256 * (f + 1));
+        }
+        ranker.cpu().write_dmem(l.layout.deq_cycle, 0x10);
+        node_model < rank_packet_t, iss_ranker > model(ranker);
+        model.set_layout(l.layout);
+        packet_source source;
+        source.open_synthetic(packets, LT_TB_FLOWS);
+        rank_packet_t p;
+        while (source.next(p)) {
+            uint64_t before = ranker.cpu().retired();
+            uint32_t rank;
+            if (!model.compute_rank(p, rank)) {
+                std::cerr << l.model << ": rank program did not end" << std::endl;
+                return false;
+            }
+            l.insns.push_back(ranker.cpu().retired() - before);
+        }
+        return true;
+    }
+
+    // Cycles of a lane's packets after the first (from the previous
+    // enqueue to theirs), and their instructions.
+    void totals(const lt_lane & l, double & cycles, double & insns) const {
+        cycles = (double) (l.enqueued[packets - 1] - l.enqueued[0]);
+        insns = 0;
+        for (size_t k = 1; k < packets; k++)
+            insns += l.insns[k];
+    }
+
+    // overhead_cycles from the null program, then the cpi of every
+    // scheduler.
+    void fit() {
+        double cycles, insns;
+        for (size_t i = 0; i < lanes.size(); i++) {
+            if (lanes[i].model == "null") {
+                totals(lanes[i], cycles, insns);
+                overhead = (unsigned) (cycles / (packets - 1) + 0.5);
+            }
+        }
+        for (size_t i = 0; i < lanes.size(); i++) {
+            totals(lanes[i], cycles, insns);
+            lanes[i].cpi = insns > 0 ? (cycles - (double) overhead * (packets - 1)) / insns : 0;
+        }
+    }
+
+    void run() {
+        rst.write(false);
+        inj_rst.write(false);
+        wait(5);
+        rst.write(true);
+        wait();
+        for (size_t i = 0; i < lanes.size(); i++) {
+            program_cfg_t cfg;
+            cfg.kind = PROGRAM_CFG_ENTRY;
+            cfg.index = 0;
+            cfg.value = lanes[i].entry;
+            lanes[i].cfg_ch->Push(cfg);
+        }
+        inj_rst.write(true);
+
+        unsigned long long limit = LT_TB_PACKET_CYCLES * (packets + 1);
+        for (unsigned long long c = 0; c < limit && !all_enqueued(); c++)
+            wait();
+        if (!all_enqueued()) {
+            std::cerr << "cycle model: not every packet was ranked" << std::endl;
+            failed = true;
+            sc_stop();
+            return;
+        }
+
+        fit();
+        std::cout << "overhead_cycles " << overhead << std::endl;
+        std::cout << "scheduler  insns/packet  cycles/packet  cpi     max error (cycles)" << std::endl;
+        for (size_t i = 0; i < lanes.size(); i++) {
+            lt_lane & l = lanes[i];
+            double cycles, insns, max_error = 0;
+            totals(l, cycles, insns);
+            for (size_t k = 1; k < packets; k++) {
+                double c = (double) (l.enqueued[k] - l.enqueued[k - 1]);
+                double error = std::fabs(c - overhead - l.cpi * l.insns[k]);
+                if (error > max_error)
+                    max_error = error;
+            }
+            printf("%-10s %12.2f %14.2f  %.4f  %.1f\n", l.model.c_str(), insns / (packets - 1),
+                cycles / (packets - 1), l.cpi, max_error);
+        }
+
+        // The same packets through the LT nodes, calibrated
+        for (size_t i = 0; i < lanes.size(); i++) {
+            lt_lane & l = lanes[i];
+            if (!l.lt)
+                continue;
+            node_lt_timing t;
+            t.period = clk.period();
+            t.cpi = l.cpi;
+            t.overhead_cycles = overhead;
+            l.lt->set_timing(t);
+            packet_source source;
+            source.open_synthetic(packets, LT_TB_FLOWS);
+            rank_packet_t p;
+            sc_time delay = SC_ZERO_TIME;
+            while (source.next(p)) {
+                uint32_t w[RANK_META_WORDS];
+                rank_meta_words(p, w);
+                tlm::tlm_generic_payload trans;
+                trans.set_command(tlm::TLM_WRITE_COMMAND);
+                trans.set_address(0);
+                trans.set_data_ptr((unsigned char *) w);
+                trans.set_data_length(NODE_LT_PACKET_BYTES);
+                trans.set_streaming_width(NODE_LT_PACKET_BYTES);
+                trans.set_byte_enable_ptr(NULL);
+                trans.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+                (* l.feed)->b_transport(trans, delay);
+                if (trans.is_response_error()) {
+                    std::cerr << l.model << " LT: " << trans.get_response_string() << std::endl;
+                    failed = true;
+                }
+            }
+        }
+        for (unsigned long long c = 0; c < limit && !all_sent(); c++)
+            wait();
+
+        std::cout << "scheduler  cycle model  LT model  error" << std::endl;
+        for (size_t i = 0; i < lanes.size(); i++) {
+            lt_lane & l = lanes[i];
+            if (!l.lt)
+                continue;
+            // Per packet; the first packet's cost is not measured in the
+            // cycle model
+            double cycle = (double) (l.enqueued[packets - 1] - l.enqueued[0]) / (packets - 1);
+            double lt = (double) l.lt->cycles() / packets;
+            double error = 100 * (lt - cycle) / cycle;
+            printf("%-10s %11.2f %9.2f  %+.2f%%\n", l.model.c_str(), cycle, lt, error);
+            if (std::fabs(error) > LT_TB_MAX_ERROR || l.sink->received != packets)
+                failed = true;
+            l.lt->print_stats(std::cout);
+        }
+        sc_stop();
+    }
+
+    bool all_enqueued() const {
+        for (size_t i = 0; i < lanes.size(); i++)
+            if (lanes[i].enqueued.size() < packets)
+                return false;
+        return true;
+    }
+
+    bool all_sent() const {
+        for (size_t i = 0; i < lanes.size(); i++)
+            if (lanes[i].sink && lanes[i].sink->received < packets)
+                return false;
+        return true;
+    }
+
+    // Queue primitive of the cycle-model nodes: records the enqueues.
+    void queue_th() {
+        unsigned long long cycle = 0;
+        wait();
+
+        while (true) {
+            for (size_t i = 0; i < lanes.size(); i++) {
+                packet_enqueue_t enq;
+                if (lanes[i].enq_ch->PopNB(enq))
+                    lanes[i].enqueued.push_back(cycle);
+            }
+            cycle++;
+            wait();
+        }
+    }
+};
+
+int sc_main(int argc, char * argv[]) {
+    unsigned long long packets = 200;
+    std::vector < std::pair < std::string, std::string > > programs;
+    programs.push_back(std::make_pair("sp", "core/schedulers/sp/notmain.elf"));
+    programs.push_back(std::make_pair("drr", "core/schedulers/drr/notmain.elf"));
+    programs.push_back(std::make_pair("wfq", "core/schedulers/wfq/notmain.elf"));
+    programs.push_back(std::make_pair("null", ""));
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool known = false;
+        if (arg == "--packets" && i + 1 < argc) {
+            packets = strtoull(argv[++i], NULL, 0);
+            known = true;
+        }
+        for (size_t p = 0; p < programs.size() && !known; p++) {
+            if (arg == "--" + programs[p].first && i + 1 < argc) {
+                programs[p].second = argv[++i];
+                known = true;
+            }
+        }
+        if (!known) {
+            std::cerr << "Usage: " << argv[0] << " [--packets <n>] [--sp <elf>] [--drr <elf>] [--wfq <elf>]"
+                      << std::endl;
+            return -1;
+        }
+    }
+    // The null program is the end loop of the DRR one
+    programs.back().second = programs[1].second;
+    if (packets < 2) {
+        std::cerr << "--packets must be at least 2" << std::endl;
+        return -1;
+    }
+
+    SchedulingNodeLT::set_quantum(sc_time(1, SC_US));
+    lt_bench bench("bench", programs, packets);
+    if (!bench.load())
+        return -1;
+
+    sc_start();
+
+    bool pass = bench.passed();
+    std::cout << "node_lt: " << (pass ? "PASS" : "FAIL") << std::endl;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,680 @@
+/*
+	@brief
+	Testbench of SchedulingNode with its drim4hls core (simulation only).
+	The node is driven through its ports: packets come from a
+	packet_injector, departures go to a packet_sink, and the queue
+	primitive is a pifo_queue that answers each dequeue request with its
+	head, once it holds a packet. Every rank the node enqueues is checked
+	against the golden model (rank_ref.h) of the program that ranked the
+	packet, on a mirror of the node's DMEM.
+
+	The programs of IMEM bank 0 are loaded into IMEM and DMEM before the
+	simulation, like the testbench of the core loads its program; the
+	weights (WEIGHT_TABLE) and quantums (QUANTUM_TABLE) are written there
+	too. Arrivals count from the end of the configuration.
+
+	Scenarios:
+
+		multi   two resident programs at different link addresses, DRR
+		        for classes 0-3 and WFQ for classes 4-7 (class =
+		        flow_id[3:0]), each class ranked by its own program
+		swap    DRR runs from bank 0; halfway through the packets WFQ,
+		        linked at 0x400, is written to the shadow bank through
+		        imem_write_port with its entry (PROGRAM_CFG_SHADOW_ENTRY),
+		        and the banks are switched while packets keep coming.
+		        Every packet before the switch is ranked by DRR, every
+		        packet after it by WFQ, none is lost.
+		table   DRR under traffic while the control plane reads the
+		        quantum table back to back, with no bound on the wait
+		        of a read (set_table_max_wait(0)), so reads stall the
+		        rank program; every 4 ranked packets it writes a new
+		        quantum for one flow. Writes go in between packets:
+		        every rank matches the model with the writes done
+		        before the packet, every read returns the last value
+		        written, and the reads stalled the core.
+		dma     DRR under traffic; a quarter of the way through, a
+		        DMEM burst on dma_req_port replaces the quantum table,
+		        and halfway WFQ is loaded into the shadow bank by an
+		        IMEM burst and the banks are switched. The burst lands
+		        whole between two packets: every rank matches the
+		        model with either all of the new table or none of it.
+		trace   DRR ranks the packets of a CSV or pcap trace (--trace,
+		        default core/tests/trace.csv), pushed by the injector on
+		        their timestamps. Every packet reaches the node with
+		        the fields of its record.
+
+	Usage: node_tb <scenario> [--packets <n>] [--interval <cycles>]
+	               [--idle-skip] [--pkt-log <file>] [--drr <elf>] [--wfq <elf>]
+	               [--trace <file>]
+
+	--interval spaces the packets, so the node idles between them, and
+	--idle-skip suspends the core meanwhile
+	(SchedulingNode::set_idle_skip); the ranks and the cycles are the
+	same with or without it, only the simulation is faster.
+
+	--pkt-log writes the egress log of the packet_sink
+	(SchedulingNode::set_egress_log), read back at the end: every packet
+	must have one record, with the rank the node enqueued and ingress <=
+	enqueue <= dequeue.
+
+	The defaults are the ELF files of core/schedulers, WFQ linked at
+	0x400 (make BASE=0x400), relative to scheduling_node/. The exit
+	status is 0 if every packet was ranked as its model ranks it and
+	left the node.
+
+*/
+
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <systemc.h>
+#include <mc_connections.h>
+
+#include "node.h"
+#include "elf_file.h"
+#include "packet_log.h"
+#include "packet_injector.h"
+#include "packet_sink.h"
+#include "packet_source.h"
+#include "pifo.h"
+#include "rank_abi.h"
+#include "rank_ref.h"
+
+// Cycles a packet may take from its arrival to its departure
+#define TB_PACKET_CYCLES 500
+// Flows of the synthetic packet stream, classes 0 to TB_FLOWS - 1
+#define TB_FLOWS 8
+
+// A rank program of one IMEM bank and the model that checks it.
+struct tb_program {
+    std::string model;
+    rank_ref_model_t ref;
+    unsigned entry;
+    std::vector < std::pair < unsigned, unsigned > > words; // (byte address, word)
+    unsigned long long ranked;
+
+    tb_program(): ref(NULL), entry(0), ranked(0) {}
+};
+
+class node_bench: public sc_module {
+    public:
+    sc_clock clk;
+    sc_signal < bool > rst;
+    // Reset of the injector, released once the node is configured
+    sc_signal < bool > inj_rst;
+
+    SchedulingNode node;
+    packet_injector injector;
+    // Cycles between two packets, 0 for back to back (--interval)
+    unsigned long long interval;
+    packet_sink sink;
+
+    Connections::Combinational < packet_metadata_t > in_pkt_ch;
+    Connections::Combinational < packet_metadata_t > out_pkt_ch;
+    Connections::Combinational < table_req_t > inj_table_ch;
+    Connections::Combinational < imem_write_req_t > imem_write_ch;
+    Connections::Combinational < imem_swap_req_t > swap_ch;
+    Connections::Combinational < imem_swap_done_t > swap_done_ch;
+    Connections::Combinational < dma_load_req_t > dma_req_ch;
+    Connections::Combinational < dma_beat_t > dma_data_ch;
+    Connections::Combinational < dma_done_t > dma_done_ch;
+    Connections::Combinational < program_cfg_t > cfg_ch;
+    Connections::Combinational < table_req_t > table_req_ch;
+    Connections::Combinational < table_resp_t > table_resp_ch;
+    Connections::Combinational < packet_enqueue_t > enq_ch;
+    Connections::Combinational < packet_dequeue_req_t > deq_req_ch;
+    Connections::Combinational < packet_dequeue_resp_t > deq_resp_ch;
+
+    SC_HAS_PROCESS(node_bench);
+    node_bench(sc_module_name name, const std::string & scenario, unsigned long long packets):
+        sc_module(name),
+        clk("clk", 10, SC_NS, 0.5, 0, SC_NS, true),
+        rst("rst"),
+        inj_rst("inj_rst"),
+        node("node"),
+        injector("injector"),
+        interval(0),
+        sink("sink"),
+        scenario(scenario),
+        packets(packets),
+        have_layout(false),
+        bank(0),
+        ranked(0),
+        departed(0),
+        mismatches(0),
+        log_errors(0),
+        failed(false),
+        table_applied(0),
+        dma_addr(0),
+        dma_applied(true) {
+        Connections::set_sim_clk(& clk);
+
+        node.clk(clk);
+        node.rst(rst);
+        node.in_pkt(in_pkt_ch);
+        node.out_pkt(out_pkt_ch);
+        node.imem_write_port(imem_write_ch);
+        node.imem_swap_port(swap_ch);
+        node.imem_swap_done_port(swap_done_ch);
+        node.dma_req_port(dma_req_ch);
+        node.dma_data_port(dma_data_ch);
+        node.dma_done_port(dma_done_ch);
+        node.program_cfg_port(cfg_ch);
+        node.table_req_port(table_req_ch);
+        node.table_resp_port(table_resp_ch);
+        node.mem_primitive_enqueue_ch(enq_ch);
+        node.mem_primitive_dequeue_req_ch(deq_req_ch);
+        node.mem_primitive_dequeue_resp_ch(deq_resp_ch);
+        node.set_egress_log(& sink);
+
+        injector.clk(clk);
+        injector.rst(inj_rst);
+        injector.out(in_pkt_ch);
+        injector.table_out(inj_table_ch);
+
+        sink.clk(clk);
+        sink.rst(rst);
+        sink.in(out_pkt_ch);
+
+        for (unsigned c = 0; c < PROGRAM_CLASSES; c++)
+            class_program[c] = 0;
+
+        SC_THREAD(run);
+        sensitive << clk.posedge_event();
+
+        SC_THREAD(queue_th);
+        sensitive << clk.posedge_event();
+        async_reset_signal_is(rst, false);
+    }
+
+    // Reads an ELF as resident program `program` of IMEM bank `b`, ranked
+    // by the golden model `model`. Bank 0 programs are written to IMEM and
+    // DMEM right away, before the simulation; bank 1 ones by the scenario.
+    bool load_program(unsigned b, unsigned program, const std::string & path, const std::string & model) {
+        elf_file elf;
+        if (!elf.open(path)) {
+            std::cerr << path << ": " << elf.error() << std::endl;
+            return false;
+        }
+        tb_program & p = programs[b][program];
+        bool fits = true;
+        bool ok = elf.for_each_load_word([&p, &fits](unsigned addr, unsigned word) {
+            if ((addr >> 2) >= ICACHE_SIZE)
+                fits = false;
+            else
+                p.words.push_back(std::make_pair(addr, word));
+        });
+        if (!ok || !fits) {
+            std::cerr << path << ": bad or oversized program" << std::endl;
+            return false;
+        }
+        if (!have_layout) {
+            layout.from_symbols(elf);
+            node.set_layout(layout);
+            have_layout = true;
+        }
+        p.entry = elf.entry();
+        p.model = model;
+        p.ref = rank_ref_model(model);
+        if (b == 0) {
+            for (size_t i = 0; i < p.words.size(); i++) {
+                node.imem[0][p.words[i].first >> 2] = p.words[i].second;
+                node.dmem[p.words[i].first >> 2] = p.words[i].second;
+            }
+        }
+        return true;
+    }
+
+    // Per-flow weights and quantums, written to DMEM before the simulation.
+    void load_tables() {
+        for (unsigned f = 0; f < RANK_MAX_FLOWS; f++) {
+            node.dmem[(layout.weight >> 2) + f] = f + 1;
+            node.dmem[(layout.quantum >> 2) + f] = 256 * (f + 1);
+        }
+        node.dmem[layout.deq_cycle >> 2] = 0x10;
+    }
+
+    // Packets of the trace scenario: the records of a trace instead of the
+    // synthetic stream, kept to check what reaches the node.
+    bool open_trace(const std::string & path) {
+        packet_source src;
+        rank_packet_t p;
+        if (!src.open(path)) {
+            std::cerr << "Cannot open " << path << std::endl;
+            return false;
+        }
+        while (src.next(p))
+            trace_packets.push_back(p);
+        if (src.failed() || trace_packets.empty()) {
+            std::cerr << path << ": no packets" << std::endl;
+            return false;
+        }
+        packets = trace_packets.size();
+        return injector.open(path, clk.period().to_seconds() * 1e9);
+    }
+
+    bool passed() const {
+        return !failed && mismatches == 0 && ranked == packets && departed == packets && log_errors == 0;
+    }
+
+    // Reads back the egress log of the sink (--pkt-log).
+    void check_egress_log(const std::string & path) {
+        sink.close();
+        packet_log_reader log;
+        packet_log_rec_t r;
+        unsigned long long records = 0;
+        if (!log.open(path)) {
+            std::cerr << log.error() << std::endl;
+            log_errors++;
+            return;
+        }
+        while (log.next(r)) {
+            records++;
+            std::unordered_map < uint32_t, uint32_t >::const_iterator it = enqueued_rank.find(r.payload_ptr);
+            if (it == enqueued_rank.end() || it->second != r.rank || r.ingress > r.enqueue || r.enqueue > r.dequeue) {
+                if (log_errors++ < 10)
+                    std::cerr << "egress record " << r.seq << " (payload 0x" << std::hex << r.payload_ptr << std::dec
+                              << "): rank " << r.rank << ", cycles " << r.ingress << " " << r.enqueue << " "
+                              << r.dequeue << std::endl;
+            }
+        }
+        if (!log.error().empty() || records != packets || sink.unmatched_departures()) {
+            std::cerr << path << ": " << records << " records of " << packets << " packets, "
+                      << sink.unmatched_departures() << " unmatched " << log.error() << std::endl;
+            log_errors++;
+        }
+        std::cout << "egress log: " << records << " records, " << log_errors << " errors" << std::endl;
+    }
+
+    void report(std::ostream & os) const {
+        for (unsigned b = 0; b < 2; b++) {
+            for (unsigned p = 0; p < RESIDENT_PROGRAMS; p++) {
+                const tb_program & prog = programs[b][p];
+                if (prog.model.empty())
+                    continue;
+                os << "bank " << b << " program " << p << " (" << prog.model << ", entry 0x" << std::hex
+                   << prog.entry << std::dec << "): " << prog.ranked << " packets ranked" << std::endl;
+            }
+        }
+        os << ranked << " of " << packets << " packets ranked, " << departed << " departed, " << mismatches
+           << " rank mismatches" << std::endl;
+        injector.print_stats(os);
+        sink.print_stats(os);
+        node.print_memory_stats(os);
+    }
+
+    private:
+    std::string scenario;
+    unsigned long long packets;
+    rank_layout_t layout;
+    bool have_layout;
+    tb_program programs[2][RESIDENT_PROGRAMS];
+    unsigned class_program[PROGRAM_CLASSES];
+    // Bank the node ranks from, as acknowledged on imem_swap_done_port
+    unsigned bank;
+    std::vector < uint32_t > ref_dmem;
+    pifo_queue < packet_metadata_t > pifo;
+    unsigned long long ranked;
+    unsigned long long departed;
+    unsigned long long mismatches;
+    // Rank of every enqueued packet by payload_ptr, for the egress log
+    std::unordered_map < uint32_t, uint32_t > enqueued_rank;
+    unsigned long long log_errors;
+    bool failed;
+    // Table writes issued by the scenario, applied to the mirror DMEM as
+    // the node reports them done (table_writes)
+    std::vector < std::pair < unsigned, uint32_t > > table_writes;
+    size_t table_applied;
+    // DMEM burst of the dma scenario (word address, words), applied to the
+    // mirror DMEM once the node holds its last word
+    unsigned dma_addr;
+    std::vector < uint32_t > dma_table;
+    bool dma_applied;
+    std::vector < rank_packet_t > trace_packets;
+
+    void configure(unsigned kind, unsigned index, unsigned value) {
+        program_cfg_t cfg;
+        cfg.kind = kind;
+        cfg.index = index;
+        cfg.value = value;
+        cfg_ch.Push(cfg);
+        if (kind == PROGRAM_CFG_CLASS)
+            class_program[index] = value;
+    }
+
+    // Waits for every packet to be ranked and to leave the node.
+    void wait_packets() {
+        unsigned long long limit = (TB_PACKET_CYCLES + interval) * (packets + 1);
+        for (unsigned long long c = 0; c < limit && departed < packets; c++)
+            wait();
+        wait(10);
+    }
+
+    void run() {
+        rst.write(false);
+        inj_rst.write(false);
+        ref_dmem.resize(DCACHE_SIZE);
+        for (unsigned i = 0; i < DCACHE_SIZE; i++)
+            ref_dmem[i] = node.dmem.read(i).to_uint();
+        if (trace_packets.empty())
+            injector.open_synthetic(packets, TB_FLOWS);
+        injector.set_rate(interval);
+        wait(5);
+        rst.write(true);
+        wait();
+
+        if (scenario == "multi") {
+            configure(PROGRAM_CFG_ENTRY, 1, programs[0][1].entry);
+            for (unsigned c = 4; c < 8; c++)
+                configure(PROGRAM_CFG_CLASS, c, 1);
+            inj_rst.write(true);
+            wait_packets();
+            failed = programs[0][0].ranked == 0 || programs[0][1].ranked == 0;
+        } else if (scenario == "swap") {
+            configure(PROGRAM_CFG_ENTRY, 0, programs[0][0].entry);
+            inj_rst.write(true);
+            while (ranked < packets / 2)
+                wait();
+
+            // New program in the shadow bank, in the background
+            const tb_program & next = programs[1][0];
+            for (size_t i = 0; i < next.words.size(); i++) {
+                imem_write_req_t req;
+                req.addr = next.words[i].first;
+                req.data = next.words[i].second;
+                imem_write_ch.Push(req);
+            }
+            configure(PROGRAM_CFG_SHADOW_ENTRY, 0, next.entry);
+            imem_swap_req_t swap;
+            swap.bank = 1;
+            swap_ch.Push(swap);
+            imem_swap_done_t done = swap_done_ch.Pop();
+            bank = done.bank.to_uint();
+            std::cout << "swap to bank " << bank << " after " << ranked << " packets, waited "
+                      << done.cycles << " cycles" << std::endl;
+            wait_packets();
+            failed = programs[0][0].ranked == 0 || programs[1][0].ranked == 0;
+        } else if (scenario == "table") {
+            configure(PROGRAM_CFG_ENTRY, 0, programs[0][0].entry);
+            inj_rst.write(true);
+            run_table();
+            wait_packets();
+            std::cout << "table: " << node.table_reads.read() << " reads, " << node.table_writes.read()
+                      << " writes, " << node.table_stall_cycles.read() << " core stall cycles" << std::endl;
+            failed = failed || node.table_stall_cycles.read() == 0;
+        } else if (scenario == "dma") {
+            configure(PROGRAM_CFG_ENTRY, 0, programs[0][0].entry);
+            inj_rst.write(true);
+            while (ranked < packets / 4)
+                wait();
+
+            // New quantum table, one burst into DMEM, issued while a
+            // packet is ranked
+            while (!node.core_busy.read())
+                wait();
+            wait(150);
+            dma_addr = layout.quantum >> 2;
+            for (unsigned f = 0; f < RANK_MAX_FLOWS; f++)
+                dma_table.push_back(100 * (f + 3));
+            dma_applied = false;
+            std::vector < std::pair < unsigned, unsigned > > table;
+            for (unsigned f = 0; f < RANK_MAX_FLOWS; f++)
+                table.push_back(std::make_pair(layout.quantum + 4 * f, dma_table[f]));
+            dma_done_t done = dma_load(DMA_TARGET_DMEM, table);
+            std::cout << "DMEM burst of " << done.words << " words after " << ranked << " packets, "
+                      << done.cycles << " cycles" << std::endl;
+            while (ranked < packets / 2)
+                wait();
+
+            // New program, one burst into the shadow bank
+            const tb_program & next = programs[1][0];
+            done = dma_load(DMA_TARGET_IMEM, next.words);
+            std::cout << "IMEM burst of " << done.words << " words after " << ranked << " packets, "
+                      << done.cycles << " cycles" << std::endl;
+            configure(PROGRAM_CFG_SHADOW_ENTRY, 0, next.entry);
+            imem_swap_req_t swap;
+            swap.bank = 1;
+            swap_ch.Push(swap);
+            bank = swap_done_ch.Pop().bank.to_uint();
+            wait_packets();
+            failed = !dma_applied || programs[0][0].ranked == 0 || programs[1][0].ranked == 0;
+        } else if (scenario == "trace") {
+            configure(PROGRAM_CFG_ENTRY, 0, programs[0][0].entry);
+            inj_rst.write(true);
+            wait_packets();
+        }
+        sc_stop();
+    }
+
+    // Burst load of contiguous (byte address, word) pairs on dma_req_port.
+    dma_done_t dma_load(unsigned target, const std::vector < std::pair < unsigned, unsigned > > & words) {
+        dma_load_req_t req;
+        req.target = target;
+        req.base = words.front().first;
+        req.length = words.size();
+        dma_req_ch.Push(req);
+        for (size_t i = 0; i < words.size(); i += DMA_BEAT_WORDS) {
+            dma_beat_t beat;
+            for (size_t j = 0; j < DMA_BEAT_WORDS && i + j < words.size(); j++)
+                beat.data[j] = words[i + j].second;
+            dma_data_ch.Push(beat);
+        }
+        return dma_done_ch.Pop();
+    }
+
+    // Control plane of the table scenario: back-to-back reads of the
+    // quantum table, and a new quantum every 4 ranked packets, issued at
+    // a different point of a rank each time.
+    void run_table() {
+        uint32_t quantum[TB_FLOWS];
+        for (unsigned f = 0; f < TB_FLOWS; f++)
+            quantum[f] = ref_dmem[(layout.quantum >> 2) + f];
+        unsigned long long next_write = 4;
+        unsigned long long limit = (TB_PACKET_CYCLES + interval) * (packets + 1);
+        unsigned writes = 0;
+        for (unsigned long long i = 0; i < limit && departed < packets; i++) {
+            table_req_t req;
+            if (ranked >= next_write && ranked < packets) {
+                // At a varying point of the next packet's rank
+                wait((writes * 37) % 200);
+                unsigned f = writes++ % TB_FLOWS;
+                quantum[f] = 128 * (writes + 1);
+                req.write = 1;
+                req.addr = layout.quantum + 4 * f;
+                req.data = quantum[f];
+                table_writes.push_back(std::make_pair(req.addr.to_uint() >> 2, quantum[f]));
+                table_req_ch.Push(req);
+                next_write += 4;
+            }
+            unsigned f = i % TB_FLOWS;
+            req.write = 0;
+            req.addr = layout.quantum + 4 * f;
+            req.data = 0;
+            table_req_ch.Push(req);
+            table_resp_t resp = table_resp_ch.Pop();
+            if (resp.data.to_uint() != quantum[f]) {
+                if (mismatches++ < 10)
+                    std::cerr << "table read of flow " << f << " quantum: " << resp.data.to_uint() << ", last written "
+                              << quantum[f] << std::endl;
+            }
+        }
+    }
+
+    // Queue primitive of the node. Checks each rank against the model of
+    // the packet's program, run on the mirror DMEM in enqueue order.
+    // A dequeue request waits for a packet if the queue is empty.
+    void queue_th() {
+        bool have_req = false, have_resp = false;
+        packet_dequeue_req_t req;
+        packet_dequeue_resp_t resp;
+        wait();
+
+        while (true) {
+            packet_enqueue_t enq;
+            if (enq_ch.PopNB(enq)) {
+                check_rank(enq);
+                pifo.enqueue(enq);
+            }
+            if (!have_req)
+                have_req = deq_req_ch.PopNB(req);
+            if (have_req && !have_resp && pifo.dequeue(resp.metadata)) {
+                have_req = false;
+                have_resp = true;
+            }
+            if (have_resp && deq_resp_ch.PushNB(resp)) {
+                have_resp = false;
+                departed++;
+            }
+            wait();
+        }
+    }
+
+    void check_rank(const packet_enqueue_t & enq) {
+        const packet_metadata_t & m = enq.metadata;
+        rank_packet_t p;
+        p.src = m.src.to_uint();
+        p.dst = m.dst.to_uint();
+        p.length = m.length.to_uint();
+        p.tos = m.tos.to_uint();
+        p.priority = m.priority.to_uint();
+        p.flow_id = m.flow_id.to_uint();
+        p.arrival_time = m.arrival_time.to_uint();
+        p.payload_ptr = m.payload_ptr.to_uint();
+        if (!trace_packets.empty()) {
+            const rank_packet_t * t = p.payload_ptr < trace_packets.size() ? & trace_packets[p.payload_ptr] : NULL;
+            if (!t || t->src != p.src || t->dst != p.dst || t->length != p.length || t->priority != p.priority ||
+                t->flow_id != p.flow_id) {
+                if (mismatches++ < 10)
+                    std::cerr << "packet " << ranked << " (payload " << p.payload_ptr
+                              << "): fields differ from its trace record" << std::endl;
+            }
+        }
+        uint32_t w[RANK_META_WORDS];
+        rank_meta_words(p, w);
+        for (int i = 0; i < RANK_META_WORDS; i++)
+            ref_dmem[(layout.meta >> 2) + i] = w[i];
+        // Table writes land between packets: those done by now were done
+        // before this packet was ranked
+        while (table_applied < table_writes.size() && table_applied < (size_t) node.table_writes.read()) {
+            ref_dmem[table_writes[table_applied].first] = table_writes[table_applied].second;
+            table_applied++;
+        }
+        // All of the burst or none of it: the node holds its last word once
+        // the whole burst is in
+        if (!dma_applied && node.dmem.read(dma_addr + dma_table.size() - 1).to_uint() == dma_table.back()) {
+            for (size_t i = 0; i < dma_table.size(); i++)
+                ref_dmem[dma_addr + i] = dma_table[i];
+            dma_applied = true;
+        }
+
+        unsigned program = class_program[p.flow_id & 0xF];
+        tb_program & prog = programs[bank][program];
+        rank_ref_mem mem(ref_dmem.data(), ref_dmem.size());
+        bool ok = prog.ref && prog.ref(mem, layout);
+        uint32_t rank = ref_dmem[layout.out >> 2];
+        enqueued_rank[p.payload_ptr] = enq.rank.to_uint();
+        if (!ok || rank != enq.rank.to_uint()) {
+            if (mismatches++ < 10)
+                std::cerr << "packet " << ranked << " flow " << p.flow_id << " (bank " << bank << " program "
+                          << program << ", " << prog.model << "): rank " << enq.rank.to_uint() << ", model "
+                          << (ok ? std::to_string(rank) : std::string("failed")) << std::endl;
+        }
+        prog.ranked++;
+        ranked++;
+    }
+};
+
+int sc_main(int argc, char * argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <scenario> [options]" << std::endl;
+        std::cerr << "scenarios:" << std::endl;
+        std::cerr << "  multi            - DRR (classes 0-3) and WFQ (classes 4-7) resident at once" << std::endl;
+        std::cerr << "  swap             - DRR, then WFQ from the other IMEM bank, switched under traffic" << std::endl;
+        std::cerr << "  table            - DRR while the control plane reads and writes its quantum table" << std::endl;
+        std::cerr << "  dma              - DRR, a DMEM burst of its quantum table, then WFQ by an IMEM burst" << std::endl;
+        std::cerr << "  trace            - DRR on the packets of a CSV or pcap trace" << std::endl;
+        std::cerr << "options:" << std::endl;
+        std::cerr << "  --packets <n>    - packets to rank (default 64), spread over 8 flows" << std::endl;
+        std::cerr << "  --interval <n>   - one packet every n cycles (default back to back)" << std::endl;
+        std::cerr << "  --idle-skip      - suspend the core while the node idles" << std::endl;
+        std::cerr << "  --pkt-log <file> - egress log of the packets (.csv or binary), checked at the end" << std::endl;
+        std::cerr << "  --drr <elf>      - DRR program (default core/schedulers/drr/notmain.elf)" << std::endl;
+        std::cerr << "  --wfq <elf>      - WFQ program linked away from the DRR one" << std::endl;
+        std::cerr << "                     (default core/schedulers/wfq/notmain_0x400.elf)" << std::endl;
+        std::cerr << "  --trace <file>   - trace of the trace scenario (default core/tests/trace.csv)" << std::endl;
+        return -1;
+    }
+
+    std::string scenario = argv[1];
+    unsigned long long packets = 64;
+    std::string drr_path = "core/schedulers/drr/notmain.elf";
+    std::string wfq_path = "core/schedulers/wfq/notmain_0x400.elf";
+    unsigned long long interval = 0;
+    bool idle_skip = false;
+    std::string pkt_log_path;
+    std::string trace_path = "core/tests/trace.csv";
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--packets" && i + 1 < argc) {
+            packets = strtoull(argv[++i], NULL, 0);
+        } else if (arg == "--interval" && i + 1 < argc) {
+            interval = strtoull(argv[++i], NULL, 0);
+        } else if (arg == "--idle-skip") {
+            idle_skip = true;
+        } else if (arg == "--pkt-log" && i + 1 < argc) {
+            pkt_log_path = argv[++i];
+        } else if (arg == "--drr" && i + 1 < argc) {
+            drr_path = argv[++i];
+        } else if (arg == "--wfq" && i + 1 < argc) {
+            wfq_path = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return -1;
+        }
+    }
+
+    node_bench bench("bench", scenario, packets);
+    bool loaded;
+    if (scenario == "multi")
+        loaded = bench.load_program(0, 0, drr_path, "drr") && bench.load_program(0, 1, wfq_path, "wfq");
+    else if (scenario == "swap" || scenario == "dma")
+        loaded = bench.load_program(0, 0, drr_path, "drr") && bench.load_program(1, 0, wfq_path, "wfq");
+    else if (scenario == "table") {
+        loaded = bench.load_program(0, 0, drr_path, "drr");
+        bench.node.set_table_max_wait(0);
+    } else if (scenario == "trace") {
+        loaded = bench.load_program(0, 0, drr_path, "drr") && bench.open_trace(trace_path);
+    } else {
+        std::cerr << "Unknown scenario " << scenario << std::endl;
+        return -1;
+    }
+    if (!loaded)
+        return -1;
+    bench.load_tables();
+    bench.interval = interval;
+    bench.node.set_idle_skip(idle_skip);
+    if (!pkt_log_path.empty() && !bench.sink.open(pkt_log_path)) {
+        std::cerr << "Cannot open " << pkt_log_path << std::endl;
+        return -1;
+    }
+
+    clock_t start = clock();
+    sc_start();
+    double wall = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    if (!pkt_log_path.empty())
+        bench.check_egress_log(pkt_log_path);
+    bench.report(std::cout);
+    std::cout << "simulated " << (unsigned long long) (sc_time_stamp() / bench.clk.period()) << " cycles in " << wall
+              << " s" << std::endl;
+    bool pass = bench.passed();
+    std::cout << scenario << ": " << (pass ? "PASS" : "FAIL") << std::endl;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+/*
+	@brief
+	Native runner for the rank programs on the instruction-accurate ISS
+	(src/iss.h). Each packet is written to the metadata words of the DMEM,
+	the program is run from PC 0 to its end and the rank is read back, as
+	the scheduling node does with the core. DMEM state (finish times,
+	service counters, ...) carries over from one packet to the next.
+
+	Usage: iss <notmain.elf|notmain.txt> [options]
+		--packets <file>   one packet per line: flow_id length [priority [arrival]],
+		                   or a .csv or pcap trace (src/packet_trace.h)
+		--bench <n>        run n synthetic packets and report the throughput
+		--flows <n>        flows of the synthetic and pcap packets (default 8)
+		--gen <spec>       seeded synthetic workload, e.g. flows=8,load=0.7,weights=1:2:4:8
+		                   (src/traffic_gen.h); its weights replace --weight
+		--weight <q>       weight/quantum written for every flow (default 128)
+		--deq-cycle <n>    initial DRR dequeue cycle (default 0x10)
+		--quiet            do not print the ranks
+
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "iss.h"
+#include "packet_source.h"
+#include "rank_abi.h"
+#include "traffic_gen.h"
+
+static const uint64_t MAX_INSNS_PER_PACKET = 1000000;
+
+static const char * const stop_names[] = { "end", "instruction limit", "trap", "illegal instruction", "bad address" };
+
+static bool rank_one(iss & cpu, const rank_layout_t & layout, const rank_packet_t & p, uint32_t & rank) {
+    uint32_t w[RANK_META_WORDS];
+    rank_meta_words(p, w);
+    for (int i = 0; i < RANK_META_WORDS; i++)
+        cpu.write_dmem(layout.meta + 4 * i, w[i]);
+
+    cpu.reset();
+    iss::stop_t s = cpu.run(MAX_INSNS_PER_PACKET);
+    if (s != iss::ISS_END) {
+        fprintf(stderr, "rank program stopped at pc 0x%x: %s\n", cpu.pc(), stop_names[s]);
+        return false;
+    }
+    rank = cpu.read_dmem(layout.out);
+    return true;
+}
+
+static void usage(const char * prog) {
+    fprintf(stderr, "Usage: %s <notmain.elf> [--packets <file>] [--bench <n>] [--gen <spec>] [--flows <n>]\n"
+        "          [--weight <q>] [--deq-cycle <n>] [--quiet]\n", prog);
+}
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::string packets_path;
+    unsigned long long bench = 0;
+    unsigned flows = 8;
+    uint32_t weight = 128;
+    uint32_t deq_cycle = 0x10;
+    bool quiet = false;
+    traffic_config workload;
+    bool have_workload = false;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--packets" && i + 1 < argc)
+            packets_path = argv[++i];
+        else if (arg == "--bench" && i + 1 < argc)
+            bench = strtoull(argv[++i], NULL, 0);
+        else if (arg == "--gen" && i + 1 < argc) {
+            if (!workload.parse(argv[++i])) {
+                fprintf(stderr, "--gen: %s\n", workload.error().c_str());
+                return 1;
+            }
+            have_workload = true;
+        } else if (arg == "--flows" && i + 1 < argc)
+            flows = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--weight" && i + 1 < argc)
+            weight = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--deq-cycle" && i + 1 < argc)
+            deq_cycle = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--quiet")
+            quiet = true;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (flows == 0 || flows > RANK_MAX_FLOWS) {
+        fprintf(stderr, "--flows must be 1..%d\n", RANK_MAX_FLOWS);
+        return 1;
+    }
+
+    iss cpu;
+    rank_layout_t layout;
+    if (!cpu.load_program(argv[1], & layout)) {
+        fprintf(stderr, "Cannot load %s\n", argv[1]);
+        return 1;
+    }
+    for (unsigned f = 0; f < flows; f++) {
+        cpu.write_dmem(layout.weight + 4 * f, have_workload ? workload.weight(f) : weight);
+        cpu.write_dmem(layout.quantum + 4 * f, have_workload ? workload.weight(f) : weight);
+    }
+    cpu.write_dmem(layout.deq_cycle, deq_cycle);
+
+    packet_source packets;
+    if (!packets_path.empty() && !packets.open(packets_path)) {
+        fprintf(stderr, "Cannot open %s\n", packets_path.c_str());
+        return 1;
+    }
+    if (have_workload)
+        packets.open_generator(workload);
+    packets.open_synthetic(bench, flows);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned long long count = 0;
+    rank_packet_t p;
+    uint32_t rank;
+
+    while (packets.next(p)) {
+        if (!rank_one(cpu, layout, p, rank))
+            return 1;
+        if (!quiet)
+            printf("%llu %u %u %u\n", count, (unsigned) p.flow_id, (unsigned) p.length, rank);
+        count++;
+    }
+    if (packets.failed())
+        return 1;
+
+    double secs = std::chrono::duration < double > (std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%llu packets, %llu instructions in %.3f s", count, (unsigned long long) cpu.retired(), secs);
+    if (secs > 0)
+        fprintf(stderr, " (%.1f M instr/s, %.2f M packets/s)", cpu.retired() / secs / 1e6, count / secs / 1e6);
+    fprintf(stderr, "\n");
+    return 0;
+}
@@ -0,0 +1,311 @@
+/*
+	@brief
+	Untimed SchedulingNode (src/node_model.h) for policy sweeps: packets
+	are ranked by the rank program and queued in the node's PIFO; a packet
+	is dequeued whenever the PIFO holds <depth> packets, and the rest at the
+	end of the stream. Prints one line per dequeued packet,
+	"seq flow length rank" with seq the arrival index, which is the order
+	sim_sc --pifo <depth> prints on its DEQ lines.
+
+	With --link the queue drains instead onto a link of <b> bytes per
+	cycle: packets are ranked on their arrival cycle and dequeued whenever
+	the link is free, and --pkt-log writes the egress log of the run
+	(src/packet_log.h, the input of tools/pkt_analyze).
+
+	The rank program is the one translated by rank_aot (built per
+	scheduler like rank_score); --iss interprets it on the ISS instead.
+
+	Usage: node_untimed_<sched> [options]
+		--packets <file>   one packet per line: flow_id length [priority [arrival]],
+		                   or a .csv or pcap trace (src/packet_trace.h)
+		--bench <n>        n synthetic packets
+		--flows <n>        flows of the synthetic and pcap packets (default 8)
+		--gen <spec>       seeded synthetic workload, e.g. flows=8,load=0.7,weights=1:2:4:8
+		                   (src/traffic_gen.h); its weights replace --weight
+		--weight <q>       weight/quantum written for every flow (default 128)
+		--deq-cycle <n>    initial DRR dequeue cycle (default 0x10)
+		--pifo <depth>     PIFO occupancy that triggers a dequeue (default 16)
+		--link <b>         dequeue onto a link of b bytes per cycle instead
+		--pkt-log <file>   with --link, per-packet log (.csv or binary)
+		--iss              rank on the ISS instead of the translated code
+		--quiet            do not print the dequeued packets
+
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unordered_map>
+
+#include "node_model.h"
+#include "packet_log.h"
+#include "packet_source.h"
+#include "rank_abi.h"
+#include "rank_aot.h"
+#include "traffic_gen.h"
+
+// Rank program translated by rank_aot.
+class aot_ranker {
+    public:
+    aot_ranker(): mem(DCACHE_SIZE, 0) {}
+
+    uint32_t * dmem() {
+        return mem.data();
+    }
+
+    unsigned dmem_words() {
+        return mem.size();
+    }
+
+    bool run() {
+        return rank_aot_run(mem.data(), mem.size()) == RANK_AOT_END;
+    }
+
+    private:
+    std::vector < uint32_t > mem;
+};
+
+// Dequeue lines, formatted into a buffer written out in 64 KB blocks:
+// printf took most of the time of a run.
+class line_out {
+    public:
+    line_out(): n(0) {}
+
+    ~line_out() {
+        flush();
+    }
+
+    // v followed by sep (' ' or '\n'), two digits per division.
+    void put(unsigned long long v, char sep) {
+        static const char pairs[] =
+            "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+            "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+        if (n + 21 > sizeof(buf))
+            flush();
+        char d[20];
+        int k = 20;
+        while (v >= 100) {
+            unsigned r = v % 100;
+            v /= 100;
+            d[--k] = pairs[2 * r + 1];
+            d[--k] = pairs[2 * r];
+        }
+        if (v >= 10) {
+            d[--k] = pairs[2 * v + 1];
+            d[--k] = pairs[2 * v];
+        } else {
+            d[--k] = '0' + v;
+        }
+        memcpy(buf + n, d + k, 20 - k);
+        n += 20 - k;
+        buf[n++] = sep;
+    }
+
+    void flush() {
+        fwrite(buf, 1, n, stdout);
+        n = 0;
+    }
+
+    private:
+    char buf[1 << 16];
+    size_t n;
+};
+
+struct options {
+    std::string packets_path;
+    unsigned long long bench;
+    unsigned flows;
+    uint32_t weight;
+    uint32_t deq_cycle;
+    unsigned depth;
+    bool quiet;
+    traffic_config workload;
+    bool have_workload;
+    double link;
+    std::string log_path;
+
+    options(): bench(0), flows(8), weight(128), deq_cycle(0x10), depth(16), quiet(false), have_workload(false),
+        link(0) {}
+};
+
+// Same initial state as sim_sc --packets: the program image in DMEM, the
+// weight of every table entry and the dequeue cycle.
+template < class RANKER > static void init_dmem(RANKER & r, const options & o) {
+    uint32_t * dmem = r.dmem();
+    for (unsigned i = 0; i < rank_aot_image_words && i < r.dmem_words(); i++)
+        dmem[i] = rank_aot_image[i];
+    const rank_layout_t layout = rank_aot_layout();
+    for (unsigned f = 0; f < RANK_MAX_FLOWS; f++) {
+        dmem[(layout.weight >> 2) + f] = o.have_workload ? o.workload.weight(f) : o.weight;
+        dmem[(layout.quantum >> 2) + f] = dmem[(layout.weight >> 2) + f];
+    }
+    dmem[layout.deq_cycle >> 2] = o.deq_cycle;
+}
+
+template < class RANKER > static int run(RANKER & ranker, const options & o) {
+    init_dmem(ranker, o);
+    node_model < rank_packet_t, RANKER > node(ranker);
+    node.set_layout(rank_aot_layout());
+
+    packet_source packets;
+    if (!o.packets_path.empty() && !packets.open(o.packets_path)) {
+        fprintf(stderr, "Cannot open %s\n", o.packets_path.c_str());
+        return 1;
+    }
+    if (o.have_workload)
+        packets.open_generator(o.workload);
+    packets.open_synthetic(o.bench, o.flows);
+
+    packet_log log;
+    if (!o.log_path.empty() && !log.open(o.log_path)) {
+        fprintf(stderr, "Cannot open %s\n", o.log_path.c_str());
+        return 1;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned long long dequeued = 0;
+    rank_packet_t p;
+    uint32_t rank;
+    uint64_t seq;
+
+    // --link: arrival cycle of the queued packets by enqueue index, and the
+    // cycle the link is free from.
+    std::unordered_map < uint64_t, unsigned long long > arrivals;
+    double link_free = 0;
+
+    line_out out;
+    auto depart = [&](const rank_packet_t & q) {
+        if (!o.quiet) {
+            out.put(seq, ' ');
+            out.put(q.flow_id, ' ');
+            out.put(q.length, ' ');
+            out.put(rank, '\n');
+        }
+        dequeued++;
+        if (o.link <= 0)
+            return;
+        std::unordered_map < uint64_t, unsigned long long >::iterator it = arrivals.find(seq);
+        if (log.is_open()) {
+            packet_log_rec_t r;
+            r.seq = seq;
+            r.ingress = r.enqueue = it->second;
+            r.dequeue = (uint64_t) link_free;
+            r.rank = rank;
+            r.flow_id = q.flow_id;
+            r.length = q.length;
+            r.priority = q.priority;
+            r.tos = q.tos;
+            r.payload_ptr = q.payload_ptr;
+            log.write(r);
+        }
+        arrivals.erase(it);
+        link_free += q.length / o.link;
+    };
+
+    while (true) {
+        unsigned long long arrival;
+        bool more = packets.next(p, & arrival);
+        if (o.link > 0) {
+            // Transmissions that start before the arrival.
+            rank_packet_t q;
+            while ((!more || link_free < arrival) && node.dequeue(q, & rank, & seq))
+                depart(q);
+            if (more && link_free < arrival)
+                link_free = arrival;
+        }
+        if (more) {
+            if (!node.enqueue(p)) {
+                fprintf(stderr, "packet %llu: rank program did not end\n", node.packets());
+                return 1;
+            }
+            if (o.link > 0)
+                arrivals[node.packets() - 1] = arrival;
+        }
+        while (o.link <= 0 && (more ? node.backlog() >= o.depth : node.backlog() > 0) && node.dequeue(p, & rank, & seq))
+            depart(p);
+        if (!more)
+            break;
+    }
+    out.flush();
+    log.close();
+    if (packets.failed())
+        return 1;
+
+    double secs = std::chrono::duration < double > (std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%s: %llu packets in %.3f s", rank_aot_source, dequeued, secs);
+    if (secs > 0)
+        fprintf(stderr, " (%.2f M packets/s)", dequeued / secs / 1e6);
+    if (log.deferred_records())
+        fprintf(stderr, ", %llu log records deferred (at most %zu queued)", log.deferred_records(), log.max_overflow());
+    fprintf(stderr, "\n");
+    return 0;
+}
+
+static void usage(const char * prog) {
+    fprintf(stderr, "Usage: %s [--packets <file>] [--bench <n>] [--gen <spec>] [--flows <n>] [--weight <q>]\n"
+        "          [--deq-cycle <n>] [--pifo <depth>] [--link <b>] [--pkt-log <file>] [--iss] [--quiet]\n", prog);
+}
+
+int main(int argc, char * argv[]) {
+    options o;
+    bool use_iss = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--packets" && i + 1 < argc)
+            o.packets_path = argv[++i];
+        else if (arg == "--bench" && i + 1 < argc)
+            o.bench = strtoull(argv[++i], NULL, 0);
+        else if (arg == "--gen" && i + 1 < argc) {
+            if (!o.workload.parse(argv[++i])) {
+                fprintf(stderr, "--gen: %s\n", o.workload.error().c_str());
+                return 1;
+            }
+            o.have_workload = true;
+        } else if (arg == "--flows" && i + 1 < argc)
+            o.flows = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--weight" && i + 1 < argc)
+            o.weight = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--deq-cycle" && i + 1 < argc)
+            o.deq_cycle = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--pifo" && i + 1 < argc)
+            o.depth = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--link" && i + 1 < argc)
+            o.link = strtod(argv[++i], NULL);
+        else if (arg == "--pkt-log" && i + 1 < argc)
+            o.log_path = argv[++i];
+        else if (arg == "--iss")
+            use_iss = true;
+        else if (arg == "--quiet")
+            o.quiet = true;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (o.flows == 0 || o.flows > RANK_MAX_FLOWS) {
+        fprintf(stderr, "--flows must be 1..%d\n", RANK_MAX_FLOWS);
+        return 1;
+    }
+    if (!o.log_path.empty() && !(o.link > 0)) {
+        fprintf(stderr, "--pkt-log needs --link\n");
+        return 1;
+    }
+    if (o.depth == 0) {
+        fprintf(stderr, "--pifo must be at least 1\n");
+        return 1;
+    }
+
+    if (use_iss) {
+        iss_ranker ranker;
+        for (unsigned i = 0; i < rank_aot_image_words; i++)
+            ranker.cpu().write_imem(i << 2, rank_aot_image[i]);
+        return run(ranker, o);
+    }
+    aot_ranker ranker;
+    return run(ranker, o);
+}
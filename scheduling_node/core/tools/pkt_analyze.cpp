@@ -0,0 +1,472 @@
+/*
+	@brief
+	Scheduling quality of a packet log (src/packet_log.h, CSV or binary),
+	in one pass with memory bounded by the node's backlog:
+
+	- per-flow throughput, next to its demand-aware fair share;
+	- Jain's fairness index of the throughput normalized by the fair
+	  share, per window of --window cycles and over the log. In a window,
+	  a flow's demand is the bytes it had backlogged there (arrived before
+	  the window ends, dequeued after it starts), and the bytes the node
+	  sent in the window are split in weighted max-min fair shares of
+	  these demands (water-filling). A flow that asked for less than its
+	  weighted share is fair at its demand, so the index does not depend
+	  on the offered loads. The log's index is that of the throughput
+	  over the sum of the window shares;
+	- lag behind an ideal GPS server: the log's arrivals (ingress cycle,
+	  length, flow) are replayed into a fluid GPS server of --link bytes
+	  per cycle with the flow weights, and each packet's dequeue cycle is
+	  compared with its GPS finish time;
+	- p50 / p99 / p99.9 queueing delay and sojourn time per class.
+
+	The log carries the ingress cycle of every packet, so it is both the
+	ingress and the egress log. It is in dequeue order; records are put
+	back in ingress order (seq) for the GPS replay and the window demands
+	with a reorder buffer as large as the backlog. A window is closed once
+	every packet that arrived before its end has been put back.
+
+	Usage: pkt_analyze <log> [options]
+		--weights <w:w:...>  flow weights, repeated over the flows (default 1,
+		                     i.e. equal shares); use the WEIGHT_TABLE values
+		--link <b>           link rate of the GPS server, bytes per cycle (default 1)
+		--window <cycles>    throughput window (default 10000)
+		--windows <file>     write the per-window throughput and Jain index (CSV)
+		--class <c>          latency classes: priority (default), flow or tos
+
+*/
+
+#include <stdint.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "packet_log.h"
+#include "rank_abi.h"
+#include "traffic_gen.h"
+
+// Latency histogram with constant memory: exact below 2^SUB cycles, then
+// 2^SUB buckets per power of two (under 1% error).
+class latency_hist {
+    public:
+    latency_hist(): counts(BUCKETS, 0), n(0), top(0) {}
+
+    void add(uint64_t v) {
+        counts[bucket(v)]++;
+        n++;
+        if (v > top)
+            top = v;
+    }
+
+    uint64_t quantile(double q) const {
+        uint64_t rank = (uint64_t) std::ceil(q * n);
+        if (rank == 0)
+            rank = 1;
+        uint64_t seen = 0;
+        for (unsigned b = 0; b < BUCKETS; b++) {
+            seen += counts[b];
+            if (seen >= rank)
+                return lower(b) < top ? lower(b) : top;
+        }
+        return top;
+    }
+
+    uint64_t count() const {
+        return n;
+    }
+
+    uint64_t max() const {
+        return top;
+    }
+
+    private:
+    enum { SUB = 7, BUCKETS = (64 - SUB + 1) << SUB };
+
+    std::vector < uint64_t > counts;
+    uint64_t n;
+    uint64_t top;
+
+    static unsigned bucket(uint64_t v) {
+        if (v < (1u << SUB))
+            return v;
+        unsigned e = 63 - __builtin_clzll(v);
+        return ((e - SUB + 1) << SUB) + ((v >> (e - SUB)) & ((1u << SUB) - 1));
+    }
+
+    static uint64_t lower(unsigned b) {
+        if (b < (1u << SUB))
+            return b;
+        unsigned e = (b >> SUB) + SUB - 1;
+        return ((uint64_t)((1u << SUB) + (b & ((1u << SUB) - 1)))) << (e - SUB);
+    }
+};
+
+// Fluid GPS server: packets of the flows share the link in proportion to
+// the weights of the backlogged flows. Virtual time V advances at
+// link / (sum of backlogged weights); a packet finishes when V reaches its
+// finish tag max(V(arrival), F of the previous packet of its flow) +
+// length / weight.
+class gps_server {
+    public:
+    struct done_t {
+        packet_log_rec_t rec;
+        double finish; // cycle
+    };
+
+    gps_server(double link_rate, const std::vector < double > & w):
+        link(link_rate), weight(w), last_finish(w.size(), 0), queued(w.size(), 0), now(0), vtime(0), active_weight(0) {}
+
+    // Replays an arrival; finished packets go to done (in finish order).
+    void arrive(const packet_log_rec_t & r, std::vector < done_t > & done) {
+        advance((double) r.ingress, done);
+        unsigned f = r.flow_id % weight.size();
+        double start = vtime > last_finish[f] ? vtime : last_finish[f];
+        entry_t e;
+        e.finish_tag = start + r.length / weight[f];
+        e.rec = r;
+        last_finish[f] = e.finish_tag;
+        if (queued[f]++ == 0)
+            active_weight += weight[f];
+        heap.push(e);
+    }
+
+    // Serves everything left.
+    void drain(std::vector < done_t > & done) {
+        advance(HUGE_VAL, done);
+    }
+
+    private:
+    struct entry_t {
+        double finish_tag;
+        packet_log_rec_t rec;
+
+        bool operator < (const entry_t & o) const {
+            return finish_tag != o.finish_tag ? finish_tag > o.finish_tag : rec.seq > o.rec.seq;
+        }
+    };
+
+    double link;
+    std::vector < double > weight;
+    std::vector < double > last_finish;
+    std::vector < unsigned long long > queued;
+    std::priority_queue < entry_t > heap;
+    double now;
+    double vtime;
+    double active_weight;
+
+    void advance(double t, std::vector < done_t > & done) {
+        while (now < t) {
+            if (heap.empty()) {
+                now = t;
+                return;
+            }
+            const entry_t & e = heap.top();
+            double rate = link / active_weight;
+            double hit = now + (e.finish_tag - vtime) / rate;
+            if (hit > t) {
+                vtime += (t - now) * rate;
+                now = t;
+                return;
+            }
+            now = hit > now ? hit : now;
+            vtime = e.finish_tag;
+            done_t d;
+            d.rec = e.rec;
+            d.finish = now;
+            done.push_back(d);
+            unsigned f = e.rec.flow_id % weight.size();
+            if (--queued[f] == 0) {
+                active_weight -= weight[f];
+                if (active_weight < 1e-12)
+                    active_weight = 0;
+            }
+            heap.pop();
+        }
+    }
+};
+
+struct flow_stats {
+    unsigned long long packets;
+    unsigned long long bytes;
+    double fair_bytes; // sum of the window fair shares
+    double lag_sum;
+    double lag_max;
+    double lag_min;
+
+    flow_stats(): packets(0), bytes(0), fair_bytes(0), lag_sum(0), lag_max(-HUGE_VAL), lag_min(HUGE_VAL) {}
+};
+
+// Bytes of the flows in a window: dequeued in it, and backlogged in it.
+struct window_stats {
+    std::vector < double > sent;
+    std::vector < double > demand;
+
+    window_stats(): sent(RANK_MAX_FLOWS, 0), demand(RANK_MAX_FLOWS, 0) {}
+};
+
+// Weighted max-min fair split of capacity between demands (water-filling):
+// flows whose demand is below their weighted share get it, the rest share
+// what is left by weight.
+static std::vector < double > max_min_shares(double capacity, const std::vector < double > & demand,
+    const std::vector < double > & w) {
+    std::vector < double > share(demand.size(), 0);
+    std::vector < bool > open(demand.size());
+    double open_w = 0;
+    for (size_t f = 0; f < demand.size(); f++) {
+        open[f] = demand[f] > 0;
+        if (open[f])
+            open_w += w[f];
+    }
+    bool capped = true;
+    while (capped && open_w > 0 && capacity > 0) {
+        capped = false;
+        double level = capacity / open_w;
+        for (size_t f = 0; f < demand.size(); f++) {
+            if (open[f] && demand[f] <= level * w[f]) {
+                share[f] = demand[f];
+                capacity -= demand[f];
+                open_w -= w[f];
+                open[f] = false;
+                capped = true;
+            }
+        }
+        if (!capped) {
+            for (size_t f = 0; f < demand.size(); f++)
+                if (open[f])
+                    share[f] = level * w[f];
+        }
+    }
+    return share;
+}
+
+// Jain's index of the values of the flows in use.
+static double jain(const std::vector < double > & x) {
+    double sum = 0, sq = 0;
+    for (size_t i = 0; i < x.size(); i++) {
+        sum += x[i];
+        sq += x[i] * x[i];
+    }
+    return sq > 0 ? sum * sum / (x.size() * sq) : 1.0;
+}
+
+static void usage(const char * prog) {
+    fprintf(stderr, "Usage: %s <log> [--weights <w:w:...>] [--link <b>] [--window <cycles>] [--windows <file>]\n"
+        "          [--class priority|flow|tos]\n", prog);
+}
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    traffic_config weights;
+    weights.weights.assign(1, 1);
+    double link = 1.0;
+    unsigned long long window = 10000;
+    std::string windows_path;
+    std::string class_by = "priority";
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--weights" && i + 1 < argc) {
+            if (!weights.parse(std::string("weights=") + argv[++i])) {
+                fprintf(stderr, "--weights: %s\n", weights.error().c_str());
+                return 1;
+            }
+        } else if (arg == "--link" && i + 1 < argc)
+            link = strtod(argv[++i], NULL);
+        else if (arg == "--window" && i + 1 < argc)
+            window = strtoull(argv[++i], NULL, 0);
+        else if (arg == "--windows" && i + 1 < argc)
+            windows_path = argv[++i];
+        else if (arg == "--class" && i + 1 < argc)
+            class_by = argv[++i];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!(link > 0) || window == 0 || (class_by != "priority" && class_by != "flow" && class_by != "tos")) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    packet_log_reader log;
+    if (!log.open(argv[1])) {
+        fprintf(stderr, "%s\n", log.error().c_str());
+        return 1;
+    }
+    FILE * windows_out = NULL;
+    if (!windows_path.empty()) {
+        windows_out = fopen(windows_path.c_str(), "w");
+        if (!windows_out) {
+            fprintf(stderr, "Cannot open %s\n", windows_path.c_str());
+            return 1;
+        }
+        fprintf(windows_out, "start");
+        for (unsigned f = 0; f < RANK_MAX_FLOWS; f++)
+            fprintf(windows_out, ",flow%u", f);
+        fprintf(windows_out, ",jain\n");
+    }
+
+    std::vector < double > w(RANK_MAX_FLOWS);
+    for (unsigned f = 0; f < RANK_MAX_FLOWS; f++)
+        w[f] = weights.weight(f) ? weights.weight(f) : 1;
+    gps_server gps(link, w);
+    std::vector < flow_stats > flows(RANK_MAX_FLOWS);
+    std::map < unsigned, latency_hist > queueing, sojourn;
+    std::map < uint64_t, packet_log_rec_t > reorder; // by seq, until the gap closes
+    std::vector < gps_server::done_t > done;
+
+    unsigned long long packets = 0, bytes = 0;
+    uint64_t next_seq = 0, first_cycle = UINT64_MAX, last_cycle = 0;
+    unsigned long long windows = 0;
+    double jain_sum = 0, jain_min = 1.0;
+    size_t reorder_max = 0;
+    // Windows not closed yet, by index (start / window): from the one of
+    // the last ingress put back to the last dequeue seen
+    std::map < uint64_t, window_stats > open_windows;
+
+    // Closes the first open window.
+    auto close_window = [&]() {
+        std::map < uint64_t, window_stats >::iterator it = open_windows.begin();
+        const window_stats & ws = it->second;
+        double sent = 0;
+        for (unsigned f = 0; f < RANK_MAX_FLOWS; f++)
+            sent += ws.sent[f];
+        std::vector < double > fair = max_min_shares(sent, ws.demand, w);
+        std::vector < double > x;
+        for (unsigned f = 0; f < RANK_MAX_FLOWS; f++) {
+            flows[f].fair_bytes += fair[f];
+            if (fair[f] > 0)
+                x.push_back(ws.sent[f] / fair[f]);
+        }
+        if (!x.empty()) {
+            double j = jain(x);
+            jain_sum += j;
+            if (j < jain_min)
+                jain_min = j;
+            windows++;
+            if (windows_out) {
+                fprintf(windows_out, "%llu", (unsigned long long) (it->first * window));
+                for (unsigned f = 0; f < RANK_MAX_FLOWS; f++)
+                    fprintf(windows_out, ",%.6f", ws.sent[f] / window);
+                fprintf(windows_out, ",%.6f\n", j);
+            }
+        }
+        open_windows.erase(it);
+    };
+
+    // A packet in ingress order: it is backlogged from its ingress window
+    // to its dequeue window. Windows that end before its ingress are
+    // complete.
+    auto put_back = [&](const packet_log_rec_t & q) {
+        uint64_t first = q.ingress / window, last = q.dequeue / window;
+        while (!open_windows.empty() && open_windows.begin()->first < first)
+            close_window();
+        unsigned f = q.flow_id % RANK_MAX_FLOWS;
+        for (uint64_t k = first; k <= last; k++)
+            open_windows[k].demand[f] += q.length;
+        open_windows[last].sent[f] += q.length;
+    };
+
+    auto account_gps = [&]() {
+        for (size_t i = 0; i < done.size(); i++) {
+            flow_stats & fs = flows[done[i].rec.flow_id % RANK_MAX_FLOWS];
+            double lag = (double) done[i].rec.dequeue - done[i].finish;
+            fs.lag_sum += lag;
+            if (lag > fs.lag_max)
+                fs.lag_max = lag;
+            if (lag < fs.lag_min)
+                fs.lag_min = lag;
+        }
+        done.clear();
+    };
+
+    packet_log_rec_t r;
+    while (log.next(r)) {
+        flow_stats & fs = flows[r.flow_id % RANK_MAX_FLOWS];
+        fs.packets++;
+        fs.bytes += r.length;
+        packets++;
+        bytes += r.length;
+        if (r.ingress < first_cycle)
+            first_cycle = r.ingress;
+        if (r.dequeue > last_cycle)
+            last_cycle = r.dequeue;
+
+        unsigned cls = class_by == "flow" ? r.flow_id : class_by == "tos" ? r.tos : r.priority;
+        queueing[cls].add(r.queueing());
+        sojourn[cls].add(r.sojourn());
+
+        // GPS replay in ingress order.
+        reorder[r.seq] = r;
+        if (reorder.size() > reorder_max)
+            reorder_max = reorder.size();
+        while (!reorder.empty() && reorder.begin()->first == next_seq) {
+            put_back(reorder.begin()->second);
+            gps.arrive(reorder.begin()->second, done);
+            reorder.erase(reorder.begin());
+            next_seq++;
+        }
+        account_gps();
+    }
+    if (!log.error().empty()) {
+        fprintf(stderr, "%s\n", log.error().c_str());
+        return 1;
+    }
+    if (packets == 0) {
+        fprintf(stderr, "%s: no packets\n", argv[1]);
+        return 1;
+    }
+    // Gaps in seq (packets never dequeued) do not stop the replay.
+    for (std::map < uint64_t, packet_log_rec_t >::iterator it = reorder.begin(); it != reorder.end(); ++it) {
+        put_back(it->second);
+        gps.arrive(it->second, done);
+    }
+    while (!open_windows.empty())
+        close_window();
+    if (windows_out)
+        fclose(windows_out);
+    gps.drain(done);
+    account_gps();
+
+    unsigned long long span = last_cycle - first_cycle + 1;
+    printf("%llu packets, %llu bytes in %llu cycles (%.4f bytes/cycle), reorder buffer %zu\n", packets, bytes, span,
+        (double) bytes / span, reorder_max);
+
+    std::vector < double > x;
+    for (unsigned f = 0; f < RANK_MAX_FLOWS; f++)
+        if (flows[f].fair_bytes > 0)
+            x.push_back(flows[f].bytes / flows[f].fair_bytes);
+    printf("\nflow  weight   packets        bytes   share   fair  GPS lag mean / min / max (cycles)\n");
+    for (unsigned f = 0; f < RANK_MAX_FLOWS; f++) {
+        const flow_stats & fs = flows[f];
+        if (!fs.packets)
+            continue;
+        printf("%4u %7g %9llu %12llu %7.4f %6.4f  %.1f / %.1f / %.1f\n", f, w[f], fs.packets, fs.bytes,
+            (double) fs.bytes / bytes, fs.fair_bytes / bytes, fs.lag_sum / fs.packets, fs.lag_min, fs.lag_max);
+    }
+    printf("\nJain fairness (max-min fair shares): %.4f over the log", jain(x));
+    if (windows)
+        printf(", %.4f mean / %.4f min over %llu windows of %llu cycles", jain_sum / windows, jain_min, windows,
+            window);
+    printf("\n");
+
+    printf("\n%-8s %9s  queueing p50 / p99 / p99.9 / max      sojourn p50 / p99 / p99.9 / max\n", class_by.c_str(),
+        "packets");
+    for (std::map < unsigned, latency_hist >::iterator it = queueing.begin(); it != queueing.end(); ++it) {
+        const latency_hist & q = it->second, & s = sojourn[it->first];
+        printf("%-8u %9llu  %llu / %llu / %llu / %llu", it->first, (unsigned long long) q.count(),
+            (unsigned long long) q.quantile(0.5), (unsigned long long) q.quantile(0.99),
+            (unsigned long long) q.quantile(0.999), (unsigned long long) q.max());
+        printf("      %llu / %llu / %llu / %llu\n", (unsigned long long) s.quantile(0.5),
+            (unsigned long long) s.quantile(0.99), (unsigned long long) s.quantile(0.999),
+            (unsigned long long) s.max());
+    }
+    return 0;
+}
@@ -0,0 +1,256 @@
+/*
+	@brief
+	Ahead-of-time translator of a rank program (schedulers/<name>/notmain.elf)
+	to C++. Every loaded word becomes a labelled block of straight-line host
+	code with the semantics of the ISS (src/iss.h, itself checked against
+	drim4hls with --lockstep): registers are locals, branches and jal are
+	gotos, jalr dispatches through a switch over all code addresses. The
+	output implements rank_aot.h and is linked with rank_score.
+
+	The ISS follows the RISC-V specification where drim4hls does not:
+	the core compares SLTU/SLTIU as signed, and its SB/SH overwrite the
+	rest of the word with zeros (SH also stores only the low byte). The
+	translation would not match the core on those instructions, so a
+	program containing any of them is rejected.
+
+	Usage: rank_aot <notmain.elf> [-o <file.cpp>]
+
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "elf_file.h"
+#include "iss.h"
+#include "rank_abi.h"
+
+static std::string reg(unsigned r) {
+    return r == 0 ? "0u" : "x" + std::to_string(r);
+}
+
+static std::string dst(unsigned rd) {
+    return rd == REG_NUM ? "xz" : "x" + std::to_string(rd);
+}
+
+static std::string hex(uint32_t v) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "0x%xu", v);
+    return buf;
+}
+
+// Instructions on which the ISS, and so the translation, differ from the core.
+static const char * core_mismatch(uint32_t insn, uint32_t pc) {
+    switch (iss::decode(insn, pc).kind) {
+    case iss::K_SLTU: return "sltu";
+    case iss::K_SLTIU: return "sltiu";
+    case iss::K_SB: return "sb";
+    case iss::K_SH: return "sh";
+    default: return NULL;
+    }
+}
+
+static std::string label(uint32_t pc) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "L_%x", pc);
+    return buf;
+}
+
+class translator {
+    public:
+    translator(const std::map < uint32_t, uint32_t > & words): code(words) {}
+
+    // C++ for the instruction at pc.
+    std::string emit(uint32_t pc, uint32_t insn) const {
+        iss::op_t o = iss::decode(insn, pc);
+        std::string d = dst(o.rd), a = reg(o.rs1), b = reg(o.rs2);
+        std::string imm = hex(o.imm);
+        std::string sh = std::to_string(o.imm & 31);
+
+        switch (o.kind) {
+        case iss::K_END: return "return RANK_AOT_END;";
+        case iss::K_TRAP:
+        case iss::K_ILLEGAL:
+        case iss::K_CSRRW: case iss::K_CSRRS: case iss::K_CSRRC:
+        case iss::K_CSRRWI: case iss::K_CSRRSI: case iss::K_CSRRCI:
+            return "return RANK_AOT_UNSUPPORTED;";
+
+        case iss::K_LUI:
+        case iss::K_AUIPC: return d + " = " + imm + ";";
+        case iss::K_JAL: return d + " = " + hex(pc + 4) + "; " + jump(o.imm);
+        case iss::K_JALR:
+            return "next = (" + a + " + " + imm + ") & ~1u; " + d + " = " + hex(pc + 4) + "; goto dispatch;";
+
+        case iss::K_BEQ: return branch(a + " == " + b, o.imm);
+        case iss::K_BNE: return branch(a + " != " + b, o.imm);
+        case iss::K_BLT: return branch("(int32_t) " + a + " < (int32_t) " + b, o.imm);
+        case iss::K_BGE: return branch("(int32_t) " + a + " >= (int32_t) " + b, o.imm);
+        case iss::K_BLTU: return branch(a + " < " + b, o.imm);
+        case iss::K_BGEU: return branch(a + " >= " + b, o.imm);
+
+        case iss::K_LB: return load(a, imm) + d + " = (int32_t)(int8_t)(dmem[ea >> 2] >> ((ea & 3) * 8));";
+        case iss::K_LH: return load(a, imm) + d + " = (int32_t)(int16_t)(dmem[ea >> 2] >> ((ea & 2) * 8));";
+        case iss::K_LW: return load(a, imm) + d + " = dmem[ea >> 2];";
+        case iss::K_LBU: return load(a, imm) + d + " = (uint8_t)(dmem[ea >> 2] >> ((ea & 3) * 8));";
+        case iss::K_LHU: return load(a, imm) + d + " = (uint16_t)(dmem[ea >> 2] >> ((ea & 2) * 8));";
+        case iss::K_SB: return load(a, imm) + "{ unsigned s = (ea & 3) * 8; uint32_t m = 0xFFu << s; "
+            "dmem[ea >> 2] = (dmem[ea >> 2] & ~m) | ((" + b + " << s) & m); }";
+        case iss::K_SH: return load(a, imm) + "{ unsigned s = (ea & 2) * 8; uint32_t m = 0xFFFFu << s; "
+            "dmem[ea >> 2] = (dmem[ea >> 2] & ~m) | ((" + b + " << s) & m); }";
+        case iss::K_SW: return load(a, imm) + "dmem[ea >> 2] = " + b + ";";
+
+        case iss::K_ADDI: return d + " = " + a + " + " + imm + ";";
+        case iss::K_SLTI: return d + " = (int32_t) " + a + " < (int32_t) " + imm + ";";
+        case iss::K_SLTIU: return d + " = " + a + " < " + imm + ";";
+        case iss::K_XORI: return d + " = " + a + " ^ " + imm + ";";
+        case iss::K_ORI: return d + " = " + a + " | " + imm + ";";
+        case iss::K_ANDI: return d + " = " + a + " & " + imm + ";";
+        case iss::K_SLLI: return d + " = " + a + " << " + sh + ";";
+        case iss::K_SRLI: return d + " = " + a + " >> " + sh + ";";
+        case iss::K_SRAI: return d + " = (uint32_t)((int32_t) " + a + " >> " + sh + ");";
+
+        case iss::K_ADD: return d + " = " + a + " + " + b + ";";
+        case iss::K_SUB: return d + " = " + a + " - " + b + ";";
+        case iss::K_SLL: return d + " = " + a + " << (" + b + " & 31);";
+        case iss::K_SLT: return d + " = (int32_t) " + a + " < (int32_t) " + b + ";";
+        case iss::K_SLTU: return d + " = " + a + " < " + b + ";";
+        case iss::K_XOR: return d + " = " + a + " ^ " + b + ";";
+        case iss::K_SRL: return d + " = " + a + " >> (" + b + " & 31);";
+        case iss::K_SRA: return d + " = (uint32_t)((int32_t) " + a + " >> (" + b + " & 31));";
+        case iss::K_OR: return d + " = " + a + " | " + b + ";";
+        case iss::K_AND: return d + " = " + a + " & " + b + ";";
+
+        case iss::K_MUL: return d + " = " + a + " * " + b + ";";
+        case iss::K_MULH: return d + " = (uint32_t)(((int64_t)(int32_t) " + a + " * (int64_t)(int32_t) " + b + ") >> 32);";
+        case iss::K_MULHSU: return d + " = (uint32_t)(((int64_t)(int32_t) " + a + " * (int64_t)(uint64_t) " + b + ") >> 32);";
+        case iss::K_MULHU: return d + " = (uint32_t)(((uint64_t) " + a + " * (uint64_t) " + b + ") >> 32);";
+        case iss::K_DIV: return operands(a, b) + d + " = (s2 == 0) ? ~0u : (s1 == 0x80000000u && s2 == ~0u) ? s1 : "
+            "(uint32_t)((int32_t) s1 / (int32_t) s2); }";
+        case iss::K_DIVU: return operands(a, b) + d + " = s2 ? s1 / s2 : ~0u; }";
+        case iss::K_REM: return operands(a, b) + d + " = (s2 == 0) ? s1 : (s1 == 0x80000000u && s2 == ~0u) ? 0u : "
+            "(uint32_t)((int32_t) s1 % (int32_t) s2); }";
+        case iss::K_REMU: return operands(a, b) + d + " = s2 ? s1 % s2 : s1; }";
+        }
+        return "return RANK_AOT_UNSUPPORTED;";
+    }
+
+    private:
+    const std::map < uint32_t, uint32_t > & code;
+
+    std::string jump(uint32_t target) const {
+        if (!code.count(target))
+            return "return RANK_AOT_BAD_ADDR;";
+        return "goto " + label(target) + ";";
+    }
+
+    std::string branch(const std::string & cond, uint32_t target) const {
+        return "if (" + cond + ") " + jump(target);
+    }
+
+    static std::string load(const std::string & base, const std::string & imm) {
+        return "ea = " + base + " + " + imm + "; if ((ea >> 2) >= dmem_words) return RANK_AOT_BAD_ADDR; ";
+    }
+
+    static std::string operands(const std::string & a, const std::string & b) {
+        return "{ uint32_t s1 = " + a + ", s2 = " + b + "; ";
+    }
+};
+
+int main(int argc, char * argv[]) {
+    const char * out_path = NULL;
+    if (argc == 4 && !strcmp(argv[2], "-o"))
+        out_path = argv[3];
+    else if (argc != 2) {
+        fprintf(stderr, "Usage: %s <notmain.elf> [-o <file.cpp>]\n", argv[0]);
+        return 1;
+    }
+
+    elf_file elf;
+    if (!elf.open(argv[1])) {
+        fprintf(stderr, "%s\n", elf.error().c_str());
+        return 1;
+    }
+
+    std::map < uint32_t, uint32_t > words;
+    bool ok = elf.for_each_load_word([&words](unsigned addr, unsigned word) {
+        words[addr] = word;
+    });
+    if (!ok || words.empty()) {
+        fprintf(stderr, "%s: no loadable segments\n", argv[1]);
+        return 1;
+    }
+    if ((words.rbegin()->first >> 2) >= ICACHE_SIZE || !words.count(0)) {
+        fprintf(stderr, "%s: program must start at 0 and fit in %u words of IMEM\n", argv[1], ICACHE_SIZE);
+        return 1;
+    }
+
+    unsigned mismatches = 0;
+    for (std::map < uint32_t, uint32_t >::const_iterator it = words.begin(); it != words.end(); ++it) {
+        const char * op = core_mismatch(it->second, it->first);
+        if (!op)
+            continue;
+        if (mismatches++ < 10)
+            fprintf(stderr, "%s: pc 0x%x: %s does not execute on drim4hls as in the ISS\n", argv[1], it->first, op);
+    }
+    if (mismatches) {
+        fprintf(stderr, "%s: %u instructions the core executes differently, not translated\n", argv[1], mismatches);
+        return 1;
+    }
+
+    FILE * out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        perror(out_path);
+        return 1;
+    }
+
+    rank_layout_t layout;
+    layout.from_symbols(elf);
+
+    unsigned image_words = (words.rbegin()->first >> 2) + 1;
+    fprintf(out, "// Generated by rank_aot from %s. Do not edit.\n\n", argv[1]);
+    fprintf(out, "#include \"rank_aot.h\"\n\n");
+    fprintf(out, "const char rank_aot_source[] = \"%s\";\n\n", argv[1]);
+    fprintf(out, "const unsigned rank_aot_image_words = %u;\n\n", image_words);
+    fprintf(out, "const uint32_t rank_aot_image[] = {");
+    for (unsigned i = 0; i < image_words; i++) {
+        std::map < uint32_t, uint32_t >::const_iterator it = words.find(i << 2);
+        fprintf(out, "%s0x%08x,", (i % 8) ? " " : "\n    ", it == words.end() ? 0 : it->second);
+    }
+    fprintf(out, "\n};\n\n");
+    fprintf(out, "rank_layout_t rank_aot_layout() {\n    rank_layout_t l;\n");
+    fprintf(out, "    l.meta = 0x%x;\n    l.out = 0x%x;\n    l.weight = 0x%x;\n    l.quantum = 0x%x;\n", layout.meta,
+        layout.out, layout.weight, layout.quantum);
+    fprintf(out, "    l.deq_cycle = 0x%x;\n", layout.deq_cycle);
+    fprintf(out, "    l.finish_time = 0x%x;\n    l.srv_cntr = 0x%x;\n    l.vtime = 0x%x;\n", layout.finish_time,
+        layout.srv_cntr, layout.vtime);
+    fprintf(out, "    return l;\n}\n\n");
+
+    fprintf(out, "int rank_aot_run(uint32_t * dmem, unsigned dmem_words) {\n");
+    fprintf(out, "    uint32_t x1 = 0, x2 = 0, x3 = 0, x4 = 0, x5 = 0, x6 = 0, x7 = 0, x8 = 0,\n");
+    fprintf(out, "        x9 = 0, x10 = 0, x11 = 0, x12 = 0, x13 = 0, x14 = 0, x15 = 0, x16 = 0,\n");
+    fprintf(out, "        x17 = 0, x18 = 0, x19 = 0, x20 = 0, x21 = 0, x22 = 0, x23 = 0, x24 = 0,\n");
+    fprintf(out, "        x25 = 0, x26 = 0, x27 = 0, x28 = 0, x29 = 0, x30 = 0, x31 = 0;\n");
+    fprintf(out, "    uint32_t xz, ea, next;\n\n");
+
+    translator t(words);
+    for (std::map < uint32_t, uint32_t >::const_iterator it = words.begin(); it != words.end(); ++it) {
+        const elf_symbol_t * sym = elf.find_symbol(it->first);
+        if (sym && sym->value == it->first)
+            fprintf(out, "    // <%s>\n", sym->name.c_str());
+        fprintf(out, "%s: /* %08x */ %s\n", label(it->first).c_str(), it->second, t.emit(it->first, it->second).c_str());
+        if (!words.count(it->first + 4)) // falls out of the loaded code
+            fprintf(out, "    return RANK_AOT_BAD_ADDR;\n");
+    }
+    fprintf(out, "\n");
+
+    fprintf(out, "dispatch:\n    switch (next) {\n");
+    for (std::map < uint32_t, uint32_t >::const_iterator it = words.begin(); it != words.end(); ++it)
+        fprintf(out, "    case 0x%x: goto %s;\n", it->first, label(it->first).c_str());
+    fprintf(out, "    }\n    return RANK_AOT_BAD_JUMP;\n}\n");
+
+    if (out_path)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,31 @@
+/*
+	@brief
+	Interface of a rank program translated to C++ by rank_aot. The
+	generated file defines the symbols below; rank_score links against it.
+
+*/
+
+#ifndef __RANK_AOT__H
+#define __RANK_AOT__H
+
+#include <stdint.h>
+
+#include "rank_abi.h"
+
+// Return values of rank_aot_run().
+#define RANK_AOT_END         0 // reached the end-of-program self jump
+#define RANK_AOT_BAD_ADDR    1 // data access or fall-through outside the memories
+#define RANK_AOT_BAD_JUMP    2 // indirect jump to an address that is not code
+#define RANK_AOT_UNSUPPORTED 3 // CSR access, ecall/ebreak or illegal instruction
+
+extern const char rank_aot_source[]; // ELF the code was translated from
+extern const unsigned rank_aot_image_words;
+extern const uint32_t rank_aot_image[]; // initial IMEM/DMEM contents, word i at address 4 * i
+
+// DMEM layout from the rank_* symbols of the ELF.
+rank_layout_t rank_aot_layout();
+
+// Runs the program once from PC 0 with zeroed registers on dmem (word-addressed).
+int rank_aot_run(uint32_t * dmem, unsigned dmem_words);
+
+#endif // __RANK_AOT__H
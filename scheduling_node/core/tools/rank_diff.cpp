@@ -0,0 +1,229 @@
+/*
+	@brief
+	Differential check of a rank program against its golden model
+	(src/rank_ref.h). Random packets go through the program on the ISS and
+	through the model, from the same DMEM; after every packet the rank and
+	the scheduler state (rank_layout_t::state_lo() .. state_hi()) must
+	match, and the whole DMEM at the end. A divergence is reported with
+	the packet, and the model is resynchronised to the ISS state so that
+	later ones are independent.
+
+	Packets cover the full field ranges: any length (0, 64 and 1518 are
+	favoured), any priority and TOS. The weights are random (0, the RV32M
+	division by zero, included) and redrawn every --reweight packets, as
+	a control plane would.
+
+	Usage: rank_diff <notmain.elf|notmain.txt> [options]
+		--model <name>     sp, drr or wfq (default: the program's directory)
+		--packets <n>      random packets (default 1000000)
+		--seed <s>         random seed (default 1)
+		--flows <n>        flow ids 0..n-1 (default 16)
+		--weights <w:...>  fixed weights instead of random ones
+		--reweight <n>     new random weights every n packets (default 100000,
+		                   0: never)
+		--deq-cycle <n>    initial DRR dequeue cycle (default 0x10)
+		--max-errors <n>   stop after n divergences (default 10)
+
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "iss.h"
+#include "rank_abi.h"
+#include "rank_ref.h"
+#include "traffic_gen.h"
+
+static const uint64_t MAX_INSNS_PER_PACKET = 1000000;
+
+struct options {
+    std::string model;
+    unsigned long long packets;
+    uint64_t seed;
+    unsigned flows;
+    traffic_config weights;
+    bool fixed_weights;
+    unsigned long long reweight;
+    uint32_t deq_cycle;
+    unsigned max_errors;
+
+    options(): packets(1000000), seed(1), flows(RANK_MAX_FLOWS), fixed_weights(false), reweight(100000),
+        deq_cycle(0x10), max_errors(10) {}
+};
+
+// schedulers/<name>/notmain.elf -> name
+static std::string program_dir(const std::string & path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos)
+        return "";
+    size_t start = path.find_last_of('/', slash - 1);
+    start = start == std::string::npos ? 0 : start + 1;
+    return path.substr(start, slash - start);
+}
+
+static rank_packet_t random_packet(std::mt19937_64 & rng, unsigned flows) {
+    rank_packet_t p;
+    uint64_t r = rng();
+    p.src = (uint32_t) r;
+    p.dst = (uint32_t)(r >> 32);
+    r = rng();
+    p.flow_id = (r & 0xFFFF) % flows;
+    switch ((r >> 16) & 3) {
+    case 0:
+        p.length = 64;
+        break;
+    case 1:
+        p.length = 1518;
+        break;
+    default:
+        p.length = (r >> 18) & 0xFFFF;
+    }
+    p.tos = (r >> 34) & 0xFF;
+    p.priority = (r >> 42) & 0x7;
+    p.arrival_time = (r >> 45) & 0xFFFF;
+    p.payload_ptr = (uint32_t) rng();
+    return p;
+}
+
+static uint32_t random_weight(std::mt19937_64 & rng) {
+    uint64_t r = rng();
+    if ((r & 63) == 0)
+        return 0;
+    return 1 + (r >> 8) % 4096;
+}
+
+static void usage(const char * prog) {
+    fprintf(stderr, "Usage: %s <notmain.elf> [--model <name>] [--packets <n>] [--seed <s>] [--flows <n>]\n"
+        "          [--weights <w:...>] [--reweight <n>] [--deq-cycle <n>] [--max-errors <n>]\n", prog);
+}
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    options o;
+    o.model = program_dir(argv[1]);
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--model" && i + 1 < argc)
+            o.model = argv[++i];
+        else if (arg == "--packets" && i + 1 < argc)
+            o.packets = strtoull(argv[++i], NULL, 0);
+        else if (arg == "--seed" && i + 1 < argc)
+            o.seed = strtoull(argv[++i], NULL, 0);
+        else if (arg == "--flows" && i + 1 < argc)
+            o.flows = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--weights" && i + 1 < argc) {
+            if (!o.weights.parse(std::string("weights=") + argv[++i])) {
+                fprintf(stderr, "--weights: %s\n", o.weights.error().c_str());
+                return 1;
+            }
+            o.fixed_weights = true;
+        } else if (arg == "--reweight" && i + 1 < argc)
+            o.reweight = strtoull(argv[++i], NULL, 0);
+        else if (arg == "--deq-cycle" && i + 1 < argc)
+            o.deq_cycle = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--max-errors" && i + 1 < argc)
+            o.max_errors = strtoul(argv[++i], NULL, 0);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    rank_ref_model_t model = rank_ref_model(o.model);
+    if (!model) {
+        fprintf(stderr, "No golden model for '%s' (--model sp, drr or wfq)\n", o.model.c_str());
+        return 1;
+    }
+    if (o.flows == 0 || o.flows > RANK_MAX_FLOWS) {
+        fprintf(stderr, "--flows must be 1..%d\n", RANK_MAX_FLOWS);
+        return 1;
+    }
+
+    iss cpu;
+    rank_layout_t layout;
+    if (!cpu.load_program(argv[1], & layout)) {
+        fprintf(stderr, "Cannot load %s\n", argv[1]);
+        return 1;
+    }
+    // Scheduler state compared after every packet
+    const uint32_t state_lo = layout.state_lo(), state_hi = layout.state_hi();
+    std::mt19937_64 rng(o.seed);
+    for (unsigned f = 0; f < RANK_MAX_FLOWS; f++) {
+        uint32_t w = o.fixed_weights ? o.weights.weight(f) : random_weight(rng);
+        cpu.write_dmem(layout.weight + 4 * f, w);
+        cpu.write_dmem(layout.quantum + 4 * f, w);
+    }
+    cpu.write_dmem(layout.deq_cycle, o.deq_cycle);
+
+    // The model starts from the same DMEM, program image included.
+    std::vector < uint32_t > & dmem = cpu.data();
+    std::vector < uint32_t > ref(dmem);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned long long n, errors = 0, bad_addr = 0;
+    for (n = 0; n < o.packets && errors < o.max_errors; n++) {
+        if (!o.fixed_weights && o.reweight && n && n % o.reweight == 0) {
+            for (unsigned f = 0; f < RANK_MAX_FLOWS; f++) {
+                uint32_t w = random_weight(rng);
+                cpu.write_dmem(layout.weight + 4 * f, w);
+                cpu.write_dmem(layout.quantum + 4 * f, w);
+                ref[(layout.weight >> 2) + f] = w;
+                ref[(layout.quantum >> 2) + f] = w;
+            }
+        }
+
+        rank_packet_t p = random_packet(rng, o.flows);
+        uint32_t w[RANK_META_WORDS];
+        rank_meta_words(p, w);
+        for (int i = 0; i < RANK_META_WORDS; i++) {
+            cpu.write_dmem(layout.meta + 4 * i, w[i]);
+            ref[(layout.meta >> 2) + i] = w[i];
+        }
+
+        cpu.reset();
+        iss::stop_t s = cpu.run(MAX_INSNS_PER_PACKET);
+        rank_ref_mem m(ref.data(), ref.size());
+        bool ref_ok = model(m, layout);
+        if (s != iss::ISS_END && !(s == iss::ISS_BAD_ADDR && !ref_ok)) {
+            fprintf(stderr, "packet %llu: program stopped at pc 0x%x (%d)\n", n, cpu.pc(), (int) s);
+            return 1;
+        }
+        if (!ref_ok)
+            bad_addr++;
+
+        uint32_t addr;
+        for (addr = state_lo; addr < state_hi; addr += 4)
+            if (dmem[addr >> 2] != ref[addr >> 2])
+                break;
+        if (addr < state_hi) {
+            errors++;
+            printf("packet %llu: flow %u length %u priority %u: DMEM[0x%x] ISS 0x%x model 0x%x (rank ISS %u model %u)\n",
+                n, (unsigned) p.flow_id, (unsigned) p.length, (unsigned) p.priority, addr, dmem[addr >> 2],
+                ref[addr >> 2], dmem[layout.out >> 2], ref[layout.out >> 2]);
+            for (addr = state_lo; addr < state_hi; addr += 4)
+                ref[addr >> 2] = dmem[addr >> 2];
+        }
+    }
+    if (errors == 0) {
+        for (size_t i = 0; i < dmem.size(); i++) {
+            if (dmem[i] != ref[i]) {
+                printf("end: DMEM[0x%zx] ISS 0x%x model 0x%x\n", i << 2, dmem[i], ref[i]);
+                errors++;
+                break;
+            }
+        }
+    }
+
+    double secs = std::chrono::duration < double > (std::chrono::steady_clock::now() - start).count();
+    printf("%s: %llu packets, %llu divergences", o.model.c_str(), n, errors);
+    if (bad_addr)
+        printf(", %llu stopped on a bad address in both", bad_addr);
+    printf(" (%.3f s)\n", secs);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,169 @@
+/*
+	@brief
+	Bulk rank scoring with a rank program translated by rank_aot. Feeds
+	packets through the translated code exactly like tools/iss does through
+	the interpreter (same DMEM layout and initial state) and prints one rank
+	per packet. With --check every rank, and the DMEM at the end, are
+	compared with the ISS.
+
+	Usage: rank_score_<sched> [options]
+		--packets <file>   one packet per line: flow_id length [priority [arrival]],
+		                   or a .csv or pcap trace (src/packet_trace.h)
+		--bench <n>        n synthetic packets
+		--flows <n>        flows of the synthetic and pcap packets (default 8)
+		--gen <spec>       seeded synthetic workload, e.g. flows=8,load=0.7,weights=1:2:4:8
+		                   (src/traffic_gen.h); its weights replace --weight
+		--weight <q>       weight/quantum written for every flow (default 128)
+		--deq-cycle <n>    initial DRR dequeue cycle (default 0x10)
+		--check            compare with the ISS
+		--quiet            do not print the ranks
+
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "iss.h"
+#include "packet_source.h"
+#include "rank_abi.h"
+#include "rank_aot.h"
+#include "traffic_gen.h"
+
+static const char * const aot_errors[] = { "end", "bad address", "bad jump", "unsupported instruction" };
+
+static void write_meta(std::vector < uint32_t > & dmem, const rank_layout_t & layout, const rank_packet_t & p) {
+    uint32_t w[RANK_META_WORDS];
+    rank_meta_words(p, w);
+    for (int i = 0; i < RANK_META_WORDS; i++)
+        dmem[(layout.meta >> 2) + i] = w[i];
+}
+
+static void usage(const char * prog) {
+    fprintf(stderr, "Usage: %s [--packets <file>] [--bench <n>] [--gen <spec>] [--flows <n>] [--weight <q>]\n"
+        "          [--deq-cycle <n>] [--check] [--quiet]\n", prog);
+}
+
+int main(int argc, char * argv[]) {
+    std::string packets_path;
+    unsigned long long bench = 0;
+    unsigned flows = 8;
+    uint32_t weight = 128;
+    uint32_t deq_cycle = 0x10;
+    bool check = false;
+    bool quiet = false;
+    traffic_config workload;
+    bool have_workload = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--packets" && i + 1 < argc)
+            packets_path = argv[++i];
+        else if (arg == "--bench" && i + 1 < argc)
+            bench = strtoull(argv[++i], NULL, 0);
+        else if (arg == "--gen" && i + 1 < argc) {
+            if (!workload.parse(argv[++i])) {
+                fprintf(stderr, "--gen: %s\n", workload.error().c_str());
+                return 1;
+            }
+            have_workload = true;
+        } else if (arg == "--flows" && i + 1 < argc)
+            flows = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--weight" && i + 1 < argc)
+            weight = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--deq-cycle" && i + 1 < argc)
+            deq_cycle = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--check")
+            check = true;
+        else if (arg == "--quiet")
+            quiet = true;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (flows == 0 || flows > RANK_MAX_FLOWS) {
+        fprintf(stderr, "--flows must be 1..%d\n", RANK_MAX_FLOWS);
+        return 1;
+    }
+
+    // Same initial state as the testbench: the program image in DMEM.
+    const rank_layout_t layout = rank_aot_layout();
+    std::vector < uint32_t > dmem(DCACHE_SIZE, 0);
+    for (unsigned i = 0; i < rank_aot_image_words; i++)
+        dmem[i] = rank_aot_image[i];
+    for (unsigned f = 0; f < flows; f++) {
+        dmem[(layout.weight >> 2) + f] = have_workload ? workload.weight(f) : weight;
+        dmem[(layout.quantum >> 2) + f] = dmem[(layout.weight >> 2) + f];
+    }
+    dmem[layout.deq_cycle >> 2] = deq_cycle;
+
+    iss ref;
+    if (check) {
+        for (unsigned i = 0; i < DCACHE_SIZE; i++)
+            ref.write_dmem(i << 2, dmem[i]);
+        for (unsigned i = 0; i < rank_aot_image_words; i++)
+            ref.write_imem(i << 2, rank_aot_image[i]);
+    }
+
+    packet_source packets;
+    if (!packets_path.empty() && !packets.open(packets_path)) {
+        fprintf(stderr, "Cannot open %s\n", packets_path.c_str());
+        return 1;
+    }
+    if (have_workload)
+        packets.open_generator(workload);
+    packets.open_synthetic(bench, flows);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned long long count = 0;
+    rank_packet_t p;
+
+    while (packets.next(p)) {
+        write_meta(dmem, layout, p);
+        int rc = rank_aot_run(dmem.data(), dmem.size());
+        if (rc != RANK_AOT_END) {
+            fprintf(stderr, "packet %llu: %s\n", count, aot_errors[rc]);
+            return 1;
+        }
+        uint32_t rank = dmem[layout.out >> 2];
+
+        if (check) {
+            uint32_t w[RANK_META_WORDS];
+            rank_meta_words(p, w);
+            for (int i = 0; i < RANK_META_WORDS; i++)
+                ref.write_dmem(layout.meta + 4 * i, w[i]);
+            ref.reset();
+            if (ref.run(1000000) != iss::ISS_END || ref.read_dmem(layout.out) != rank) {
+                fprintf(stderr, "packet %llu: rank %u, ISS %u\n", count, rank, ref.read_dmem(layout.out));
+                return 1;
+            }
+        }
+
+        if (!quiet)
+            printf("%llu %u %u %u\n", count, (unsigned) p.flow_id, (unsigned) p.length, rank);
+        count++;
+    }
+    if (packets.failed())
+        return 1;
+
+    double secs = std::chrono::duration < double > (std::chrono::steady_clock::now() - start).count();
+
+    if (check) {
+        for (unsigned i = 0; i < DCACHE_SIZE; i++) {
+            if (ref.read_dmem(i << 2) != dmem[i]) {
+                fprintf(stderr, "DMEM[0x%x]: 0x%x, ISS 0x%x\n", i << 2, dmem[i], ref.read_dmem(i << 2));
+                return 1;
+            }
+        }
+        fprintf(stderr, "%llu ranks and final DMEM match the ISS\n", count);
+    }
+
+    fprintf(stderr, "%s: %llu packets in %.3f s", rank_aot_source, count, secs);
+    if (secs > 0)
+        fprintf(stderr, " (%.2f M packets/s)", count / secs / 1e6);
+    fprintf(stderr, "\n");
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+	@brief
+	Offline decoder for the binary event trace written by the testbench
+	with --trace (see src/trace_ring.h). Prints one line per record:
+
+		<cycle> <category>.<event> name=value ...
+
+	Usage: trace_decode <trace file> [-c <category>[,<category>...]] [-l <level>]
+
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "globals.h"
+#include "trace_ring.h"
+
+static const char * const aluop_names[] = {
+    "null", "add", "sll", "slt", "sltu", "xor", "srl", "or", "and", "sub", "sra",
+    "mul", "mulh", "mulhsu", "mulhu", "div", "divu", "rem", "remu",
+    "slli", "srli", "srai", "lui", "auipc", "jal",
+    "csrrw", "csrrs", "csrrc", "csrrwi", "csrrsi", "csrrci"
+};
+
+static void print_arg(const char * fmt, uint32_t v) {
+    const char * colon = strchr(fmt, ':');
+    int len = colon ? (int)(colon - fmt) : (int) strlen(fmt);
+    char kind = colon ? colon[1] : 'x';
+
+    printf(" %.*s=", len, fmt);
+    if (kind == 'd')
+        printf("%u", v);
+    else if (kind == 'a' && v <= ALUOP_CSRRCI)
+        printf("%s", aluop_names[v]);
+    else
+        printf("0x%x", v);
+}
+
+static void usage(const char * prog) {
+    fprintf(stderr, "Usage: %s <trace file> [-c <category>[,<category>...]] [-l <level>]\n", prog);
+    fprintf(stderr, "categories:");
+    for (int i = 0; i < TR_CAT_NUM; i++)
+        fprintf(stderr, " %s", trace_cat_names[i]);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    uint32_t mask = (1u << TR_CAT_NUM) - 1;
+    int level = TR_VERBOSE;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+            level = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+            std::string list = argv[++i];
+            mask = 0;
+            size_t start = 0;
+            while (true) {
+                size_t comma = list.find(',', start);
+                std::string name = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+                int cat = 0;
+                while (cat < TR_CAT_NUM && name != trace_cat_names[cat])
+                    cat++;
+                if (cat == TR_CAT_NUM) {
+                    fprintf(stderr, "Unknown category: %s\n", name.c_str());
+                    return 1;
+                }
+                mask |= 1u << cat;
+                if (comma == std::string::npos)
+                    break;
+                start = comma + 1;
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    FILE * in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    trace_file_hdr_t hdr;
+    if (fread(& hdr, sizeof(hdr), 1, in) != 1 || memcmp(hdr.magic, "DRIMTRC1", 8) != 0) {
+        fprintf(stderr, "%s: not a trace file\n", argv[1]);
+        return 1;
+    }
+    if (hdr.version != 1 || hdr.rec_size != sizeof(trace_rec_t)) {
+        fprintf(stderr, "%s: unsupported trace version %u\n", argv[1], hdr.version);
+        return 1;
+    }
+    if (hdr.period == 0)
+        hdr.period = 1;
+
+    unsigned long long count = 0;
+    trace_rec_t r;
+    while (fread(& r, sizeof(r), 1, in) == 1) {
+        if (r.cat >= TR_CAT_NUM || r.code >= TR_CODE_NUM)
+            continue;
+        if (!((mask >> r.cat) & 1) || r.level > level)
+            continue;
+
+        const trace_event_t & ev = trace_events[r.code];
+        printf("%10llu %s.%s", (unsigned long long)(r.time / hdr.period), trace_cat_names[r.cat], ev.name);
+        for (int i = 0; i < 4 && ev.args[i]; i++)
+            print_arg(ev.args[i], r.arg[i]);
+        printf("\n");
+        count++;
+    }
+    fclose(in);
+
+    fprintf(stderr, "%llu records", count);
+    if (hdr.dropped)
+        fprintf(stderr, ", %llu dropped while tracing", (unsigned long long) hdr.dropped);
+    fprintf(stderr, "\n");
+    return 0;
+}